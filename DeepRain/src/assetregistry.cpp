@@ -0,0 +1,243 @@
+#include "assetregistry.h"
+
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+
+// Recurso e estado interno do registro
+struct AssetEntry
+{
+    Asset                            asset;
+    std::vector<AssetLoadedCallback> callbacks;   // Esperando a carga terminar
+    int                              path_hits;   // Pedidos repetidos pelo mesmo caminho
+};
+
+static std::vector<AssetEntry>                              g_Assets;
+static std::unordered_map<std::string, AssetId>             g_AssetsByPath;
+static std::map<std::pair<int, uint64_t>, AssetId>          g_AssetsByContent;
+static int                                                  g_AssetRequests = 0;
+
+// Remove "." e componentes vazios, resolve "dir/.." e usa sempre '/'
+static std::string NormalizePath(const char* path)
+{
+    std::string p(path);
+    for (size_t i = 0; i < p.size(); ++i)
+        if ( p[i] == '\\' )
+            p[i] = '/';
+
+    bool absolute = !p.empty() && p[0] == '/';
+
+    std::vector<std::string> components;
+    size_t start = 0;
+    while ( start <= p.size() )
+    {
+        size_t end = p.find('/', start);
+        if ( end == std::string::npos )
+            end = p.size();
+
+        std::string component = p.substr(start, end - start);
+        if ( component == ".." && !components.empty() && components.back() != ".." )
+            components.pop_back();
+        else if ( !component.empty() && component != "." )
+            components.push_back(component);
+
+        start = end + 1;
+    }
+
+    std::string normalized = absolute ? "/" : "";
+    for (size_t i = 0; i < components.size(); ++i)
+    {
+        if ( i > 0 )
+            normalized += '/';
+        normalized += components[i];
+    }
+    return normalized;
+}
+
+// Os intervalos da arena de geometria e as camadas dos arrays de texturas
+// são destruídos com a arena e os arrays
+static void DeleteGpuResources(const AssetGpuResources& gpu)
+{
+    if ( gpu.texture_id != 0 )
+        glDeleteTextures(1, &gpu.texture_id);
+    if ( gpu.sampler_id != 0 )
+        glDeleteSamplers(1, &gpu.sampler_id);
+}
+
+// Recurso que é dono dos objetos OpenGL usados por "id"
+static AssetId Owner(AssetId id)
+{
+    while ( g_Assets[id].asset.shared_with != ASSET_INVALID )
+        id = g_Assets[id].asset.shared_with;
+    return id;
+}
+
+// Executa as funções que esperavam a carga do recurso
+static void RunCallbacks(AssetId id)
+{
+    std::vector<AssetLoadedCallback> callbacks;
+    callbacks.swap(g_Assets[id].callbacks);
+
+    // Cópia, pois as funções podem adquirir novos recursos (realocando g_Assets)
+    Asset asset = AssetRegistry_Get(id);
+    for (size_t i = 0; i < callbacks.size(); ++i)
+        callbacks[i](asset);
+}
+
+uint64_t AssetRegistry_Hash(const void* data, size_t size, uint64_t hash)
+{
+    // FNV-1a, processando 8 bytes por vez. Não é o FNV-1a padrão (que
+    // processa um byte por vez), mas é várias vezes mais rápido para as
+    // texturas grandes e suficiente para detectar conteúdos iguais.
+    const unsigned char* bytes = (const unsigned char*)data;
+    const uint64_t prime = 0x100000001b3ULL;
+
+    size_t i = 0;
+    for ( ; i + 8 <= size; i += 8)
+    {
+        uint64_t word = 0;
+        for (int k = 0; k < 8; ++k)
+            word |= (uint64_t)bytes[i + k] << (8*k);
+        hash = (hash ^ word) * prime;
+    }
+    for ( ; i < size; ++i)
+        hash = (hash ^ bytes[i]) * prime;
+
+    return hash;
+}
+
+AssetId AssetRegistry_Register(const char* path, AssetType type, bool* is_new)
+{
+    g_AssetRequests += 1;
+
+    std::string normalized = NormalizePath(path);
+
+    std::unordered_map<std::string, AssetId>::iterator it = g_AssetsByPath.find(normalized);
+    if ( it != g_AssetsByPath.end() && g_Assets[it->second].asset.type == type )
+    {
+        g_Assets[it->second].path_hits += 1;
+        *is_new = false;
+        return it->second;
+    }
+
+    AssetEntry entry;
+    entry.asset.path         = normalized;
+    entry.asset.type         = type;
+    entry.asset.content_hash = 0;
+    entry.asset.loaded       = false;
+    entry.asset.shared_with  = ASSET_INVALID;
+    entry.asset.gpu          = AssetGpuResources();
+    entry.asset.gpu_bytes    = 0;
+    entry.path_hits          = 0;
+
+    AssetId id = (AssetId)g_Assets.size();
+    g_Assets.push_back(entry);
+    g_AssetsByPath[normalized] = id;
+
+    *is_new = true;
+    return id;
+}
+
+AssetId AssetRegistry_FindByContent(AssetType type, uint64_t content_hash)
+{
+    std::map<std::pair<int, uint64_t>, AssetId>::iterator it = g_AssetsByContent.find(std::make_pair((int)type, content_hash));
+    if ( it == g_AssetsByContent.end() )
+        return ASSET_INVALID;
+    return it->second;
+}
+
+void AssetRegistry_SetLoaded(AssetId id, uint64_t content_hash, const AssetGpuResources& gpu, size_t gpu_bytes)
+{
+    Asset& asset = g_Assets[id].asset;
+    asset.content_hash = content_hash;
+    asset.loaded       = true;
+    asset.gpu          = gpu;
+    asset.gpu_bytes    = gpu_bytes;
+
+    g_AssetsByContent[std::make_pair((int)asset.type, content_hash)] = id;
+
+    RunCallbacks(id);
+}
+
+void AssetRegistry_ShareWith(AssetId id, AssetId existing)
+{
+    Asset& asset = g_Assets[id].asset;
+    existing = Owner(existing);
+
+    asset.content_hash = g_Assets[existing].asset.content_hash;
+    asset.loaded       = true;
+    asset.shared_with  = existing;
+    asset.gpu          = g_Assets[existing].asset.gpu;
+    asset.gpu_bytes    = 0;
+
+    RunCallbacks(id);
+}
+
+void AssetRegistry_WhenLoaded(AssetId id, const AssetLoadedCallback& callback)
+{
+    if ( g_Assets[id].asset.loaded )
+    {
+        Asset asset = AssetRegistry_Get(id);
+        callback(asset);
+    }
+    else
+        g_Assets[id].callbacks.push_back(callback);
+}
+
+const Asset& AssetRegistry_Get(AssetId id)
+{
+    return g_Assets[Owner(id)].asset;
+}
+
+void AssetRegistry_PrintReport()
+{
+    int    num_resident = 0;
+    int    path_hits = 0;
+    int    content_hits = 0;
+    size_t resident_bytes = 0;
+    size_t saved_bytes = 0;
+
+    for (size_t id = 0; id < g_Assets.size(); ++id)
+    {
+        const AssetEntry& entry = g_Assets[id];
+        if ( !entry.asset.loaded )
+            continue;
+
+        size_t bytes = AssetRegistry_Get((AssetId)id).gpu_bytes;
+
+        // Cada pedido repetido evitou uma nova cópia do recurso na GPU
+        path_hits   += entry.path_hits;
+        saved_bytes += entry.path_hits * bytes;
+
+        if ( entry.asset.shared_with != ASSET_INVALID )
+        {
+            content_hits += 1;
+            saved_bytes  += bytes;
+        }
+        else
+        {
+            num_resident   += 1;
+            resident_bytes += bytes;
+        }
+    }
+
+    printf("Registro de recursos: %d pedidos, %d recursos na GPU (%.1f MB).\n",
+           g_AssetRequests, num_resident, resident_bytes / (1024.0*1024.0));
+    printf("  Reutilizados: %d pelo caminho, %d pelo conteúdo; %.1f MB de memória de vídeo economizados.\n\n",
+           path_hits, content_hits, saved_bytes / (1024.0*1024.0));
+}
+
+void AssetRegistry_Shutdown()
+{
+    for (size_t id = 0; id < g_Assets.size(); ++id)
+    {
+        const Asset& asset = g_Assets[id].asset;
+        if ( asset.loaded && asset.shared_with == ASSET_INVALID )
+            DeleteGpuResources(asset.gpu);
+    }
+
+    g_Assets.clear();
+    g_AssetsByPath.clear();
+    g_AssetsByContent.clear();
+    g_AssetRequests = 0;
+}
@@ -0,0 +1,107 @@
+#ifndef _ASSETREGISTRY_H
+#define _ASSETREGISTRY_H
+
+// Registro dos recursos (modelos e texturas) enviados para a GPU.
+//
+// Cada recurso é identificado pelo caminho do arquivo (normalizado, então
+// "../../data/sphere.obj" e "../../data//./sphere.obj" são o mesmo arquivo) e
+// pelo hash do conteúdo efetivamente enviado para a GPU. Assim:
+//  - pedir de novo um arquivo já pedido não lê nem processa o arquivo outra
+//    vez: o recurso existente é retornado;
+//  - arquivos diferentes com o mesmo conteúdo compartilham os mesmos recursos
+//    de GPU (intervalo na arena de geometria, texturas), em vez de enviar uma
+//    segunda cópia.
+// Todos os modelos e texturas do jogo são usados até o fim da execução: os
+// recursos de GPU só são liberados em AssetRegistry_Shutdown().
+//
+// O registro não pode ser usado por duas threads ao mesmo tempo. Durante a
+// carga, somente a thread principal o utiliza. Durante o jogo, o contexto
+// OpenGL pertence à thread de renderização (veja "renderthread.h"): as
+// tarefas de conclusão que registram os recursos carregados são executadas
+// por ela na troca de quadros, com a thread do jogo parada, e a thread do
+// jogo só pede recursos fora da troca. AssetRegistry_Shutdown() deve ser
+// chamada na thread com o contexto OpenGL, e AssetRegistry_Hash() pode ser
+// usada por qualquer thread.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "geometryarena.h"
+#include "texturearray.h"
+
+typedef int AssetId;
+#define ASSET_INVALID (-1)
+
+// Valor inicial de AssetRegistry_Hash()
+#define ASSET_HASH_SEED 0xcbf29ce484222325ULL
+
+enum AssetType
+{
+    ASSET_MESH,
+    ASSET_TEXTURE
+};
+
+// Recursos de GPU de um recurso. Os campos que não se aplicam ao tipo do
+// recurso ficam com zero.
+struct AssetGpuResources
+{
+    GeometryRange geometry;          // Intervalo da malha na arena de geometria
+    GLuint        texture_id;
+    GLuint        sampler_id;
+    bool          in_texture_array;  // Se verdadeiro, a imagem está em "texture_layer"
+    TextureLayer  texture_layer;     // Camada de um array de texturas
+};
+
+struct Asset
+{
+    std::string       path;         // Caminho normalizado
+    AssetType         type;
+    uint64_t          content_hash;
+    bool              loaded;       // Falso enquanto a carga está agendada
+    AssetId           shared_with;  // Recurso cujos objetos OpenGL são utilizados, ou ASSET_INVALID
+    AssetGpuResources gpu;
+    size_t            gpu_bytes;    // Memória de vídeo ocupada pelos objetos acima
+};
+
+typedef std::function<void(const Asset&)> AssetLoadedCallback;
+
+// Hash FNV-1a de um bloco de memória. Para combinar vários blocos, passe o
+// resultado do anterior como "hash".
+uint64_t AssetRegistry_Hash(const void* data, size_t size, uint64_t hash = ASSET_HASH_SEED);
+
+// Retorna o recurso do arquivo "path". Se o arquivo ainda não foi pedido,
+// registra um novo recurso (ainda não carregado) e retorna true em "*is_new":
+// quem chamou deve então carregá-lo e chamar AssetRegistry_SetLoaded() ou
+// AssetRegistry_ShareWith().
+AssetId AssetRegistry_Register(const char* path, AssetType type, bool* is_new);
+
+// Procura um recurso já carregado com o mesmo conteúdo
+AssetId AssetRegistry_FindByContent(AssetType type, uint64_t content_hash);
+
+// Registra os objetos OpenGL criados para um recurso recém-carregado
+void AssetRegistry_SetLoaded(AssetId id, uint64_t content_hash, const AssetGpuResources& gpu, size_t gpu_bytes);
+
+// Marca um recurso recém-carregado como cópia de "existing" (encontrado com
+// AssetRegistry_FindByContent()), utilizando os objetos OpenGL deste.
+void AssetRegistry_ShareWith(AssetId id, AssetId existing);
+
+// Chama "callback" quando o recurso estiver carregado (imediatamente, se ele
+// já estiver). O Asset passado contém os objetos OpenGL efetivamente usados.
+void AssetRegistry_WhenLoaded(AssetId id, const AssetLoadedCallback& callback);
+
+// Retorna o recurso com os objetos OpenGL efetivamente usados por "id"
+const Asset& AssetRegistry_Get(AssetId id);
+
+// Imprime no terminal quantos pedidos foram atendidos por recursos já
+// existentes e quanta memória de vídeo isso economizou.
+void AssetRegistry_PrintReport();
+
+// Libera todos os recursos de GPU. Chamada antes de destruir o contexto
+// OpenGL.
+void AssetRegistry_Shutdown();
+
+#endif // _ASSETREGISTRY_H
@@ -0,0 +1,229 @@
+#include "debugdraw.h"
+
+#if DEBUGDRAW_ENABLED
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/geometric.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
+
+static const GLchar* const g_VertexShaderSource = ""
+"#version 330 core\n"
+"layout (location = 0) in vec3 position;\n"
+"layout (location = 1) in vec3 color;\n"
+"uniform mat4 view_projection;\n"
+"out vec3 color_v;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = view_projection * vec4(position, 1.0);\n"
+"    color_v = color;\n"
+"}\n";
+
+static const GLchar* const g_FragmentShaderSource = ""
+"#version 330 core\n"
+"in vec3 color_v;\n"
+"out vec4 color;\n"
+"void main()\n"
+"{\n"
+"    color = vec4(color_v, 1.0);\n"
+"}\n";
+
+struct DebugVertex
+{
+    glm::vec3 position;
+    glm::vec3 color;
+};
+
+static bool                     g_Enabled = false;
+static std::vector<DebugVertex> g_Vertices;      // Dois vértices por segmento
+static std::vector<DebugVertex> g_FrameVertices; // Quadro entregue por DebugDraw_SwapFrame()
+static GLuint                   g_ProgramId = 0;
+static GLint                    g_ViewProjectionUniform = -1;
+static GLuint                   g_VertexArrayId = 0;
+static GLuint                   g_BufferId = 0;
+static size_t                   g_BufferCapacity = 0; // Em vértices
+static int                      g_LastLineCount = 0;
+
+// Pontos de um círculo unitário, calculados uma única vez
+static float g_CircleCos[DEBUGDRAW_CIRCLE_SEGMENTS + 1];
+static float g_CircleSin[DEBUGDRAW_CIRCLE_SEGMENTS + 1];
+
+static GLuint CompileShader(GLenum type, const GLchar* source)
+{
+    GLuint shader_id = glCreateShader(type);
+    glShaderSource(shader_id, 1, &source, NULL);
+    glCompileShader(shader_id);
+
+    GLint compiled_ok;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
+    if ( !compiled_ok )
+    {
+        GLint log_length = 0;
+        glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
+        std::vector<GLchar> log(log_length + 1);
+        glGetShaderInfoLog(shader_id, log_length, &log_length, log.data());
+        fprintf(stderr, "ERROR: OpenGL compilation of debug draw shader failed.\n== Start of compilation log\n%s== End of compilation log\n", log.data());
+    }
+    return shader_id;
+}
+
+void DebugDraw_Init()
+{
+    for (int i = 0; i <= DEBUGDRAW_CIRCLE_SEGMENTS; ++i)
+    {
+        float angle = 2.0f * 3.14159265f * i / DEBUGDRAW_CIRCLE_SEGMENTS;
+        g_CircleCos[i] = std::cos(angle);
+        g_CircleSin[i] = std::sin(angle);
+    }
+
+    GLuint vertex_shader_id = CompileShader(GL_VERTEX_SHADER, g_VertexShaderSource);
+    GLuint fragment_shader_id = CompileShader(GL_FRAGMENT_SHADER, g_FragmentShaderSource);
+    g_ProgramId = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    g_ViewProjectionUniform = glGetUniformLocation(g_ProgramId, "view_projection");
+
+    glGenVertexArrays(1, &g_VertexArrayId);
+    glBindVertexArray(g_VertexArrayId);
+
+    glGenBuffers(1, &g_BufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, g_BufferId);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, color));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DebugDraw_SetEnabled(bool enabled)
+{
+    g_Enabled = enabled;
+    if ( !enabled )
+        g_Vertices.clear();
+}
+
+bool DebugDraw_IsEnabled()
+{
+    return g_Enabled;
+}
+
+void DebugDraw_Line(const glm::vec3& a, const glm::vec3& b, const glm::vec3& color)
+{
+    if ( !g_Enabled )
+        return;
+
+    DebugVertex va = { a, color };
+    DebugVertex vb = { b, color };
+    g_Vertices.push_back(va);
+    g_Vertices.push_back(vb);
+}
+
+void DebugDraw_Ray(const glm::vec3& origin, const glm::vec3& direction, float length, const glm::vec3& color)
+{
+    if ( !g_Enabled || glm::length(direction) == 0.0f )
+        return;
+
+    glm::vec3 d = glm::normalize(direction);
+    glm::vec3 end = origin + length * d;
+    DebugDraw_Line(origin, end, color);
+
+    // Ponta da seta: dois segmentos em um plano que contém o raio
+    glm::vec3 up = std::fabs(d.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 side = glm::normalize(glm::cross(d, up));
+    float head = 0.1f * length;
+    DebugDraw_Line(end, end - head * d + 0.5f * head * side, color);
+    DebugDraw_Line(end, end - head * d - 0.5f * head * side, color);
+}
+
+void DebugDraw_Sphere(const glm::vec3& center, float radius, const glm::vec3& color)
+{
+    if ( !g_Enabled )
+        return;
+
+    for (int i = 0; i < DEBUGDRAW_CIRCLE_SEGMENTS; ++i)
+    {
+        float c0 = radius * g_CircleCos[i],   s0 = radius * g_CircleSin[i];
+        float c1 = radius * g_CircleCos[i+1], s1 = radius * g_CircleSin[i+1];
+        DebugDraw_Line(center + glm::vec3(c0, s0, 0.0f), center + glm::vec3(c1, s1, 0.0f), color);
+        DebugDraw_Line(center + glm::vec3(c0, 0.0f, s0), center + glm::vec3(c1, 0.0f, s1), color);
+        DebugDraw_Line(center + glm::vec3(0.0f, c0, s0), center + glm::vec3(0.0f, c1, s1), color);
+    }
+}
+
+void DebugDraw_Box(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::vec3& color)
+{
+    if ( !g_Enabled )
+        return;
+
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; ++i)
+        corners[i] = glm::vec3((i & 1) ? bbox_max.x : bbox_min.x,
+                               (i & 2) ? bbox_max.y : bbox_min.y,
+                               (i & 4) ? bbox_max.z : bbox_min.z);
+
+    // Cada aresta liga dois cantos que diferem em um único eixo
+    for (int i = 0; i < 8; ++i)
+        for (int axis = 1; axis < 8; axis <<= 1)
+            if ( (i & axis) == 0 )
+                DebugDraw_Line(corners[i], corners[i | axis], color);
+}
+
+void DebugDraw_SwapFrame()
+{
+    g_FrameVertices.swap(g_Vertices);
+    g_Vertices.clear();
+    g_LastLineCount = (int)(g_FrameVertices.size() / 2);
+}
+
+void DebugDraw_Flush(const glm::mat4& view, const glm::mat4& projection)
+{
+    if ( g_FrameVertices.empty() )
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, g_BufferId);
+    if ( g_FrameVertices.size() > g_BufferCapacity )
+        g_BufferCapacity = std::max(g_FrameVertices.size(), 2 * g_BufferCapacity);
+    glBufferData(GL_ARRAY_BUFFER, g_BufferCapacity * sizeof(DebugVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, g_FrameVertices.size() * sizeof(DebugVertex), g_FrameVertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // As linhas são escondidas pela cena, mas não escondem umas às outras
+    glDepthMask(GL_FALSE);
+
+    glUseProgram(g_ProgramId);
+    glm::mat4 view_projection = projection * view;
+    glUniformMatrix4fv(g_ViewProjectionUniform, 1, GL_FALSE, glm::value_ptr(view_projection));
+
+    glBindVertexArray(g_VertexArrayId);
+    glDrawArrays(GL_LINES, 0, (GLsizei)g_FrameVertices.size());
+    glBindVertexArray(0);
+
+    glUseProgram(0);
+    glDepthMask(GL_TRUE);
+}
+
+int DebugDraw_LastLineCount()
+{
+    return g_LastLineCount;
+}
+
+void DebugDraw_Shutdown()
+{
+    glDeleteBuffers(1, &g_BufferId);
+    glDeleteVertexArrays(1, &g_VertexArrayId);
+    glDeleteProgram(g_ProgramId);
+    g_BufferId = 0;
+    g_VertexArrayId = 0;
+    g_ProgramId = 0;
+    g_Vertices.clear();
+    g_FrameVertices.clear();
+}
+
+#endif // DEBUGDRAW_ENABLED
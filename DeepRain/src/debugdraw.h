@@ -0,0 +1,91 @@
+#ifndef _DEBUGDRAW_H
+#define _DEBUGDRAW_H
+
+// Desenho de depuração: esferas de colisão, caixas, linhas e raios.
+//
+// As primitivas são acumuladas durante o quadro como segmentos de reta em
+// um único vetor (uma esfera vira três círculos, uma caixa as suas 12
+// arestas) e desenhadas por DebugDraw_Flush() com um único glDrawArrays
+// (GL_LINES), com teste de profundidade contra a cena e sem escrita no
+// Z-buffer.
+//
+// O desenho é ligado e desligado durante o jogo com DebugDraw_SetEnabled()
+// (tecla F3, veja KeyCallback() em "main.cpp"); desligado, as funções
+// retornam sem fazer nada. Nas compilações de release (com NDEBUG definido)
+// o módulo inteiro é removido: as funções abaixo viram funções vazias
+// "inline" e DebugDraw_IsEnabled() é a constante false, de modo que o
+// compilador também elimina o código que prepara as primitivas, desde que
+// ele fique dentro de "if ( DebugDraw_IsEnabled() )".
+//
+// As primitivas são acumuladas na thread do jogo e entregues à thread de
+// renderização por DebugDraw_SwapFrame(), chamada com as duas threads
+// sincronizadas (veja "renderthread.h"). DebugDraw_Init(), DebugDraw_Flush()
+// e DebugDraw_Shutdown() devem ser chamadas na thread que possui o contexto
+// OpenGL; as demais, na thread do jogo.
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#ifndef DEBUGDRAW_ENABLED
+#ifdef NDEBUG
+#define DEBUGDRAW_ENABLED 0
+#else
+#define DEBUGDRAW_ENABLED 1
+#endif
+#endif
+
+// Número de segmentos dos círculos das esferas
+#define DEBUGDRAW_CIRCLE_SEGMENTS 24
+
+#if DEBUGDRAW_ENABLED
+
+// Cria o programa de GPU e o buffer de vértices. Chamada depois da criação
+// do contexto OpenGL.
+void DebugDraw_Init();
+
+void DebugDraw_SetEnabled(bool enabled);
+bool DebugDraw_IsEnabled();
+
+void DebugDraw_Line(const glm::vec3& a, const glm::vec3& b, const glm::vec3& color);
+
+// Segmento de "origin" até origin + length*direction, com uma pequena ponta
+// de seta no fim. "direction" não precisa ser unitário.
+void DebugDraw_Ray(const glm::vec3& origin, const glm::vec3& direction, float length, const glm::vec3& color);
+
+// Três círculos, nos planos XY, XZ e YZ
+void DebugDraw_Sphere(const glm::vec3& center, float radius, const glm::vec3& color);
+
+// Caixa alinhada aos eixos
+void DebugDraw_Box(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::vec3& color);
+
+// Entrega as primitivas acumuladas no quadro para DebugDraw_Flush(), e
+// recomeça a acumulação
+void DebugDraw_SwapFrame();
+
+// Desenha as primitivas entregues. Chamada depois dos desenhos da cena
+// (RenderQueue_Execute()), com as mesmas matrizes.
+void DebugDraw_Flush(const glm::mat4& view, const glm::mat4& projection);
+
+// Número de segmentos do último quadro entregue
+int DebugDraw_LastLineCount();
+
+// Destrói o programa e o buffer. Chamada antes de destruir o contexto OpenGL.
+void DebugDraw_Shutdown();
+
+#else
+
+inline void DebugDraw_Init() {}
+inline void DebugDraw_SetEnabled(bool) {}
+inline bool DebugDraw_IsEnabled() { return false; }
+inline void DebugDraw_Line(const glm::vec3&, const glm::vec3&, const glm::vec3&) {}
+inline void DebugDraw_Ray(const glm::vec3&, const glm::vec3&, float, const glm::vec3&) {}
+inline void DebugDraw_Sphere(const glm::vec3&, float, const glm::vec3&) {}
+inline void DebugDraw_Box(const glm::vec3&, const glm::vec3&, const glm::vec3&) {}
+inline void DebugDraw_SwapFrame() {}
+inline void DebugDraw_Flush(const glm::mat4&, const glm::mat4&) {}
+inline int  DebugDraw_LastLineCount() { return 0; }
+inline void DebugDraw_Shutdown() {}
+
+#endif // DEBUGDRAW_ENABLED
+
+#endif // _DEBUGDRAW_H
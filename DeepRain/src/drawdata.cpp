@@ -0,0 +1,336 @@
+#include "drawdata.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+#include <glm/mat3x3.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+// glBufferStorage() e as suas constantes não fazem parte do OpenGL 3.3
+// carregado pelo GLAD, então são obtidas do driver em DrawData_Init().
+#define DRAWDATA_MAP_PERSISTENT_BIT 0x0040
+#define DRAWDATA_MAP_COHERENT_BIT   0x0080
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Bloco "FrameData", com o layout std140
+struct FrameRecord
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 camera_position;
+};
+
+static GLuint g_FrameBufferId = 0;
+static GLuint g_MaterialBufferId = 0;
+static GLuint g_DrawBufferId = 0;
+static size_t g_Stride = sizeof(DrawRecord);
+
+// Buffer circular mapeado permanentemente (NULL sem GL_ARB_buffer_storage)
+static BufferStorageProc g_BufferStorage = NULL;
+static unsigned char*    g_Persistent = NULL;
+static GLsync            g_SegmentFences[DRAWDATA_NUM_SEGMENTS];
+
+static size_t g_SegmentSize = DRAWDATA_SEGMENT_SIZE; // Cresce em GrowDrawBuffer()
+static size_t g_Segment = 0;  // Parte do quadro atual
+static size_t g_Offset = 0;   // Próxima posição livre, em bytes desde o início do buffer
+
+// Cria o buffer circular, com DRAWDATA_NUM_SEGMENTS partes de g_SegmentSize
+// bytes, mapeado permanentemente se possível
+static void CreateDrawBuffer()
+{
+    size_t buffer_size = g_SegmentSize * DRAWDATA_NUM_SEGMENTS;
+
+    glGenBuffers(1, &g_DrawBufferId);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_DrawBufferId);
+
+    if ( g_BufferStorage != NULL )
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | DRAWDATA_MAP_PERSISTENT_BIT | DRAWDATA_MAP_COHERENT_BIT;
+        g_BufferStorage(GL_UNIFORM_BUFFER, buffer_size, NULL, flags);
+        g_Persistent = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, buffer_size, flags);
+        if ( g_Persistent == NULL )
+        {
+            // O armazenamento criado com glBufferStorage() é imutável: um
+            // novo buffer é necessário para o modo sem a extensão.
+            fprintf(stderr, "ERROR: Cannot map draw data buffer persistently.\n");
+            g_BufferStorage = NULL;
+            glDeleteBuffers(1, &g_DrawBufferId);
+            glGenBuffers(1, &g_DrawBufferId);
+            glBindBuffer(GL_UNIFORM_BUFFER, g_DrawBufferId);
+        }
+    }
+
+    if ( g_Persistent == NULL )
+        glBufferData(GL_UNIFORM_BUFFER, buffer_size, NULL, GL_STREAM_DRAW);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void DrawData_Init()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if ( alignment < 1 )
+        alignment = 1;
+    g_Stride = (sizeof(DrawRecord) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &g_FrameBufferId);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_FrameBufferId);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameRecord), NULL, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, DRAWDATA_FRAME_BINDING, g_FrameBufferId);
+
+    // O bloco tem sempre DRAWDATA_MAX_MATERIALS elementos; os não escritos
+    // por DrawData_SetMaterials() ficam com zero.
+    std::vector<MaterialRecord> materials(DRAWDATA_MAX_MATERIALS);
+    memset(materials.data(), 0, materials.size() * sizeof(MaterialRecord));
+    glGenBuffers(1, &g_MaterialBufferId);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_MaterialBufferId);
+    glBufferData(GL_UNIFORM_BUFFER, materials.size() * sizeof(MaterialRecord), materials.data(), GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, DRAWDATA_MATERIAL_BINDING, g_MaterialBufferId);
+
+    g_BufferStorage = NULL;
+    if ( glfwExtensionSupported("GL_ARB_buffer_storage") )
+        g_BufferStorage = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+
+    g_SegmentSize = DRAWDATA_SEGMENT_SIZE;
+    CreateDrawBuffer();
+
+    for (size_t i = 0; i < DRAWDATA_NUM_SEGMENTS; ++i)
+        g_SegmentFences[i] = 0;
+    g_Segment = 0;
+    g_Offset = 0;
+}
+
+bool DrawData_IsPersistent()
+{
+    return g_Persistent != NULL;
+}
+
+void DrawData_BindProgram(GLuint program_id)
+{
+    GLuint frame_block = glGetUniformBlockIndex(program_id, "FrameData");
+    if ( frame_block != GL_INVALID_INDEX )
+        glUniformBlockBinding(program_id, frame_block, DRAWDATA_FRAME_BINDING);
+
+    GLuint draw_block = glGetUniformBlockIndex(program_id, "DrawData");
+    if ( draw_block != GL_INVALID_INDEX )
+        glUniformBlockBinding(program_id, draw_block, DRAWDATA_DRAW_BINDING);
+
+    GLuint material_block = glGetUniformBlockIndex(program_id, "MaterialData");
+    if ( material_block != GL_INVALID_INDEX )
+        glUniformBlockBinding(program_id, material_block, DRAWDATA_MATERIAL_BINDING);
+}
+
+void DrawData_SetFrame(const glm::mat4& view, const glm::mat4& projection)
+{
+    FrameRecord frame;
+    frame.view = view;
+    frame.projection = projection;
+    // Posição da câmera: a origem do sistema de coordenadas da câmera,
+    // levada para o sistema global pela inversa da matriz "view".
+    frame.camera_position = glm::inverse(view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // O conteúdo antigo é descartado, para não esperar a GPU terminar de
+    // ler o quadro anterior.
+    glBindBuffer(GL_UNIFORM_BUFFER, g_FrameBufferId);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameRecord), &frame, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void DrawData_SetMaterials(const MaterialRecord* materials, size_t count)
+{
+    if ( count > DRAWDATA_MAX_MATERIALS )
+        count = DRAWDATA_MAX_MATERIALS;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, g_MaterialBufferId);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(MaterialRecord), materials);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void DrawData_MakeRecord(DrawRecord* record, const glm::mat4& model, int object_id, const glm::vec3& bbox_min, const glm::vec3& bbox_max)
+{
+    glm::mat3 normal_matrix = glm::inverseTranspose(glm::mat3(model));
+
+    record->model = model;
+    for (int column = 0; column < 3; ++column)
+        record->normal_matrix[column] = glm::vec4(normal_matrix[column], 0.0f);
+    record->bbox_min = glm::vec4(bbox_min, 1.0f);
+    record->bbox_max = glm::vec4(bbox_max, 1.0f);
+    record->object_id = object_id;
+    record->padding[0] = record->padding[1] = record->padding[2] = 0;
+}
+
+size_t DrawData_Stride()
+{
+    return g_Stride;
+}
+
+size_t DrawData_MaxRecords()
+{
+    return g_SegmentSize / g_Stride;
+}
+
+// Espera a GPU terminar de ler a parte "segment" do buffer circular
+static void WaitSegment(size_t segment)
+{
+    GLsync fence = g_SegmentFences[segment];
+    if ( fence == 0 )
+        return;
+
+    while ( glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED )
+        ;
+    glDeleteSync(fence);
+    g_SegmentFences[segment] = 0;
+}
+
+// Substitui o buffer circular por um maior, no meio de um quadro. Os
+// desenhos do quadro atual só são feitos depois de todos os envios, então os
+// seus registros são copiados para o novo buffer nas mesmas posições: a
+// parte do quadro atual passa a ser a parte 0, que começa no início do
+// buffer e vai além do fim do novo envio. As partes dos quadros anteriores
+// ficam no buffer antigo, que o driver só destrói quando a GPU termina de
+// usá-lo.
+static void GrowDrawBuffer(size_t size)
+{
+    size_t segment_start = g_Segment * g_SegmentSize;
+    GLuint old_buffer_id = g_DrawBufferId;
+    bool   old_persistent = g_Persistent != NULL;
+
+    g_SegmentSize = std::max(2 * g_SegmentSize, g_Offset + size);
+    g_Persistent = NULL;
+    CreateDrawBuffer();
+
+    if ( g_Offset > segment_start )
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, old_buffer_id);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, g_DrawBufferId);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, segment_start, segment_start, g_Offset - segment_start);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    if ( old_persistent )
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, old_buffer_id);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &old_buffer_id);
+
+    // As cercas eram das partes do buffer antigo
+    for (size_t i = 0; i < DRAWDATA_NUM_SEGMENTS; ++i)
+    {
+        if ( g_SegmentFences[i] != 0 )
+            glDeleteSync(g_SegmentFences[i]);
+        g_SegmentFences[i] = 0;
+    }
+    g_Segment = 0;
+
+    printf("Buffer de registros de desenho aumentado para %d KB por quadro.\n", (int)(g_SegmentSize / 1024));
+}
+
+GLintptr DrawData_Upload(const DrawRecord* records, size_t count)
+{
+    size_t size = count * g_Stride;
+
+    // Os registros já enviados neste quadro ainda não foram lidos pela GPU
+    // (os desenhos vêm depois de todos os envios): sem espaço na parte do
+    // quadro, o buffer cresce, em vez de passar para outra parte.
+    if ( g_Offset + size > (g_Segment + 1) * g_SegmentSize )
+        GrowDrawBuffer(size);
+
+    GLintptr offset = (GLintptr)g_Offset;
+    if ( g_Persistent != NULL )
+    {
+        for (size_t i = 0; i < count; ++i)
+            memcpy(g_Persistent + g_Offset + i * g_Stride, &records[i], sizeof(DrawRecord));
+        g_Offset += size;
+        return offset;
+    }
+
+    // Cada parte é escrita uma única vez entre dois descartes do buffer
+    // (veja DrawData_EndFrame()), então a GPU não está lendo esta posição.
+    glBindBuffer(GL_UNIFORM_BUFFER, g_DrawBufferId);
+    unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if ( mapped != NULL )
+    {
+        for (size_t i = 0; i < count; ++i)
+            memcpy(mapped + i * g_Stride, &records[i], sizeof(DrawRecord));
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            glBufferSubData(GL_UNIFORM_BUFFER, offset + i * g_Stride, sizeof(DrawRecord), &records[i]);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    g_Offset += size;
+    return offset;
+}
+
+void DrawData_BindRecord(GLintptr offset)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAWDATA_DRAW_BINDING, g_DrawBufferId, offset, sizeof(DrawRecord));
+}
+
+void DrawData_EndFrame()
+{
+    // Os desenhos que leem a parte do quadro já foram enviados: a cerca só
+    // sinaliza quando a GPU termina todos eles
+    if ( g_Persistent != NULL )
+    {
+        if ( g_SegmentFences[g_Segment] != 0 )
+            glDeleteSync(g_SegmentFences[g_Segment]);
+        g_SegmentFences[g_Segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    g_Segment = (g_Segment + 1) % DRAWDATA_NUM_SEGMENTS;
+    g_Offset = g_Segment * g_SegmentSize;
+
+    if ( g_Persistent != NULL )
+        WaitSegment(g_Segment);
+    else if ( g_Segment == 0 )
+    {
+        // Sem cercas: ao voltar para o início, descartamos o conteúdo
+        // antigo, como em Instancing_Upload()
+        glBindBuffer(GL_UNIFORM_BUFFER, g_DrawBufferId);
+        glBufferData(GL_UNIFORM_BUFFER, g_SegmentSize * DRAWDATA_NUM_SEGMENTS, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+}
+
+void DrawData_Shutdown()
+{
+    for (size_t i = 0; i < DRAWDATA_NUM_SEGMENTS; ++i)
+    {
+        if ( g_SegmentFences[i] != 0 )
+            glDeleteSync(g_SegmentFences[i]);
+        g_SegmentFences[i] = 0;
+    }
+
+    if ( g_Persistent != NULL )
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, g_DrawBufferId);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        g_Persistent = NULL;
+    }
+
+    if ( g_DrawBufferId != 0 )
+        glDeleteBuffers(1, &g_DrawBufferId);
+    if ( g_FrameBufferId != 0 )
+        glDeleteBuffers(1, &g_FrameBufferId);
+    if ( g_MaterialBufferId != 0 )
+        glDeleteBuffers(1, &g_MaterialBufferId);
+    g_DrawBufferId = 0;
+    g_FrameBufferId = 0;
+    g_MaterialBufferId = 0;
+    g_Segment = 0;
+    g_Offset = 0;
+    g_SegmentSize = DRAWDATA_SEGMENT_SIZE;
+}
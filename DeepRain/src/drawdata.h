@@ -0,0 +1,149 @@
+#ifndef _DRAWDATA_H
+#define _DRAWDATA_H
+
+// Dados dos desenhos em buffers de variáveis uniformes (uniform buffer
+// objects, OpenGL 3.1), no lugar de chamadas a glUniform*().
+//
+// Os shaders declaram dois blocos de variáveis uniformes (veja
+// "shader_vertex.glsl" e "shader_fragment.glsl"):
+//
+//  - "FrameData": as matrizes "view" e "projection" e a posição da câmera,
+//    escritas uma vez por quadro com DrawData_SetFrame().
+//
+//  - "DrawData": a matriz "model", a matriz das normais (a inversa da
+//    transposta de "model", calculada na CPU), a caixa do modelo e o
+//    "object_id" de um desenho (DrawRecord). Os registros de todos os
+//    desenhos de uma fila (veja "renderqueue.h") são copiados de uma só vez
+//    para um buffer circular com DrawData_Upload(), e cada desenho apenas
+//    escolhe o seu registro com DrawData_BindRecord() (glBindBufferRange).
+//
+//  - "MaterialData": a tabela de materiais (MaterialRecord), indexada pelo
+//    "object_id" de cada desenho, com as imagens (array de texturas e
+//    camada, veja "texturearray.h") e os parâmetros do material. Escrita com
+//    DrawData_SetMaterials() quando muda (por exemplo, quando uma textura
+//    termina de carregar). O mapeamento das coordenadas de textura e o
+//    modelo de iluminação não fazem parte da tabela: cada combinação tem o
+//    seu próprio programa de GPU (veja "shaderpermutation.h").
+//
+// O buffer circular é dividido em DRAWDATA_NUM_SEGMENTS partes, uma por
+// quadro. Os desenhos de um quadro só são feitos depois de todos os seus
+// envios, então um quadro nunca reutiliza o espaço que ele mesmo escreveu:
+// se os registros do quadro não cabem na sua parte, o buffer inteiro é
+// substituído por um maior, com os registros já enviados nas mesmas
+// posições.
+//
+// Se o driver oferece GL_ARB_buffer_storage (OpenGL 4.4), o buffer circular
+// fica mapeado permanentemente na memória (GL_MAP_PERSISTENT_BIT): os
+// registros são copiados diretamente, sem nenhuma chamada ao driver. No fim
+// de cada quadro, depois dos desenhos, uma cerca (glFenceSync) marca a parte
+// do quadro, e antes de reutilizar uma parte esperamos a GPU terminar o
+// quadro que a leu. Sem a extensão, cada envio é feito com
+// glMapBufferRange(), como o buffer de instâncias (veja "instancing.h"), e o
+// buffer é descartado (glBufferData) quando o quadro volta para a primeira
+// parte.
+//
+// Todas as funções devem ser chamadas na thread de renderização (veja
+// "renderthread.h").
+
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Pontos de ligação (binding points) dos blocos
+#define DRAWDATA_FRAME_BINDING    0
+#define DRAWDATA_DRAW_BINDING     1
+#define DRAWDATA_MATERIAL_BINDING 2
+
+// Tamanho da tabela de materiais ("MAX_MATERIALS" em "shader_fragment.glsl")
+#define DRAWDATA_MAX_MATERIALS 32
+
+// Tamanho inicial de cada parte do buffer circular, em bytes, e número de
+// partes
+#define DRAWDATA_SEGMENT_SIZE  (256 * 1024)
+#define DRAWDATA_NUM_SEGMENTS  3
+
+// Bloco "DrawData", com o layout std140
+struct DrawRecord
+{
+    glm::mat4 model;
+    glm::vec4 normal_matrix[3];  // mat3: uma coluna por vec4
+    glm::vec4 bbox_min;
+    glm::vec4 bbox_max;
+    GLint     object_id;
+    GLint     padding[3];
+};
+
+// Mapeamento das coordenadas de textura de um material ("UV_MODE" nos
+// shaders, com os mesmos valores em "shader_fragment.glsl")
+#define MATERIAL_UV_TEXCOORDS 0  // Coordenadas do arquivo OBJ, multiplicadas por "uv_scale"
+#define MATERIAL_UV_SPHERE    1  // Projeção esférica a partir do centro da caixa do modelo
+#define MATERIAL_UV_PLANAR_XY 2  // Projeção no plano XY da caixa do modelo
+
+// Modelo de iluminação de um material ("LIGHTING" nos shaders, com os mesmos
+// valores)
+#define MATERIAL_LIGHTING_LAMBERT   0  // Imagem difusa com o termo de Lambert
+#define MATERIAL_LIGHTING_DAY_NIGHT 1  // Imagem "detail" no lado escuro, e Blinn-Phong
+#define MATERIAL_LIGHTING_DETAIL    2  // Soma da imagem difusa e da imagem "detail"
+#define MATERIAL_LIGHTING_VERTEX    3  // Calculada por vértice, em "shader_vertex.glsl"
+
+// Elemento do bloco "MaterialData", com o layout std140
+struct MaterialRecord
+{
+    GLint   texture_array;  // Imagem difusa (veja "texturearray.h"), ou -1 se
+    GLint   texture_layer;  // ainda não carregada (cinza)
+    GLint   detail_array;   // Segunda imagem, lida só pelos modelos de
+    GLint   detail_layer;   // iluminação que a utilizam, ou -1
+    GLfloat uv_scale;
+    GLfloat alpha;
+    GLfloat padding[2];
+};
+
+// Cria os buffers. Chamada uma vez, depois da criação do contexto OpenGL.
+void DrawData_Init();
+
+// Verdadeiro se o buffer circular está mapeado permanentemente
+bool DrawData_IsPersistent();
+
+// Liga os blocos "FrameData" e "DrawData" de um programa de GPU aos pontos
+// de ligação acima. Chamada depois de cada (re)criação do programa.
+void DrawData_BindProgram(GLuint program_id);
+
+// Escreve o bloco "FrameData" do quadro
+void DrawData_SetFrame(const glm::mat4& view, const glm::mat4& projection);
+
+// Escreve a tabela de materiais (no máximo DRAWDATA_MAX_MATERIALS)
+void DrawData_SetMaterials(const MaterialRecord* materials, size_t count);
+
+// Preenche um registro, calculando a matriz das normais
+void DrawData_MakeRecord(DrawRecord* record, const glm::mat4& model, int object_id, const glm::vec3& bbox_min, const glm::vec3& bbox_max);
+
+// Copia "count" registros para a parte do quadro atual no buffer circular e
+// retorna a posição (em bytes) do primeiro. O registro i fica em
+// offset + i * DrawData_Stride(). Se o buffer cresce, as posições já
+// retornadas no quadro continuam válidas, mas os registros ligados antes do
+// envio com DrawData_BindRecord() devem ser ligados de novo.
+GLintptr DrawData_Upload(const DrawRecord* records, size_t count);
+
+// Distância entre registros consecutivos no buffer circular: o tamanho do
+// registro arredondado para GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+size_t DrawData_Stride();
+
+// Número de registros que cabem em uma parte do buffer circular, no tamanho
+// atual
+size_t DrawData_MaxRecords();
+
+// Utiliza o registro em "offset" nos próximos desenhos
+void DrawData_BindRecord(GLintptr offset);
+
+// Chamada uma vez por quadro, depois de glfwSwapBuffers() (com todos os
+// desenhos do quadro já enviados): coloca a cerca da parte atual do buffer
+// circular e passa para a próxima.
+void DrawData_EndFrame();
+
+// Destrói os buffers. Chamada antes de destruir o contexto OpenGL.
+void DrawData_Shutdown();
+
+#endif // _DRAWDATA_H
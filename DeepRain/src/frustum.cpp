@@ -0,0 +1,165 @@
+#include "frustum.h"
+
+#include <cmath>
+#include <atomic>
+
+#include "jobs.h"
+
+// SSE2 faz parte de todo processador x86 de 64 bits. Em outras arquiteturas
+// (por exemplo, Macs com processador ARM) utilizamos somente o código escalar.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+Frustum Frustum_FromMatrix(const glm::mat4& m)
+{
+    // As linhas da matriz (GLM guarda as colunas: m[coluna][linha])
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i)
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = row[3] + row[0]; // Esquerda
+    frustum.planes[1] = row[3] - row[0]; // Direita
+    frustum.planes[2] = row[3] + row[1]; // Baixo
+    frustum.planes[3] = row[3] - row[1]; // Cima
+    frustum.planes[4] = row[3] + row[2]; // Perto
+    frustum.planes[5] = row[3] - row[2]; // Longe
+
+    // Os planos não precisam ser normalizados para o teste de interseção
+    return frustum;
+}
+
+void Frustum_ClearBoxes(FrustumBoxes* boxes)
+{
+    for (int c = 0; c < 3; ++c)
+    {
+        boxes->center[c].clear();
+        boxes->extent[c].clear();
+    }
+}
+
+void Frustum_AddBox(FrustumBoxes* boxes, const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model)
+{
+    glm::vec3 center = (bbox_min + bbox_max) * 0.5f;
+    glm::vec3 extent = (bbox_max - bbox_min) * 0.5f;
+
+    // A caixa transformada é envolvida pela caixa com o centro transformado
+    // e a metade do tamanho multiplicada pelo valor absoluto da parte 3x3 da
+    // matriz (Arvo, "Transforming Axis-Aligned Bounding Boxes", 1990).
+    for (int r = 0; r < 3; ++r)
+    {
+        float c = model[3][r];
+        float e = 0.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+            c += model[k][r] * center[k];
+            e += std::fabs(model[k][r]) * extent[k];
+        }
+        boxes->center[r].push_back(c);
+        boxes->extent[r].push_back(e);
+    }
+}
+
+// Testa as caixas [begin, end) com código escalar
+static size_t CullBoxes(const Frustum& frustum, const FrustumBoxes& boxes, size_t begin, size_t end, uint8_t* visible)
+{
+    size_t num_visible = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+
+            // Distância do centro ao plano, somada à maior distância que um
+            // canto da caixa pode estar do centro na direção da normal.
+            float distance = plane.x * boxes.center[0][i] + plane.y * boxes.center[1][i] + plane.z * boxes.center[2][i] + plane.w;
+            float radius = std::fabs(plane.x) * boxes.extent[0][i] + std::fabs(plane.y) * boxes.extent[1][i] + std::fabs(plane.z) * boxes.extent[2][i];
+            inside = distance + radius >= 0.0f;
+        }
+        visible[i] = inside ? 1 : 0;
+        num_visible += visible[i];
+    }
+    return num_visible;
+}
+
+#ifdef FRUSTUM_USE_SSE2
+// Como acima, de 4 em 4 caixas, a partir de "begin" e enquanto restarem 4
+// caixas. Retorna a posição da primeira caixa não testada em "*next".
+static size_t CullBoxes4(const Frustum& frustum, const FrustumBoxes& boxes, size_t begin, size_t end, uint8_t* visible, size_t* next)
+{
+    __m128 plane[6][4];
+    __m128 abs_plane[6][3];
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int k = 0; k < 4; ++k)
+            plane[p][k] = _mm_set1_ps(frustum.planes[p][k]);
+        for (int k = 0; k < 3; ++k)
+            abs_plane[p][k] = _mm_andnot_ps(sign_mask, plane[p][k]);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    size_t num_visible = 0;
+    size_t i = begin;
+    for ( ; i + 4 <= end; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&boxes.center[0][i]);
+        __m128 cy = _mm_loadu_ps(&boxes.center[1][i]);
+        __m128 cz = _mm_loadu_ps(&boxes.center[2][i]);
+        __m128 ex = _mm_loadu_ps(&boxes.extent[0][i]);
+        __m128 ey = _mm_loadu_ps(&boxes.extent[1][i]);
+        __m128 ez = _mm_loadu_ps(&boxes.extent[2][i]);
+
+        // Bits ligados nas caixas inteiramente fora de algum plano
+        __m128 outside = zero;
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane[p][0], cx), _mm_mul_ps(plane[p][1], cy)),
+                                         _mm_add_ps(_mm_mul_ps(plane[p][2], cz), plane[p][3]));
+            __m128 radius   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_plane[p][0], ex), _mm_mul_ps(abs_plane[p][1], ey)),
+                                         _mm_mul_ps(abs_plane[p][2], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; ++k)
+        {
+            visible[i + k] = (mask & (1 << k)) ? 0 : 1;
+            num_visible += visible[i + k];
+        }
+    }
+
+    *next = i;
+    return num_visible;
+}
+#endif
+
+static size_t CullRange(const Frustum& frustum, const FrustumBoxes& boxes, size_t begin, size_t end, uint8_t* visible)
+{
+    size_t num_visible = 0;
+#ifdef FRUSTUM_USE_SSE2
+    num_visible += CullBoxes4(frustum, boxes, begin, end, visible, &begin);
+#endif
+    num_visible += CullBoxes(frustum, boxes, begin, end, visible);
+    return num_visible;
+}
+
+size_t Frustum_CullBoxes(const Frustum& frustum, const FrustumBoxes& boxes, uint8_t* visible)
+{
+    const size_t num_boxes = boxes.center[0].size();
+
+    // Listas pequenas são testadas inteiramente pela thread que chamou
+    if ( num_boxes < FRUSTUM_MIN_BOXES_PER_BATCH )
+        return CullRange(frustum, boxes, 0, num_boxes, visible);
+
+    std::atomic<size_t> num_visible(0);
+    Jobs_ParallelFor(num_boxes, FRUSTUM_MIN_BOXES_PER_BATCH,
+        [&](size_t begin, size_t end, size_t)
+        {
+            num_visible += CullRange(frustum, boxes, begin, end, visible);
+        });
+    return num_visible;
+}
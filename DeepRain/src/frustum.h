@@ -0,0 +1,59 @@
+#ifndef _FRUSTUM_H
+#define _FRUSTUM_H
+
+// Descarte de objetos fora do campo de visão (frustum culling).
+//
+// Os seis planos do frustum são extraídos da matriz projection*view
+// (Gribb e Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+// World-View-Projection Matrix", 2001). Cada objeto é representado pela
+// axis-aligned bounding box (AABB) do seu modelo, transformada para o espaço
+// do mundo; a caixa está fora do frustum se estiver inteiramente do lado de
+// fora de algum dos planos.
+//
+// As caixas são guardadas como estrutura de vetores (um vetor para cada
+// coordenada) e testadas de 4 em 4 com instruções SIMD (SSE2), quando
+// disponíveis. Listas grandes são divididas entre as threads auxiliares
+// (veja "jobs.h").
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Listas com pelo menos este número de caixas são testadas em paralelo
+#define FRUSTUM_MIN_BOXES_PER_BATCH 1024
+
+// Planos (a,b,c,d), com a normal (a,b,c) apontando para dentro: um ponto p
+// está dentro do frustum se a*p.x + b*p.y + c*p.z + d >= 0 para os seis.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Caixas no espaço do mundo, dadas pelo centro e pela metade do tamanho
+// (extent) em cada eixo.
+struct FrustumBoxes
+{
+    std::vector<float> center[3];
+    std::vector<float> extent[3];
+};
+
+// Extrai os planos do frustum da matriz projection*view
+Frustum Frustum_FromMatrix(const glm::mat4& projection_view);
+
+// Esvazia a lista de caixas, mantendo a memória alocada
+void Frustum_ClearBoxes(FrustumBoxes* boxes);
+
+// Adiciona à lista a caixa que envolve a AABB (bbox_min, bbox_max) de um
+// modelo transformada pela matriz de modelagem "model".
+void Frustum_AddBox(FrustumBoxes* boxes, const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model);
+
+// Testa todas as caixas da lista. "visible" recebe 1 para as caixas que
+// intersectam o frustum e 0 para as demais, e deve ter espaço para uma
+// posição por caixa. Retorna o número de caixas visíveis.
+size_t Frustum_CullBoxes(const Frustum& frustum, const FrustumBoxes& boxes, uint8_t* visible);
+
+#endif // _FRUSTUM_H
@@ -0,0 +1,195 @@
+#include "geometryarena.h"
+
+#include <cstdio>
+
+// Capacidade inicial dos buffers. Todos os modelos do jogo cabem nela; ela
+// só cresce se mais modelos forem adicionados.
+#define GEOMETRYARENA_INITIAL_VERTICES (256*1024)
+#define GEOMETRYARENA_INITIAL_INDICES  (1024*1024)
+
+// Alocador de intervalos dentro de um buffer. As malhas ficam na arena até
+// GeometryArena_Shutdown() (veja "assetregistry.h"), então os intervalos são
+// apenas entregues em sequência, a partir do fim do último.
+struct RangeAllocator
+{
+    size_t capacity;
+    size_t used;
+};
+
+static GLuint         g_ArenaVertexArrayId = 0;
+static GLuint         g_ArenaVertexBufferId = 0;
+static GLuint         g_ArenaIndexBufferId = 0;
+static RangeAllocator g_ArenaVertices;
+static RangeAllocator g_ArenaIndices;
+
+static bool Range_Allocate(RangeAllocator* allocator, size_t size, size_t* offset)
+{
+    if ( size == 0 )
+    {
+        *offset = 0;
+        return true;
+    }
+
+    if ( size > allocator->capacity - allocator->used )
+        return false;
+
+    *offset = allocator->used;
+    allocator->used += size;
+    return true;
+}
+
+static void Range_Init(RangeAllocator* allocator, size_t capacity)
+{
+    allocator->capacity = capacity;
+    allocator->used     = 0;
+}
+
+// Cria um buffer com "size" bytes, sem inicializar. Utilizamos o alvo
+// GL_COPY_WRITE_BUFFER em todas as operações da arena, pois ligar um buffer
+// em GL_ELEMENT_ARRAY_BUFFER alteraria o VAO que estiver ligado.
+static GLuint CreateBuffer(size_t size)
+{
+    GLuint buffer_id;
+    glGenBuffers(1, &buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+    return buffer_id;
+}
+
+// Substitui um buffer por um maior, copiando o conteúdo na GPU
+static GLuint GrowBuffer(GLuint buffer_id, size_t old_size, size_t new_size)
+{
+    GLuint new_buffer_id = CreateBuffer(new_size);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glDeleteBuffers(1, &buffer_id);
+    return new_buffer_id;
+}
+
+// Configura o VAO com os buffers atuais da arena. O formato dos vértices é
+// o de PackedVertex; veja "meshcache.h" e "shader_vertex.glsl".
+static void SetupVertexArray()
+{
+    glBindVertexArray(g_ArenaVertexArrayId);
+    glBindBuffer(GL_ARRAY_BUFFER, g_ArenaVertexBufferId);
+
+    const GLsizei stride = sizeof(PackedVertex);
+
+    GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
+    GLint  number_of_dimensions = 3; // X, Y, Z; a GPU completa W = 1 no vec4 de "shader_vertex.glsl"
+    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(location);
+
+    location = 1; // "(location = 1)" em "shader_vertex.glsl"
+    number_of_dimensions = 4; // GL_INT_2_10_10_10_REV sempre tem 4 componentes
+    glVertexAttribPointer(location, number_of_dimensions, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(location);
+
+    location = 2; // "(location = 2)" em "shader_vertex.glsl"
+    number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
+    glVertexAttribPointer(location, number_of_dimensions, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, texcoord));
+    glEnableVertexAttribArray(location);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // O buffer de índices faz parte do estado do VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ArenaIndexBufferId);
+}
+
+// Cria a arena na primeira utilização, e aumenta os buffers se "num_vertices"
+// vértices e "num_indices" índices não couberem nos blocos livres.
+static void ReserveSpace(size_t num_vertices, size_t num_indices, size_t* vertex_offset, size_t* index_offset)
+{
+    // O VAO ligado é alterado abaixo; restauramos o anterior no final
+    GLint previous_vertex_array_id;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous_vertex_array_id);
+
+    bool changed = false;
+    if ( g_ArenaVertexArrayId == 0 )
+    {
+        glGenVertexArrays(1, &g_ArenaVertexArrayId);
+        g_ArenaVertexBufferId = CreateBuffer(GEOMETRYARENA_INITIAL_VERTICES * sizeof(PackedVertex));
+        g_ArenaIndexBufferId  = CreateBuffer(GEOMETRYARENA_INITIAL_INDICES * sizeof(GLuint));
+        Range_Init(&g_ArenaVertices, GEOMETRYARENA_INITIAL_VERTICES);
+        Range_Init(&g_ArenaIndices, GEOMETRYARENA_INITIAL_INDICES);
+        changed = true;
+    }
+
+    while ( !Range_Allocate(&g_ArenaVertices, num_vertices, vertex_offset) )
+    {
+        size_t capacity = g_ArenaVertices.capacity;
+        g_ArenaVertexBufferId = GrowBuffer(g_ArenaVertexBufferId, capacity * sizeof(PackedVertex), 2 * capacity * sizeof(PackedVertex));
+        g_ArenaVertices.capacity = 2 * capacity;
+        changed = true;
+    }
+
+    while ( !Range_Allocate(&g_ArenaIndices, num_indices, index_offset) )
+    {
+        size_t capacity = g_ArenaIndices.capacity;
+        g_ArenaIndexBufferId = GrowBuffer(g_ArenaIndexBufferId, capacity * sizeof(GLuint), 2 * capacity * sizeof(GLuint));
+        g_ArenaIndices.capacity = 2 * capacity;
+        changed = true;
+    }
+
+    if ( changed )
+        SetupVertexArray();
+
+    glBindVertexArray(previous_vertex_array_id);
+}
+
+GeometryRange GeometryArena_Add(const MeshStreams& streams)
+{
+    size_t vertex_offset, index_offset;
+    ReserveSpace(streams.num_vertices, streams.num_indices, &vertex_offset, &index_offset);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, g_ArenaVertexBufferId);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, vertex_offset * sizeof(PackedVertex), streams.num_vertices * sizeof(PackedVertex), streams.vertices);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, g_ArenaIndexBufferId);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, index_offset * sizeof(GLuint), streams.num_indices * sizeof(GLuint), streams.indices);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    GeometryRange range;
+    range.base_vertex  = (GLint)vertex_offset;
+    range.num_vertices = streams.num_vertices;
+    range.first_index  = index_offset;
+    range.num_indices  = streams.num_indices;
+    return range;
+}
+
+void GeometryArena_Bind()
+{
+    glBindVertexArray(g_ArenaVertexArrayId);
+}
+
+GLuint GeometryArena_GetVertexArray()
+{
+    return g_ArenaVertexArrayId;
+}
+
+void GeometryArena_PrintReport()
+{
+    printf("Arena de geometria: %d de %d vértices (%.1f MB), %d de %d índices (%.1f MB).\n\n",
+           (int)g_ArenaVertices.used, (int)g_ArenaVertices.capacity,
+           g_ArenaVertices.capacity * sizeof(PackedVertex) / (1024.0*1024.0),
+           (int)g_ArenaIndices.used, (int)g_ArenaIndices.capacity,
+           g_ArenaIndices.capacity * sizeof(GLuint) / (1024.0*1024.0));
+}
+
+void GeometryArena_Shutdown()
+{
+    if ( g_ArenaVertexArrayId == 0 )
+        return;
+
+    glDeleteVertexArrays(1, &g_ArenaVertexArrayId);
+    glDeleteBuffers(1, &g_ArenaVertexBufferId);
+    glDeleteBuffers(1, &g_ArenaIndexBufferId);
+    g_ArenaVertexArrayId  = 0;
+    g_ArenaVertexBufferId = 0;
+    g_ArenaIndexBufferId  = 0;
+
+    Range_Init(&g_ArenaVertices, 0);
+    Range_Init(&g_ArenaIndices, 0);
+}
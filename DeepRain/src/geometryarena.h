@@ -0,0 +1,49 @@
+#ifndef _GEOMETRYARENA_H
+#define _GEOMETRYARENA_H
+
+// Arena de geometria: todas as malhas estáticas ficam em um único VBO de
+// vértices e um único buffer de índices, descritos por um único VAO.
+//
+// Cada malha ocupa um intervalo de vértices e um intervalo de índices da
+// arena. Os índices de cada malha continuam começando em zero; o primeiro
+// vértice da malha é passado como "base vertex" para
+// glDrawElementsBaseVertex() (OpenGL 3.2). Assim, desenhar objetos de malhas
+// diferentes não exige trocar de VAO, e vários objetos podem ser desenhados
+// com uma única chamada a glMultiDrawElementsBaseVertex().
+//
+// Os buffers começam com uma capacidade fixa e dobram de tamanho quando
+// necessário (o conteúdo é copiado na própria GPU). Todas as funções devem
+// ser chamadas na thread com o contexto OpenGL: a thread principal durante a
+// carga e a thread de renderização durante o jogo (veja "renderthread.h").
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include "meshcache.h"
+
+// Intervalo ocupado por uma malha na arena
+struct GeometryRange
+{
+    GLint  base_vertex;  // Posição do primeiro vértice da malha no VBO da arena
+    size_t num_vertices;
+    size_t first_index;  // Posição do primeiro índice da malha no buffer de índices
+    size_t num_indices;
+};
+
+// Copia os vetores de uma malha para a arena e retorna onde eles ficaram
+GeometryRange GeometryArena_Add(const MeshStreams& streams);
+
+// "Liga" o VAO da arena
+void GeometryArena_Bind();
+
+// Retorna o VAO da arena, sem ligá-lo (veja "renderqueue.h")
+GLuint GeometryArena_GetVertexArray();
+
+// Imprime no terminal a ocupação dos buffers da arena
+void GeometryArena_PrintReport();
+
+// Destrói o VAO e os buffers. Chamada antes de destruir o contexto OpenGL.
+void GeometryArena_Shutdown();
+
+#endif // _GEOMETRYARENA_H
@@ -0,0 +1,131 @@
+#include "instancing.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include <glm/mat3x3.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+static GLuint   g_InstanceBufferId = 0;
+static size_t   g_InstanceCapacity = 0; // Em cópias
+static size_t   g_InstanceOffset = 0;   // Próxima posição livre, em cópias
+
+// Define os atributos constantes "instance_model" e "instance_normal" como a
+// matriz identidade. Cada coluna de uma matriz é uma posição de atributo
+// separada.
+static void SetIdentityAttribute()
+{
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        GLfloat value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        value[column] = 1.0f;
+        glVertexAttrib4fv(INSTANCING_MODEL_LOCATION + column, value);
+        if ( column < 3 )
+            glVertexAttrib4fv(INSTANCING_NORMAL_LOCATION + column, value);
+    }
+}
+
+// Escreve a cópia "model" em "instance"
+static void MakeInstance(InstanceData* instance, const glm::mat4& model)
+{
+    glm::mat3 normal_matrix = glm::inverseTranspose(glm::mat3(model));
+
+    instance->model = model;
+    for (int column = 0; column < 3; ++column)
+        instance->normal_matrix[column] = glm::vec4(normal_matrix[column], 0.0f);
+}
+
+void Instancing_Init()
+{
+    SetIdentityAttribute();
+}
+
+GLintptr Instancing_Upload(const glm::mat4* models, size_t count)
+{
+    if ( g_InstanceBufferId == 0 )
+        glGenBuffers(1, &g_InstanceBufferId);
+
+    glBindBuffer(GL_ARRAY_BUFFER, g_InstanceBufferId);
+
+    // Sem espaço até o fim do buffer: descartamos o conteúdo antigo (o driver
+    // entrega uma nova área de memória se a GPU ainda estiver lendo a
+    // anterior) e voltamos ao início.
+    if ( g_InstanceOffset + count > g_InstanceCapacity )
+    {
+        while ( g_InstanceCapacity < count )
+            g_InstanceCapacity = g_InstanceCapacity == 0 ? INSTANCING_INITIAL_CAPACITY : 2 * g_InstanceCapacity;
+
+        glBufferData(GL_ARRAY_BUFFER, g_InstanceCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+        g_InstanceOffset = 0;
+    }
+
+    GLintptr offset = g_InstanceOffset * sizeof(InstanceData);
+    GLsizeiptr size = count * sizeof(InstanceData);
+
+    // A região escrita não está sendo lida pela GPU (ela fica depois de tudo
+    // que foi enviado desde o último descarte), então não precisamos de
+    // sincronização.
+    void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if ( mapped != NULL )
+    {
+        InstanceData* instances = (InstanceData*)mapped;
+        for (size_t i = 0; i < count; ++i)
+            MakeInstance(&instances[i], models[i]);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            InstanceData instance;
+            MakeInstance(&instance, models[i]);
+            glBufferSubData(GL_ARRAY_BUFFER, offset + i * sizeof(InstanceData), sizeof(InstanceData), &instance);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    g_InstanceOffset += count;
+    return offset;
+}
+
+void Instancing_EnableAttributes(GLintptr offset)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, g_InstanceBufferId);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+        GLuint location = INSTANCING_MODEL_LOCATION + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    for (GLuint column = 0; column < 3; ++column)
+    {
+        GLuint location = INSTANCING_NORMAL_LOCATION + column;
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, normal_matrix) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Instancing_DisableAttributes()
+{
+    for (GLuint column = 0; column < 4; ++column)
+        glDisableVertexAttribArray(INSTANCING_MODEL_LOCATION + column);
+    for (GLuint column = 0; column < 3; ++column)
+        glDisableVertexAttribArray(INSTANCING_NORMAL_LOCATION + column);
+
+    // O valor constante de um atributo fica indefinido depois de um desenho
+    // com o atributo ligado a um buffer, então o redefinimos.
+    SetIdentityAttribute();
+}
+
+void Instancing_Shutdown()
+{
+    if ( g_InstanceBufferId != 0 )
+        glDeleteBuffers(1, &g_InstanceBufferId);
+    g_InstanceBufferId = 0;
+    g_InstanceCapacity = 0;
+    g_InstanceOffset   = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef _INSTANCING_H
+#define _INSTANCING_H
+
+// Desenho instanciado: várias cópias de um mesmo objeto desenhadas com uma
+// única chamada a glDrawElementsInstancedBaseVertex() (OpenGL 3.2).
+//
+// As matrizes de modelagem das cópias são escritas em um buffer de instâncias
+// e lidas pelo vertex shader como o atributo "instance_model" (um mat4, que
+// ocupa as posições INSTANCING_MODEL_LOCATION a INSTANCING_MODEL_LOCATION+3),
+// com glVertexAttribDivisor() = 1: o atributo avança uma vez por instância, e
+// não por vértice. Veja "shader_vertex.glsl". Junto de cada matriz é escrita
+// a matriz das normais da cópia (a inversa da transposta, calculada na CPU
+// por Instancing_Upload()), lida como o atributo "instance_normal" (um mat3,
+// nas posições INSTANCING_NORMAL_LOCATION a INSTANCING_NORMAL_LOCATION+2).
+//
+// Fora dos desenhos instanciados os atributos ficam desligados, e o vertex
+// shader recebe o valor constante dos atributos, que é a matriz identidade;
+// assim, "model * instance_model" funciona para os dois tipos de desenho.
+//
+// O buffer é preenchido como um anel: cada envio é escrito logo depois do
+// anterior, e quando o fim do buffer é alcançado o conteúdo antigo é
+// descartado (glBufferData com NULL), para não esperar a GPU terminar de ler.
+// Todas as funções devem ser chamadas na thread de renderização (veja
+// "renderthread.h").
+
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+// "(location = 3)" e "(location = 7)" em "shader_vertex.glsl"
+#define INSTANCING_MODEL_LOCATION  3
+#define INSTANCING_NORMAL_LOCATION 7
+
+// Capacidade inicial do buffer de instâncias, em cópias. O buffer cresce se
+// um único envio não couber nele.
+#define INSTANCING_INITIAL_CAPACITY 4096
+
+// Dados de uma cópia no buffer de instâncias
+struct InstanceData
+{
+    glm::mat4 model;
+    glm::vec4 normal_matrix[3];  // mat3: uma coluna por vec4 (w não é lido)
+};
+
+// Define o valor constante dos atributos "instance_model" e
+// "instance_normal" (identidade). Chamada uma vez, depois da criação do
+// contexto OpenGL.
+void Instancing_Init();
+
+// Copia "count" matrizes para o buffer de instâncias, com as suas matrizes
+// das normais, e retorna a posição (em bytes) onde elas ficaram, para
+// Instancing_EnableAttributes(). A cópia i fica em
+// offset + i * sizeof(InstanceData).
+GLintptr Instancing_Upload(const glm::mat4* models, size_t count);
+
+// Liga os atributos "instance_model" e "instance_normal" do VAO atualmente
+// ligado às cópias que começam em "offset" no buffer de instâncias.
+void Instancing_EnableAttributes(GLintptr offset);
+
+// Desliga os atributos ligados acima, voltando ao valor constante (identidade)
+void Instancing_DisableAttributes();
+
+// Destrói o buffer. Chamada antes de destruir o contexto OpenGL.
+void Instancing_Shutdown();
+
+#endif // _INSTANCING_H
@@ -0,0 +1,263 @@
+#include "jobs.h"
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+#include <memory>
+
+// Estado do sistema de tarefas. Um único mutex protege as duas filas; as
+// tarefas são grandes (um arquivo inteiro cada), então a contenção é mínima.
+static std::vector<std::thread>  g_JobWorkers;
+static std::mutex                g_JobsMutex;
+static std::condition_variable   g_JobsAvailable;      // Sinaliza os workers
+static std::condition_variable   g_CompletionsChanged; // Sinaliza a thread principal
+static std::deque<Job>           g_PendingJobs;
+static std::deque<Job>           g_PendingCompletions;
+static size_t                    g_NumPendingJobs = 0; // Tarefas + conclusões ainda não terminadas
+static bool                      g_JobsQuit = false;
+
+// Laço executado por cada thread auxiliar
+static void Jobs_WorkerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(g_JobsMutex);
+            while ( g_PendingJobs.empty() && !g_JobsQuit )
+                g_JobsAvailable.wait(lock);
+
+            if ( g_JobsQuit )
+                return;
+
+            job = g_PendingJobs.front();
+            g_PendingJobs.pop_front();
+        }
+
+        try
+        {
+            job();
+        }
+        catch (...)
+        {
+            // Repassamos a exceção para a thread principal
+            std::exception_ptr error = std::current_exception();
+            Jobs_SubmitToMainThread([error]() { std::rethrow_exception(error); });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(g_JobsMutex);
+            g_NumPendingJobs -= 1;
+        }
+        g_CompletionsChanged.notify_all();
+    }
+}
+
+void Jobs_Init(unsigned int num_threads)
+{
+    if ( num_threads == 0 )
+        num_threads = std::thread::hardware_concurrency();
+    if ( num_threads == 0 )
+        num_threads = 1;
+
+    g_JobsQuit = false;
+    for (unsigned int i = 0; i < num_threads; ++i)
+        g_JobWorkers.push_back(std::thread(Jobs_WorkerLoop));
+}
+
+void Jobs_Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_JobsMutex);
+        g_JobsQuit = true;
+        g_NumPendingJobs -= g_PendingJobs.size();
+        g_PendingJobs.clear();
+    }
+    g_JobsAvailable.notify_all();
+
+    for (size_t i = 0; i < g_JobWorkers.size(); ++i)
+        g_JobWorkers[i].join();
+    g_JobWorkers.clear();
+}
+
+unsigned int Jobs_NumThreads()
+{
+    return (unsigned int)g_JobWorkers.size();
+}
+
+void Jobs_Submit(const Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_JobsMutex);
+        g_PendingJobs.push_back(job);
+        g_NumPendingJobs += 1;
+    }
+    g_JobsAvailable.notify_one();
+}
+
+void Jobs_SubmitToMainThread(const Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_JobsMutex);
+        g_PendingCompletions.push_back(job);
+        g_NumPendingJobs += 1;
+    }
+    g_CompletionsChanged.notify_all();
+}
+
+size_t Jobs_RunCompletions()
+{
+    size_t count = 0;
+    for (;;)
+    {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(g_JobsMutex);
+            if ( g_PendingCompletions.empty() )
+                return count;
+            job = g_PendingCompletions.front();
+            g_PendingCompletions.pop_front();
+        }
+
+        // Decrementamos o contador mesmo se a tarefa lançar uma exceção
+        struct Done
+        {
+            ~Done()
+            {
+                std::lock_guard<std::mutex> lock(g_JobsMutex);
+                g_NumPendingJobs -= 1;
+            }
+        } done;
+
+        job();
+        count += 1;
+    }
+}
+
+void Jobs_WaitAll()
+{
+    for (;;)
+    {
+        Jobs_RunCompletions();
+
+        std::unique_lock<std::mutex> lock(g_JobsMutex);
+        if ( g_NumPendingJobs == 0 )
+            return;
+        while ( g_PendingCompletions.empty() && g_NumPendingJobs > 0 )
+            g_CompletionsChanged.wait(lock);
+    }
+}
+
+size_t Jobs_NumPending()
+{
+    std::lock_guard<std::mutex> lock(g_JobsMutex);
+    return g_NumPendingJobs;
+}
+
+// Estado compartilhado de uma chamada a Jobs_ParallelFor(). É mantido vivo
+// por shared_ptr, pois tarefas auxiliares podem começar a executar depois que
+// todos os lotes já terminaram (nesse caso elas não fazem nada).
+struct ParallelForState
+{
+    ParallelForBody         body;
+    size_t                  count;
+    size_t                  num_batches;
+    std::atomic<size_t>     next_batch;
+    std::atomic<bool>       failed;     // Algum lote lançou uma exceção
+    size_t                  num_done;
+    std::exception_ptr      error;      // Primeira exceção lançada
+    std::mutex              mutex;
+    std::condition_variable done;
+};
+
+// Processa lotes até que não reste nenhum. Se "body" lançar uma exceção, ela
+// é guardada para a thread que chamou Jobs_ParallelFor(), e os lotes
+// seguintes são apenas contados como terminados.
+static void ParallelFor_RunBatches(ParallelForState* state)
+{
+    for (;;)
+    {
+        size_t batch = state->next_batch.fetch_add(1);
+        if ( batch >= state->num_batches )
+            return;
+
+        std::exception_ptr error;
+        if ( !state->failed )
+        {
+            size_t begin = state->count * batch / state->num_batches;
+            size_t end   = state->count * (batch + 1) / state->num_batches;
+            try
+            {
+                state->body(begin, end, batch);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+                state->failed = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if ( error && !state->error )
+            state->error = error;
+        state->num_done += 1;
+        if ( state->num_done == state->num_batches )
+            state->done.notify_all();
+    }
+}
+
+size_t Jobs_NumParallelForBatches(size_t count, size_t min_batch_size)
+{
+    if ( count == 0 )
+        return 0;
+    if ( min_batch_size == 0 )
+        min_batch_size = 1;
+
+    // Mais lotes do que núcleos do processador só adicionariam trocas de
+    // contexto entre as threads.
+    size_t max_batches = (count + min_batch_size - 1) / min_batch_size;
+    size_t num_batches = g_JobWorkers.size() + 1;
+    size_t num_cores   = std::thread::hardware_concurrency();
+    if ( num_cores > 0 && num_batches > num_cores )
+        num_batches = num_cores;
+    return num_batches < max_batches ? num_batches : max_batches;
+}
+
+size_t Jobs_ParallelFor(size_t count, size_t min_batch_size, const ParallelForBody& body)
+{
+    size_t num_batches = Jobs_NumParallelForBatches(count, min_batch_size);
+    if ( num_batches == 0 )
+        return 0;
+
+    if ( num_batches == 1 )
+    {
+        body(0, count, 0);
+        return 1;
+    }
+
+    std::shared_ptr<ParallelForState> state(new ParallelForState);
+    state->body        = body;
+    state->count       = count;
+    state->num_batches = num_batches;
+    state->next_batch  = 0;
+    state->failed      = false;
+    state->num_done    = 0;
+
+    for (size_t i = 1; i < num_batches; ++i)
+        Jobs_Submit([state]() { ParallelFor_RunBatches(state.get()); });
+
+    ParallelFor_RunBatches(state.get());
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while ( state->num_done < state->num_batches )
+        state->done.wait(lock);
+
+    if ( state->error )
+        std::rethrow_exception(state->error);
+
+    return num_batches;
+}
@@ -0,0 +1,75 @@
+#ifndef _JOBS_H
+#define _JOBS_H
+
+// Sistema simples de tarefas (jobs) executadas em threads auxiliares.
+//
+// Existem duas filas:
+//  - a fila de tarefas, consumida pelas threads auxiliares (workers). Aqui
+//    ficam os trabalhos pesados que não usam OpenGL: leitura de arquivos,
+//    decodificação de imagens, leitura de OBJ, cálculo de normais, etc.;
+//  - a fila de conclusão, consumida somente pela thread principal, que é a
+//    única que possui o contexto OpenGL. Uma tarefa executada em um worker
+//    agenda aqui a parte final do seu trabalho (glTexImage2D, glBufferData,
+//    etc.) com Jobs_SubmitToMainThread().
+//
+// Durante o jogo, o contexto OpenGL pertence à thread de renderização (veja
+// "renderthread.h"), que faz aqui o papel da thread principal: as tarefas de
+// conclusão são executadas por ela, na troca de quadros.
+//
+// Exceções lançadas dentro de uma tarefa são capturadas e relançadas na
+// thread principal, dentro de Jobs_RunCompletions() ou Jobs_WaitAll().
+
+#include <cstddef>
+#include <functional>
+
+typedef std::function<void()> Job;
+
+// Cria as threads auxiliares. Se num_threads == 0, utilizamos uma thread por
+// núcleo do processador.
+void Jobs_Init(unsigned int num_threads = 0);
+
+// Termina as threads auxiliares. Tarefas ainda não iniciadas são descartadas.
+void Jobs_Shutdown();
+
+// Número de threads auxiliares em execução
+unsigned int Jobs_NumThreads();
+
+// Agenda uma tarefa para ser executada em uma thread auxiliar
+void Jobs_Submit(const Job& job);
+
+// Agenda uma tarefa para ser executada na thread principal (OpenGL). Pode ser
+// chamada de qualquer thread.
+void Jobs_SubmitToMainThread(const Job& job);
+
+// Executa, na thread principal, todas as tarefas de conclusão já prontas, sem
+// esperar pelas tarefas que ainda estão em execução. Retorna o número de
+// tarefas executadas. Deve ser chamada somente pela thread principal.
+size_t Jobs_RunCompletions();
+
+// Espera todas as tarefas agendadas terminarem, executando as tarefas de
+// conclusão à medida que ficam prontas. Deve ser chamada somente pela thread
+// principal.
+void Jobs_WaitAll();
+
+// Número de tarefas agendadas (incluindo as de conclusão) ainda não terminadas
+size_t Jobs_NumPending();
+
+// Corpo de um laço paralelo: processa os itens [begin, end). "batch" é o
+// número do lote (entre 0 e o valor retornado por Jobs_ParallelFor() menos
+// um), e pode ser usado para indexar acumuladores separados por lote.
+typedef std::function<void(size_t begin, size_t end, size_t batch)> ParallelForBody;
+
+// Divide "count" itens em lotes de pelo menos "min_batch_size" itens e
+// processa os lotes em paralelo nas threads auxiliares. A thread que chama
+// também processa lotes, e só retorna quando todos terminaram; por isso esta
+// função pode ser chamada de qualquer thread, inclusive de dentro de uma
+// tarefa. Retorna o número de lotes. Se algum lote lançar uma exceção, os
+// lotes restantes não são processados e a primeira exceção é relançada aqui,
+// depois que todos os lotes em andamento terminaram.
+size_t Jobs_ParallelFor(size_t count, size_t min_batch_size, const ParallelForBody& body);
+
+// Número de lotes que Jobs_ParallelFor() utilizará para os mesmos argumentos.
+// Útil para alocar os acumuladores antes do laço.
+size_t Jobs_NumParallelForBatches(size_t count, size_t min_batch_size);
+
+#endif // _JOBS_H
@@ -21,9 +21,12 @@
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <cstring>
+#include <cstddef>
 
 // Headers abaixo so especficos de C++
 #include <map>
+#include <deque>
 #include <stack>
 #include <string>
 #include <vector>
@@ -32,6 +35,8 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <memory>
+#include <unordered_map>
 
 // Headers das bibliotecas OpenGL
 #include <glad/glad.h>   // Criao de contexto OpenGL 3.3
@@ -69,12 +74,41 @@
 #define ASTRONAUT 15
 #define SKYBOX2 16
 
+// ndices dos objetos estticos no PVS (veja "pvs.h"), definidos antes do
+// loop de renderizao em main()
+#define STATIC_MOUNT         0
+#define STATIC_FIRST_ROCK    1
+#define STATIC_NUM_ROCKS     17
+#define STATIC_FIRST_TREE    (STATIC_FIRST_ROCK + STATIC_NUM_ROCKS)
+#define STATIC_NUM_TREES     48
+#define STATIC_FIRST_CAPSULE (STATIC_FIRST_TREE + STATIC_NUM_TREES)
+#define STATIC_NUM_CAPSULES  3
+#define STATIC_NUM_OBJECTS   (STATIC_FIRST_CAPSULE + STATIC_NUM_CAPSULES)
+
 // Prints para debugging
 #include "iostream"
 using namespace std;
 
 #include "collisions.h"
 #include "bezier.h"
+#include "meshcache.h"
+#include "jobs.h"
+#include "meshoptimize.h"
+#include "meshsimplify.h"
+#include "normals.h"
+#include "texturecook.h"
+#include "assetregistry.h"
+#include "geometryarena.h"
+#include "instancing.h"
+#include "drawdata.h"
+#include "texturearray.h"
+#include "shaderpermutation.h"
+#include "renderqueue.h"
+#include "occlusion.h"
+#include "pvs.h"
+#include "scenegraph.h"
+#include "debugdraw.h"
+#include "renderthread.h"
 
 #define M_PI   3.14159265358979323846
 
@@ -141,22 +175,48 @@ struct ObjModel
 void PushMatrix(glm::mat4 M);
 void PopMatrix(glm::mat4& M);
 
+// Identificador de um objeto da cena virtual: sua posio em g_SceneObjects.
+// Obtido uma nica vez a partir do nome, com GetObjectHandle().
+typedef int ObjectHandle;
+#define OBJECT_INVALID (-1)
+
 // Declarao de vrias funes utilizadas em main().  Essas esto definidas
 // logo aps a definio de main() neste arquivo.
 void BuildTrianglesAndAddToVirtualScene(ObjModel*); // Constri representao de um ObjModel como malha de tringulos para renderizao
+void BuildTriangles(ObjModel*, MeshData*); // Constri, somente na CPU, os vetores de vrtices e ndices de um ObjModel
+AssetGpuResources AddMeshToVirtualScene(const std::vector<MeshShape>& shapes, const MeshStreams& streams); // Envia uma malha para a GPU e a adiciona em g_SceneObjects
+void LoadObjModelAndAddToVirtualScene(const char* filename, bool deferred = false); // Agenda a carga de um arquivo ".obj", utilizando o cache binrio quando possvel
 GLuint BuildTrianglesForCrosshair(); // Constri tringulos para renderizao
-void ComputeNormals(ObjModel* model); // Computa normais de um ObjModel, caso no existam.
-void LoadShadersFromFiles(); // Carrega os shaders de vrtice e fragmento, criando um programa de GPU
-void LoadTextureImage(const char* filename); // Funo que carrega imagens de textura
-void DrawVirtualObject(const char* object_name); // Desenha um objeto armazenado em g_VirtualScene
-GLuint LoadShader_Vertex(const char* filename);   // Carrega um vertex shader
-GLuint LoadShader_Fragment(const char* filename); // Carrega um fragment shader
-void LoadShader(const char* filename, GLuint shader_id); // Funo utilizada pelas duas acima
+void ComputeNormals(ObjModel* model, NormalWeighting weighting = NORMALS_AREA_WEIGHTED); // Computa normais de um ObjModel, caso no existam.
+void LoadShadersFromFiles(); // Carrega os shaders de vrtice e fragmento, criando um programa de GPU por classe de material
+void LoadTextureImage(const char* filename, bool deferred = false); // Funo que agenda a carga de imagens de textura
+void UpdateMaterials(); // Envia a tabela de materiais para a GPU, se ela mudou
+void SetDrawMaterial(int object_id); // Define o "object_id" e o programa de GPU dos prximos desenhos
+void UpdateDeferredAssets(bool urgent); // Inicia as cargas adiadas, em segundo plano
+void PrintAssetLoadReport(double wall_time); // Imprime o tempo de carga de cada arquivo
+int CookTextures(); // Gera os arquivos de textura cozidos (opo "--cook")
+ObjectHandle GetObjectHandle(const char* object_name); // Identificador de um objeto da cena virtual, a partir do nome
+void CheckSceneObjects(); // Imprime os objetos pedidos que no existem em nenhum modelo
+void DrawVirtualObject(ObjectHandle object); // Desenha um objeto armazenado em g_SceneObjects
+void DrawVirtualObject(ObjectHandle object, const glm::mat4& model); // Desenha um objeto no nvel de detalhe adequado  distncia
+void DrawVirtualObjects(const ObjectHandle objects[], int num_objects); // Desenha vrios objetos com uma nica chamada
+void DrawVirtualObjectInstanced(ObjectHandle object, const glm::mat4 models[], int num_instances); // Desenha vrias cpias de um objeto com desenho instanciado
+int AddSceneDrawable(const ObjectHandle objects[], int num_objects, int object_id, int flags, RenderPass pass = RENDERPASS_OPAQUE); // Define o que um n do grafo de cena desenha
+void DrawSceneGraph(SceneNodeId root, const uint8_t* static_visible); // Desenha os ns visveis do grafo de cena
+void TransformBoundingBox(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model, glm::vec3* world_min, glm::vec3* world_max); // Caixa alinhada aos eixos que envolve uma caixa transformada
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Cria um programa de GPU
+void HandoffFrame(); // Entrega o quadro gravado pela thread do jogo para a thread de renderizao
+void RenderFrame(GLFWwindow* window, GLuint crosshair_vertex_array_id); // Executa os comandos OpenGL do quadro entregue
 
 // Declarao de funes auxiliares para renderizar texto dentro da janela
 // OpenGL. Estas funes esto definidas no arquivo "textrendering.cpp".
 void TextRendering_Init();
+void TextRendering_BeginFrame(GLFWwindow* window);
+void TextRendering_SwapFrame();
+void TextRendering_Flush();
+int TextRendering_CreateWidget(size_t max_chars);
+bool TextRendering_UpdateWidget(GLFWwindow* window, int widget_id, int value, float x, float y, float scale = 1.0f);
+void TextRendering_SetWidgetText(int widget_id, const std::string &str);
 float TextRendering_LineHeight(GLFWwindow* window);
 float TextRendering_CharWidth(GLFWwindow* window);
 void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f);
@@ -194,25 +254,58 @@ void CursorPosCallback(GLFWwindow* window, double xpos, double ypos);
 void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
 // Definimos uma estrutura que armazenar dados necessrios para renderizar
-// cada objeto da cena virtual.
+// cada objeto da cena virtual. O nome do objeto fica fora da estrutura (veja
+// g_SceneObjectNames), pois no  usado para desenhar.
 struct SceneObject
 {
-    std::string  name;        // Nome do objeto
-    size_t       first_index; // ndice do primeiro vrtice dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
-    size_t       num_indices; // Nmero de ndices do objeto dentro do vetor indices[] definido em BuildTrianglesAndAddToVirtualScene()
+    bool         loaded;      // Falso enquanto o modelo do objeto no terminou de carregar
+    size_t       first_index; // Posio do primeiro ndice do objeto dentro do buffer de ndices da arena de geometria (veja "geometryarena.h")
+    size_t       num_indices; // Nmero de ndices do objeto
     GLenum       rendering_mode; // Modo de rasterizao (GL_TRIANGLES, GL_TRIANGLE_STRIP, etc.)
-    GLuint       vertex_array_object_id; // ID do VAO onde esto armazenados os atributos do modelo
+    GLint        base_vertex; // Posio do primeiro vrtice do modelo dentro do VBO da arena; somada a cada ndice
     glm::vec3    bbox_min; // Axis-Aligned Bounding Box do objeto
     glm::vec3    bbox_max;
+    int          num_lods; // Nveis de detalhe (veja "meshsimplify.h"); lods[0]  o intervalo acima
+    MeshLod      lods[MESH_MAX_LODS]; // "first_index" na arena de geometria, como acima
+    OccluderId   occluder; // Malha substituta para o descarte por ocluso (veja "occlusion.h"), ou OCCLUDER_NONE
+};
+
+// O que um n do grafo de cena desenha (veja "scenegraph.h" e
+// DrawSceneGraph()): um ou mais objetos de g_SceneObjects, todos com a
+// matriz "world" do n.
+#define DRAWABLE_LOD       1 // Nvel de detalhe e oclusor: DrawVirtualObject(handle, model)
+#define DRAWABLE_INSTANCED 2 // Todos os ns visveis juntos: DrawVirtualObjectInstanced()
+#define DRAWABLE_DEPTH_PREPASS 4 // Fragment shader caro: tambm desenhado no passo de profundidade (veja "renderqueue.h")
+struct SceneDrawable
+{
+    std::vector<ObjectHandle> objects;
+    int                       object_id;
+    RenderPass                pass;
+    int                       flags;     // DRAWABLE_*
 };
 
+// Objetos grandes que escondem boa parte do mapa. Ao serem desenhados, eles
+// tambm so rasterizados na CPU para descartar os objetos atrs deles (veja
+// "occlusion.h"). Devem ser desenhados com DrawVirtualObject(handle, model)
+// ou DrawVirtualObjectInstanced().
+const char* g_OccluderObjectNames[] = { "the_mount", "the_rock" };
+
 // Abaixo definimos variveis globais utilizadas em vrias funes do cdigo.
 
-// A cena virtual  uma lista de objetos nomeados, guardados em um dicionrio
-// (map).  Veja dentro da funo BuildTrianglesAndAddToVirtualScene() como que so includos
-// objetos dentro da varivel g_VirtualScene, e veja na funo main() como
-// estes so acessados.
-std::map<std::string, SceneObject> g_VirtualScene;
+// A cena virtual  um vetor de objetos, acessados pelo ndice (ObjectHandle).
+// Veja dentro da funo AddMeshToVirtualScene() como que so includos
+// objetos dentro da varivel g_SceneObjects, e veja na funo main() como
+// estes so acessados: os nomes so convertidos em ObjectHandle uma nica
+// vez, antes do loop de renderizao, e o desenho no manipula strings.
+std::vector<SceneObject>                      g_SceneObjects;
+std::vector<std::string>                      g_SceneObjectNames;   // Nome de cada objeto de g_SceneObjects
+std::unordered_map<std::string, ObjectHandle> g_SceneObjectsByName; // Utilizado somente por GetObjectHandle()
+
+// Valores de "drawable" dos ns do grafo de cena so ndices deste vetor.
+// Veja AddSceneDrawable() e DrawSceneGraph().
+std::vector<SceneDrawable>          g_SceneDrawables;
+std::vector<std::vector<glm::mat4>> g_SceneDrawableInstances; // Matrizes dos ns de cada DRAWABLE_INSTANCED no quadro
+std::vector<SceneNodeDraw>          g_SceneDraws;             // Reutilizado por DrawSceneGraph()
 
 // Pilha que guardar as matrizes de modelagem.
 std::stack<glm::mat4>  g_MatrixStack;
@@ -335,6 +428,17 @@ typedef GLubyte index_type;
 // Razo de proporo da janela (largura/altura). Veja funo FramebufferSizeCallback().
 float g_ScreenRatio = 1.0f;
 
+// Altura da janela em pixels. Veja funo FramebufferSizeCallback().
+float g_ScreenHeight = 600.0f;
+
+// Quantos pixels na tela ocupa um objeto de tamanho 1 a uma unidade de
+// distncia da cmera. Atualizado a cada quadro junto com a matriz de
+// projeo, e utilizado para escolher os nveis de detalhe em SelectLod().
+float g_LodPixelsPerUnit = 1.0f;
+
+// Erro mximo, em pixels, aceito para um nvel de detalhe simplificado
+#define LOD_MAX_SCREEN_ERROR 1.0f
+
 // ngulos de Euler que controlam a rotao de um dos cubos da cena virtual
 float g_AngleX = 0.0f;
 float g_AngleY = 0.0f;
@@ -364,13 +468,9 @@ bool g_UsePerspectiveProjection = true;
 bool g_ShowInfoText = true;
 
 // Variveis que definem um programa de GPU (shaders). Veja funo LoadShadersFromFiles().
+// g_GpuProgramID  o programa da permutao padro, usado fora da fila de
+// renderizao (a mira).
 GLuint g_GpuProgramID = 0;
-GLint g_model_uniform;
-GLint g_view_uniform;
-GLint g_projection_uniform;
-GLint g_object_id_uniform;
-GLint g_bbox_min_uniform;
-GLint g_bbox_max_uniform;
 
 // Booleanos para movimentao e camera lock
 bool tecla_W_pressionada = false;
@@ -407,8 +507,143 @@ bool lock = false;
 // Nmero de texturas carregadas pela funo LoadTextureImage()
 GLuint g_NumLoadedTextures = 0;
 
+// Camada de array (veja "texturearray.h") de cada textura carregada, na ordem
+// das chamadas a LoadTextureImage(). Array -1 enquanto a textura no termina
+// de carregar.
+std::vector<TextureLayer> g_TextureLayers;
+
+// Tempo gasto na carga de cada arquivo (textura ou modelo), preenchido pelas
+// tarefas de concluso na thread com o contexto OpenGL. Veja
+// PrintAssetLoadReport().
+struct AssetLoadTime
+{
+    std::string filename;
+    double      load_time;   // Tempo na thread auxiliar (leitura, decodificao, processamento)
+    double      upload_time; // Tempo na thread com o contexto OpenGL (envio para a GPU)
+};
+std::vector<AssetLoadTime> g_AssetLoadTimes;
+
+// Imagens de textura. A posio de cada imagem neste vetor  utilizada pela
+// tabela de materiais (g_Materials) abaixo.
+// Imagens com "deferred" verdadeiro tm a carga adiada; veja UpdateDeferredAssets().
+struct TextureFile
+{
+    const char* filename;
+    bool        deferred;
+};
+const TextureFile g_TextureFiles[] = {
+    { "../../data/tc-earth_daymap_surface.jpg",      true  }, // 0
+    { "../../data/tc-earth_nightmap_citylights.gif", true  }, // 1
+    { "../../data/tc-monster.jpg",                   false }, // 2
+    { "../../data/tc-grass.jpg",                     false }, // 3
+    { "../../data/tc-skydome.jpg",                   false }, // 4
+    { "../../data/tc-rock.jpg",                      false }, // 5
+    { "../../data/tc-flymonster.jpg",                false }, // 6
+    { "../../data/tc-spaceship.jpg",                 false }, // 7
+    { "../../data/tc-mount.jpg",                     false }, // 8
+    { "../../data/tc-bullet.jpg",                    false }, // 9
+    { "../../data/tc-piece.png",                     false }, // 10
+    { "../../data/tc-tree.jpg",                      false }, // 11
+    { "../../data/tc-boss_metal.jpg",                false }, // 12
+    { "../../data/tc-boss_body.jpg",                 false }, // 13
+    { "../../data/tc-gun.jpg",                       false }, // 14
+    { "../../data/tc-capsule.png",                   false }, // 15
+    { "../../data/tc-astronaut.jpg",                 true  }, // 16 (game over)
+    { "../../data/tc-universe.jpg",                  true  }, // 17 (vitria)
+};
+const size_t g_NumTextureFiles = sizeof(g_TextureFiles) / sizeof(g_TextureFiles[0]);
+
+// Material de cada objeto ("object_id"), enviado para a GPU como a tabela do
+// bloco "MaterialData" (veja "drawdata.h" e "shader_fragment.glsl"). As
+// imagens "texture" e "detail" so posies em g_TextureFiles, ou -1.
+// "uv_mode" e "lighting" formam a classe do material: cada combinao 
+// compilada como um programa de GPU separado (veja "shaderpermutation.h").
+struct Material
+{
+    int   object_id;
+    int   texture;
+    int   detail;
+    int   uv_mode;
+    float uv_scale;
+    int   lighting;
+    float alpha;
+};
+const Material g_Materials[] = {
+    { SKYBOX1,     4, -1, MATERIAL_UV_SPHERE,     1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { BUNNY,       0,  1, MATERIAL_UV_PLANAR_XY,  1.0f, MATERIAL_LIGHTING_DAY_NIGHT, 1.0f },
+    { PLANE,       3, -1, MATERIAL_UV_TEXCOORDS, 10.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { MONSTER,     2, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { ROCK,        5, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { FLYMONSTER,  6, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { SPACESHIP,   7, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { MOUNT,       8, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { BULLETS,     9, -1, MATERIAL_UV_SPHERE,     1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { PIECE,      10, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { TREE,       11, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_VERTEX,    1.0f },
+    { BOSS,       12, 13, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_DETAIL,    1.0f },
+    { GUN,        14, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { CAPSULE,    15, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { ASTRONAUT,  16, -1, MATERIAL_UV_TEXCOORDS,  1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+    { SKYBOX2,    17, -1, MATERIAL_UV_SPHERE,     1.0f, MATERIAL_LIGHTING_LAMBERT,   1.0f },
+};
+const size_t g_NumMaterials = sizeof(g_Materials) / sizeof(g_Materials[0]);
+
+// Permutao de shaders de cada "object_id". Veja LoadShadersFromFiles().
+ShaderPermutationId g_MaterialPermutations[DRAWDATA_MAX_MATERIALS];
+ShaderPermutationId g_DefaultPermutation = 0;
+ShaderPermutationId g_DepthPermutation = 0;    // Passo de profundidade
+ShaderPermutationId g_OverdrawPermutation = 0; // Visualizao de sobreposio (tecla F4)
+
+// Dados de um quadro usados pela thread de renderizao, alm das filas dos
+// mdulos (veja "renderthread.h"). A thread do jogo os grava em g_GameFrame,
+// que  copiado para g_RenderFrame por HandoffFrame().
+struct FrameSnapshot
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 clear_color;
+    int       framebuffer_width;
+    int       framebuffer_height;
+    bool      draw_crosshair;
+};
+FrameSnapshot g_GameFrame;
+FrameSnapshot g_RenderFrame;
+
+// Tecla R: os shaders so recarregados pela thread de renderizao, na
+// prxima troca de quadros. Veja HandoffFrame().
+bool g_ReloadShadersRequested = false;
+
+// Verdadeiro se alguma textura terminou de carregar desde o ltimo envio da
+// tabela de materiais. Veja UpdateMaterials().
+bool g_MaterialsChanged = true;
+
+// Se verdadeiro, LoadTextureImage() utiliza os arquivos cozidos (".ktx"),
+// quando existirem. Veja "texturecook.h".
+bool g_UseCookedTextures = false;
+
+// Cargas adiadas. Arquivos usados somente nas telas de fim de jogo (ou pouco
+// usados) no atrasam o primeiro quadro: eles so carregados em segundo plano
+// depois dele. Veja UpdateDeferredAssets().
+struct DeferredLoad
+{
+    AssetId     asset;
+    std::string filename;
+    Job         load; // Tarefa de carga, a ser executada por uma thread auxiliar
+};
+std::deque<DeferredLoad> g_DeferredLoads;
+int g_NumDeferredLoadsInFlight = 0;
+
 int main(int argc, char* argv[])
 {
+    // "./main --cook" apenas gera os arquivos de textura cozidos e termina,
+    // sem abrir nenhuma janela.
+    if ( argc > 1 && strcmp(argv[1], "--cook") == 0 )
+        return CookTextures();
+
+    // "./main --bake-pvs" carrega o jogo normalmente, calcula o PVS dos
+    // objetos estticos (veja "pvs.h") e termina, sem entrar no loop.
+    bool bake_pvs = argc > 1 && strcmp(argv[1], "--bake-pvs") == 0;
+
     // Inicializamos a biblioteca GLFW, utilizada para criar uma janela do
     // sistema operacional, onde poderemos renderizar com OpenGL.
     int success = glfwInit();
@@ -485,88 +720,72 @@ int main(int argc, char* argv[])
     //
     LoadShadersFromFiles();
 
-    // Carregamos duas imagens para serem utilizadas como textura
-    LoadTextureImage("../../data/tc-earth_daymap_surface.jpg");      // TextureImage0
-    LoadTextureImage("../../data/tc-earth_nightmap_citylights.gif"); // TextureImage1
-    LoadTextureImage("../../data/tc-monster.jpg");                   // TextureImage2
-    LoadTextureImage("../../data/tc-grass.jpg");                     // TextureImage3
-    LoadTextureImage("../../data/tc-skydome.jpg");                   // TextureImage4
-    LoadTextureImage("../../data/tc-rock.jpg");                      // TextureImage5
-    LoadTextureImage("../../data/tc-flymonster.jpg");                // TextureImage6
-    LoadTextureImage("../../data/tc-spaceship.jpg");                 // TextureImage7
-    LoadTextureImage("../../data/tc-mount.jpg");                     // TextureImage8
-    LoadTextureImage("../../data/tc-bullet.jpg");                    // TextureImage9
-    LoadTextureImage("../../data/tc-piece.png");                     // TextureImage10
-    LoadTextureImage("../../data/tc-tree.jpg");                      // TextureImage11
-    LoadTextureImage("../../data/tc-boss_metal.jpg");                // TextureImage12
-    LoadTextureImage("../../data/tc-boss_body.jpg");                 // TextureImage13
-    LoadTextureImage("../../data/tc-gun.jpg");                       // TextureImage14
-    LoadTextureImage("../../data/tc-capsule.png");                   // TextureImage15
-    LoadTextureImage("../../data/tc-astronaut.jpg");                 // TextureImage16
-    LoadTextureImage("../../data/tc-universe.jpg");                  // TextureImage17
-
-    // Construmos a representao de objetos geomtricos atravs de malhas de tringulos
-    ObjModel spheremodel("../../data/sphere.obj");
-    ComputeNormals(&spheremodel);
-    BuildTrianglesAndAddToVirtualScene(&spheremodel);
-
-    ObjModel bunnymodel("../../data/bunny.obj");
-    ComputeNormals(&bunnymodel);
-    BuildTrianglesAndAddToVirtualScene(&bunnymodel);
-
-    ObjModel planemodel("../../data/plane.obj");
-    ComputeNormals(&planemodel);
-    BuildTrianglesAndAddToVirtualScene(&planemodel);
-
-    ObjModel monstermodel("../../data/monster.obj");
-    ComputeNormals(&monstermodel);
-    BuildTrianglesAndAddToVirtualScene(&monstermodel);
-
-    ObjModel rockmodel("../../data/rock.obj");
-    ComputeNormals(&rockmodel);
-    BuildTrianglesAndAddToVirtualScene(&rockmodel);
-
-    ObjModel flymonstermodel("../../data/flymonster.obj");
-    ComputeNormals(&flymonstermodel);
-    BuildTrianglesAndAddToVirtualScene(&flymonstermodel);
-
-    ObjModel shipmodel("../../data/spaceship.obj");
-    ComputeNormals(&shipmodel);
-    BuildTrianglesAndAddToVirtualScene(&shipmodel);
-
-    ObjModel mountmodel("../../data/mount.obj");
-    ComputeNormals(&mountmodel);
-    BuildTrianglesAndAddToVirtualScene(&mountmodel);
-
-    ObjModel bulletmodel("../../data/sphere.obj");
-    ComputeNormals(&bulletmodel);
-    BuildTrianglesAndAddToVirtualScene(&bulletmodel);
-
-    ObjModel piecemodel("../../data/piece.obj");
-    ComputeNormals(&piecemodel);
-    BuildTrianglesAndAddToVirtualScene(&piecemodel);
-
-    ObjModel treemodel("../../data/tree.obj");
-    ComputeNormals(&treemodel);
-    BuildTrianglesAndAddToVirtualScene(&treemodel);
-
-    ObjModel bossmodel("../../data/boss.obj");
-    ComputeNormals(&bossmodel);
-    BuildTrianglesAndAddToVirtualScene(&bossmodel);
-
-    ObjModel gunmodel("../../data/gun.obj");
-    ComputeNormals(&gunmodel);
-    BuildTrianglesAndAddToVirtualScene(&gunmodel);
-
-    ObjModel capsulemodel("../../data/capsule.obj");
-    ComputeNormals(&capsulemodel);
-    BuildTrianglesAndAddToVirtualScene(&capsulemodel);
-
-    ObjModel astronautmodel("../../data/astronaut.obj");
-    ComputeNormals(&astronautmodel);
-    BuildTrianglesAndAddToVirtualScene(&astronautmodel);
-
-    if ( argc > 1 )
+    // Atributo constante utilizado pelos desenhos no instanciados. Veja "instancing.h".
+    Instancing_Init();
+
+    // Buffers das variveis uniformes dos desenhos. Veja "drawdata.h".
+    DrawData_Init();
+
+    // Linhas de depurao (esferas de coliso, caixas). Veja "debugdraw.h".
+    DebugDraw_Init();
+
+    // Criamos as threads auxiliares. A leitura e a decodificao das texturas
+    // e dos modelos abaixo so feitas em paralelo nestas threads, enquanto a
+    // thread com o contexto OpenGL envia para a GPU cada arquivo que fica
+    // pronto: esta thread durante a carga, e a thread de renderizao, na
+    // troca de quadros, para os arquivos adiados. Veja "jobs.h" e
+    // "renderthread.h".
+    Jobs_Init();
+    double asset_load_start = glfwGetTime();
+
+    // Texturas j comprimidas s podem ser usadas se a GPU suportar BC1
+    g_UseCookedTextures = TextureCook_IsSupported();
+    if ( !g_UseCookedTextures )
+        printf("Texturas comprimidas (BC1) no suportadas; utilizando as imagens originais.\n");
+
+    // Carregamos as imagens para serem utilizadas como textura
+    for (size_t i = 0; i < g_NumTextureFiles; ++i)
+        LoadTextureImage(g_TextureFiles[i].filename, g_TextureFiles[i].deferred);
+
+    // Construmos a representao de objetos geomtricos atravs de malhas de
+    // tringulos. Veja LoadObjModelAndAddToVirtualScene(): na primeira execuo
+    // os arquivos OBJ so lidos e processados, e nas seguintes os vetores
+    // finais so lidos diretamente do cache binrio.
+    LoadObjModelAndAddToVirtualScene("../../data/sphere.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/bunny.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/plane.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/monster.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/rock.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/flymonster.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/spaceship.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/mount.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/sphere.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/piece.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/tree.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/boss.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/gun.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/capsule.obj");
+    LoadObjModelAndAddToVirtualScene("../../data/astronaut.obj", true); // Somente no game over
+
+    // Esperamos todas as cargas terminarem antes de iniciar o jogo, exceto as
+    // adiadas, que comeam depois do primeiro quadro.
+    Jobs_WaitAll();
+    PrintAssetLoadReport(glfwGetTime() - asset_load_start);
+    AssetRegistry_PrintReport();
+    GeometryArena_PrintReport();
+    printf("Texturas em %d arrays (%.1f MB).\n", (int)TextureArray_NumArrays(), TextureArray_GpuBytes() / (1024.0 * 1024.0));
+
+    // Com as malhas na GPU, desenhamos com cada permutao de shaders para
+    // que o driver termine as compilaes agora, e no no meio do jogo. Os
+    // desenhos leem um registro qualquer do bloco "DrawData".
+    {
+        DrawRecord record;
+        DrawData_MakeRecord(&record, Matrix_Identity(), 0, glm::vec3(0.0f), glm::vec3(1.0f));
+        DrawData_BindRecord(DrawData_Upload(&record, 1));
+        ShaderPermutation_Prewarm();
+    }
+
+    if ( argc > 1 && !bake_pvs )
     {
         ObjModel model(argv[1]);
         BuildTrianglesAndAddToVirtualScene(&model);
@@ -902,26 +1121,464 @@ int main(int argc, char* argv[])
 
     glm::vec4 movementVec;
 
+    // Identificadores dos objetos desenhados no loop abaixo, obtidos uma nica
+    // vez: o desenho no procura objetos pelo nome.
+    const ObjectHandle the_sphere     = GetObjectHandle("the_sphere");
+    const ObjectHandle the_bunny      = GetObjectHandle("the_bunny");
+    const ObjectHandle the_plane      = GetObjectHandle("the_plane");
+    const ObjectHandle the_monster    = GetObjectHandle("the_monster");
+    const ObjectHandle the_rock       = GetObjectHandle("the_rock");
+    const ObjectHandle the_ship       = GetObjectHandle("the_ship");
+    const ObjectHandle the_mount      = GetObjectHandle("the_mount");
+    const ObjectHandle the_piece      = GetObjectHandle("the_piece");
+    const ObjectHandle the_tree       = GetObjectHandle("the_tree");
+    const ObjectHandle the_boss       = GetObjectHandle("the_boss");
+    const ObjectHandle the_gun        = GetObjectHandle("the_gun");
+    const ObjectHandle the_flymonster = GetObjectHandle("the_flymonster");
+
+    // Matrizes de modelagem das cpias de um objeto desenhadas com
+    // DrawVirtualObjectInstanced(). O vetor  reutilizado por todos os
+    // desenhos instanciados, ento no h alocaes a cada quadro.
+    std::vector<glm::mat4> instance_models;
+
+    // Objetos que compem a cpsula e o astronauta. Todos usam a mesma matriz
+    // de modelagem e a mesma textura, ento cada modelo  desenhado com uma
+    // nica chamada a DrawVirtualObjects().
+    const ObjectHandle capsule_parts[] = {
+        GetObjectHandle("the_capsule"),
+        GetObjectHandle("Cylinder.011_Cylinder.022"),
+        GetObjectHandle("Cylinder.008_Cylinder.021"),
+        GetObjectHandle("Cylinder.005_Cylinder.010"),
+        GetObjectHandle("Cylinder.004_Cylinder.009"),
+    };
+    const int num_capsule_parts = sizeof(capsule_parts) / sizeof(capsule_parts[0]);
+
+    const ObjectHandle astronaut_parts[] = {
+        GetObjectHandle("the_astronaut_1"), GetObjectHandle("the_astronaut_2"),
+        GetObjectHandle("the_astronaut_3"), GetObjectHandle("the_astronaut_4"),
+        GetObjectHandle("the_astronaut_5"), GetObjectHandle("the_astronaut_6"),
+        GetObjectHandle("the_astronaut_7"), GetObjectHandle("the_astronaut_8"),
+    };
+    const int num_astronaut_parts = sizeof(astronaut_parts) / sizeof(astronaut_parts[0]);
+
+    // Objetos estticos //////////////////////////////////////////////////
+
+    // O morro, as pedras, as rvores e as cpsulas nunca mudam de lugar: as
+    // matrizes de modelagem so calculadas uma nica vez, e a cada quadro
+    // somente os objetos do PVS da clula da cmera so desenhados (veja
+    // "pvs.h" e os ndices STATIC_*).
+
+    const glm::mat4 mount_model = Matrix_Translate(mount_position.x, mount_position.y, mount_position.z)
+                                * Matrix_Scale(20.0f, 20.0f, 20.0f);
+
+    std::vector<glm::mat4> rock_models;
+    glm::mat4 rock;
+
+    // definindo os quatro cantos do mapa
+    for (int i=0; i<4; i++)
+    {
+        if (i == 0 || i == 1)
+        {
+            rock = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i+1))
+                 * Matrix_Scale(2.0f * i, 2.0f * i, 2.0f * i)
+                 * Matrix_Rotate_Y((3.141592f/2)*(i+1));
+        }
+        else
+        {
+            rock = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i))
+                 * Matrix_Scale(2.0f + i, 2.0f + i, 2.0f + i)
+                 * Matrix_Rotate_Y((3.141592f/2)*(i+1));
+        }
+        rock_models.push_back(rock);
+    }
+
+    rock = Matrix_Translate(80.0f, 1.0f, 110.0f)
+         * Matrix_Scale(7.0f, 7.0f, 7.0f)
+         * Matrix_Rotate_Y(M_PI/3);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(110.0f, 0.5f, 90.0f)
+         * Matrix_Scale(12.0f, 12.0f, 9.0f)
+         * Matrix_Rotate_Y(M_PI/2);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-90.0f, 1.0f, -110.0f)
+         * Matrix_Scale(12.0f, 5.0f, 7.0f);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-110.0f, 2.0f, -100.0f)
+         * Matrix_Scale(5.0f, 5.0f, 5.0f)
+         * Matrix_Rotate_Y(M_PI/2);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(90.0f, 1.0f, -110.0f)
+         * Matrix_Scale(12.0f, 5.0f, 7.0f);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(110.0f, 2.0f, -100.0f)
+         * Matrix_Scale(5.0f, 15.0f, 5.0f)
+         * Matrix_Rotate_Y(M_PI/2);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(112.0f, 1.0f, -120.0f)
+         * Matrix_Scale(10.0f, 15.0f, 7.0f);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(105.0f, 2.0f, -80.0f)
+         * Matrix_Scale(7.0f, 10.0f, 7.0f)
+         * Matrix_Rotate_Y(M_PI);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-75.0f, 0.0f, 90.0f)
+         * Matrix_Scale(12.0f, 12.0f, 12.0f)
+         * Matrix_Rotate_X(M_PI/2);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-100.0f, 1.0f, 75.0f)
+         * Matrix_Scale(6.0f, 6.0f, 6.0f)
+         * Matrix_Rotate_Y(M_PI);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-85.0f, 2.0f, 105.0f)
+         * Matrix_Scale(9.0f, 9.0f, 9.0f)
+         * Matrix_Rotate_Y(M_PI/4);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-120.0f, 5.0f, 90.0f)
+         * Matrix_Scale(15.0f, 15.0f, 15.0f)
+         * Matrix_Rotate_Z(M_PI/2);
+    rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-105.0f, 3.0f, 110.0f)
+         * Matrix_Scale(10.0f, 10.0f, 10.0f)
+         * Matrix_Rotate_Y(M_PI/2)
+         * Matrix_Rotate_X(M_PI)
+         * Matrix_Rotate_Z(M_PI/2);
+    rock_models.push_back(rock);
+
+
+    std::vector<glm::mat4> tree_models;
+    glm::mat4 tree_model;
+
+    tree_model = Matrix_Translate(tree[0].position.x, tree[0].position.y, tree[0].position.z)
+               * Matrix_Scale(10.0f, 10.0f, 10.0f);
+    tree_models.push_back(tree_model);
+
+    tree_model = Matrix_Translate(tree[1].position.x, tree[1].position.y, tree[1].position.z)
+               * Matrix_Scale(12.0f, 12.0f, 12.0f)
+               * Matrix_Rotate_Y(M_PI/2);
+    tree_models.push_back(tree_model);
+
+    tree_model = Matrix_Translate(tree[2].position.x, tree[2].position.y, tree[2].position.z)
+               * Matrix_Scale(15.0f, 15.0f, 15.0f)
+               * Matrix_Rotate_Y(-M_PI/2);
+    tree_models.push_back(tree_model);
+
+    for(int i = 3; i < 48; i++)
+    {
+        tree_model = Matrix_Translate(tree[i].position.x, tree[i].position.y, tree[i].position.z)
+               * Matrix_Scale(7.0f, 7.0f, 7.0f);
+        tree_models.push_back(tree_model);
+    }
+
+
+    // Caixas dos objetos estticos no espao do mundo. As cpsulas giram em
+    // torno do eixo Y, ento a caixa de cada uma envolve todas as rotaes.
+    std::vector<glm::vec3> static_min(STATIC_NUM_OBJECTS);
+    std::vector<glm::vec3> static_max(STATIC_NUM_OBJECTS);
+
+    TransformBoundingBox(g_SceneObjects[the_mount].bbox_min, g_SceneObjects[the_mount].bbox_max, mount_model,
+                         &static_min[STATIC_MOUNT], &static_max[STATIC_MOUNT]);
+    for (int i = 0; i < STATIC_NUM_ROCKS; ++i)
+        TransformBoundingBox(g_SceneObjects[the_rock].bbox_min, g_SceneObjects[the_rock].bbox_max, rock_models[i],
+                             &static_min[STATIC_FIRST_ROCK + i], &static_max[STATIC_FIRST_ROCK + i]);
+    for (int i = 0; i < STATIC_NUM_TREES; ++i)
+        TransformBoundingBox(g_SceneObjects[the_tree].bbox_min, g_SceneObjects[the_tree].bbox_max, tree_models[i],
+                             &static_min[STATIC_FIRST_TREE + i], &static_max[STATIC_FIRST_TREE + i]);
+
+    glm::vec3 capsule_min = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 capsule_max = glm::vec3(-std::numeric_limits<float>::max());
+    for (int i = 0; i < num_capsule_parts; ++i)
+    {
+        capsule_min = glm::min(capsule_min, g_SceneObjects[capsule_parts[i]].bbox_min);
+        capsule_max = glm::max(capsule_max, g_SceneObjects[capsule_parts[i]].bbox_max);
+    }
+    float capsule_spin_radius = glm::length(glm::vec2(std::max(-capsule_min.x, capsule_max.x),
+                                                      std::max(-capsule_min.z, capsule_max.z)));
+    capsule_min = glm::vec3(-capsule_spin_radius, capsule_min.y, -capsule_spin_radius);
+    capsule_max = glm::vec3( capsule_spin_radius, capsule_max.y,  capsule_spin_radius);
+    for (int i = 0; i < STATIC_NUM_CAPSULES; ++i)
+        TransformBoundingBox(capsule_min, capsule_max,
+                             Matrix_Translate(capsule[i].position.x, capsule[i].position.y, capsule[i].position.z)
+                           * Matrix_Scale(capsule[i].radius, capsule[i].radius, capsule[i].radius),
+                             &static_min[STATIC_FIRST_CAPSULE + i], &static_max[STATIC_FIRST_CAPSULE + i]);
+
+    // O PVS gravado s vale para estas caixas: se algum objeto mudar de
+    // lugar (ou de malha), o arquivo precisa ser gerado de novo
+    uint64_t static_hash = AssetRegistry_Hash(static_min.data(), static_min.size() * sizeof(glm::vec3));
+    static_hash = AssetRegistry_Hash(static_max.data(), static_max.size() * sizeof(glm::vec3), static_hash);
+
+    if ( bake_pvs )
+    {
+        PvsBakeInput input;
+        input.area_min     = cubo_min;
+        input.area_max     = cubo_max;
+        input.object_min   = static_min;
+        input.object_max   = static_max;
+        input.objects_hash = static_hash;
+
+        // Regies onde a cmera pode estar durante o jogo: no cho (at a
+        // altura mxima do pulo), escalando o morro e em cima do morro
+        PvsViewVolume ground = { glm::vec3(cubo_min.x, 1.0f, cubo_min.z), glm::vec3(cubo_max.x, 3.5f, cubo_max.z) };
+        PvsViewVolume climb  = { glm::vec3(mount_min.x, 1.0f, mount_min.z), glm::vec3(mount_max.x, 35.0f, mount_max.z) };
+        PvsViewVolume top    = { glm::vec3(mount_top_min.x, 29.0f, mount_top_min.z), glm::vec3(mount_top_max.x, 35.0f, mount_top_max.z) };
+        input.view_volumes.push_back(ground);
+        input.view_volumes.push_back(climb);
+        input.view_volumes.push_back(top);
+
+        // Os oclusores so as mesmas malhas substitutas do descarte por
+        // ocluso (veja "occlusion.h")
+        for (int i = 0; i < STATIC_FIRST_TREE; ++i)
+        {
+            PvsOccluder occluder;
+            occluder.object = i;
+            if ( i == STATIC_MOUNT )
+                Occlusion_GetOccluderTriangles(g_SceneObjects[the_mount].occluder, mount_model, &occluder.triangles);
+            else
+                Occlusion_GetOccluderTriangles(g_SceneObjects[the_rock].occluder, rock_models[i - STATIC_FIRST_ROCK], &occluder.triangles);
+            if ( occluder.triangles.empty() )
+                continue;
+
+            occluder.bbox_min = occluder.bbox_max = occluder.triangles[0];
+            for (size_t j = 1; j < occluder.triangles.size(); ++j)
+            {
+                occluder.bbox_min = glm::min(occluder.bbox_min, occluder.triangles[j]);
+                occluder.bbox_max = glm::max(occluder.bbox_max, occluder.triangles[j]);
+            }
+            input.occluders.push_back(occluder);
+        }
+
+        double bake_start = glfwGetTime();
+        bool ok = Pvs_Bake(input, PVS_FILENAME);
+        printf("PVS baked in %.1f s.\n", glfwGetTime() - bake_start);
+
+        Jobs_Shutdown();
+        AssetRegistry_Shutdown();
+        TextureArray_Shutdown();
+        ShaderPermutation_Shutdown();
+        GeometryArena_Shutdown();
+        Instancing_Shutdown();
+        DebugDraw_Shutdown();
+        DrawData_Shutdown();
+        glfwTerminate();
+        return ok ? 0 : EXIT_FAILURE;
+    }
+
+    Pvs_Load(PVS_FILENAME, static_hash);
+
+    ///////////////////////////////////////////////////////////////////////
+
+    // Grafo de cena ////////////////////////////////////////////////////////
+
+    // As pedras do game over ficam em outras posies
+    std::vector<glm::mat4> game_over_rock_models;
+
+    // definindo os quatro cantos do mapa
+    for (int i=0; i<4; i++)
+    {
+        if (i == 0 || i == 1)
+        {
+            rock = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i+1))
+                 * Matrix_Scale(2.0f + i, 200.0f + i, 2.0f + i)
+                 * Matrix_Rotate_Y((3.141592f/2)*(i+1));
+        }
+        else
+        {
+            rock = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i))
+                 * Matrix_Scale(2.0f + i, 2.0f + i, 2.0f + i)
+                 * Matrix_Rotate_Y((3.141592f/2)*(i+1));
+        }
+        game_over_rock_models.push_back(rock);
+    }
+
+    rock = Matrix_Translate(80.0f, 1.0f, 110.0f)
+         * Matrix_Scale(7.0f, 7.0f, 7.0f)
+         * Matrix_Rotate_Y(M_PI/3);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(110.0f, 0.5f, 90.0f)
+         * Matrix_Scale(12.0f, 12.0f, 9.0f)
+         * Matrix_Rotate_Y(M_PI/2);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-90.0f, 1.0f, -110.0f)
+         * Matrix_Scale(12.0f, 5.0f, 7.0f);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-110.0f, 2.0f, -100.0f)
+         * Matrix_Scale(5.0f, 5.0f, 5.0f)
+         * Matrix_Rotate_Y(M_PI/2);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-90.0f, 1.0f, 110.0f)
+         * Matrix_Scale(12.0f, 5.0f, 7.0f);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(-110.0f, 2.0f, 100.0f)
+         * Matrix_Scale(5.0f, 15.0f, 5.0f)
+         * Matrix_Rotate_Y(M_PI/2);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(75.0f, 0.0f, -90.0f)
+         * Matrix_Scale(12.0f, 12.0f, 12.0f)
+         * Matrix_Rotate_X(M_PI/2);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(100.0f, 1.0f, -75.0f)
+         * Matrix_Scale(6.0f, 6.0f, 6.0f)
+         * Matrix_Rotate_Y(M_PI);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(82.0f, 2.0f, -110.0f)
+         * Matrix_Scale(9.0f, 9.0f, 9.0f)
+         * Matrix_Rotate_Y(M_PI);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(120.0f, 5.0f, -90.0f)
+         * Matrix_Scale(15.0f, 15.0f, 15.0f)
+         * Matrix_Rotate_Z(M_PI/2);
+    game_over_rock_models.push_back(rock);
+
+    rock = Matrix_Translate(105.0f, 3.0f, -110.0f)
+         * Matrix_Scale(10.0f, 10.0f, 10.0f)
+         * Matrix_Rotate_Y(M_PI/2)
+         * Matrix_Rotate_X(M_PI)
+         * Matrix_Rotate_Z(M_PI/2);
+    game_over_rock_models.push_back(rock);
+
+    // O que cada n desenha (veja DrawSceneGraph())
+    const int sky_1_drawable      = AddSceneDrawable(&the_sphere, 1, SKYBOX1, 0, RENDERPASS_BACKGROUND);
+    const int sky_2_drawable      = AddSceneDrawable(&the_sphere, 1, SKYBOX2, 0, RENDERPASS_BACKGROUND);
+    const int plane_drawable      = AddSceneDrawable(&the_plane, 1, PLANE, 0);
+    const int ship_drawable       = AddSceneDrawable(&the_ship, 1, SPACESHIP, 0);
+    const int bunny_drawable      = AddSceneDrawable(&the_bunny, 1, BUNNY, DRAWABLE_LOD | DRAWABLE_DEPTH_PREPASS);
+    const int monster_drawable    = AddSceneDrawable(&the_monster, 1, MONSTER, DRAWABLE_INSTANCED);
+    const int rock_drawable       = AddSceneDrawable(&the_rock, 1, ROCK, DRAWABLE_INSTANCED);
+    const int mount_drawable      = AddSceneDrawable(&the_mount, 1, MOUNT, DRAWABLE_LOD);
+    const int piece_drawable      = AddSceneDrawable(&the_piece, 1, PIECE, 0);
+    const int capsule_drawable    = AddSceneDrawable(capsule_parts, num_capsule_parts, CAPSULE, 0);
+    const int tree_drawable       = AddSceneDrawable(&the_tree, 1, TREE, DRAWABLE_INSTANCED);
+    const int boss_drawable       = AddSceneDrawable(&the_boss, 1, BOSS, DRAWABLE_LOD | DRAWABLE_DEPTH_PREPASS);
+    const int gun_drawable        = AddSceneDrawable(&the_gun, 1, GUN, 0);
+    const int flymonster_drawable = AddSceneDrawable(&the_flymonster, 1, FLYMONSTER, DRAWABLE_LOD);
+    const int astronaut_drawable  = AddSceneDrawable(astronaut_parts, num_astronaut_parts, ASTRONAUT, 0);
+
+    // Cada cena (jogo, game over e as duas partes da vitria) mostra alguns
+    // dos grupos abaixo; veja o incio de "GRAFO DE CENA" no loop.
+    const SceneNodeId scene_root = SceneGraph_CreateNode(SCENENODE_NONE);
+
+    const SceneNodeId sky_1_node = SceneGraph_CreateNode(scene_root, sky_1_drawable);
+    const SceneNodeId sky_2_node = SceneGraph_CreateNode(scene_root, sky_2_drawable);
+
+    // Cho e nave: jogo, game over e primeira parte da vitria
+    const SceneNodeId ground_group = SceneGraph_CreateNode(scene_root);
+    const SceneNodeId plane_node   = SceneGraph_CreateNode(ground_group, plane_drawable);
+    const SceneNodeId ship_node    = SceneGraph_CreateNode(ground_group, ship_drawable);
+    SceneGraph_SetLocal(plane_node, Matrix_Translate(plane_position.x, plane_position.y, plane_position.z)
+                                  * Matrix_Scale(200.0f, 1.0f, 200.0f));
+
+    // Objetos do mapa: jogo e game over
+    const SceneNodeId map_group = SceneGraph_CreateNode(scene_root);
+
+    const SceneNodeId mount_node = SceneGraph_CreateNode(map_group, mount_drawable);
+    SceneGraph_SetLocal(mount_node, mount_model);
+    SceneGraph_SetStaticIndex(mount_node, STATIC_MOUNT);
+
+    for (int i = 0; i < STATIC_NUM_TREES; ++i)
+    {
+        SceneNodeId node = SceneGraph_CreateNode(map_group, tree_drawable);
+        SceneGraph_SetLocal(node, tree_models[i]);
+        SceneGraph_SetStaticIndex(node, STATIC_FIRST_TREE + i);
+    }
+
+    SceneNodeId capsule_nodes[STATIC_NUM_CAPSULES];
+    for (int i = 0; i < STATIC_NUM_CAPSULES; ++i)
+    {
+        capsule_nodes[i] = SceneGraph_CreateNode(map_group, capsule_drawable);
+        SceneGraph_SetStaticIndex(capsule_nodes[i], STATIC_FIRST_CAPSULE + i);
+    }
+
+    SceneNodeId piece_nodes[5];
+    for (int i = 0; i < 5; ++i)
+        piece_nodes[i] = SceneGraph_CreateNode(map_group, piece_drawable);
+
+    const SceneNodeId bunny_node     = SceneGraph_CreateNode(map_group, bunny_drawable);
+    const SceneNodeId boss_node      = SceneGraph_CreateNode(map_group, boss_drawable);
+    const SceneNodeId monsters_group = SceneGraph_CreateNode(map_group);
+    std::vector<SceneNodeId> monster_nodes;
+
+    // Somente durante o jogo
+    const SceneNodeId playing_group = SceneGraph_CreateNode(scene_root);
+    for (int i = 0; i < STATIC_NUM_ROCKS; ++i)
+    {
+        SceneNodeId node = SceneGraph_CreateNode(playing_group, rock_drawable);
+        SceneGraph_SetLocal(node, rock_models[i]);
+        SceneGraph_SetStaticIndex(node, STATIC_FIRST_ROCK + i);
+    }
+    const SceneNodeId flymonster_node = SceneGraph_CreateNode(playing_group, flymonster_drawable);
+
+    // Somente no game over
+    const SceneNodeId game_over_group = SceneGraph_CreateNode(scene_root);
+    for (size_t i = 0; i < game_over_rock_models.size(); ++i)
+        SceneGraph_SetLocal(SceneGraph_CreateNode(game_over_group, rock_drawable), game_over_rock_models[i]);
+    const SceneNodeId astronaut_node = SceneGraph_CreateNode(game_over_group, astronaut_drawable);
+
+    // Objetos presos  cmera, definidos no sistema de coordenadas dela: a
+    // arma e a nave da segunda parte da vitria
+    const SceneNodeId camera_node   = SceneGraph_CreateNode(scene_root);
+    const SceneNodeId gun_node      = SceneGraph_CreateNode(camera_node, gun_drawable);
+    const SceneNodeId win_ship_node = SceneGraph_CreateNode(camera_node, ship_drawable);
+    SceneGraph_SetLocal(gun_node, Matrix_Translate(0.06f, -0.115f, -0.2f)
+                                * Matrix_Scale(0.1f, 0.1f, 0.1f)
+                                * Matrix_Rotate_Y(M_PI));
+    SceneGraph_SetLocal(win_ship_node, Matrix_Translate(0.0f, -2.0f, -15.0f)
+                                     * Matrix_Scale(5.0f, 5.0f, 5.0f)
+                                     * Matrix_Rotate_Y(M_PI/2));
+
+    ///////////////////////////////////////////////////////////////////////
+
+    // A partir daqui, o contexto OpenGL pertence  thread de renderizao
+    // (veja "renderthread.h"). O loop abaixo (a thread do jogo) simula e
+    // grava o quadro N+1 enquanto ela executa os comandos OpenGL do quadro N.
+    RenderThread_Start(window, HandoffFrame, [window, vertex_array_object_id_crosshair]()
+    {
+        RenderFrame(window, vertex_array_object_id_crosshair);
+    });
+
     // Ficamos em um loop infinito, renderizando, at que o usurio feche a janela
     while (!glfwWindowShouldClose(window))
     {
-        // Aqui executamos as operaes de renderizao
+        // Aqui gravamos as operaes de renderizao do quadro
 
         // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor 
         // definida como coeficientes RGBA: Red, Green, Blue, Alpha; isto :
         // Vermelho, Verde, Azul, Alpha (valor de transparncia).
         // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminao.
         //
-        //           R     G     B     A
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        //                                   R     G     B     A
+        g_GameFrame.clear_color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
 
-        // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
-        // e tambm resetamos todos os pixels do Z-buffer (depth buffer).
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Na visualizao de sobreposio (tecla F4), os desenhos somam cor a
+        // partir do preto (veja "renderqueue.h")
+        if ( RenderQueue_OverdrawMode() )
+            g_GameFrame.clear_color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 
-        // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
-        // os shaders de vrtice e fragmentos).
-        glUseProgram(g_GpuProgramID);
+        glfwGetFramebufferSize(window, &g_GameFrame.framebuffer_width, &g_GameFrame.framebuffer_height);
+        g_GameFrame.draw_crosshair = false;
+
+        // Os textos deste quadro so acumulados e desenhados juntos no fim
+        // do quadro, por TextRendering_Flush()
+        TextRendering_BeginFrame(window);
 
         // Computamos a posio da cmera utilizando coordenadas esfricas.  As
         // variveis g_CameraDistance, g_CameraPhi, e g_CameraTheta so
@@ -1338,31 +1995,32 @@ int main(int argc, char* argv[])
         // Para definio do field of view (FOV), veja slides 205-215 do documento Aula_09_Projecoes.pdf.
         float field_of_view = 3.141592 / 3.0f;
         projection = Matrix_Perspective(field_of_view, g_ScreenRatio, nearplane, farplane);
+        g_LodPixelsPerUnit = g_ScreenHeight / (2.0f * tan(field_of_view / 2.0f));
 
         glm::mat4 model = Matrix_Identity(); // Transformao identidade de modelagem
 
-        // Enviamos as matrizes "view" e "projection" para a placa de vdeo
-        // (GPU). Veja o arquivo "shader_vertex.glsl", onde estas so
+        // As matrizes "view" e "projection" so enviadas para a placa de
+        // vdeo (GPU) pela thread de renderizao, no bloco "FrameData". Veja
+        // RenderFrame() e o arquivo "shader_vertex.glsl", onde estas so
         // efetivamente aplicadas em todos os pontos.
-        glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-        glUniformMatrix4fv(g_projection_uniform , 1 , GL_FALSE , glm::value_ptr(projection));
+        g_GameFrame.view = view;
+        g_GameFrame.projection = projection;
 
+        // Os desenhos abaixo so guardados na fila de renderizao, e s so
+        // executados pela thread de renderizao. Veja "renderqueue.h".
+        RenderQueue_SetView(view);
+        RenderQueue_SetProjection(projection);
 
-        if (!win && !gameOver)
-        {
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// SKYBOX ///////////////////////////////////////////////
 
-            model = Matrix_Translate(player.position.x, player.position.y, player.position.z);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SKYBOX1);
-            glDisable(GL_CULL_FACE);
-            glDisable(GL_DEPTH_TEST);
-            DrawVirtualObject("the_sphere");
-            glEnable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);
+        // Cenas do jogo: cada uma mostra uma parte do grafo de cena (veja
+        // "scenegraph.h" e a montagem do grafo antes do loop)
+        bool playing   = !win && !gameOver;
+        bool game_over = gameOver && !tp_end;
+        bool win_1     = win && (float)glfwGetTime() <= cutscene_win_time + 2.0f;
+        bool win_2     = win && (float)glfwGetTime() > cutscene_win_time + 2.0f;
 
+        if (playing)
+        {
             //////////////////////////////////////////////////////////////////////////
 
             /////////////////// TIROS ////////////////////////////////////////////////
@@ -1392,6 +2050,7 @@ int main(int argc, char* argv[])
                 if (reload)
                     num_shots = 6;
 
+                instance_models.clear();
                 for (size_t i = 0; i < shot.size(); ++i) {
 
                     if (shot[i].is_active)
@@ -1438,288 +2097,14 @@ int main(int argc, char* argv[])
                         // Desenha o tiro aps feita a atualizao
                         model = Matrix_Translate(shot[i].position.x, shot[i].position.y, shot[i].position.z)
                               * Matrix_Scale(0.025f, 0.025f, 0.025f);
-                        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                        glUniform1i(g_object_id_uniform, BULLETS);
-                        DrawVirtualObject("the_sphere");
+                        instance_models.push_back(model);
 
                     }
                 }
-            }
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// COELHO ///////////////////////////////////////////////
-
-            model = Matrix_Translate(bunny_position.x, bunny_position.y, bunny_position.z)
-                  * Matrix_Rotate_Z(g_AngleZ)
-                  * Matrix_Rotate_Y(g_AngleY)
-                  * Matrix_Rotate_X(g_AngleX);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, BUNNY);
-            if (bunny_alive)
-                DrawVirtualObject("the_bunny");
-
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// PLANO ////////////////////////////////////////////////
-
-            model = Matrix_Translate(plane_position.x, plane_position.y, plane_position.z)
-                  * Matrix_Scale(200.0f, 1.0f, 200.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, PLANE);
-            DrawVirtualObject("the_plane");
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// MONSTRO //////////////////////////////////////////////
-
-            for (size_t i = 0; i < monster.size(); ++i) {
-
-                if (monster[i].is_alive)
-                {
-                    model = Matrix_Translate(monster[i].position.x, monster[i].position.y, monster[i].position.z)
-                          * Matrix_Scale(2.0f, 2.0f, 2.0f)
-                          * Matrix_Rotate_Y(monster[i].angle);
-                    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                    glUniform1i(g_object_id_uniform, MONSTER);
-                    if (monster[i].lifes > 0)
-                        DrawVirtualObject("the_monster");
-                }
-
-            }
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// PEDRAS ///////////////////////////////////////////////
-
-            // definindo os quatro cantos do mapa
-            for (int i=0; i<4; i++)
-            {
-                if (i == 0 || i == 1)
-                {
-                    model = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i+1))
-                          * Matrix_Scale(2.0f * i, 2.0f * i, 2.0f * i)
-                          * Matrix_Rotate_Y((3.141592f/2)*(i+1));
-                }
-                else
-                {
-                    model = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i))
-                          * Matrix_Scale(2.0f + i, 2.0f + i, 2.0f + i)
-                          * Matrix_Rotate_Y((3.141592f/2)*(i+1));
-                }
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-            }
-
-            model = Matrix_Translate(80.0f, 1.0f, 110.0f)
-                  * Matrix_Scale(7.0f, 7.0f, 7.0f)
-                  * Matrix_Rotate_Y(M_PI/3);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(110.0f, 0.5f, 90.0f)
-                  * Matrix_Scale(12.0f, 12.0f, 9.0f)
-                  * Matrix_Rotate_Y(M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(-90.0f, 1.0f, -110.0f)
-                  * Matrix_Scale(12.0f, 5.0f, 7.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(-110.0f, 2.0f, -100.0f)
-                  * Matrix_Scale(5.0f, 5.0f, 5.0f)
-                  * Matrix_Rotate_Y(M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(90.0f, 1.0f, -110.0f)
-                  * Matrix_Scale(12.0f, 5.0f, 7.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(110.0f, 2.0f, -100.0f)
-                  * Matrix_Scale(5.0f, 15.0f, 5.0f)
-                  * Matrix_Rotate_Y(M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(112.0f, 1.0f, -120.0f)
-                  * Matrix_Scale(10.0f, 15.0f, 7.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(105.0f, 2.0f, -80.0f)
-                  * Matrix_Scale(7.0f, 10.0f, 7.0f)
-                  * Matrix_Rotate_Y(M_PI);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(-75.0f, 0.0f, 90.0f)
-                  * Matrix_Scale(12.0f, 12.0f, 12.0f)
-                  * Matrix_Rotate_X(M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(-100.0f, 1.0f, 75.0f)
-                  * Matrix_Scale(6.0f, 6.0f, 6.0f)
-                  * Matrix_Rotate_Y(M_PI);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(-85.0f, 2.0f, 105.0f)
-                  * Matrix_Scale(9.0f, 9.0f, 9.0f)
-                  * Matrix_Rotate_Y(M_PI/4);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(-120.0f, 5.0f, 90.0f)
-                  * Matrix_Scale(15.0f, 15.0f, 15.0f)
-                  * Matrix_Rotate_Z(M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            model = Matrix_Translate(-105.0f, 3.0f, 110.0f)
-                  * Matrix_Scale(10.0f, 10.0f, 10.0f)
-                  * Matrix_Rotate_Y(M_PI/2)
-                  * Matrix_Rotate_X(M_PI)
-                  * Matrix_Rotate_Z(M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, ROCK);
-            DrawVirtualObject("the_rock");
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// NAVE /////////////////////////////////////////////////
-
-            model = Matrix_Translate(spaceship.position.x, spaceship.position.y, spaceship.position.z)
-                  * Matrix_Scale(5.0f, 5.0f, 5.0f)
-                  * Matrix_Rotate_Y(3.141592f*0.75f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SPACESHIP);
-            DrawVirtualObject("the_ship");
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// MORRO ////////////////////////////////////////////////
-
-            model = Matrix_Translate(mount_position.x, mount_position.y, mount_position.z)
-                  * Matrix_Scale(20.0f, 20.0f, 20.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, MOUNT);
-            DrawVirtualObject("the_mount");
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// PEDAO DA NAVE ///////////////////////////////////////
-
-            for(int i = 0; i < 5; i++){
-                if(piece[i].collected == false){
-                    model = Matrix_Translate(piece[i].position.x, piece[i].position.y, piece[i].position.z)
-                          * Matrix_Scale(0.4f, 0.4f, 0.4f)
-                          * Matrix_Rotate_Y(fmod(prev_time, piece[i].angle));
-                    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                    glUniform1i(g_object_id_uniform, PIECE);
-                    DrawVirtualObject("the_piece");
-                }
-
-            }
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// CAPSULAS /////////////////////////////////////////////
-
-            for (int i = 0; i < 3; i++){
-                model = Matrix_Translate(capsule[i].position.x, capsule[i].position.y, capsule[i].position.z)
-                      * Matrix_Scale(capsule[i].radius, capsule[i].radius, capsule[i].radius)
-                      * Matrix_Rotate_Y(fmod(prev_time, capsule[i].angle));
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, CAPSULE);
-            DrawVirtualObject("the_capsule");
-            DrawVirtualObject("Cylinder.011_Cylinder.022");
-            DrawVirtualObject("Cylinder.008_Cylinder.021");
-            DrawVirtualObject("Cylinder.005_Cylinder.010");
-            DrawVirtualObject("Cylinder.004_Cylinder.009");
-            }
-
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// ARVORES ///////////////////////////////////////////////
-
-            model = Matrix_Translate(tree[0].position.x, tree[0].position.y, tree[0].position.z)
-                  * Matrix_Scale(10.0f, 10.0f, 10.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, TREE);
-            DrawVirtualObject("the_tree");
-
-            model = Matrix_Translate(tree[1].position.x, tree[1].position.y, tree[1].position.z)
-                  * Matrix_Scale(12.0f, 12.0f, 12.0f)
-                  * Matrix_Rotate_Y(M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, TREE);
-            DrawVirtualObject("the_tree");
-
-            model = Matrix_Translate(tree[2].position.x, tree[2].position.y, tree[2].position.z)
-                  * Matrix_Scale(15.0f, 15.0f, 15.0f)
-                  * Matrix_Rotate_Y(-M_PI/2);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, TREE);
-            DrawVirtualObject("the_tree");
-
-            for(int i = 3; i < 48; i++)
-            {
-                model = Matrix_Translate(tree[i].position.x, tree[i].position.y, tree[i].position.z)
-                  * Matrix_Scale(7.0f, 7.0f, 7.0f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, TREE);
-                DrawVirtualObject("the_tree");
-            }
-
-            //////////////////////////////////////////////////////////////////////////
 
-            /////////////////// BOSS /////////////////////////////////////////////////
-
-            if(boss.is_alive == true) {
-                model = Matrix_Translate(boss.position.x, boss.position.y, boss.position.z)
-                  * Matrix_Scale(10.0f, 10.0f, 10.0f)
-                  * Matrix_Rotate_Y(boss.angle);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, BOSS);
-                DrawVirtualObject("the_boss");
-            }
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// ARMA /////////////////////////////////////////////////
-
-            if (!lookat_boss && !win && !gameOver)
-            {
-                model = Matrix_Translate(0.06f, -0.115f, -0.2f)
-                      * Matrix_Scale(0.1f, 0.1f, 0.1f)
-                      * Matrix_Rotate_Y(M_PI);
-                view = Matrix_Identity();
-                glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, GUN);
-                DrawVirtualObject("the_gun");
-                view = Matrix_Camera_View(camera_position_c, camera_view_vector, camera_up_vector);
-                glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
+                // Todos os tiros so desenhados com uma nica chamada
+                SetDrawMaterial(BULLETS);
+                DrawVirtualObjectInstanced(the_sphere, instance_models.data(), (int)instance_models.size());
             }
 
             //////////////////////////////////////////////////////////////////////////
@@ -1734,11 +2119,8 @@ int main(int argc, char* argv[])
 
             fly_monster_angle = -atan2(fly_position.z - player.position.z, fly_position.x - player.position.x);
 
-            model = Matrix_Translate(fly_position.x, fly_position.y, fly_position.z)
-                  * Matrix_Rotate_Y(fly_monster_angle);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, FLYMONSTER);
-            DrawVirtualObject("the_flymonster");
+            SceneGraph_SetLocal(flymonster_node, Matrix_Translate(fly_position.x, fly_position.y, fly_position.z)
+                                               * Matrix_Rotate_Y(fly_monster_angle));
 
             // Incremento para que o objeto se mova na curva
             t += 0.8f * delta_t;
@@ -1751,427 +2133,127 @@ int main(int argc, char* argv[])
             }
         }
 
-        // GAME OVER ////////////////////////////////////////////////////////////////////////
+        //////////////////////////////////////////////////////////////////////////
 
-        if (gameOver)
+        /////////////////// GRAFO DE CENA ////////////////////////////////////////
+
+        SceneGraph_SetVisible(sky_1_node,      !win_2);
+        SceneGraph_SetVisible(sky_2_node,      win_2);
+        SceneGraph_SetVisible(ground_group,    playing || game_over || win_1);
+        SceneGraph_SetVisible(map_group,       playing || game_over);
+        SceneGraph_SetVisible(playing_group,   playing);
+        SceneGraph_SetVisible(game_over_group, game_over);
+        SceneGraph_SetVisible(gun_node,        playing && !lookat_boss);
+        SceneGraph_SetVisible(win_ship_node,   win_2);
+
+        // Os filhos da cmera so definidos no sistema de coordenadas da
+        // cmera: a matriz local dela leva da cmera para o mundo
+        SceneGraph_SetLocal(camera_node, glm::inverse(view));
+
+        glm::mat4 sky_model = Matrix_Translate(player.position.x, player.position.y, player.position.z);
+        SceneGraph_SetLocal(sky_1_node, sky_model);
+        SceneGraph_SetLocal(sky_2_node, sky_model);
+
+        SceneGraph_SetVisible(bunny_node, bunny_alive);
+        SceneGraph_SetLocal(bunny_node, Matrix_Translate(bunny_position.x, bunny_position.y, bunny_position.z)
+                                      * Matrix_Rotate_Z(g_AngleZ)
+                                      * Matrix_Rotate_Y(g_AngleY)
+                                      * Matrix_Rotate_X(g_AngleX));
+
+        // Os monstros das novas ondas ganham ns na primeira vez em que aparecem
+        while (monster_nodes.size() < monster.size())
+            monster_nodes.push_back(SceneGraph_CreateNode(monsters_group, monster_drawable));
+        for (size_t i = 0; i < monster.size(); ++i)
         {
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// SKYBOX ///////////////////////////////////////////////
-
-            model = Matrix_Translate(player.position.x, player.position.y, player.position.z);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SKYBOX1);
-            glDisable(GL_CULL_FACE);
-            glDisable(GL_DEPTH_TEST);
-            DrawVirtualObject("the_sphere");
-            glEnable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// ASTRONAUTA ///////////////////////////////////////////
-
-            if (!tp_end)
-            {
-                model = Matrix_Translate(death_position.x, death_position.y, death_position.z)
-                      * Matrix_Rotate_Z(M_PI/2)
-                      * Matrix_Rotate_Y(M_PI);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ASTRONAUT);
-                DrawVirtualObject("the_astronaut_1");
-                DrawVirtualObject("the_astronaut_2");
-                DrawVirtualObject("the_astronaut_3");
-                DrawVirtualObject("the_astronaut_4");
-                DrawVirtualObject("the_astronaut_5");
-                DrawVirtualObject("the_astronaut_6");
-                DrawVirtualObject("the_astronaut_7");
-                DrawVirtualObject("the_astronaut_8");
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// PLANO ////////////////////////////////////////////////
-
-                model = Matrix_Translate(plane_position.x, plane_position.y, plane_position.z)
-                      * Matrix_Scale(200.0f, 1.0f, 200.0f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, PLANE);
-                DrawVirtualObject("the_plane");
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// COELHO ///////////////////////////////////////////////
-
-                model = Matrix_Translate(bunny_position.x, bunny_position.y, bunny_position.z)
-                      * Matrix_Rotate_Z(g_AngleZ)
-                      * Matrix_Rotate_Y(g_AngleY)
-                      * Matrix_Rotate_X(g_AngleX);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, BUNNY);
-                if (bunny_alive)
-                    DrawVirtualObject("the_bunny");
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// MONSTRO //////////////////////////////////////////////
-
-                for (size_t i = 0; i < monster.size(); ++i) {
-
-                    if (monster[i].is_alive)
-                    {
-                        model = Matrix_Translate(monster[i].position.x, monster[i].position.y, monster[i].position.z)
-                              * Matrix_Scale(2.0f, 2.0f, 2.0f)
-                              * Matrix_Rotate_Y(monster[i].angle);
-                        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                        glUniform1i(g_object_id_uniform, MONSTER);
-                        if (monster[i].lifes > 0)
-                            DrawVirtualObject("the_monster");
-                    }
-
-                }
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// PEDRAS ///////////////////////////////////////////////
-
-                // definindo os quatro cantos do mapa
-                for (int i=0; i<4; i++)
-                {
-                    if (i == 0 || i == 1)
-                    {
-                        model = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i+1))
-                              * Matrix_Scale(2.0f + i, 200.0f + i, 2.0f + i)
-                              * Matrix_Rotate_Y((3.141592f/2)*(i+1));
-                    }
-                    else
-                    {
-                        model = Matrix_Translate(98.0f*pow(-1, i), 0.0f + (0.6*i), 98.0f*pow(-1, i))
-                              * Matrix_Scale(2.0f + i, 2.0f + i, 2.0f + i)
-                              * Matrix_Rotate_Y((3.141592f/2)*(i+1));
-                    }
-                    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                    glUniform1i(g_object_id_uniform, ROCK);
-                    DrawVirtualObject("the_rock");
-                }
-
-                model = Matrix_Translate(80.0f, 1.0f, 110.0f)
-                      * Matrix_Scale(7.0f, 7.0f, 7.0f)
-                      * Matrix_Rotate_Y(M_PI/3);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(110.0f, 0.5f, 90.0f)
-                      * Matrix_Scale(12.0f, 12.0f, 9.0f)
-                      * Matrix_Rotate_Y(M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(-90.0f, 1.0f, -110.0f)
-                      * Matrix_Scale(12.0f, 5.0f, 7.0f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(-110.0f, 2.0f, -100.0f)
-                      * Matrix_Scale(5.0f, 5.0f, 5.0f)
-                      * Matrix_Rotate_Y(M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(-90.0f, 1.0f, 110.0f)
-                      * Matrix_Scale(12.0f, 5.0f, 7.0f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(-110.0f, 2.0f, 100.0f)
-                      * Matrix_Scale(5.0f, 15.0f, 5.0f)
-                      * Matrix_Rotate_Y(M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(75.0f, 0.0f, -90.0f)
-                      * Matrix_Scale(12.0f, 12.0f, 12.0f)
-                      * Matrix_Rotate_X(M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(100.0f, 1.0f, -75.0f)
-                      * Matrix_Scale(6.0f, 6.0f, 6.0f)
-                      * Matrix_Rotate_Y(M_PI);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(82.0f, 2.0f, -110.0f)
-                      * Matrix_Scale(9.0f, 9.0f, 9.0f)
-                      * Matrix_Rotate_Y(M_PI);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(120.0f, 5.0f, -90.0f)
-                      * Matrix_Scale(15.0f, 15.0f, 15.0f)
-                      * Matrix_Rotate_Z(M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                model = Matrix_Translate(105.0f, 3.0f, -110.0f)
-                      * Matrix_Scale(10.0f, 10.0f, 10.0f)
-                      * Matrix_Rotate_Y(M_PI/2)
-                      * Matrix_Rotate_X(M_PI)
-                      * Matrix_Rotate_Z(M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, ROCK);
-                DrawVirtualObject("the_rock");
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// NAVE /////////////////////////////////////////////////
-
-                model = Matrix_Translate(spaceship.position.x, spaceship.position.y, spaceship.position.z)
-                      * Matrix_Scale(5.0f, 5.0f, 5.0f)
-                      * Matrix_Rotate_Y(3.141592f*0.75f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, SPACESHIP);
-                DrawVirtualObject("the_ship");
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// MORRO ////////////////////////////////////////////////
-
-                model = Matrix_Translate(mount_position.x, mount_position.y, mount_position.z)
-                      * Matrix_Scale(20.0f, 20.0f, 20.0f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, MOUNT);
-                DrawVirtualObject("the_mount");
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// PEDAO DA NAVE ///////////////////////////////////////
-
-                for(int i = 0; i < 5; i++){
-                    if(piece[i].collected == false){
-                        model = Matrix_Translate(piece[i].position.x, piece[i].position.y, piece[i].position.z)
-                              * Matrix_Scale(0.4f, 0.4f, 0.4f)
-                              * Matrix_Rotate_Y(fmod(prev_time, piece[i].angle));
-                        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                        glUniform1i(g_object_id_uniform, PIECE);
-                        DrawVirtualObject("the_piece");
-                    }
-
-                }
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// CAPSULAS /////////////////////////////////////////////
-
-                for (int i = 0; i < 3; i++){
-                    model = Matrix_Translate(capsule[i].position.x, capsule[i].position.y, capsule[i].position.z)
-                          * Matrix_Scale(capsule[i].radius, capsule[i].radius, capsule[i].radius)
-                          * Matrix_Rotate_Y(fmod(prev_time, capsule[i].angle));
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, CAPSULE);
-                DrawVirtualObject("the_capsule");
-                DrawVirtualObject("Cylinder.011_Cylinder.022");
-                DrawVirtualObject("Cylinder.008_Cylinder.021");
-                DrawVirtualObject("Cylinder.005_Cylinder.010");
-                DrawVirtualObject("Cylinder.004_Cylinder.009");
-                }
-
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// ARVORES ///////////////////////////////////////////////
-
-                model = Matrix_Translate(tree[0].position.x, tree[0].position.y, tree[0].position.z)
-                      * Matrix_Scale(10.0f, 10.0f, 10.0f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, TREE);
-                DrawVirtualObject("the_tree");
-
-                model = Matrix_Translate(tree[1].position.x, tree[1].position.y, tree[1].position.z)
-                      * Matrix_Scale(12.0f, 12.0f, 12.0f)
-                      * Matrix_Rotate_Y(M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, TREE);
-                DrawVirtualObject("the_tree");
-
-                model = Matrix_Translate(tree[2].position.x, tree[2].position.y, tree[2].position.z)
-                      * Matrix_Scale(15.0f, 15.0f, 15.0f)
-                      * Matrix_Rotate_Y(-M_PI/2);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, TREE);
-                DrawVirtualObject("the_tree");
-
-                for(int i = 3; i < 48; i++)
-                {
-                    model = Matrix_Translate(tree[i].position.x, tree[i].position.y, tree[i].position.z)
-                      * Matrix_Scale(7.0f, 7.0f, 7.0f);
-                    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                    glUniform1i(g_object_id_uniform, TREE);
-                    DrawVirtualObject("the_tree");
-                }
-
-                //////////////////////////////////////////////////////////////////////////
-
-                /////////////////// BOSS /////////////////////////////////////////////////
-
-                if(boss.is_alive == true) {
-                    model = Matrix_Translate(boss.position.x, boss.position.y, boss.position.z)
-                      * Matrix_Scale(10.0f, 10.0f, 10.0f)
-                      * Matrix_Rotate_Y(boss.angle);
-                    glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                    glUniform1i(g_object_id_uniform, BOSS);
-                    DrawVirtualObject("the_boss");
-                }
-            }
+            SceneGraph_SetVisible(monster_nodes[i], monster[i].is_alive && monster[i].lifes > 0);
+            SceneGraph_SetLocal(monster_nodes[i], Matrix_Translate(monster[i].position.x, monster[i].position.y, monster[i].position.z)
+                                                * Matrix_Scale(2.0f, 2.0f, 2.0f)
+                                                * Matrix_Rotate_Y(monster[i].angle));
         }
 
-        // WIN 1 /////////////////////////////////////////////////////////////////////////////////
-
-        if(win && (float)glfwGetTime() <= cutscene_win_time + 2.0f)
+        for (int i = 0; i < 5; i++)
         {
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// SKYBOX ///////////////////////////////////////////////
+            SceneGraph_SetVisible(piece_nodes[i], piece[i].collected == false);
+            SceneGraph_SetLocal(piece_nodes[i], Matrix_Translate(piece[i].position.x, piece[i].position.y, piece[i].position.z)
+                                              * Matrix_Scale(0.4f, 0.4f, 0.4f)
+                                              * Matrix_Rotate_Y(fmod(prev_time, piece[i].angle)));
+        }
 
-            model = Matrix_Translate(player.position.x, player.position.y, player.position.z);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SKYBOX1);
-            glDisable(GL_CULL_FACE);
-            glDisable(GL_DEPTH_TEST);
-            DrawVirtualObject("the_sphere");
-            glEnable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);
+        for (int i = 0; i < STATIC_NUM_CAPSULES; i++)
+            SceneGraph_SetLocal(capsule_nodes[i], Matrix_Translate(capsule[i].position.x, capsule[i].position.y, capsule[i].position.z)
+                                                * Matrix_Scale(capsule[i].radius, capsule[i].radius, capsule[i].radius)
+                                                * Matrix_Rotate_Y(fmod(prev_time, capsule[i].angle)));
 
-            //////////////////////////////////////////////////////////////////////////
+        SceneGraph_SetVisible(boss_node, boss.is_alive == true);
+        SceneGraph_SetLocal(boss_node, Matrix_Translate(boss.position.x, boss.position.y, boss.position.z)
+                                     * Matrix_Scale(10.0f, 10.0f, 10.0f)
+                                     * Matrix_Rotate_Y(boss.angle));
 
-            /////////////////// PLANO ////////////////////////////////////////////////
+        SceneGraph_SetLocal(ship_node, Matrix_Translate(spaceship.position.x, spaceship.position.y, spaceship.position.z)
+                                     * Matrix_Scale(5.0f, 5.0f, 5.0f)
+                                     * Matrix_Rotate_Y(3.141592f*0.75f));
 
-            model = Matrix_Translate(plane_position.x, plane_position.y, plane_position.z)
-                  * Matrix_Scale(200.0f, 1.0f, 200.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, PLANE);
-            DrawVirtualObject("the_plane");
+        SceneGraph_SetLocal(astronaut_node, Matrix_Translate(death_position.x, death_position.y, death_position.z)
+                                          * Matrix_Rotate_Z(M_PI/2)
+                                          * Matrix_Rotate_Y(M_PI));
 
-            //////////////////////////////////////////////////////////////////////////
+        // Objetos estticos visveis da clula da cmera (veja "pvs.h").
+        // Durante a cena do boss, no game over e na vitria a cmera sai das
+        // regies usadas no clculo do PVS.
+        const uint8_t* static_visible = (playing && !lookat_boss) ? Pvs_VisibleSet(camera_position_c) : NULL;
 
-            /////////////////// NAVE /////////////////////////////////////////////////
+        DrawSceneGraph(scene_root, static_visible);
 
-            model = Matrix_Translate(spaceship.position.x, spaceship.position.y, spaceship.position.z)
-                  * Matrix_Scale(5.0f, 5.0f, 5.0f)
-                  * Matrix_Rotate_Y(3.141592f*0.75f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SPACESHIP);
-            DrawVirtualObject("the_ship");
-        }
+        //////////////////////////////////////////////////////////////////////////
 
-        // WIN 2 ////////////////////////////////////////////////////////////////////////////////////
+        /////////////////// HITBOXES /////////////////////////////////////////////
 
-        if (win && (float)glfwGetTime() > cutscene_win_time + 2.0f)
+        // Esferas de coliso e regies do mapa, desenhadas como linhas somente
+        // com o desenho de depurao ligado (tecla F3). Veja "debugdraw.h".
+        if ( DebugDraw_IsEnabled() )
         {
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// SKYBOX ///////////////////////////////////////////////
+            const glm::vec3 red(1.0f, 0.0f, 0.0f);
+            const glm::vec3 green(0.0f, 1.0f, 0.0f);
+            const glm::vec3 blue(0.0f, 0.4f, 1.0f);
+            const glm::vec3 yellow(1.0f, 0.9f, 0.0f);
 
-            model = Matrix_Translate(player.position.x, player.position.y, player.position.z);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SKYBOX2);
-            glDisable(GL_CULL_FACE);
-            glDisable(GL_DEPTH_TEST);
-            DrawVirtualObject("the_sphere");
-            glEnable(GL_CULL_FACE);
-            glEnable(GL_DEPTH_TEST);
-
-            //////////////////////////////////////////////////////////////////////////
-
-            /////////////////// NAVE /////////////////////////////////////////////////
+            for (size_t i = 0; i < monster.size(); ++i)
+                if (monster[i].is_alive)
+                    DebugDraw_Sphere(glm::vec3(monster[i].hitbox), monster[i].radius, red);
 
-            model = Matrix_Translate(0.0f, -2.0f, -15.0f)
-                  * Matrix_Scale(5.0f, 5.0f, 5.0f)
-                  * Matrix_Rotate_Y(M_PI/2);
-            view = Matrix_Identity();
-            glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, SPACESHIP);
-            DrawVirtualObject("the_ship");
-            view = Matrix_Camera_View(camera_position_c, camera_view_vector, camera_up_vector);
-            glUniformMatrix4fv(g_view_uniform       , 1 , GL_FALSE , glm::value_ptr(view));
+            DebugDraw_Sphere(glm::vec3(hitbox_bunny), bunny_radius, green);
+            DebugDraw_Sphere(glm::vec3(hitbox_spaceship), spaceship.radius, green);
 
-        }
+            if (boss.is_alive == true)
+                DebugDraw_Sphere(glm::vec3(boss.hitbox), boss.radius, red);
 
-        //////////////////////////////////////////////////////////////////////////
+            // Regio em que o jogador pode comprar upgrades
+            for (size_t i = 0; i < capsule.size(); ++i)
+                DebugDraw_Sphere(glm::vec3(capsule[i].hitbox), capsule[i].radius + 3.0f, yellow);
 
-        /////////////////// HITBOXES /////////////////////////////////////////////
+            for (size_t i = 0; i < piece.size(); ++i)
+                if (piece[i].collected == false)
+                    DebugDraw_Sphere(glm::vec3(piece[i].hitbox), piece[i].radius, yellow);
 
-        for (size_t i = 0; i < monster.size(); ++i)
-        {
-            if (monster[i].is_alive)
+            // Tiros, com a direo do movimento
+            for (size_t i = 0; i < shot.size(); ++i)
             {
-                // Esfera de coliso centrada nos monstros
-                model = Matrix_Translate(monster[i].hitbox.x, monster[i].hitbox.y, monster[i].hitbox.z)
-                      * Matrix_Scale(1.5f, 1.5f, 1.5f);
-                glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-                glUniform1i(g_object_id_uniform, HITBOX);
-                glEnable(GL_BLEND);
-                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                DrawVirtualObject("the_sphere");
-                glDisable(GL_BLEND);
+                if (shot[i].is_active)
+                {
+                    DebugDraw_Sphere(glm::vec3(shot[i].position), shot[i].radius, blue);
+                    DebugDraw_Ray(glm::vec3(shot[i].position), glm::vec3(shot[i].speed), 2.0f, blue);
+                }
             }
-        }
 
-        // Esfera de coliso centrada no coelho
-        model = Matrix_Translate(hitbox_bunny.x, hitbox_bunny.y, hitbox_bunny.z)
-              * Matrix_Scale(2.0f, 2.0f, 2.0f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, HITBOX);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        DrawVirtualObject("the_sphere");
-        glDisable(GL_BLEND);
-
-        // Esfera de coliso centrada na nave
-        model = Matrix_Translate(hitbox_spaceship.x, hitbox_spaceship.y, hitbox_spaceship.z)
-              * Matrix_Scale(2.0f, 2.0f, 2.0f);
-        glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-        glUniform1i(g_object_id_uniform, HITBOX);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        DrawVirtualObject("the_sphere");
-        glDisable(GL_BLEND);
-
-        // Esfera de coliso centrada no boss
-        if(boss.is_alive == true){
-            model = Matrix_Translate(boss.hitbox.x, boss.hitbox.y, boss.hitbox.z)
-              * Matrix_Scale(11.0f, 11.0f, 11.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, HITBOX);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            DrawVirtualObject("the_sphere");
-            glDisable(GL_BLEND);
+            // Limites do mapa e regio de escalada do morro
+            DebugDraw_Box(cubo_min, cubo_max, blue);
+            DebugDraw_Box(mount_min, mount_max, yellow);
         }
 
-        // Esfera de coliso centrada nas capsulas
-        for (size_t i = 0; i < capsule.size(); ++i)
-        {
-            model = Matrix_Translate(capsule[i].hitbox.x, capsule[i].hitbox.y, capsule[i].hitbox.z)
-                  * Matrix_Scale(1.0f, 1.0f, 1.0f);
-            glUniformMatrix4fv(g_model_uniform, 1 , GL_FALSE , glm::value_ptr(model));
-            glUniform1i(g_object_id_uniform, HITBOX);
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            DrawVirtualObject("the_sphere");
-            glDisable(GL_BLEND);
-        }
+        // Descarta os desenhos invisveis e ordena a fila pelo estado; os
+        // desenhos (e as linhas de depurao acumuladas acima) so executados
+        // em RenderFrame()
+        RenderQueue_Prepare();
 
         //////////////////////////////////////////////////////////////////////////
 
@@ -2374,11 +2456,8 @@ int main(int argc, char* argv[])
             if(show_message_5)
                 TextRendering_ShowMessageClimbing(window);
 
-            // desenha a crossair na frente da tela
-            glDisable(GL_DEPTH_TEST);
-            glBindVertexArray(vertex_array_object_id_crosshair);
-            glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_BYTE, 0);
-            glEnable(GL_DEPTH_TEST);
+            // desenha a crossair na frente da tela (veja RenderFrame())
+            g_GameFrame.draw_crosshair = true;
 
         }
 
@@ -2390,21 +2469,23 @@ int main(int argc, char* argv[])
             // Imprimimos na tela a mensagem de fim de jogo
             TextRendering_ShowWin(window);
 
-        // Desligamos o VAO
-        glBindVertexArray(0);
-
         // Atualiza delta de tempo
         float current_time = (float)glfwGetTime();
         delta_t = current_time - prev_time;
         prev_time = current_time;
 
-        // O framebuffer onde OpenGL executa as operaes de renderizao no
-        //  o mesmo que est sendo mostrado para o usurio, caso contrrio
-        // seria possvel ver artefatos conhecidos como "screen tearing". A
-        // chamada abaixo faz a troca dos buffers, mostrando para o usurio
-        // tudo que foi renderizado pelas funes acima.
-        // Veja o link: https://en.wikipedia.org/w/index.php?title=Multiple_buffering&oldid=793452829#Double_buffering_in_computer_graphics
-        glfwSwapBuffers(window);
+        // Entregamos o quadro gravado para a thread de renderizao. Aqui
+        // esperamos ela terminar o quadro anterior e trocar os quadros (veja
+        // HandoffFrame()); em seguida, enquanto ela desenha este quadro,
+        // continuamos com o prximo.
+        RenderThread_SubmitFrame();
+
+        // Depois do primeiro quadro, os arquivos adiados so carregados em
+        // segundo plano, um por vez. Se o fim do jogo parece prximo (ltima
+        // vida, ou todas as peas coletadas e o boss aparecendo), todos so
+        // carregados de uma vez, para estarem prontos na tela final.
+        bool end_predicted = gameOver || win || player.lifes <= 1 || num_pieces == 5;
+        UpdateDeferredAssets(end_predicted);
 
         // Verificamos com o sistema operacional se houve alguma interao do
         // usurio (teclado, mouse, ...). Caso positivo, as funes de callback
@@ -2413,98 +2494,748 @@ int main(int argc, char* argv[])
         glfwPollEvents();
     }
 
+    // O contexto OpenGL volta para esta thread
+    RenderThread_Stop();
+
     // Finalizamos o uso dos recursos do sistema operacional
+    Jobs_Shutdown();
+    AssetRegistry_Shutdown();
+    TextureArray_Shutdown();
+    ShaderPermutation_Shutdown();
+    GeometryArena_Shutdown();
+    Instancing_Shutdown();
+    DebugDraw_Shutdown();
+    DrawData_Shutdown();
     glfwTerminate();
 
     // Fim do programa
     return 0;
 }
 
-// Funo que carrega uma imagem para ser utilizada como textura
-void LoadTextureImage(const char* filename)
+// Executada pela thread de renderizao, com a thread do jogo parada em
+// RenderThread_SubmitFrame(): todo o estado compartilhado pelas duas threads
+//  alterado aqui. Veja "renderthread.h".
+void HandoffFrame()
 {
-    printf("Carregando imagem \"%s\"... ", filename);
-
-    // Primeiro fazemos a leitura da imagem do disco
-    stbi_set_flip_vertically_on_load(true);
-    int width;
-    int height;
-    int channels;
-    unsigned char *data = stbi_load(filename, &width, &height, &channels, 3);
-
-    if ( data == NULL )
+    // Enviamos para a GPU os arquivos adiados que j foram lidos. As malhas
+    // e texturas novas s so vistas pela thread do jogo no prximo quadro.
+    Jobs_RunCompletions();
+
+    RenderQueue_SwapFrame();
+    TextRendering_SwapFrame();
+    DebugDraw_SwapFrame();
+    Occlusion_EndFrame();
+    g_RenderFrame = g_GameFrame;
+
+    // O quadro entregue foi gravado com os programas antigos
+    if ( g_ReloadShadersRequested )
     {
-        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
+        std::vector<GLuint> old_programs(ShaderPermutation_Count());
+        for (size_t i = 0; i < old_programs.size(); ++i)
+            old_programs[i] = ShaderPermutation_Program((ShaderPermutationId)i);
+
+        LoadShadersFromFiles();
+        for (size_t i = 0; i < old_programs.size(); ++i)
+            RenderQueue_ReplaceProgram(old_programs[i], ShaderPermutation_Program((ShaderPermutationId)i));
+        g_ReloadShadersRequested = false;
     }
 
-    printf("OK (%dx%d).\n", width, height);
+    UpdateMaterials();
+}
 
-    // Agora criamos objetos na GPU com OpenGL para armazenar a textura
-    GLuint texture_id;
-    GLuint sampler_id;
-    glGenTextures(1, &texture_id);
-    glGenSamplers(1, &sampler_id);
+// Executada pela thread de renderizao enquanto a thread do jogo grava o
+// prximo quadro: somente os dados entregues por HandoffFrame() so lidos.
+void RenderFrame(GLFWwindow* window, GLuint crosshair_vertex_array_id)
+{
+    const FrameSnapshot& frame = g_RenderFrame;
 
-    // Veja slides 95-96 do documento Aula_20_Mapeamento_de_Texturas.pdf
-    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glSamplerParameteri(sampler_id, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+    static int viewport_width = -1;
+    static int viewport_height = -1;
+    if ( frame.framebuffer_width != viewport_width || frame.framebuffer_height != viewport_height )
+    {
+        glViewport(0, 0, frame.framebuffer_width, frame.framebuffer_height);
+        viewport_width = frame.framebuffer_width;
+        viewport_height = frame.framebuffer_height;
+    }
 
-    // Parmetros de amostragem da textura.
-    glSamplerParameteri(sampler_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glSamplerParameteri(sampler_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // "Pintamos" todos os pixels do framebuffer com a cor do quadro, e
+    // tambm resetamos todos os pixels do Z-buffer (depth buffer).
+    glClearColor(frame.clear_color.r, frame.clear_color.g, frame.clear_color.b, frame.clear_color.a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Agora enviamos a imagem lida do disco para a GPU
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    // Enviamos as matrizes "view" e "projection" para a placa de vdeo
+    // (GPU), no bloco "FrameData"
+    DrawData_SetFrame(frame.view, frame.projection);
 
-    GLuint textureunit = g_NumLoadedTextures;
-    glActiveTexture(GL_TEXTURE0 + textureunit);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindSampler(textureunit, sampler_id);
+    // Executa todos os desenhos da cena, ordenados pelo estado
+    RenderQueue_Execute();
 
-    stbi_image_free(data);
+    // Linhas de depurao, com uma nica chamada
+    DebugDraw_Flush(frame.view, frame.projection);
 
-    g_NumLoadedTextures += 1;
-}
+    if ( frame.draw_crosshair )
+    {
+        // desenha a crossair na frente da tela
+        glUseProgram(g_GpuProgramID);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(crosshair_vertex_array_id);
+        glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_BYTE, 0);
+        glEnable(GL_DEPTH_TEST);
+    }
 
-// Funo que desenha um objeto armazenado em g_VirtualScene. Veja definio
-// dos objetos na funo BuildTrianglesAndAddToVirtualScene().
-void DrawVirtualObject(const char* object_name)
-{
-    // "Ligamos" o VAO. Informamos que queremos utilizar os atributos de
-    // vrtices apontados pelo VAO criado pela funo BuildTrianglesAndAddToVirtualScene(). Veja
-    // comentrios detalhados dentro da definio de BuildTrianglesAndAddToVirtualScene().
-    glBindVertexArray(g_VirtualScene[object_name].vertex_array_object_id);
-
-    // Setamos as variveis "bbox_min" e "bbox_max" do fragment shader
-    // com os parmetros da axis-aligned bounding box (AABB) do modelo.
-    glm::vec3 bbox_min = g_VirtualScene[object_name].bbox_min;
-    glm::vec3 bbox_max = g_VirtualScene[object_name].bbox_max;
-    glUniform4f(g_bbox_min_uniform, bbox_min.x, bbox_min.y, bbox_min.z, 1.0f);
-    glUniform4f(g_bbox_max_uniform, bbox_max.x, bbox_max.y, bbox_max.z, 1.0f);
-
-    // Pedimos para a GPU rasterizar os vrtices dos eixos XYZ
-    // apontados pelo VAO como linhas. Veja a definio de
-    // g_VirtualScene[""] dentro da funo BuildTrianglesAndAddToVirtualScene(), e veja
-    // a documentao da funo glDrawElements() em
-    // http://docs.gl/gl3/glDrawElements.
-    glDrawElements(
-        g_VirtualScene[object_name].rendering_mode,
-        g_VirtualScene[object_name].num_indices,
-        GL_UNSIGNED_INT,
-        (void*)(g_VirtualScene[object_name].first_index * sizeof(GLuint))
-    );
+    // Desenhamos todos os textos do quadro com uma nica chamada
+    TextRendering_Flush();
 
-    // "Desligamos" o VAO, evitando assim que operaes posteriores venham a
-    // alterar o mesmo. Isso evita bugs.
+    // Desligamos o VAO
     glBindVertexArray(0);
+
+    // O framebuffer onde OpenGL executa as operaes de renderizao no
+    //  o mesmo que est sendo mostrado para o usurio, caso contrrio
+    // seria possvel ver artefatos conhecidos como "screen tearing". A
+    // chamada abaixo faz a troca dos buffers, mostrando para o usurio
+    // tudo que foi renderizado pelas funes acima.
+    // Veja o link: https://en.wikipedia.org/w/index.php?title=Multiple_buffering&oldid=793452829#Double_buffering_in_computer_graphics
+    glfwSwapBuffers(window);
+
+    RenderQueue_EndFrame();
+    DrawData_EndFrame();
+
+    static bool first_frame_shown = false;
+    if ( !first_frame_shown )
+    {
+        printf("Primeiro quadro exibido %.1f ms aps o incio do programa.\n", 1000.0*glfwGetTime());
+        first_frame_shown = true;
+    }
+}
+
+// Imagem de textura sendo carregada por uma thread auxiliar
+struct TextureLoadJob
+{
+    std::string       filename;
+    AssetId           asset;
+    unsigned char*    data;
+    int               width;
+    int               height;
+    bool              cooked;      // Se verdadeiro, a textura est em "compressed"
+    CompressedTexture compressed;
+    uint64_t          content_hash; // Hash dos dados enviados para a GPU
+    double            load_time;
+};
+
+// Registra a camada de array de uma textura carregada, para o prximo envio
+// da tabela de materiais
+static void SetTextureLayer(GLuint texture_index, const Asset& asset)
+{
+    if ( asset.gpu.in_texture_array )
+        g_TextureLayers[texture_index] = asset.gpu.texture_layer;
+    g_MaterialsChanged = true;
+}
+
+// Camada de array de uma posio de g_TextureFiles, ou array -1 se a textura
+// ainda no foi carregada
+static TextureLayer MaterialTexture(int texture)
+{
+    if ( texture < 0 || (size_t)texture >= g_TextureLayers.size() )
+    {
+        TextureLayer none = { -1, 0 };
+        return none;
+    }
+    return g_TextureLayers[texture];
+}
+
+// Monta a tabela de materiais com as camadas das texturas j carregadas e a
+// envia para a GPU. Chamada a cada quadro; s faz algo quando alguma textura
+// terminou de carregar.
+void UpdateMaterials()
+{
+    if ( !g_MaterialsChanged )
+        return;
+
+    MaterialRecord records[DRAWDATA_MAX_MATERIALS];
+    memset(records, 0, sizeof(records));
+    for (size_t i = 0; i < DRAWDATA_MAX_MATERIALS; ++i)
+    {
+        records[i].texture_array = -1;
+        records[i].detail_array  = -1;
+        records[i].uv_scale      = 1.0f;
+        records[i].alpha         = 1.0f;
+    }
+
+    for (size_t i = 0; i < g_NumMaterials; ++i)
+    {
+        const Material& material = g_Materials[i];
+        TextureLayer texture = MaterialTexture(material.texture);
+        TextureLayer detail  = MaterialTexture(material.detail);
+
+        MaterialRecord& record = records[material.object_id];
+        record.texture_array = texture.array;
+        record.texture_layer = texture.layer;
+        record.detail_array  = detail.array;
+        record.detail_layer  = detail.layer;
+        record.uv_scale      = material.uv_scale;
+        record.alpha         = material.alpha;
+    }
+
+    DrawData_SetMaterials(records, DRAWDATA_MAX_MATERIALS);
+    g_MaterialsChanged = false;
+}
+
+// Os prximos desenhos da fila de renderizao utilizam o material
+// "object_id" e o programa de GPU especializado para a sua classe
+void SetDrawMaterial(int object_id)
+{
+    RenderQueue_SetObjectId(object_id);
+
+    RenderProgram program = { ShaderPermutation_Program(g_MaterialPermutations[object_id]) };
+    RenderQueue_SetProgram(program);
+}
+
+// Agenda a tarefa "load", que carrega o arquivo do recurso "asset", em uma
+// thread auxiliar, ou a guarda em g_DeferredLoads se a carga for adiada.
+static void SubmitOrDeferLoad(AssetId asset, const char* filename, bool deferred, const Job& load)
+{
+    if ( !deferred )
+    {
+        Jobs_Submit(load);
+        return;
+    }
+
+    DeferredLoad deferred_load;
+    deferred_load.asset    = asset;
+    deferred_load.filename = filename;
+    deferred_load.load     = load;
+    g_DeferredLoads.push_back(deferred_load);
+}
+
+// Inicia as cargas adiadas. Normalmente, apenas uma carga  feita por vez,
+// para no competir com o jogo pelas threads auxiliares e pelo envio para a
+// GPU; se "urgent" for verdadeiro, todas as restantes so iniciadas de uma
+// vez. Chamada a cada quadro, depois do primeiro.
+void UpdateDeferredAssets(bool urgent)
+{
+    while ( !g_DeferredLoads.empty() && (urgent || g_NumDeferredLoadsInFlight == 0) )
+    {
+        DeferredLoad deferred_load = g_DeferredLoads.front();
+        g_DeferredLoads.pop_front();
+
+        printf("Carregando \"%s\" em segundo plano...\n", deferred_load.filename.c_str());
+
+        std::string filename = deferred_load.filename;
+        double request_time = glfwGetTime();
+        g_NumDeferredLoadsInFlight += 1;
+        AssetRegistry_WhenLoaded(deferred_load.asset, [filename, request_time](const Asset&)
+        {
+            g_NumDeferredLoadsInFlight -= 1;
+            printf("\"%s\" carregado em segundo plano (%.1f ms).\n", filename.c_str(), 1000.0*(glfwGetTime() - request_time));
+        });
+
+        Jobs_Submit(deferred_load.load);
+    }
+
+    // Quando todas as cargas terminam, todos os objetos desenhados j devem existir
+    static bool checked = false;
+    if ( !checked && g_DeferredLoads.empty() && g_NumDeferredLoadsInFlight == 0 )
+    {
+        CheckSceneObjects();
+        checked = true;
+    }
+}
+
+// Envia para a GPU uma imagem j decodificada. Executada na thread com o
+// contexto OpenGL, por Jobs_RunCompletions() ou Jobs_WaitAll().
+static void UploadTextureImage(TextureLoadJob* job)
+{
+    if ( job->data == NULL && !job->cooked )
+    {
+        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", job->filename.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+
+    double upload_start = glfwGetTime();
+
+    // Se uma imagem com o mesmo contedo j est na GPU, ela  reutilizada
+    AssetId existing = AssetRegistry_FindByContent(ASSET_TEXTURE, job->content_hash);
+    if ( existing != ASSET_INVALID )
+    {
+        printf("Imagem \"%s\"  igual a \"%s\"; reutilizando a textura.\n", job->filename.c_str(), AssetRegistry_Get(existing).path.c_str());
+        if ( job->data != NULL )
+            stbi_image_free(job->data);
+        job->data = NULL;
+        job->compressed.data.clear();
+        AssetRegistry_ShareWith(job->asset, existing);
+        return;
+    }
+
+    // Agora enviamos a imagem lida do disco para a GPU, como uma camada de
+    // um array de texturas com o mesmo formato e tamanho (veja
+    // "texturearray.h"). Os parmetros de amostragem (veja slides 95-96 do
+    // documento Aula_20_Mapeamento_de_Texturas.pdf) so os do array.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    TextureLayer texture_layer;
+    size_t gpu_bytes = 0;
+    if ( job->cooked )
+    {
+        // Todos os nveis de mipmap j esto prontos no arquivo cozido
+        const CompressedTexture& texture = job->compressed;
+        texture_layer = TextureArray_Add(texture.internal_format, job->width, job->height, (int)texture.levels.size());
+        if ( texture_layer.array >= 0 )
+        {
+            for (size_t level = 0; level < texture.levels.size(); ++level)
+            {
+                const CompressedTexture::Level& l = texture.levels[level];
+                TextureArray_SetCompressedLevel(texture_layer, (int)level, l.width, l.height, (GLsizei)l.size, &texture.data[l.offset]);
+            }
+            gpu_bytes = texture.data.size();
+        }
+        job->compressed.data.clear();
+    }
+    else
+    {
+        int num_levels = 1;
+        while ( (std::max(job->width, job->height) >> num_levels) > 0 )
+            num_levels += 1;
+
+        texture_layer = TextureArray_Add(GL_SRGB8, job->width, job->height, num_levels);
+        if ( texture_layer.array >= 0 )
+        {
+            TextureArray_SetLevel(texture_layer, 0, job->width, job->height, GL_RGB, GL_UNSIGNED_BYTE, job->data);
+            TextureArray_GenerateMipmaps(texture_layer);
+
+            // Os drivers guardam GL_SRGB8 com 4 bytes por pixel, e os mipmaps
+            // ocupam mais 1/3 da imagem.
+            gpu_bytes = (size_t)job->width * job->height * 4 * 4 / 3;
+        }
+
+        stbi_image_free(job->data);
+        job->data = NULL;
+    }
+
+    // A camada  registrada para os materiais que pediram a textura (veja
+    // LoadTextureImage()) por AssetRegistry_SetLoaded(). Se no havia array
+    // disponvel, os materiais continuam cinza.
+    AssetGpuResources gpu = AssetGpuResources();
+    gpu.in_texture_array = texture_layer.array >= 0;
+    gpu.texture_layer    = texture_layer;
+    AssetRegistry_SetLoaded(job->asset, job->content_hash, gpu, gpu_bytes);
+
+    AssetLoadTime timing;
+    timing.filename    = job->filename;
+    timing.load_time   = job->load_time;
+    timing.upload_time = glfwGetTime() - upload_start;
+    g_AssetLoadTimes.push_back(timing);
+}
+
+// Funo que carrega uma imagem para ser utilizada como textura. A leitura e
+// a decodificao da imagem so feitas em uma thread auxiliar; o envio para a
+// GPU  feito depois, na thread com o contexto OpenGL (a thread de
+// renderizao, durante o jogo), por Jobs_RunCompletions() ou
+// Jobs_WaitAll(). A posio em g_TextureLayers  reservada aqui, ento a
+// ordem das chamadas define as posies usadas pela tabela de materiais.
+//
+// Se a mesma imagem j foi pedida antes, ela no  lida novamente: a camada
+// j existente (veja "assetregistry.h")  utilizada tambm na nova posio.
+//
+// Se "deferred" for verdadeiro, a carga s comea depois do primeiro quadro
+// (veja UpdateDeferredAssets()); at l, os materiais que a usam so cinza.
+void LoadTextureImage(const char* filename, bool deferred)
+{
+    GLuint texture_index = g_NumLoadedTextures;
+    g_NumLoadedTextures += 1;
+
+    TextureLayer not_loaded = { -1, 0 };
+    g_TextureLayers.push_back(not_loaded);
+
+    bool is_new;
+    AssetId asset = AssetRegistry_Register(filename, ASSET_TEXTURE, &is_new);
+    AssetRegistry_WhenLoaded(asset, [texture_index](const Asset& loaded) { SetTextureLayer(texture_index, loaded); });
+
+    if ( !is_new )
+    {
+        printf("Imagem \"%s\" j carregada; reutilizando a textura.\n", filename);
+        return;
+    }
+
+    printf("Carregando imagem \"%s\"...\n", filename);
+
+    // A stb_image (verso 2.15) guarda esta opo em uma varivel global, que
+    // no deve ser alterada enquanto as threads auxiliares decodificam imagens.
+    // Por isso ela  definida aqui, na thread principal.
+    stbi_set_flip_vertically_on_load(true);
+
+    std::shared_ptr<TextureLoadJob> job(new TextureLoadJob);
+    job->filename     = filename;
+    job->asset        = asset;
+    job->data         = NULL;
+    job->width        = 0;
+    job->height       = 0;
+    job->cooked       = false;
+    job->content_hash = 0;
+    job->load_time    = 0.0;
+
+    SubmitOrDeferLoad(asset, filename, deferred, [job]()
+    {
+        double load_start = glfwGetTime();
+
+        // Se existe um arquivo cozido atualizado, ele  lido diretamente,
+        // sem nenhuma decodificao. Caso contrrio, fazemos a leitura da
+        // imagem original do disco.
+        std::string cooked_filename = TextureCook_Filename(job->filename.c_str());
+        if ( g_UseCookedTextures && TextureCook_LoadKTX(cooked_filename.c_str(), job->filename.c_str(), &job->compressed) )
+        {
+            job->cooked = true;
+            job->width  = job->compressed.levels[0].width;
+            job->height = job->compressed.levels[0].height;
+            job->content_hash = AssetRegistry_Hash(&job->compressed.internal_format, sizeof(job->compressed.internal_format));
+            job->content_hash = AssetRegistry_Hash(job->compressed.data.data(), job->compressed.data.size(), job->content_hash);
+        }
+        else
+        {
+            int channels;
+            job->data = stbi_load(job->filename.c_str(), &job->width, &job->height, &channels, 3);
+            if ( job->data != NULL )
+            {
+                int size[2] = { job->width, job->height };
+                job->content_hash = AssetRegistry_Hash(size, sizeof(size));
+                job->content_hash = AssetRegistry_Hash(job->data, (size_t)job->width * job->height * 3, job->content_hash);
+            }
+        }
+        job->load_time = glfwGetTime() - load_start;
+
+        Jobs_SubmitToMainThread([job]() { UploadTextureImage(job.get()); });
+    });
+}
+
+// Gera, em paralelo, o arquivo cozido de cada imagem de g_TextureFiles.
+// Imagens que no podem ser lidas so ignoradas; o jogo carrega a imagem
+// original sempre que no existe um arquivo cozido.
+int CookTextures()
+{
+    // Mesma orientao utilizada por LoadTextureImage()
+    stbi_set_flip_vertically_on_load(true);
+
+    Jobs_Init();
+
+    for (size_t i = 0; i < g_NumTextureFiles; ++i)
+    {
+        const char* filename = g_TextureFiles[i].filename;
+        Jobs_Submit([filename]()
+        {
+            std::string cooked_filename = TextureCook_Filename(filename);
+            if ( TextureCook_CookFile(filename, cooked_filename.c_str()) )
+                printf("Textura \"%s\" cozida em \"%s\".\n", filename, cooked_filename.c_str());
+        });
+    }
+
+    Jobs_WaitAll();
+    Jobs_Shutdown();
+
+    return EXIT_SUCCESS;
+}
+
+// Imprime no terminal o tempo de carga de cada arquivo, e o tempo total. A
+// soma dos tempos nas threads auxiliares  aproximadamente o tempo que a
+// carga levaria sem paralelismo.
+void PrintAssetLoadReport(double wall_time)
+{
+    printf("\nTempo de carga dos arquivos (%u threads auxiliares):\n", Jobs_NumThreads());
+
+    double total_load_time = 0.0;
+    double total_upload_time = 0.0;
+    for (size_t i = 0; i < g_AssetLoadTimes.size(); ++i)
+    {
+        const AssetLoadTime& timing = g_AssetLoadTimes[i];
+        printf("  %8.1f ms + %6.1f ms GPU  %s\n", 1000.0*timing.load_time, 1000.0*timing.upload_time, timing.filename.c_str());
+        total_load_time += timing.load_time;
+        total_upload_time += timing.upload_time;
+    }
+
+    printf("  Soma: %.1f ms de leitura + %.1f ms de envio para a GPU\n", 1000.0*total_load_time, 1000.0*total_upload_time);
+    printf("  Tempo total: %.1f ms\n\n", 1000.0*wall_time);
+}
+
+// Retorna o identificador do objeto "object_name". Chamada fora do loop de
+// renderizao: o resultado deve ser guardado e passado para
+// DrawVirtualObject(). Se o objeto ainda no existe (por exemplo, de um
+// modelo com carga adiada), uma posio  reservada para ele e preenchida por
+// AddMeshToVirtualScene(); at l, o objeto no  desenhado.
+ObjectHandle GetObjectHandle(const char* object_name)
+{
+    std::unordered_map<std::string, ObjectHandle>::iterator it = g_SceneObjectsByName.find(object_name);
+    if ( it != g_SceneObjectsByName.end() )
+        return it->second;
+
+    SceneObject theobject = SceneObject();
+    theobject.loaded = false;
+    theobject.occluder = OCCLUDER_NONE;
+
+    ObjectHandle handle = (ObjectHandle)g_SceneObjects.size();
+    g_SceneObjects.push_back(theobject);
+    g_SceneObjectNames.push_back(object_name);
+    g_SceneObjectsByName[object_name] = handle;
+    return handle;
+}
+
+// Imprime um erro para cada objeto pedido com GetObjectHandle() que no
+// existe em nenhum dos modelos carregados (nome digitado errado, por
+// exemplo). Chamada depois que todas as cargas terminam.
+void CheckSceneObjects()
+{
+    for (size_t handle = 0; handle < g_SceneObjects.size(); ++handle)
+        if ( !g_SceneObjects[handle].loaded )
+            fprintf(stderr, "ERROR: Object \"%s\" is drawn but does not exist in any loaded model.\n", g_SceneObjectNames[handle].c_str());
+}
+
+// Descreve o nvel de detalhe "lod" de um objeto para a fila de
+// renderizao. Veja definio dos objetos na funo AddMeshToVirtualScene().
+static RenderMesh SceneObjectMesh(ObjectHandle handle, int lod)
+{
+    const SceneObject& object = g_SceneObjects[handle];
+
+    // Todos os modelos esto no VAO da arena de geometria (veja
+    // "geometryarena.h"). Os ndices de cada modelo comeam em zero;
+    // "base_vertex"  somado a eles para encontrar os vrtices do modelo
+    // dentro do VBO da arena.
+    RenderMesh mesh;
+    mesh.vertex_array_id = GeometryArena_GetVertexArray();
+    mesh.rendering_mode  = object.rendering_mode;
+    mesh.num_indices     = (GLsizei)object.lods[lod].num_indices;
+    mesh.first_index     = object.lods[lod].first_index;
+    mesh.base_vertex     = object.base_vertex;
+    mesh.mesh_id         = handle;
+
+    // Parmetros da axis-aligned bounding box (AABB) do modelo, enviados
+    // para as variveis "bbox_min" e "bbox_max" do fragment shader.
+    mesh.bbox_min = object.bbox_min;
+    mesh.bbox_max = object.bbox_max;
+    return mesh;
+}
+
+// Escolhe o nvel de detalhe mais simples de um objeto cujo erro, projetado
+// na tela, no passa de LOD_MAX_SCREEN_ERROR pixels. O erro de cada nvel
+// (veja "meshsimplify.h")  multiplicado pela maior escala de "model" e
+// dividido pela distncia entre a cmera e a esfera que envolve o objeto.
+static int SelectLod(const SceneObject& object, const glm::mat4& model)
+{
+    if ( object.num_lods <= 1 )
+        return 0;
+
+    glm::vec3 center = (object.bbox_min + object.bbox_max) * 0.5f;
+    float radius = glm::length(object.bbox_max - object.bbox_min) * 0.5f;
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+    glm::vec4 center_world = model * glm::vec4(center, 1.0f);
+    float distance = glm::length(glm::vec3(center_world - camera_position_c)) - radius * scale;
+    if ( distance <= 0.0f )
+        return 0;
+
+    float pixels_per_model_unit = scale * g_LodPixelsPerUnit / distance;
+    for (int lod = object.num_lods - 1; lod > 0; --lod)
+        if ( object.lods[lod].error * pixels_per_model_unit <= LOD_MAX_SCREEN_ERROR )
+            return lod;
+    return 0;
+}
+
+// Os desenhos abaixo no so executados imediatamente: so adicionados  fila
+// de renderizao, com a matriz de modelagem e o material definidos por
+// RenderQueue_SetModel() e SetDrawMaterial(). Veja "renderqueue.h".
+void DrawVirtualObject(ObjectHandle handle)
+{
+    // Objetos de modelos com carga adiada s existem depois que o modelo
+    // termina de carregar (veja UpdateDeferredAssets()); at l, no so
+    // desenhados.
+    const SceneObject& object = g_SceneObjects[handle];
+    if ( !object.loaded )
+        return;
+
+    RenderQueue_Draw(SceneObjectMesh(handle, 0));
+}
+
+// Como acima, mas escolhe o nvel de detalhe pela distncia at a cmera.
+// "model" deve ser a mesma matriz passada para RenderQueue_SetModel().
+void DrawVirtualObject(ObjectHandle handle, const glm::mat4& model)
+{
+    const SceneObject& object = g_SceneObjects[handle];
+    if ( !object.loaded )
+        return;
+
+    int lod = SelectLod(object, model);
+    RenderQueue_Draw(SceneObjectMesh(handle, lod));
+    Occlusion_AddOccluder(object.occluder, model);
+}
+
+// Cria um SceneDrawable e retorna o seu ndice, usado como "drawable" dos
+// ns do grafo de cena
+int AddSceneDrawable(const ObjectHandle objects[], int num_objects, int object_id, int flags, RenderPass pass)
+{
+    SceneDrawable drawable;
+    drawable.objects.assign(objects, objects + num_objects);
+    drawable.object_id = object_id;
+    drawable.pass      = pass;
+    drawable.flags     = flags;
+    g_SceneDrawables.push_back(drawable);
+    g_SceneDrawableInstances.push_back(std::vector<glm::mat4>());
+    return (int)g_SceneDrawables.size() - 1;
+}
+
+// Atualiza as matrizes do grafo de cena e adiciona  fila de renderizao
+// os ns visveis a partir de "root". Os ns de um mesmo DRAWABLE_INSTANCED
+// so desenhados juntos, com uma nica chamada por nvel de detalhe.
+void DrawSceneGraph(SceneNodeId root, const uint8_t* static_visible)
+{
+    SceneGraph_Update();
+
+    g_SceneDraws.clear();
+    SceneGraph_Collect(root, static_visible, &g_SceneDraws);
+
+    for (size_t i = 0; i < g_SceneDraws.size(); ++i)
+    {
+        const SceneDrawable& drawable = g_SceneDrawables[g_SceneDraws[i].drawable];
+        const glm::mat4& world = *g_SceneDraws[i].world;
+
+        if ( drawable.flags & DRAWABLE_INSTANCED )
+        {
+            g_SceneDrawableInstances[g_SceneDraws[i].drawable].push_back(world);
+            continue;
+        }
+
+        RenderQueue_SetPass(drawable.pass);
+        RenderQueue_SetDepthPrepass((drawable.flags & DRAWABLE_DEPTH_PREPASS) != 0);
+        RenderQueue_SetModel(world);
+        SetDrawMaterial(drawable.object_id);
+        if ( drawable.objects.size() > 1 )
+            DrawVirtualObjects(drawable.objects.data(), (int)drawable.objects.size());
+        else if ( drawable.flags & DRAWABLE_LOD )
+            DrawVirtualObject(drawable.objects[0], world);
+        else
+            DrawVirtualObject(drawable.objects[0]);
+    }
+
+    for (size_t i = 0; i < g_SceneDrawables.size(); ++i)
+    {
+        std::vector<glm::mat4>& models = g_SceneDrawableInstances[i];
+        if ( models.empty() )
+            continue;
+
+        RenderQueue_SetPass(g_SceneDrawables[i].pass);
+        RenderQueue_SetDepthPrepass((g_SceneDrawables[i].flags & DRAWABLE_DEPTH_PREPASS) != 0);
+        SetDrawMaterial(g_SceneDrawables[i].object_id);
+        DrawVirtualObjectInstanced(g_SceneDrawables[i].objects[0], models.data(), (int)models.size());
+        models.clear();
+    }
+    RenderQueue_SetDepthPrepass(false);
+
+    RenderQueue_SetPass(RENDERPASS_OPAQUE);
+}
+
+// Calcula a caixa alinhada aos eixos que envolve os 8 cantos da caixa
+// [bbox_min, bbox_max] transformados pela matriz "model"
+void TransformBoundingBox(const glm::vec3& bbox_min, const glm::vec3& bbox_max, const glm::mat4& model, glm::vec3* world_min, glm::vec3* world_max)
+{
+    *world_min = glm::vec3( std::numeric_limits<float>::max());
+    *world_max = glm::vec3(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec4 p = model * glm::vec4((corner & 1) ? bbox_max.x : bbox_min.x,
+                                        (corner & 2) ? bbox_max.y : bbox_min.y,
+                                        (corner & 4) ? bbox_max.z : bbox_min.z,
+                                        1.0f);
+        *world_min = glm::min(*world_min, glm::vec3(p));
+        *world_max = glm::max(*world_max, glm::vec3(p));
+    }
+}
+
+// Desenha vrios objetos de g_SceneObjects, possivelmente de modelos
+// diferentes, com os mesmos valores das variveis uniformes (matriz de
+// modelagem, object_id, etc.); "bbox_min" e "bbox_max" recebem a caixa que
+// envolve todos os objetos. Como o estado dos itens  idntico, a fila os
+// desenha com uma nica chamada a glMultiDrawElementsBaseVertex().
+void DrawVirtualObjects(const ObjectHandle objects[], int num_objects)
+{
+    glm::vec3 bbox_min = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 bbox_max = glm::vec3(-std::numeric_limits<float>::max());
+    ObjectHandle first_loaded = OBJECT_INVALID;
+
+    for (int i = 0; i < num_objects; ++i)
+    {
+        const SceneObject& object = g_SceneObjects[objects[i]];
+        if ( !object.loaded )
+            continue;
+
+        if ( first_loaded == OBJECT_INVALID )
+            first_loaded = objects[i];
+        bbox_min = glm::min(bbox_min, object.bbox_min);
+        bbox_max = glm::max(bbox_max, object.bbox_max);
+    }
+
+    if ( first_loaded == OBJECT_INVALID )
+        return;
+
+    for (int i = 0; i < num_objects; ++i)
+    {
+        const SceneObject& object = g_SceneObjects[objects[i]];
+        if ( !object.loaded )
+            continue;
+
+        // Todas as partes usam a caixa e o identificador de malha do
+        // conjunto, para terem a mesma chave de ordenao e ficarem juntas
+        // na fila.
+        RenderMesh mesh = SceneObjectMesh(objects[i], 0);
+        mesh.mesh_id  = first_loaded;
+        mesh.bbox_min = bbox_min;
+        mesh.bbox_max = bbox_max;
+        RenderQueue_Draw(mesh);
+
+    }
+}
+
+// Desenha uma cpia de um objeto para cada matriz de modelagem em "models",
+// com desenho instanciado (veja "instancing.h"): as cpias so agrupadas pelo
+// nvel de detalhe (veja SelectLod()) e cada grupo vira um nico item da fila,
+// desenhado com uma nica chamada a glDrawElementsInstancedBaseVertex().
+// Assim, o custo na CPU no cresce com o nmero de cpias. Todas as cpias
+// usam o mesmo "object_id"; a matriz de modelagem do item  a identidade.
+void DrawVirtualObjectInstanced(ObjectHandle handle, const glm::mat4 models[], int num_instances)
+{
+    const SceneObject& object = g_SceneObjects[handle];
+    if ( !object.loaded || num_instances <= 0 )
+        return;
+
+    // Vetores reutilizados entre as chamadas, para evitar alocaes a cada quadro
+    static std::vector<glm::mat4> sorted_models;
+    static std::vector<int>       instance_lods;
+    sorted_models.resize(num_instances);
+    instance_lods.resize(num_instances);
+
+    // Ordenao por contagem: first_instance[lod]  a posio da primeira
+    // cpia desenhada com o nvel "lod" em sorted_models.
+    int first_instance[MESH_MAX_LODS + 1] = { 0 };
+    for (int i = 0; i < num_instances; ++i)
+    {
+        instance_lods[i] = SelectLod(object, models[i]);
+        first_instance[instance_lods[i] + 1] += 1;
+        Occlusion_AddOccluder(object.occluder, models[i]);
+    }
+    for (int lod = 0; lod < MESH_MAX_LODS; ++lod)
+        first_instance[lod + 1] += first_instance[lod];
+
+    int next_instance[MESH_MAX_LODS];
+    for (int lod = 0; lod < MESH_MAX_LODS; ++lod)
+        next_instance[lod] = first_instance[lod];
+    for (int i = 0; i < num_instances; ++i)
+        sorted_models[next_instance[instance_lods[i]]++] = models[i];
+
+    for (int lod = 0; lod < object.num_lods; ++lod)
+    {
+        int count = first_instance[lod + 1] - first_instance[lod];
+        if ( count == 0 )
+            continue;
+
+        RenderQueue_DrawInstanced(SceneObjectMesh(handle, lod), &sorted_models[first_instance[lod]], count);
+    }
 }
 
 // Constri tringulos para futura renderizao
@@ -2611,46 +3342,58 @@ void LoadShadersFromFiles()
     //       |
     //       o-- shader_fragment.glsl
     //
-    GLuint vertex_shader_id = LoadShader_Vertex("../../src/shader_vertex.glsl");
-    GLuint fragment_shader_id = LoadShader_Fragment("../../src/shader_fragment.glsl");
-
-    // Deletamos o programa de GPU anterior, caso ele exista.
-    if ( g_GpuProgramID != 0 )
-        glDeleteProgram(g_GpuProgramID);
-
-    // Criamos um programa de GPU utilizando os shaders carregados acima.
-    g_GpuProgramID = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
-
-    // Buscamos o endereo das variveis definidas dentro do Vertex Shader.
-    // Utilizaremos estas variveis para enviar dados para a placa de vdeo
-    // (GPU)! Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
-    g_model_uniform      = glGetUniformLocation(g_GpuProgramID, "model"); // Varivel da matriz "model"
-    g_view_uniform       = glGetUniformLocation(g_GpuProgramID, "view"); // Varivel da matriz "view" em shader_vertex.glsl
-    g_projection_uniform = glGetUniformLocation(g_GpuProgramID, "projection"); // Varivel da matriz "projection" em shader_vertex.glsl
-    g_object_id_uniform  = glGetUniformLocation(g_GpuProgramID, "object_id"); // Varivel "object_id" em shader_fragment.glsl
-    g_bbox_min_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_min");
-    g_bbox_max_uniform   = glGetUniformLocation(g_GpuProgramID, "bbox_max");
-
-    // Variveis em "shader_fragment.glsl" para acesso das imagens de textura
-    glUseProgram(g_GpuProgramID);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage0"), 0);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage1"), 1);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage2"), 2);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage3"), 3);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage4"), 4);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage5"), 5);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage6"), 6);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage7"), 7);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage8"), 8);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage9"), 9);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage10"), 10);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage11"), 11);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage12"), 12);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage13"), 13);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage14"), 14);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage15"), 15);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage16"), 16);
-    glUniform1i(glGetUniformLocation(g_GpuProgramID, "TextureImage17"), 17);
+    // Cada classe de material (combinao de "uv_mode" e "lighting")  uma
+    // permutao dos mesmos arquivos, com as definies "UV_MODE" e
+    // "LIGHTING" lidas pelos "#if" dos shaders. A permutao padro (sem
+    // definies)  a dos objetos sem material na tabela.
+    g_DefaultPermutation = ShaderPermutation_Add("");
+    g_DepthPermutation = ShaderPermutation_Add("#define DEPTH_ONLY\n");
+    g_OverdrawPermutation = ShaderPermutation_Add("#define OVERDRAW\n");
+    for (size_t i = 0; i < DRAWDATA_MAX_MATERIALS; ++i)
+        g_MaterialPermutations[i] = g_DefaultPermutation;
+    for (size_t i = 0; i < g_NumMaterials; ++i)
+    {
+        char defines[64];
+        snprintf(defines, sizeof(defines), "#define UV_MODE %d\n#define LIGHTING %d\n", g_Materials[i].uv_mode, g_Materials[i].lighting);
+        g_MaterialPermutations[g_Materials[i].object_id] = ShaderPermutation_Add(defines);
+    }
+
+    // Compilamos (ou recompilamos, com a tecla R) todas as permutaes
+    ShaderPermutation_Build("../../src/shader_vertex.glsl", "../../src/shader_fragment.glsl");
+
+    GLint texture_units[TEXTUREARRAY_MAX_ARRAYS];
+    for (GLint i = 0; i < TEXTUREARRAY_MAX_ARRAYS; ++i)
+        texture_units[i] = i;
+
+    for (size_t i = 0; i < ShaderPermutation_Count(); ++i)
+    {
+        GLuint program_id = ShaderPermutation_Program((ShaderPermutationId)i);
+        if ( program_id == 0 )
+            continue;
+
+        // As matrizes e os dados de cada desenho so lidos pelos shaders dos
+        // blocos "FrameData" e "DrawData", ligados aqui aos buffers de
+        // "drawdata.h". Veja arquivo "shader_vertex.glsl" e "shader_fragment.glsl".
+        DrawData_BindProgram(program_id);
+
+        // Variveis nos shaders para acesso dos arrays de texturas: o array i
+        // est na unidade de textura i (veja "texturearray.h")
+        glUseProgram(program_id);
+        glUniform1iv(ShaderPermutation_Uniform((ShaderPermutationId)i, SHADERUNIFORM_TEXTURE_ARRAYS), TEXTUREARRAY_MAX_ARRAYS, texture_units);
+    }
+
+    g_GpuProgramID = ShaderPermutation_Program(g_DefaultPermutation);
+
+    // Desenhos sem SetDrawMaterial() utilizam a permutao padro (veja
+    // "renderqueue.h")
+    RenderProgram program = { g_GpuProgramID };
+    RenderQueue_SetProgram(program);
+
+    // Programas do passo de profundidade e da visualizao de sobreposio
+    RenderProgram depth_program = { ShaderPermutation_Program(g_DepthPermutation) };
+    RenderQueue_SetDepthProgram(depth_program);
+    RenderProgram overdraw_program = { ShaderPermutation_Program(g_OverdrawPermutation) };
+    RenderQueue_SetOverdrawProgram(overdraw_program);
 
     glUseProgram(0);
 }
@@ -2677,7 +3420,7 @@ void PopMatrix(glm::mat4& M)
 
 // Funo que computa as normais de um ObjModel, caso elas no tenham sido
 // especificadas dentro do arquivo ".obj"
-void ComputeNormals(ObjModel* model)
+void ComputeNormals(ObjModel* model, NormalWeighting weighting)
 {
     if ( !model->attrib.normals.empty() )
         return;
@@ -2685,13 +3428,13 @@ void ComputeNormals(ObjModel* model)
     // Primeiro computamos as normais para todos os TRINGULOS.
     // Segundo, computamos as normais dos VRTICES atravs do mtodo proposto
     // por Gouraud, onde a normal de cada vrtice vai ser a mdia das normais de
-    // todas as faces que compartilham este vrtice.
+    // todas as faces que compartilham este vrtice. Veja "normals.h".
 
     size_t num_vertices = model->attrib.vertices.size() / 3;
 
-    std::vector<int> num_triangles_per_vertex(num_vertices, 0);
-    std::vector<glm::vec4> vertex_normals(num_vertices, glm::vec4(0.0f,0.0f,0.0f,0.0f));
-
+    // Juntamos os tringulos de todos os objetos em um nico vetor. Cada
+    // vrtice passa a ter a normal de mesmo ndice.
+    std::vector<int> triangle_indices;
     for (size_t shape = 0; shape < model->shapes.size(); ++shape)
     {
         size_t num_triangles = model->shapes[shape].mesh.num_face_vertices.size();
@@ -2700,55 +3443,195 @@ void ComputeNormals(ObjModel* model)
         {
             assert(model->shapes[shape].mesh.num_face_vertices[triangle] == 3);
 
-            glm::vec4  vertices[3];
             for (size_t vertex = 0; vertex < 3; ++vertex)
             {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
-                const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
-                const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
-                vertices[vertex] = glm::vec4(vx,vy,vz,1.0);
+                tinyobj::index_t& idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
+                triangle_indices.push_back(idx.vertex_index);
+                idx.normal_index = idx.vertex_index;
             }
+        }
+    }
 
-            const glm::vec4  a = vertices[0];
-            const glm::vec4  b = vertices[1];
-            const glm::vec4  c = vertices[2];
+    model->attrib.normals.resize( 3*num_vertices );
 
-            const glm::vec4  n = crossproduct(b-a, c-a);
+    Normals_Compute(model->attrib.vertices.data(), num_vertices,
+                    triangle_indices.data(), triangle_indices.size(),
+                    weighting, model->attrib.normals.data());
+}
 
-            for (size_t vertex = 0; vertex < 3; ++vertex)
-            {
-                tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
-                num_triangles_per_vertex[idx.vertex_index] += 1;
-                vertex_normals[idx.vertex_index] += n;
-                model->shapes[shape].mesh.indices[3*triangle + vertex].normal_index = idx.vertex_index;
-            }
+// Modelo sendo carregado por uma thread auxiliar
+struct MeshLoadJob
+{
+    std::string   filename;
+    AssetId       asset;
+    MeshCacheFile cache;
+    MeshData      mesh;
+    bool          from_cache;
+    uint64_t      content_hash; // Hash dos objetos e vetores enviados para a GPU
+    double        load_time;
+};
+
+// Hash do contedo de uma malha. Inclui os nomes dos objetos, pois so eles
+// que identificam os objetos da malha em g_SceneObjects.
+static uint64_t MeshContentHash(const std::vector<MeshShape>& shapes, const MeshStreams& streams)
+{
+    uint64_t hash = ASSET_HASH_SEED;
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        uint64_t range[2] = { shapes[i].first_index, shapes[i].num_indices };
+        hash = AssetRegistry_Hash(shapes[i].name.c_str(), shapes[i].name.size() + 1, hash);
+        hash = AssetRegistry_Hash(range, sizeof(range), hash);
+        for (int lod = 0; lod < shapes[i].num_lods; ++lod)
+        {
+            uint64_t lod_range[2] = { shapes[i].lods[lod].first_index, shapes[i].lods[lod].num_indices };
+            hash = AssetRegistry_Hash(lod_range, sizeof(lod_range), hash);
         }
     }
+    hash = AssetRegistry_Hash(streams.vertices, streams.num_vertices * sizeof(PackedVertex), hash);
+    hash = AssetRegistry_Hash(streams.indices, streams.num_indices * sizeof(GLuint), hash);
+    return hash;
+}
 
-    model->attrib.normals.resize( 3*num_vertices );
-
-    for (size_t i = 0; i < vertex_normals.size(); ++i)
+// Carrega um arquivo ".obj" e adiciona seus objetos em g_SceneObjects.
+// Se existir um cache binrio vlido (veja "meshcache.h") para o arquivo, os
+// vetores finais so lidos diretamente dele, evitando a leitura do texto do
+// OBJ, o clculo das normais e a montagem dos vetores. Caso contrrio, o
+// modelo  processado normalmente e o cache  gravado para a prxima execuo.
+//
+// Todo este trabalho  feito em uma thread auxiliar; somente o envio para a
+// GPU (AddMeshToVirtualScene())  feito na thread com o contexto OpenGL (a
+// thread de renderizao, durante o jogo). Arquivos j pedidos antes, ou
+// com o mesmo contedo de uma malha j enviada, no so enviados novamente
+// (veja "assetregistry.h").
+//
+// Se "deferred" for verdadeiro, a carga s comea depois do primeiro quadro
+// (veja UpdateDeferredAssets()); at l, DrawVirtualObject() no desenha os
+// objetos do modelo.
+void LoadObjModelAndAddToVirtualScene(const char* filename, bool deferred)
+{
+    bool is_new;
+    AssetId asset = AssetRegistry_Register(filename, ASSET_MESH, &is_new);
+    if ( !is_new )
     {
-        glm::vec4 n = vertex_normals[i] / (float)num_triangles_per_vertex[i];
-        n /= norm(n);
-        model->attrib.normals[3*i + 0] = n.x;
-        model->attrib.normals[3*i + 1] = n.y;
-        model->attrib.normals[3*i + 2] = n.z;
+        printf("Modelo \"%s\" j carregado; reutilizando.\n", filename);
+        return;
     }
+
+    std::shared_ptr<MeshLoadJob> job(new MeshLoadJob);
+    job->filename     = filename;
+    job->asset        = asset;
+    job->from_cache   = false;
+    job->content_hash = 0;
+    job->load_time    = 0.0;
+
+    SubmitOrDeferLoad(asset, filename, deferred, [job]()
+    {
+        double load_start = glfwGetTime();
+
+        const char* filename = job->filename.c_str();
+        std::string cache_filename = MeshCache_Filename(filename);
+
+        if ( job->cache.Open(cache_filename.c_str(), filename) )
+        {
+            printf("Carregando objetos do cache \"%s\"... OK.\n", cache_filename.c_str());
+            job->from_cache = true;
+        }
+        else
+        {
+            ObjModel model(filename);
+            ComputeNormals(&model);
+            BuildTriangles(&model, &job->mesh);
+            MeshCache_Write(cache_filename.c_str(), filename, job->mesh);
+        }
+
+        if ( job->from_cache )
+            job->content_hash = MeshContentHash(job->cache.shapes, job->cache.streams);
+        else
+            job->content_hash = MeshContentHash(job->mesh.shapes, job->mesh.Streams());
+
+        job->load_time = glfwGetTime() - load_start;
+
+        Jobs_SubmitToMainThread([job]()
+        {
+            double upload_start = glfwGetTime();
+
+            const std::vector<MeshShape>& shapes = job->from_cache ? job->cache.shapes : job->mesh.shapes;
+            MeshStreams streams = job->from_cache ? job->cache.streams : job->mesh.Streams();
+
+            // Os objetos de uma malha com o mesmo contedo (e portanto os
+            // mesmos nomes) j esto em g_SceneObjects.
+            AssetId existing = AssetRegistry_FindByContent(ASSET_MESH, job->content_hash);
+            if ( existing != ASSET_INVALID )
+            {
+                printf("Modelo \"%s\"  igual a \"%s\"; reutilizando.\n", job->filename.c_str(), AssetRegistry_Get(existing).path.c_str());
+                AssetRegistry_ShareWith(job->asset, existing);
+            }
+            else
+            {
+                MeshOptimize_PrintReport(job->filename.c_str(), shapes, streams);
+                MeshSimplify_PrintReport(job->filename.c_str(), shapes);
+                AssetGpuResources gpu = AddMeshToVirtualScene(shapes, streams);
+                size_t gpu_bytes = streams.num_vertices * sizeof(PackedVertex) + streams.num_indices * sizeof(GLuint);
+                AssetRegistry_SetLoaded(job->asset, job->content_hash, gpu, gpu_bytes);
+            }
+
+            AssetLoadTime timing;
+            timing.filename    = job->filename;
+            timing.load_time   = job->load_time;
+            timing.upload_time = glfwGetTime() - upload_start;
+            g_AssetLoadTimes.push_back(timing);
+        });
+    });
 }
 
 // Constri tringulos para futura renderizao a partir de um ObjModel.
 void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
 {
-    GLuint vertex_array_object_id;
-    glGenVertexArrays(1, &vertex_array_object_id);
-    glBindVertexArray(vertex_array_object_id);
+    MeshData mesh;
+    BuildTriangles(model, &mesh);
+    AddMeshToVirtualScene(mesh.shapes, mesh.Streams());
+}
+
+// Funes utilizadas como chave para fundir vrtices repetidos em
+// BuildTriangles(). Os vrtices so comparados j no formato compacto
+// enviado para a GPU (PackedVertex no possui bytes de preenchimento), ento
+// cantos que ficam idnticos aps a compactao tambm so fundidos.
+struct PackedVertexHash
+{
+    size_t operator()(const PackedVertex& v) const
+    {
+        // FNV-1a sobre os bytes da estrutura
+        const unsigned char* bytes = (const unsigned char*)&v;
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < sizeof(PackedVertex); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return (size_t)hash;
+    }
+};
+
+struct PackedVertexEqual
+{
+    bool operator()(const PackedVertex& a, const PackedVertex& b) const
+    {
+        return memcmp(&a, &b, sizeof(PackedVertex)) == 0;
+    }
+};
+
+typedef std::unordered_map<PackedVertex, GLuint, PackedVertexHash, PackedVertexEqual> WeldVertexMap;
 
-    std::vector<GLuint> indices;
-    std::vector<float>  model_coefficients;
-    std::vector<float>  normal_coefficients;
-    std::vector<float>  texture_coefficients;
+// Constri os vetores de vrtices e ndices de um ObjModel, sem nenhuma
+// chamada OpenGL. Vrtices repetidos so fundidos, ento os ndices
+// realmente reaproveitam vrtices. O resultado pode ser enviado para a GPU com
+// AddMeshToVirtualScene() ou gravado no cache com MeshCache_Write().
+void BuildTriangles(ObjModel* model, MeshData* mesh)
+{
+    std::vector<GLuint>&       indices  = mesh->indices;
+    std::vector<PackedVertex>& vertices = mesh->vertices;
+
+    WeldVertexMap welded;
 
     for (size_t shape = 0; shape < model->shapes.size(); ++shape)
     {
@@ -2769,16 +3652,10 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
             {
                 tinyobj::index_t idx = model->shapes[shape].mesh.indices[3*triangle + vertex];
 
-                indices.push_back(first_index + 3*triangle + vertex);
-
                 const float vx = model->attrib.vertices[3*idx.vertex_index + 0];
                 const float vy = model->attrib.vertices[3*idx.vertex_index + 1];
                 const float vz = model->attrib.vertices[3*idx.vertex_index + 2];
                 //printf("tri %d vert %d = (%.2f, %.2f, %.2f)\n", (int)triangle, (int)vertex, vx, vy, vz);
-                model_coefficients.push_back( vx ); // X
-                model_coefficients.push_back( vy ); // Y
-                model_coefficients.push_back( vz ); // Z
-                model_coefficients.push_back( 1.0f ); // W
 
                 bbox_min.x = std::min(bbox_min.x, vx);
                 bbox_min.y = std::min(bbox_min.y, vy);
@@ -2791,194 +3668,102 @@ void BuildTrianglesAndAddToVirtualScene(ObjModel* model)
                 // Sulzbach (2017/1) apontou que a maneira correta de testar se
                 // existem normais e coordenadas de textura no ObjModel 
                 // comparando se o ndice retornado  -1. Fazemos isso abaixo.
+                // Cantos sem o atributo recebem zeros.
 
+                float nx = 0.0f, ny = 0.0f, nz = 0.0f;
                 if ( idx.normal_index != -1 )
                 {
-                    const float nx = model->attrib.normals[3*idx.normal_index + 0];
-                    const float ny = model->attrib.normals[3*idx.normal_index + 1];
-                    const float nz = model->attrib.normals[3*idx.normal_index + 2];
-                    normal_coefficients.push_back( nx ); // X
-                    normal_coefficients.push_back( ny ); // Y
-                    normal_coefficients.push_back( nz ); // Z
-                    normal_coefficients.push_back( 0.0f ); // W
+                    nx = model->attrib.normals[3*idx.normal_index + 0];
+                    ny = model->attrib.normals[3*idx.normal_index + 1];
+                    nz = model->attrib.normals[3*idx.normal_index + 2];
                 }
 
+                float u = 0.0f, v = 0.0f;
                 if ( idx.texcoord_index != -1 )
                 {
-                    const float u = model->attrib.texcoords[2*idx.texcoord_index + 0];
-                    const float v = model->attrib.texcoords[2*idx.texcoord_index + 1];
-                    texture_coefficients.push_back( u );
-                    texture_coefficients.push_back( v );
+                    u = model->attrib.texcoords[2*idx.texcoord_index + 0];
+                    v = model->attrib.texcoords[2*idx.texcoord_index + 1];
                 }
+
+                // Cantos de tringulos com a mesma posio, normal e
+                // coordenada de textura compartilham um nico vrtice.
+                PackedVertex packed = PackVertex(vx, vy, vz, nx, ny, nz, u, v);
+                std::pair<WeldVertexMap::iterator, bool> inserted = welded.insert(std::make_pair(packed, (GLuint)vertices.size()));
+                indices.push_back(inserted.first->second);
+                if ( inserted.second )
+                    vertices.push_back(packed);
             }
         }
 
         size_t last_index = indices.size() - 1;
 
-        SceneObject theobject;
-        theobject.name           = model->shapes[shape].name;
-        theobject.first_index    = first_index; // Primeiro ndice
-        theobject.num_indices    = last_index - first_index + 1; // Nmero de indices
-        theobject.rendering_mode = GL_TRIANGLES;       // ndices correspondem ao tipo de rasterizao GL_TRIANGLES.
-        theobject.vertex_array_object_id = vertex_array_object_id;
-
-        theobject.bbox_min = bbox_min;
-        theobject.bbox_max = bbox_max;
-
-        g_VirtualScene[model->shapes[shape].name] = theobject;
+        MeshShape theshape;
+        theshape.name        = model->shapes[shape].name;
+        theshape.first_index = first_index; // Primeiro ndice
+        theshape.num_indices = last_index - first_index + 1; // Nmero de indices
+        theshape.bbox_min    = bbox_min;
+        theshape.bbox_max    = bbox_max;
+        theshape.num_lods    = 1;
+        theshape.lods[0].first_index = theshape.first_index;
+        theshape.lods[0].num_indices = theshape.num_indices;
+        theshape.lods[0].error       = 0.0f;
+
+        mesh->shapes.push_back(theshape);
     }
 
-    GLuint VBO_model_coefficients_id;
-    glGenBuffers(1, &VBO_model_coefficients_id);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
-    GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
-    GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    if ( !normal_coefficients.empty() )
-    {
-        GLuint VBO_normal_coefficients_id;
-        glGenBuffers(1, &VBO_normal_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
-        location = 1; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
-
-    if ( !texture_coefficients.empty() )
-    {
-        GLuint VBO_texture_coefficients_id;
-        glGenBuffers(1, &VBO_texture_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
-        location = 2; // "(location = 2)" em "shader_vertex.glsl"
-        number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    }
-
-    GLuint indices_id;
-    glGenBuffers(1, &indices_id);
-
-    // "Ligamos" o buffer. Note que o tipo agora  GL_ELEMENT_ARRAY_BUFFER.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // XXX Errado!
-    //
-
-    // "Desligamos" o VAO, evitando assim que operaes posteriores venham a
-    // alterar o mesmo. Isso evita bugs.
-    glBindVertexArray(0);
-}
-
-// Carrega um Vertex Shader de um arquivo GLSL. Veja definio de LoadShader() abaixo.
-GLuint LoadShader_Vertex(const char* filename)
-{
-    // Criamos um identificador (ID) para este shader, informando que o mesmo
-    // ser aplicado nos vrtices.
-    GLuint vertex_shader_id = glCreateShader(GL_VERTEX_SHADER);
-
-    // Carregamos e compilamos o shader
-    LoadShader(filename, vertex_shader_id);
+    // Reordenamos tringulos e vrtices para a cache de vrtices da GPU
+    MeshOptimize_Optimize(mesh);
 
-    // Retorna o ID gerado acima
-    return vertex_shader_id;
+    // Geramos as verses simplificadas de cada objeto, desenhadas de longe
+    MeshSimplify_GenerateLods(mesh);
 }
 
-// Carrega um Fragment Shader de um arquivo GLSL . Veja definio de LoadShader() abaixo.
-GLuint LoadShader_Fragment(const char* filename)
+// Copia os vetores de uma malha para a arena de geometria (veja
+// "geometryarena.h") e adiciona cada um de seus objetos em g_SceneObjects.
+// Objetos cujo ObjectHandle j foi pedido ocupam a posio j reservada.
+// Retorna o intervalo ocupado na arena.
+AssetGpuResources AddMeshToVirtualScene(const std::vector<MeshShape>& shapes, const MeshStreams& streams)
 {
-    // Criamos um identificador (ID) para este shader, informando que o mesmo
-    // ser aplicado nos fragmentos.
-    GLuint fragment_shader_id = glCreateShader(GL_FRAGMENT_SHADER);
-
-    // Carregamos e compilamos o shader
-    LoadShader(filename, fragment_shader_id);
+    // Os dados so passados diretamente para glBufferSubData(). Quando a malha
+    // vem do cache, os ponteiros apontam para o arquivo mapeado em memria.
+    AssetGpuResources gpu = AssetGpuResources();
+    gpu.geometry = GeometryArena_Add(streams);
 
-    // Retorna o ID gerado acima
-    return fragment_shader_id;
-}
-
-// Funo auxilar, utilizada pelas duas funes acima. Carrega cdigo de GPU de
-// um arquivo GLSL e faz sua compilao.
-void LoadShader(const char* filename, GLuint shader_id)
-{
-    // Lemos o arquivo de texto indicado pela varivel "filename"
-    // e colocamos seu contedo em memria, apontado pela varivel
-    // "shader_string".
-    std::ifstream file;
-    try {
-        file.exceptions(std::ifstream::failbit);
-        file.open(filename);
-    } catch ( std::exception& e ) {
-        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
-        std::exit(EXIT_FAILURE);
-    }
-    std::stringstream shader;
-    shader << file.rdbuf();
-    std::string str = shader.str();
-    const GLchar* shader_string = str.c_str();
-    const GLint   shader_string_length = static_cast<GLint>( str.length() );
-
-    // Define o cdigo do shader GLSL, contido na string "shader_string"
-    glShaderSource(shader_id, 1, &shader_string, &shader_string_length);
-
-    // Compila o cdigo do shader GLSL (em tempo de execuo)
-    glCompileShader(shader_id);
-
-    // Verificamos se ocorreu algum erro ou "warning" durante a compilao
-    GLint compiled_ok;
-    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
-
-    GLint log_length = 0;
-    glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
-
-    // Alocamos memria para guardar o log de compilao.
-    // A chamada "new" em C++  equivalente ao "malloc()" do C.
-    GLchar* log = new GLchar[log_length];
-    glGetShaderInfoLog(shader_id, log_length, &log_length, log);
-
-    // Imprime no terminal qualquer erro ou "warning" de compilao
-    if ( log_length != 0 )
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
     {
-        std::string  output;
+        SceneObject& theobject = g_SceneObjects[GetObjectHandle(shapes[shape].name.c_str())];
+        theobject.loaded         = true;
+        theobject.first_index    = gpu.geometry.first_index + shapes[shape].first_index; // Primeiro ndice
+        theobject.num_indices    = shapes[shape].num_indices; // Nmero de indices
+        theobject.rendering_mode = GL_TRIANGLES;       // ndices correspondem ao tipo de rasterizao GL_TRIANGLES.
+        theobject.base_vertex    = gpu.geometry.base_vertex;
+
+        theobject.bbox_min = shapes[shape].bbox_min;
+        theobject.bbox_max = shapes[shape].bbox_max;
 
-        if ( !compiled_ok )
+        theobject.num_lods = shapes[shape].num_lods;
+        for (int lod = 0; lod < shapes[shape].num_lods; ++lod)
         {
-            output += "ERROR: OpenGL compilation of \"";
-            output += filename;
-            output += "\" failed.\n";
-            output += "== Start of compilation log\n";
-            output += log;
-            output += "== End of compilation log\n";
+            theobject.lods[lod] = shapes[shape].lods[lod];
+            theobject.lods[lod].first_index += gpu.geometry.first_index;
         }
-        else
+
+        // A malha substituta dos oclusores  o nvel de detalhe mais simples,
+        // recuada para dentro da malha original (veja "occlusion.h")
+        theobject.occluder = OCCLUDER_NONE;
+        for (size_t i = 0; i < sizeof(g_OccluderObjectNames) / sizeof(g_OccluderObjectNames[0]); ++i)
         {
-            output += "WARNING: OpenGL compilation of \"";
-            output += filename;
-            output += "\".\n";
-            output += "== Start of compilation log\n";
-            output += log;
-            output += "== End of compilation log\n";
-        }
+            if ( shapes[shape].name != g_OccluderObjectNames[i] )
+                continue;
 
-        fprintf(stderr, "%s", output.c_str());
+            const MeshLod& original = shapes[shape].lods[0];
+            const MeshLod& coarsest = shapes[shape].lods[shapes[shape].num_lods - 1];
+            theobject.occluder = Occlusion_CreateOccluder(streams.vertices, streams.indices + coarsest.first_index, coarsest.num_indices,
+                                                          streams.indices + original.first_index, original.num_indices);
+        }
     }
 
-    // A chamada "delete" em C++  equivalente ao "free()" do C
-    delete [] log;
+    return gpu;
 }
 
 // Esta funo cria um programa de GPU, o qual contm obrigatoriamente um
@@ -3041,7 +3826,9 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
     // funo "glViewport" define o mapeamento das "normalized device
     // coordinates" (NDC) para "pixel coordinates".  Essa  a operao de
     // "Screen Mapping" ou "Viewport Mapping" vista em aula ({+ViewportMapping2+}).
-    glViewport(0, 0, width, height);
+    // Durante o jogo, o contexto OpenGL pertence  thread de renderizao,
+    // que chama glViewport() quando o tamanho do quadro entregue muda (veja
+    // RenderFrame()).
 
     // Atualizamos tambm a razo que define a proporo da janela (largura /
     // altura), a qual ser utilizada na definio das matrizes de projeo,
@@ -3051,6 +3838,7 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
     // O cast para float  necessrio pois nmeros inteiros so arredondados ao
     // serem divididos!
     g_ScreenRatio = (float)width / height;
+    g_ScreenHeight = (float)height;
 }
 
 // Variveis globais que armazenam a ltima posio do cursor do mouse, para
@@ -3252,11 +4040,21 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mod)
         g_ShowInfoText = !g_ShowInfoText;
     }
 
+    // Se o usurio apertar a tecla F3, ligamos ou desligamos o desenho de
+    // depurao (esferas de coliso e regies do mapa). Veja "debugdraw.h".
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+        DebugDraw_SetEnabled(!DebugDraw_IsEnabled());
+
+    // Se o usurio apertar a tecla F4, ligamos ou desligamos a visualizao
+    // de sobreposio de desenhos (overdraw). Veja "renderqueue.h".
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+        RenderQueue_SetOverdrawMode(!RenderQueue_OverdrawMode());
+
     // Se o usurio apertar a tecla R, recarregamos os shaders dos arquivos "shader_fragment.glsl" e "shader_vertex.glsl".
     if (key == GLFW_KEY_R && action == GLFW_PRESS)
     {
         jump = false;
-        LoadShadersFromFiles();
+        g_ReloadShadersRequested = true; // Veja HandoffFrame()
         // fprintf(stdout,"Shaders recarregados!\n");
         fflush(stdout);
         reload = true;
@@ -3430,10 +4228,13 @@ void TextRendering_ShowBullets(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Bullets = %d/6\n", num_shots);
-
-    TextRendering_PrintString(window, buffer, -1.0f+pad/2, -0.9+pad/2, 1.5f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, num_shots, -1.0f+pad/2, -0.9+pad/2, 1.5f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Bullets = %d/6\n", num_shots);
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 // Escrevemos na tela o nmero de vidas que o jogador ainda possui
@@ -3444,10 +4245,13 @@ void TextRendering_ShowLifes(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Lifes = %d\n", num_lifes);
-
-    TextRendering_PrintString(window, buffer, -1.0f+pad/2, 0.9+pad/2, 1.5f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, num_lifes, -1.0f+pad/2, 0.9+pad/2, 1.5f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Lifes = %d\n", num_lifes);
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 // Escrevemos na tela o nmero de peas do foguete que o jogador ainda possui
@@ -3458,10 +4262,13 @@ void TextRendering_ShowPieces(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Pieces = %d/5\n", num_pieces);
-
-    TextRendering_PrintString(window, buffer, -1.0f+pad/2, -1.0+pad/2, 1.5f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, num_pieces, -1.0f+pad/2, -1.0+pad/2, 1.5f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Pieces = %d/5\n", num_pieces);
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 // Escrevemos na tela o nmero de balas que o jogador ainda possui
@@ -3472,10 +4279,13 @@ void TextRendering_ShowGameOver(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "GAME OVER\n");
-
-    TextRendering_PrintString(window, buffer, -0.32f+pad, 0.2f+pad, 3.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 0, -0.32f+pad, 0.2f+pad, 3.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "GAME OVER\n");
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 // Escrevemos na tela a mensagem de win
@@ -3486,10 +4296,13 @@ void TextRendering_ShowWin(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "YOU'VE WON!!\n");
-
-    TextRendering_PrintString(window, buffer, -0.35f+pad, pad, 3.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 0, -0.35f+pad, pad, 3.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "YOU'VE WON!!\n");
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 // Escrevemos na tela o tempo restante at que o oxignio acabe
@@ -3503,16 +4316,19 @@ void TextRendering_ShowTime(GLFWwindow* window)
     int minutes = 9 - floor(glfwGetTime()/60.0f);
     int seconds = 59 - floor(fmod(glfwGetTime(), 60.0f));
 
-    char buffer[80];
-    if(seconds < 10){
-        snprintf(buffer, 80, "0%d:0%d", minutes, seconds);
-    }
-    else{
-        snprintf(buffer, 80, "0%d:%d", minutes, seconds);
+    // O texto s  refeito quando o segundo mostrado muda
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 60*minutes + seconds, -0.1f+pad/3 , 0.9+pad/2, 2.0f) )
+    {
+        char buffer[80];
+        if(seconds < 10){
+            snprintf(buffer, 80, "0%d:0%d", minutes, seconds);
+        }
+        else{
+            snprintf(buffer, 80, "0%d:%d", minutes, seconds);
+        }
+        TextRendering_SetWidgetText(widget, buffer);
     }
-
-
-    TextRendering_PrintString(window, buffer, -0.1f+pad/3 , 0.9+pad/2, 2.0f);
 }
 
 void TextRendering_ShowPoints(GLFWwindow* window, int points)
@@ -3522,10 +4338,13 @@ void TextRendering_ShowPoints(GLFWwindow* window, int points)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Points: %d", points);
-
-    TextRendering_PrintString(window, buffer, 0.6f+pad/2 , -1.0+pad/2 , 1.5f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, points, 0.6f+pad/2 , -1.0+pad/2 , 1.5f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Points: %d", points);
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 void TextRendering_ShowBuyUpgrade(GLFWwindow* window, int points)
@@ -3535,10 +4354,13 @@ void TextRendering_ShowBuyUpgrade(GLFWwindow* window, int points)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Press [E] to get a random upgrade. (%d)", points);
-
-    TextRendering_PrintString(window, buffer, -0.5f+pad , -0.7+pad/2 , 1.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, points, -0.5f+pad , -0.7+pad/2 , 1.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Press [E] to get a random upgrade. (%d)", points);
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 void TextRendering_ShowMessageExtraLife(GLFWwindow* window)
@@ -3548,10 +4370,13 @@ void TextRendering_ShowMessageExtraLife(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Extra Life");
-
-    TextRendering_PrintString(window, buffer, -0.3f+pad, 0.2+pad, 2.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 0, -0.3f+pad, 0.2+pad, 2.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Extra Life");
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 void TextRendering_ShowMessageClimbing(GLFWwindow* window)
@@ -3561,10 +4386,13 @@ void TextRendering_ShowMessageClimbing(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Press [E] to climb");
-
-    TextRendering_PrintString(window, buffer, -0.45f+pad, -0.5+pad, 2.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 0, -0.45f+pad, -0.5+pad, 2.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Press [E] to climb");
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 void TextRendering_ShowMessageIncDamage(GLFWwindow* window)
@@ -3574,10 +4402,13 @@ void TextRendering_ShowMessageIncDamage(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Damage Increased");
-
-    TextRendering_PrintString(window, buffer, -0.35f+pad, 0.2+pad, 2.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 0, -0.35f+pad, 0.2+pad, 2.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Damage Increased");
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 void TextRendering_ShowMessageIncSpeed(GLFWwindow* window)
@@ -3587,10 +4418,13 @@ void TextRendering_ShowMessageIncSpeed(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Speed Increased");
-
-    TextRendering_PrintString(window, buffer, -0.35f+pad, 0.2+pad, 2.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 0, -0.35f+pad, 0.2+pad, 2.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Speed Increased");
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 void TextRendering_ShowMessageInsufficientPoints(GLFWwindow* window)
@@ -3600,10 +4434,13 @@ void TextRendering_ShowMessageInsufficientPoints(GLFWwindow* window)
 
     float pad = TextRendering_LineHeight(window);
 
-    char buffer[80];
-    snprintf(buffer, 80, "Insufficient Points");
-
-    TextRendering_PrintString(window, buffer, -0.4f+pad, 0.2+pad, 2.0f);
+    static int widget = TextRendering_CreateWidget(80);
+    if ( TextRendering_UpdateWidget(window, widget, 0, -0.4f+pad, 0.2+pad, 2.0f) )
+    {
+        char buffer[80];
+        snprintf(buffer, 80, "Insufficient Points");
+        TextRendering_SetWidgetText(widget, buffer);
+    }
 }
 
 // Escrevemos na tela o nmero de quadros renderizados por segundo (frames per
@@ -3640,6 +4477,62 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow* window)
     float charwidth = TextRendering_CharWidth(window);
 
     TextRendering_PrintString(window, buffer, 1.0f-(numchars + 1)*charwidth, 1.0f-lineheight, 1.0f);
+
+    // Tringulos desenhados no quadro anterior, que diminuem com os nveis
+    // de detalhe dos objetos distantes (veja SelectLod())
+    const RenderQueueStats& stats = RenderQueue_GetStats();
+    char triangles[32];
+    int numchars_triangles = snprintf(triangles, 32, "%d tri", stats.triangles);
+    TextRendering_PrintString(window, triangles, 1.0f-(numchars_triangles + 1)*charwidth, 1.0f-2*lineheight, 1.0f);
+
+    // Chamadas de desenho do quadro anterior e trocas de estado (programa,
+    // VAO, variveis uniformes, glEnable/glDisable) evitadas pela ordenao
+    // da fila de renderizao (veja "renderqueue.h")
+    int skipped = stats.program_binds_skipped + stats.vertex_array_binds_skipped + stats.record_binds_skipped + stats.state_changes_skipped;
+    char draws[48];
+    int numchars_draws = snprintf(draws, 48, "%d draws %d skip", stats.draw_calls, skipped);
+    TextRendering_PrintString(window, draws, 1.0f-(numchars_draws + 1)*charwidth, 1.0f-3*lineheight, 1.0f);
+
+    // Objetos (e cpias de objetos instanciados) dentro e fora do campo de
+    // viso (veja "frustum.h")
+    char culling[48];
+    int numchars_culling = snprintf(culling, 48, "%d vis %d cull", stats.boxes_visible, stats.boxes_culled);
+    TextRendering_PrintString(window, culling, 1.0f-(numchars_culling + 1)*charwidth, 1.0f-4*lineheight, 1.0f);
+
+    // Objetos escondidos pelos oclusores e tempo de CPU gasto no descarte por
+    // ocluso (veja "occlusion.h")
+    char occlusion[48];
+    int numchars_occlusion = snprintf(occlusion, 48, "%d occl %.2f ms", stats.boxes_occluded, Occlusion_GetStats().milliseconds);
+    TextRendering_PrintString(window, occlusion, 1.0f-(numchars_occlusion + 1)*charwidth, 1.0f-5*lineheight, 1.0f);
+
+    // Amostras pintadas por pixel da janela fora do passo de profundidade
+    // (veja "renderqueue.h"): 1.0 seria cada pixel pintado uma nica vez
+    if ( stats.samples_shaded >= 0 )
+    {
+        int framebuffer_width, framebuffer_height;
+        glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+        if ( framebuffer_width > 0 && framebuffer_height > 0 )
+        {
+            char overdraw[48];
+            int numchars_overdraw = snprintf(overdraw, 48, "%.2fx overdraw %d z-pre", (double)stats.samples_shaded / ((double)framebuffer_width * framebuffer_height), stats.depth_prepass_items);
+            TextRendering_PrintString(window, overdraw, 1.0f-(numchars_overdraw + 1)*charwidth, 1.0f-6*lineheight, 1.0f);
+        }
+    }
+
+    // Tempo da thread de renderizao no quadro anterior e espera da thread
+    // do jogo pela troca de quadros (veja "renderthread.h")
+    const RenderThreadStats& render_stats = RenderThread_GetStats();
+    char render_thread[48];
+    int numchars_render_thread = snprintf(render_thread, 48, "%.2f ms gl %.2f ms wait", render_stats.render_ms, render_stats.game_wait_ms);
+    TextRendering_PrintString(window, render_thread, 1.0f-(numchars_render_thread + 1)*charwidth, 1.0f-7*lineheight, 1.0f);
+
+    // Segmentos do desenho de depurao (veja "debugdraw.h")
+    if ( DebugDraw_IsEnabled() )
+    {
+        char debug_lines[32];
+        int numchars_debug_lines = snprintf(debug_lines, 32, "%d debug lines", DebugDraw_LastLineCount());
+        TextRendering_PrintString(window, debug_lines, 1.0f-(numchars_debug_lines + 1)*charwidth, 1.0f-8*lineheight, 1.0f);
+    }
 }
 
 // set makeprg=cd\ ..\ &&\ make\ run\ >/dev/null
@@ -0,0 +1,492 @@
+#include "meshcache.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <functional>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// Cabeçalho do arquivo de cache. Logo após o cabeçalho vem a tabela de
+// objetos (shapes) e, em seguida, os vetores de vértices e índices, cada um
+// alinhado em 16 bytes. Os offsets abaixo são relativos ao início do arquivo.
+struct MeshCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t num_shapes;
+    uint64_t source_size;  // Tamanho do arquivo OBJ que gerou o cache
+    int64_t  source_mtime; // Data de modificação do arquivo OBJ
+    uint64_t source_hash;  // Hash do conteúdo do arquivo OBJ
+    uint64_t num_vertices;
+    uint64_t num_indices;
+    uint64_t shapes_offset;
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+    uint64_t file_size;
+};
+
+static const char meshcache_magic[8] = { 'D','R','M','E','S','H','\0','\0' };
+
+// Entrada da tabela de objetos, seguida de "name_length" bytes com o nome
+struct MeshCacheShape
+{
+    uint32_t name_length;
+    uint32_t num_lods;
+    uint64_t first_index;
+    uint64_t num_indices;
+    float    bbox_min[3];
+    float    bbox_max[3];
+    uint64_t lod_first_index[MESH_MAX_LODS];
+    uint64_t lod_num_indices[MESH_MAX_LODS];
+    float    lod_error[MESH_MAX_LODS];
+};
+
+static uint64_t AlignTo16(uint64_t offset)
+{
+    return (offset + 15) & ~(uint64_t)15;
+}
+
+// Verdadeiro se o intervalo [first, first + count) está dentro de [0, total),
+// sem estouro nas somas
+static bool RangeInside(uint64_t first, uint64_t count, uint64_t total)
+{
+    return first <= total && count <= total - first;
+}
+
+static bool StatFile(const char* filename, uint64_t* size, int64_t* mtime)
+{
+    struct stat st;
+    if ( stat(filename, &st) != 0 )
+        return false;
+
+    *size  = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+MeshStreams MeshData::Streams() const
+{
+    MeshStreams streams;
+    streams.vertices     = vertices.empty() ? NULL : vertices.data();
+    streams.num_vertices = vertices.size();
+    streams.indices      = indices.empty() ? NULL : indices.data();
+    streams.num_indices  = indices.size();
+    return streams;
+}
+
+// Converte um float para meia precisão (IEEE 754 binary16), arredondando
+// para o mais próximo.
+static GLushort FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000;
+    int32_t  exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x007fffff;
+
+    if ( ((bits >> 23) & 0xff) == 0xff ) // Infinito ou NaN
+        return (GLushort)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    if ( exponent >= 31 ) // Grande demais: infinito
+        return (GLushort)(sign | 0x7c00);
+
+    if ( exponent <= 0 )
+    {
+        // Número subnormal em meia precisão (ou zero)
+        if ( exponent < -10 )
+            return (GLushort)sign;
+        mantissa |= 0x00800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        if ( (mantissa >> (shift - 1)) & 1 )
+            half += 1;
+        return (GLushort)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if ( mantissa & 0x00001000 ) // Arredondamento; pode propagar para o expoente
+        half += 1;
+    return (GLushort)half;
+}
+
+// Converte um valor em [-1,1] (uma coordenada de um vetor unitário) para um
+// inteiro de 10 bits com sinal. O arredondamento da normalização pode passar
+// um pouco de 1.
+static GLuint PackSnorm10(float value)
+{
+    value = std::max(-1.0f, std::min(1.0f, value));
+    int32_t i = (int32_t)floorf(value * 511.0f + 0.5f);
+    return (GLuint)i & 0x3ff;
+}
+
+PackedVertex PackVertex(float px, float py, float pz, float nx, float ny, float nz, float u, float v)
+{
+    PackedVertex vertex;
+    vertex.position[0] = px;
+    vertex.position[1] = py;
+    vertex.position[2] = pz;
+
+    // As normais lidas do arquivo OBJ podem não ser unitárias. Normais nulas
+    // ou inválidas (NaN, infinito) de um arquivo malformado passam a apontar
+    // para cima.
+    float length = sqrtf(nx*nx + ny*ny + nz*nz);
+    if ( length > 0.0f && std::isfinite(length) )
+    {
+        nx /= length;
+        ny /= length;
+        nz /= length;
+    }
+    else
+    {
+        nx = 0.0f;
+        ny = 1.0f;
+        nz = 0.0f;
+    }
+    vertex.normal      = PackSnorm10(nx) | (PackSnorm10(ny) << 10) | (PackSnorm10(nz) << 20);
+    vertex.texcoord[0] = FloatToHalf(u);
+    vertex.texcoord[1] = FloatToHalf(v);
+    return vertex;
+}
+
+std::string MeshCache_Filename(const char* source_filename)
+{
+    return std::string(source_filename) + ".meshcache";
+}
+
+bool MeshCache_HashFile(const char* filename, uint64_t* hash, uint64_t* size)
+{
+    FILE* file = fopen(filename, "rb");
+    if ( file == NULL )
+        return false;
+
+    // FNV-1a de 64 bits. Não é um hash criptográfico, mas é mais do que
+    // suficiente para detectar que um arquivo OBJ foi modificado.
+    uint64_t h = 14695981039346656037ULL;
+    uint64_t total = 0;
+
+    unsigned char buffer[64*1024];
+    size_t n;
+    while ( (n = fread(buffer, 1, sizeof(buffer), file)) > 0 )
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            h ^= buffer[i];
+            h *= 1099511628211ULL;
+        }
+        total += n;
+    }
+
+    fclose(file);
+
+    *hash = h;
+    *size = total;
+    return true;
+}
+
+MeshCacheFile::MeshCacheFile()
+    : map_base(NULL), map_size(0), map_handle(NULL)
+{
+    memset(&streams, 0, sizeof(streams));
+}
+
+MeshCacheFile::~MeshCacheFile()
+{
+    Close();
+}
+
+void MeshCacheFile::Close()
+{
+    if ( map_base != NULL )
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(map_base);
+        CloseHandle((HANDLE)map_handle);
+#else
+        munmap(map_base, map_size);
+#endif
+    }
+
+    map_base = NULL;
+    map_size = 0;
+    map_handle = NULL;
+    shapes.clear();
+    memset(&streams, 0, sizeof(streams));
+}
+
+bool MeshCacheFile::Open(const char* cache_filename, const char* source_filename)
+{
+    Close();
+
+    uint64_t source_size;
+    int64_t  source_mtime;
+    if ( !StatFile(source_filename, &source_size, &source_mtime) )
+        return false;
+
+    // Mapeamos o arquivo inteiro em memória. Os vetores de vértices são
+    // passados diretamente para glBufferData(), sem nenhuma cópia.
+#ifdef _WIN32
+    HANDLE file = CreateFileA(cache_filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if ( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER file_size;
+    if ( !GetFileSizeEx(file, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(MeshCacheHeader) )
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if ( mapping == NULL )
+        return false;
+
+    void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if ( base == NULL )
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    map_base   = base;
+    map_size   = (size_t)file_size.QuadPart;
+    map_handle = mapping;
+#else
+    int fd = open(cache_filename, O_RDONLY);
+    if ( fd < 0 )
+        return false;
+
+    struct stat st;
+    if ( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MeshCacheHeader) )
+    {
+        close(fd);
+        return false;
+    }
+
+    void* base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( base == MAP_FAILED )
+        return false;
+
+    map_base = base;
+    map_size = (size_t)st.st_size;
+#endif
+
+    const char* bytes = (const char*)map_base;
+
+    MeshCacheHeader header;
+    memcpy(&header, bytes, sizeof(header));
+
+    if ( memcmp(header.magic, meshcache_magic, sizeof(meshcache_magic)) != 0
+      || header.version != MESHCACHE_VERSION
+      || header.file_size != map_size
+      || header.source_size != source_size )
+    {
+        Close();
+        return false;
+    }
+
+    // Se a data de modificação do OBJ mudou, conferimos o conteúdo: um OBJ
+    // apenas "tocado" (ou copiado de outro lugar) continua usando o cache.
+    if ( header.source_mtime != source_mtime )
+    {
+        uint64_t hash, size;
+        if ( !MeshCache_HashFile(source_filename, &hash, &size) || hash != header.source_hash || size != header.source_size )
+        {
+            Close();
+            return false;
+        }
+    }
+
+    // Conferimos se todos os vetores estão alinhados e dentro do arquivo
+    if ( header.vertices_offset % 16 != 0 || header.indices_offset % 16 != 0
+      || header.num_vertices > map_size / sizeof(PackedVertex)
+      || header.num_indices  > map_size / sizeof(GLuint)
+      || !RangeInside(header.vertices_offset, header.num_vertices * sizeof(PackedVertex), map_size)
+      || !RangeInside(header.indices_offset,  header.num_indices  * sizeof(GLuint),       map_size) )
+    {
+        Close();
+        return false;
+    }
+
+    // Um cache danificado (ou editado) com o tamanho certo não pode fazer o
+    // desenho e os oclusores lerem fora dos vetores: todos os índices devem
+    // apontar para vértices existentes
+    const GLuint* indices = (const GLuint*)(bytes + header.indices_offset);
+    for (uint64_t i = 0; i < header.num_indices; ++i)
+    {
+        if ( indices[i] >= header.num_vertices )
+        {
+            Close();
+            return false;
+        }
+    }
+
+    uint64_t offset = header.shapes_offset;
+    for (uint32_t i = 0; i < header.num_shapes; ++i)
+    {
+        MeshCacheShape entry;
+        if ( offset + sizeof(entry) > map_size )
+        {
+            Close();
+            return false;
+        }
+        memcpy(&entry, bytes + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        if ( offset + entry.name_length > map_size )
+        {
+            Close();
+            return false;
+        }
+
+        if ( entry.num_lods < 1 || entry.num_lods > MESH_MAX_LODS
+          || !RangeInside(entry.first_index, entry.num_indices, header.num_indices) )
+        {
+            Close();
+            return false;
+        }
+
+        // Os níveis de detalhe também devem estar dentro do vetor de índices
+        for (uint32_t lod = 0; lod < entry.num_lods; ++lod)
+        {
+            if ( !RangeInside(entry.lod_first_index[lod], entry.lod_num_indices[lod], header.num_indices) )
+            {
+                Close();
+                return false;
+            }
+        }
+
+        MeshShape shape;
+        shape.name.assign(bytes + offset, entry.name_length);
+        shape.first_index = (size_t)entry.first_index;
+        shape.num_indices = (size_t)entry.num_indices;
+        shape.bbox_min    = glm::vec3(entry.bbox_min[0], entry.bbox_min[1], entry.bbox_min[2]);
+        shape.bbox_max    = glm::vec3(entry.bbox_max[0], entry.bbox_max[1], entry.bbox_max[2]);
+        shape.num_lods    = (int)entry.num_lods;
+        for (int lod = 0; lod < MESH_MAX_LODS; ++lod)
+        {
+            shape.lods[lod].first_index = (size_t)entry.lod_first_index[lod];
+            shape.lods[lod].num_indices = (size_t)entry.lod_num_indices[lod];
+            shape.lods[lod].error       = entry.lod_error[lod];
+        }
+        shapes.push_back(shape);
+
+        offset += entry.name_length;
+    }
+
+    streams.vertices     = header.num_vertices ? (const PackedVertex*)(bytes + header.vertices_offset) : NULL;
+    streams.num_vertices = (size_t)header.num_vertices;
+    streams.indices      = header.num_indices  ? (const GLuint*)(bytes + header.indices_offset)        : NULL;
+    streams.num_indices  = (size_t)header.num_indices;
+
+    return true;
+}
+
+bool MeshCache_Write(const char* cache_filename, const char* source_filename, const MeshData& mesh)
+{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, meshcache_magic, sizeof(meshcache_magic));
+    header.version    = MESHCACHE_VERSION;
+    header.num_shapes = (uint32_t)mesh.shapes.size();
+
+    uint64_t hashed_size;
+    if ( !StatFile(source_filename, &header.source_size, &header.source_mtime)
+      || !MeshCache_HashFile(source_filename, &header.source_hash, &hashed_size) )
+    {
+        fprintf(stderr, "ERROR: Cannot read \"%s\" to build its mesh cache.\n", source_filename);
+        return false;
+    }
+
+    header.num_vertices = mesh.vertices.size();
+    header.num_indices  = mesh.indices.size();
+
+    // Calculamos a posição de cada parte do arquivo
+    uint64_t offset = sizeof(MeshCacheHeader);
+    header.shapes_offset = offset;
+    for (size_t i = 0; i < mesh.shapes.size(); ++i)
+        offset += sizeof(MeshCacheShape) + mesh.shapes[i].name.size();
+
+    header.vertices_offset = offset = AlignTo16(offset);
+    offset += header.num_vertices * sizeof(PackedVertex);
+    header.indices_offset  = offset = AlignTo16(offset);
+    offset += header.num_indices * sizeof(GLuint);
+    header.file_size       = offset;
+
+    std::vector<char> buffer((size_t)header.file_size, 0);
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    offset = header.shapes_offset;
+    for (size_t i = 0; i < mesh.shapes.size(); ++i)
+    {
+        const MeshShape& shape = mesh.shapes[i];
+
+        MeshCacheShape entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.name_length = (uint32_t)shape.name.size();
+        entry.first_index = shape.first_index;
+        entry.num_indices = shape.num_indices;
+        entry.bbox_min[0] = shape.bbox_min.x; entry.bbox_min[1] = shape.bbox_min.y; entry.bbox_min[2] = shape.bbox_min.z;
+        entry.bbox_max[0] = shape.bbox_max.x; entry.bbox_max[1] = shape.bbox_max.y; entry.bbox_max[2] = shape.bbox_max.z;
+        entry.num_lods    = (uint32_t)shape.num_lods;
+        for (int lod = 0; lod < shape.num_lods; ++lod)
+        {
+            entry.lod_first_index[lod] = shape.lods[lod].first_index;
+            entry.lod_num_indices[lod] = shape.lods[lod].num_indices;
+            entry.lod_error[lod]       = shape.lods[lod].error;
+        }
+
+        memcpy(&buffer[offset], &entry, sizeof(entry));
+        offset += sizeof(entry);
+        memcpy(&buffer[offset], shape.name.data(), shape.name.size());
+        offset += shape.name.size();
+    }
+
+    if ( !mesh.vertices.empty() )
+        memcpy(&buffer[header.vertices_offset], mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex));
+    if ( !mesh.indices.empty() )
+        memcpy(&buffer[header.indices_offset], mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+
+    // Escrevemos em um arquivo temporário e só depois o renomeamos, para que
+    // uma execução interrompida nunca deixe um cache pela metade. O nome do
+    // arquivo temporário inclui a thread, pois o mesmo OBJ pode estar sendo
+    // carregado por mais de uma thread ao mesmo tempo (veja "jobs.h").
+    char thread_suffix[32];
+    snprintf(thread_suffix, sizeof(thread_suffix), ".%lx.tmp", (unsigned long)std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::string tmp_filename = std::string(cache_filename) + thread_suffix;
+    FILE* file = fopen(tmp_filename.c_str(), "wb");
+    if ( file == NULL )
+    {
+        fprintf(stderr, "ERROR: Cannot create mesh cache \"%s\".\n", cache_filename);
+        return false;
+    }
+
+    bool ok = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    ok = (fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+    remove(cache_filename);
+#endif
+    if ( !ok || rename(tmp_filename.c_str(), cache_filename) != 0 )
+    {
+        fprintf(stderr, "ERROR: Cannot write mesh cache \"%s\".\n", cache_filename);
+        remove(tmp_filename.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef _MESHCACHE_H
+#define _MESHCACHE_H
+
+// Cache binário das malhas carregadas a partir de arquivos ".obj".
+//
+// A leitura de um arquivo OBJ (texto) com a tinyobjloader, seguida de
+// ComputeNormals() e da montagem dos vetores de vértices, sempre produz o
+// mesmo resultado para o mesmo arquivo. Guardamos então os vetores finais
+// (exatamente o que é enviado para a GPU com glBufferData()) em um arquivo
+// "<arquivo.obj>.meshcache", ao lado do OBJ original. Nas execuções seguintes
+// o cache é mapeado em memória (mmap) e os dados vão direto para a GPU.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+
+// Versão do formato do cache. Deve ser incrementada sempre que o
+// processamento das malhas (normais, montagem dos vetores, etc.) mudar, pois
+// assim caches antigos são descartados automaticamente.
+#define MESHCACHE_VERSION 6
+
+// Número máximo de níveis de detalhe (LOD) de um objeto, incluindo o nível 0
+// (a malha original). Veja "meshsimplify.h".
+#define MESH_MAX_LODS 4
+
+// Intervalo de índices de um nível de detalhe. Todos os níveis utilizam os
+// mesmos vértices.
+struct MeshLod
+{
+    size_t first_index; // Posição do primeiro índice do nível dentro do vetor de índices
+    size_t num_indices;
+    float  error;       // Erro geométrico em relação ao nível 0, no espaço do modelo
+};
+
+// Descrição de um objeto (shape) dentro dos vetores de uma malha
+struct MeshShape
+{
+    std::string name;        // Nome do objeto dentro do arquivo OBJ
+    size_t      first_index; // Índice do primeiro vértice dentro do vetor de índices
+    size_t      num_indices; // Número de índices do objeto
+    glm::vec3   bbox_min;    // Axis-Aligned Bounding Box do objeto
+    glm::vec3   bbox_max;
+    int         num_lods;    // Níveis de detalhe válidos em "lods"; lods[0] é o intervalo acima
+    MeshLod     lods[MESH_MAX_LODS];
+};
+
+// Vértice compacto enviado para a GPU, com todos os atributos intercalados
+// em um único VBO (20 bytes, contra 40 bytes dos três vetores de floats
+// utilizados antes). Veja AddMeshToVirtualScene() em "main.cpp" e
+// "shader_vertex.glsl".
+//  - posição: 3 floats (a coordenada W = 1 é completada pela GPU);
+//  - normal: X, Y, Z com 10 bits cada, com sinal e normalizados
+//    (GL_INT_2_10_10_10_REV). Os 2 bits de W não são utilizados;
+//  - coordenadas de textura: U, V em meia precisão (GL_HALF_FLOAT).
+struct PackedVertex
+{
+    float    position[3];
+    GLuint   normal;
+    GLushort texcoord[2];
+};
+
+// Monta um PackedVertex a partir dos atributos em ponto flutuante
+PackedVertex PackVertex(float px, float py, float pz, float nx, float ny, float nz, float u, float v);
+
+// Ponteiros para os vetores finais de uma malha, prontos para glBufferData().
+// Podem apontar para memória própria (MeshData) ou para um arquivo mapeado
+// em memória (MeshCacheFile).
+struct MeshStreams
+{
+    const PackedVertex* vertices;
+    size_t              num_vertices;
+    const GLuint*       indices;
+    size_t              num_indices;
+};
+
+// Malha construída na CPU a partir de um ObjModel
+struct MeshData
+{
+    std::vector<MeshShape>    shapes;
+    std::vector<PackedVertex> vertices;
+    std::vector<GLuint>       indices;
+
+    MeshStreams Streams() const;
+};
+
+// Malha lida de um arquivo de cache mapeado em memória. O mapeamento é
+// desfeito no destrutor, então "streams" só é válido enquanto o objeto existir.
+class MeshCacheFile
+{
+    public:
+        std::vector<MeshShape> shapes;
+        MeshStreams            streams;
+
+        MeshCacheFile();
+        ~MeshCacheFile();
+
+        // Mapeia "cache_filename" e valida o cabeçalho contra o arquivo OBJ
+        // "source_filename". Retorna false se o cache não existe, é de outra
+        // versão, ou foi gerado a partir de um OBJ diferente.
+        bool Open(const char* cache_filename, const char* source_filename);
+        void Close();
+
+    private:
+        void*  map_base;
+        size_t map_size;
+        void*  map_handle; // Usado somente no Windows
+
+        MeshCacheFile(const MeshCacheFile&);
+        MeshCacheFile& operator=(const MeshCacheFile&);
+};
+
+// Nome do arquivo de cache correspondente a um arquivo OBJ
+std::string MeshCache_Filename(const char* source_filename);
+
+// Grava o cache de uma malha. Retorna false (e imprime o erro) em caso de falha;
+// nesse caso o programa continua normalmente, apenas sem cache.
+bool MeshCache_Write(const char* cache_filename, const char* source_filename, const MeshData& mesh);
+
+// Hash (FNV-1a de 64 bits) do conteúdo de um arquivo. Retorna false se o
+// arquivo não puder ser lido.
+bool MeshCache_HashFile(const char* filename, uint64_t* hash, uint64_t* size);
+
+#endif // _MESHCACHE_H
@@ -0,0 +1,267 @@
+#include "meshoptimize.h"
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+// Parâmetros do algoritmo de Forsyth. Veja
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+#define FORSYTH_CACHE_SIZE          32
+#define FORSYTH_CACHE_DECAY_POWER   1.5f
+#define FORSYTH_LAST_TRI_SCORE      0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+static const GLuint NO_VERTEX = ~(GLuint)0;
+
+// Pontuação de um vértice dada sua posição na cache simulada (-1 se não está
+// na cache) e o número de triângulos ainda não emitidos que o utilizam.
+static float Forsyth_VertexScore(int cache_position, size_t remaining_triangles)
+{
+    if ( remaining_triangles == 0 )
+        return -1.0f;
+
+    float score = 0.0f;
+    if ( cache_position >= 0 )
+    {
+        if ( cache_position < 3 )
+        {
+            // Vértices do último triângulo emitido recebem uma pontuação fixa,
+            // para não favorecer tiras longas demais.
+            score = FORSYTH_LAST_TRI_SCORE;
+        }
+        else
+        {
+            const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = 1.0f - (cache_position - 3) * scaler;
+            score = powf(score, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+
+    // Vértices com poucos triângulos restantes são priorizados, para que não
+    // fiquem "sobrando" e precisem ser transformados novamente mais tarde.
+    score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remaining_triangles, -FORSYTH_VALENCE_BOOST_POWER);
+    return score;
+}
+
+void MeshOptimize_VertexCache(GLuint* indices, size_t num_indices, size_t num_vertices)
+{
+    const size_t num_triangles = num_indices / 3;
+    if ( num_triangles < 2 )
+        return;
+
+    // Lista de adjacência (vértice -> triângulos), em um único vetor
+    std::vector<size_t> adjacency_offset(num_vertices + 1, 0);
+    for (size_t i = 0; i < 3*num_triangles; ++i)
+        adjacency_offset[indices[i] + 1] += 1;
+    for (size_t v = 0; v < num_vertices; ++v)
+        adjacency_offset[v + 1] += adjacency_offset[v];
+
+    std::vector<size_t> remaining(num_vertices, 0);
+    std::vector<size_t> adjacency(3*num_triangles);
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            GLuint v = indices[3*t + k];
+            adjacency[adjacency_offset[v] + remaining[v]] = t;
+            remaining[v] += 1;
+        }
+    }
+
+    std::vector<int>   cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t v = 0; v < num_vertices; ++v)
+        vertex_score[v] = Forsyth_VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangle_score(num_triangles);
+    std::vector<bool>  emitted(num_triangles, false);
+
+    size_t best_triangle = 0;
+    float  best_score = -1.0f;
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        triangle_score[t] = vertex_score[indices[3*t + 0]]
+                          + vertex_score[indices[3*t + 1]]
+                          + vertex_score[indices[3*t + 2]];
+        if ( triangle_score[t] > best_score )
+        {
+            best_score = triangle_score[t];
+            best_triangle = t;
+        }
+    }
+
+    std::vector<GLuint> output(3*num_triangles);
+    std::vector<GLuint> cache;
+    std::vector<GLuint> new_cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t next_unemitted = 0; // Usado quando nenhum triângulo da cache sobrou
+
+    for (size_t count = 0; count < num_triangles; ++count)
+    {
+        if ( best_score < 0.0f )
+        {
+            while ( emitted[next_unemitted] )
+                next_unemitted += 1;
+            best_triangle = next_unemitted;
+        }
+
+        const size_t t = best_triangle;
+        emitted[t] = true;
+
+        new_cache.clear();
+        for (size_t k = 0; k < 3; ++k)
+        {
+            GLuint v = indices[3*t + k];
+            output[3*count + k] = v;
+            new_cache.push_back(v);
+
+            // Removemos o triângulo da lista de adjacência do vértice
+            size_t first = adjacency_offset[v];
+            size_t last  = first + remaining[v] - 1;
+            for (size_t i = first; i <= last; ++i)
+            {
+                if ( adjacency[i] == t )
+                {
+                    adjacency[i] = adjacency[last];
+                    break;
+                }
+            }
+            remaining[v] -= 1;
+        }
+
+        for (size_t i = 0; i < cache.size(); ++i)
+        {
+            GLuint v = cache[i];
+            if ( v != new_cache[0] && v != new_cache[1] && v != new_cache[2] )
+                new_cache.push_back(v);
+        }
+        cache.swap(new_cache);
+
+        // Atualizamos a pontuação dos vértices da cache, incluindo os que
+        // acabaram de sair dela (posições >= FORSYTH_CACHE_SIZE)
+        for (size_t i = 0; i < cache.size(); ++i)
+        {
+            GLuint v = cache[i];
+            cache_position[v] = (i < FORSYTH_CACHE_SIZE) ? (int)i : -1;
+            vertex_score[v] = Forsyth_VertexScore(cache_position[v], remaining[v]);
+        }
+
+        // O próximo triângulo é o de maior pontuação entre os que usam algum
+        // vértice da cache.
+        best_score = -1.0f;
+        for (size_t i = 0; i < cache.size(); ++i)
+        {
+            GLuint v = cache[i];
+            for (size_t j = adjacency_offset[v]; j < adjacency_offset[v] + remaining[v]; ++j)
+            {
+                size_t u = adjacency[j];
+                triangle_score[u] = vertex_score[indices[3*u + 0]]
+                                  + vertex_score[indices[3*u + 1]]
+                                  + vertex_score[indices[3*u + 2]];
+                if ( triangle_score[u] > best_score )
+                {
+                    best_score = triangle_score[u];
+                    best_triangle = u;
+                }
+            }
+        }
+
+        if ( cache.size() > FORSYTH_CACHE_SIZE )
+            cache.resize(FORSYTH_CACHE_SIZE);
+    }
+
+    for (size_t i = 0; i < output.size(); ++i)
+        indices[i] = output[i];
+}
+
+void MeshOptimize_VertexFetch(MeshData* mesh)
+{
+    const size_t num_vertices = mesh->vertices.size();
+
+    std::vector<GLuint> remap(num_vertices, NO_VERTEX);
+    std::vector<PackedVertex> remapped;
+    remapped.reserve(num_vertices);
+
+    // Vértices que não são utilizados por nenhum índice são descartados
+    for (size_t i = 0; i < mesh->indices.size(); ++i)
+    {
+        GLuint& index = mesh->indices[i];
+        if ( remap[index] == NO_VERTEX )
+        {
+            remap[index] = (GLuint)remapped.size();
+            remapped.push_back(mesh->vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh->vertices.swap(remapped);
+}
+
+void MeshOptimize_Optimize(MeshData* mesh)
+{
+    const size_t num_vertices = mesh->vertices.size();
+
+    // Cada objeto é desenhado com uma chamada separada, então é otimizado
+    // separadamente.
+    for (size_t shape = 0; shape < mesh->shapes.size(); ++shape)
+    {
+        const MeshShape& s = mesh->shapes[shape];
+        MeshOptimize_VertexCache(&mesh->indices[s.first_index], s.num_indices, num_vertices);
+    }
+
+    MeshOptimize_VertexFetch(mesh);
+}
+
+size_t MeshOptimize_VertexShaderInvocations(const GLuint* indices, size_t num_indices, size_t cache_size)
+{
+    GLuint max_index = 0;
+    for (size_t i = 0; i < num_indices; ++i)
+        max_index = std::max(max_index, indices[i]);
+
+    // Em uma FIFO, um vértice continua na cache enquanto menos de
+    // "cache_size" outros vértices entraram depois dele.
+    const size_t NOT_CACHED = ~(size_t)0;
+    std::vector<size_t> insertion_time(num_indices > 0 ? max_index + 1 : 0, NOT_CACHED);
+
+    size_t invocations = 0;
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        size_t& time = insertion_time[indices[i]];
+        if ( time == NOT_CACHED || invocations - time >= cache_size )
+        {
+            time = invocations;
+            invocations += 1;
+        }
+    }
+
+    return invocations;
+}
+
+void MeshOptimize_PrintReport(const char* filename, const std::vector<MeshShape>& shapes, const MeshStreams& streams)
+{
+    const size_t num_vertices = streams.num_vertices;
+    if ( num_vertices == 0 )
+        return;
+
+    const size_t index_bytes = streams.num_indices * sizeof(GLuint);
+
+    // Antes, cada canto de triângulo era um vértice separado, com posição e
+    // normal em vec4 e coordenadas de textura em vec2 de floats, e os índices
+    // eram 0, 1, 2, ..., então o vertex shader executava uma vez por índice.
+    const size_t bytes_before = streams.num_indices * MESHOPTIMIZE_UNPACKED_VERTEX_SIZE + index_bytes;
+    const size_t bytes_after  = num_vertices * sizeof(PackedVertex) + index_bytes;
+
+    size_t invocations = 0;
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+        invocations += MeshOptimize_VertexShaderInvocations(streams.indices + shapes[shape].first_index, shapes[shape].num_indices);
+
+    printf("Malha \"%s\": %d -> %d vértices, buffers %.1f KB -> %.1f KB, vertex shader %d -> %d execuções (ACMR %.2f)\n",
+        filename,
+        (int)streams.num_indices, (int)num_vertices,
+        bytes_before / 1024.0, bytes_after / 1024.0,
+        (int)streams.num_indices, (int)invocations,
+        streams.num_indices > 0 ? 3.0 * invocations / streams.num_indices : 0.0);
+}
@@ -0,0 +1,47 @@
+#ifndef _MESHOPTIMIZE_H
+#define _MESHOPTIMIZE_H
+
+// Otimizações das malhas indexadas, executadas uma única vez quando um OBJ é
+// processado (o resultado fica guardado no cache, veja "meshcache.h").
+//
+// Depois que BuildTriangles() funde os vértices repetidos, os triângulos de
+// cada objeto são reordenados para aproveitar a cache de vértices já
+// transformados da GPU (algoritmo de Tom Forsyth, "Linear-Speed Vertex Cache
+// Optimisation"), e em seguida os vértices são renumerados na ordem em que os
+// índices os utilizam, para que a leitura dos VBOs seja sequencial.
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "meshcache.h"
+
+// Tamanho da cache FIFO utilizada para estimar o número de execuções do vertex
+// shader. GPUs reais têm entre 16 e 32 entradas.
+#define MESHOPTIMIZE_FIFO_SIZE 16
+
+// Tamanho de um vértice no formato antigo (vec4 + vec4 + vec2 de floats),
+// utilizado como referência em MeshOptimize_PrintReport().
+#define MESHOPTIMIZE_UNPACKED_VERTEX_SIZE 40
+
+// Reordena os triângulos (GL_TRIANGLES) de "indices" para a cache de vértices.
+// "num_vertices" deve ser maior que o maior índice utilizado.
+void MeshOptimize_VertexCache(GLuint* indices, size_t num_indices, size_t num_vertices);
+
+// Renumera os vértices de "mesh" na ordem do primeiro uso pelos índices.
+void MeshOptimize_VertexFetch(MeshData* mesh);
+
+// Otimiza todos os objetos de "mesh": cache de vértices e ordem dos vértices.
+void MeshOptimize_Optimize(MeshData* mesh);
+
+// Estima quantas vezes o vertex shader executa para desenhar os índices,
+// simulando uma cache FIFO com "cache_size" entradas.
+size_t MeshOptimize_VertexShaderInvocations(const GLuint* indices, size_t num_indices, size_t cache_size = MESHOPTIMIZE_FIFO_SIZE);
+
+// Imprime no terminal, para uma malha indexada, o tamanho dos buffers e o
+// número estimado de execuções do vertex shader, comparando com a malha sem
+// índices (um vértice por canto de triângulo) que era utilizada antes.
+void MeshOptimize_PrintReport(const char* filename, const std::vector<MeshShape>& shapes, const MeshStreams& streams);
+
+#endif // _MESHOPTIMIZE_H
@@ -0,0 +1,484 @@
+#include "meshsimplify.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+#include <glm/glm.hpp>
+
+#include "meshoptimize.h"
+
+// Peso dos planos que mantêm as bordas abertas da malha no lugar, em relação
+// ao peso (área) dos planos dos triângulos.
+#define SIMPLIFY_BOUNDARY_WEIGHT 10.0
+
+// Um colapso é rejeitado se a normal de algum triângulo girar mais do que
+// isto (cosseno do ângulo entre a normal antes e depois do colapso).
+#define SIMPLIFY_MIN_NORMAL_COS 0.25f
+
+// Matriz 4x4 simétrica de um erro quádrico (10 coeficientes), e a soma dos
+// pesos (áreas) dos planos acumulados nela.
+struct Quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+};
+
+static void Quadric_Zero(Quadric* q)
+{
+    memset(q, 0, sizeof(Quadric));
+}
+
+// Adiciona o plano ax + by + cz + d = 0 (com (a,b,c) unitário) com peso "w"
+static void Quadric_AddPlane(Quadric* q, double a, double b, double c, double d, double w)
+{
+    q->a2 += w*a*a; q->ab += w*a*b; q->ac += w*a*c; q->ad += w*a*d;
+    q->b2 += w*b*b; q->bc += w*b*c; q->bd += w*b*d;
+    q->c2 += w*c*c; q->cd += w*c*d;
+    q->d2 += w*d*d;
+}
+
+static void Quadric_Add(Quadric* q, const Quadric& other)
+{
+    q->a2 += other.a2; q->ab += other.ab; q->ac += other.ac; q->ad += other.ad;
+    q->b2 += other.b2; q->bc += other.bc; q->bd += other.bd;
+    q->c2 += other.c2; q->cd += other.cd;
+    q->d2 += other.d2;
+    q->weight += other.weight;
+}
+
+// Soma dos quadrados das distâncias (ponderadas) de "p" aos planos de "q"
+static double Quadric_Error(const Quadric& q, const glm::vec3& p)
+{
+    double x = p.x, y = p.y, z = p.z;
+    double e = q.a2*x*x + 2.0*q.ab*x*y + 2.0*q.ac*x*z + 2.0*q.ad*x
+             + q.b2*y*y + 2.0*q.bc*y*z + 2.0*q.bd*y
+             + q.c2*z*z + 2.0*q.cd*z
+             + q.d2;
+    return e > 0.0 ? e : 0.0;
+}
+
+// Colapso da aresta (from, to): "from" passa a ser "to"
+struct Collapse
+{
+    GLuint from;
+    GLuint to;
+    double cost;
+};
+
+static bool CollapseLess(const Collapse& a, const Collapse& b)
+{
+    return a.cost < b.cost;
+}
+
+static uint64_t EdgeKey(GLuint a, GLuint b)
+{
+    return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+// Estado da simplificação. Os vértices são identificados pela posição:
+// vértices com a mesma posição (separados em BuildTriangles() por normais ou
+// coordenadas de textura diferentes) são o mesmo vértice para a
+// simplificação, senão as costuras de textura seriam bordas abertas e os
+// triângulos de modelos sem vértices fundidos nunca seriam conectados. As
+// cópias continuam separadas nos índices: um colapso leva cada cópia de
+// "from" para a cópia de "to" do mesmo lado da costura (veja
+// MatchCopies()).
+struct SimplifyState
+{
+    std::vector<glm::vec3> positions;  // Posição de cada vértice da malha
+    std::vector<GLuint>    position_id; // Primeiro vértice com a mesma posição
+    std::vector<GLuint>    collapsed_to; // Cópia de destino de cada vértice da malha (ele mesmo se não colapsou)
+    std::vector<Quadric>   quadrics;    // Por vértice representante (position_id)
+};
+
+static GLuint FindTarget(SimplifyState* state, GLuint v)
+{
+    while ( state->collapsed_to[v] != v )
+    {
+        // Encurtamos o caminho para as próximas buscas
+        state->collapsed_to[v] = state->collapsed_to[state->collapsed_to[v]];
+        v = state->collapsed_to[v];
+    }
+    return v;
+}
+
+static glm::vec3 TriangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+static void InitState(SimplifyState* state, const std::vector<PackedVertex>& vertices, const std::vector<GLuint>& indices)
+{
+    const size_t num_vertices = vertices.size();
+
+    state->positions.resize(num_vertices);
+    state->position_id.resize(num_vertices);
+    state->collapsed_to.resize(num_vertices);
+    state->quadrics.resize(num_vertices);
+
+    // Vértices com bits de posição idênticos são fundidos
+    std::unordered_map<uint64_t, std::vector<GLuint> > by_hash;
+    for (size_t i = 0; i < num_vertices; ++i)
+    {
+        const float* p = vertices[i].position;
+        state->positions[i]    = glm::vec3(p[0], p[1], p[2]);
+        state->position_id[i]  = (GLuint)i;
+        state->collapsed_to[i] = (GLuint)i;
+        Quadric_Zero(&state->quadrics[i]);
+    }
+    for (size_t i = 0; i < num_vertices; ++i)
+    {
+        uint32_t bits[3];
+        memcpy(bits, vertices[i].position, sizeof(bits));
+        uint64_t hash = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+
+        std::vector<GLuint>& candidates = by_hash[hash];
+        for (size_t k = 0; k < candidates.size(); ++k)
+        {
+            if ( memcmp(vertices[candidates[k]].position, vertices[i].position, sizeof(bits)) == 0 )
+            {
+                state->position_id[i] = candidates[k];
+                break;
+            }
+        }
+        if ( state->position_id[i] == i )
+            candidates.push_back((GLuint)i);
+    }
+
+    // Cada triângulo contribui com seu plano, ponderado pela área, para os
+    // seus três vértices.
+    std::unordered_map<uint64_t, int> edge_count;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        GLuint v[3] = { state->position_id[indices[i]], state->position_id[indices[i+1]], state->position_id[indices[i+2]] };
+        glm::vec3 n = TriangleNormal(state->positions[v[0]], state->positions[v[1]], state->positions[v[2]]);
+        float length = glm::length(n);
+        if ( length == 0.0f )
+            continue;
+
+        double area = 0.5 * length;
+        n /= length;
+        double d = -glm::dot(n, state->positions[v[0]]);
+        for (int k = 0; k < 3; ++k)
+        {
+            Quadric_AddPlane(&state->quadrics[v[k]], n.x, n.y, n.z, d, area);
+            state->quadrics[v[k]].weight += area;
+            edge_count[EdgeKey(v[k], v[(k+1)%3])] += 1;
+        }
+    }
+
+    // Arestas utilizadas por um único triângulo são bordas abertas. Para que
+    // elas não encolham, adicionamos aos seus extremos um plano que contém a
+    // aresta e é perpendicular ao triângulo.
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        GLuint v[3] = { state->position_id[indices[i]], state->position_id[indices[i+1]], state->position_id[indices[i+2]] };
+        glm::vec3 n = TriangleNormal(state->positions[v[0]], state->positions[v[1]], state->positions[v[2]]);
+        if ( glm::length(n) == 0.0f )
+            continue;
+        n = glm::normalize(n);
+
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint a = v[k], b = v[(k+1)%3];
+            if ( edge_count[EdgeKey(a, b)] != 1 )
+                continue;
+
+            glm::vec3 edge = state->positions[b] - state->positions[a];
+            float edge_length = glm::length(edge);
+            if ( edge_length == 0.0f )
+                continue;
+
+            glm::vec3 p = glm::normalize(glm::cross(edge, n));
+            double d = -glm::dot(p, state->positions[a]);
+            double w = SIMPLIFY_BOUNDARY_WEIGHT * edge_length * edge_length;
+            Quadric_AddPlane(&state->quadrics[a], p.x, p.y, p.z, d, w);
+            Quadric_AddPlane(&state->quadrics[b], p.x, p.y, p.z, d, w);
+            state->quadrics[a].weight += w;
+            state->quadrics[b].weight += w;
+        }
+    }
+}
+
+// Verifica se mover "from" para a posição de "to" mantém a orientação dos
+// triângulos de "from" que não desaparecem com o colapso.
+static bool CollapseKeepsNormals(const SimplifyState& state, const std::vector<GLuint>& ids, const GLuint* triangles, size_t num_triangles, GLuint from, GLuint to)
+{
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        const GLuint* v = &ids[3*triangles[t]];
+        if ( v[0] == to || v[1] == to || v[2] == to )
+            continue;
+
+        glm::vec3 p[3], q[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            p[k] = state.positions[v[k]];
+            q[k] = v[k] == from ? state.positions[to] : p[k];
+        }
+
+        glm::vec3 before = TriangleNormal(p[0], p[1], p[2]);
+        glm::vec3 after  = TriangleNormal(q[0], q[1], q[2]);
+        float lengths = glm::length(before) * glm::length(after);
+        if ( lengths == 0.0f || glm::dot(before, after) < SIMPLIFY_MIN_NORMAL_COS * lengths )
+            return false;
+    }
+    return true;
+}
+
+// Par (cópia de "from", cópia de "to") de um colapso
+typedef std::pair<GLuint, GLuint> CopyPair;
+
+// Encontra, para cada cópia de "from" usada pelos triângulos que continuam
+// depois do colapso, a cópia de "to" que a substitui: a que aparece com ela
+// em um triângulo da aresta (from, to), e que portanto tem as coordenadas
+// de textura e a normal do mesmo lado das costuras. Retorna falso se alguma
+// cópia não tem par, ou tem dois pares diferentes: o colapso moveria uma
+// costura de textura ou uma aresta viva, e os triângulos passariam a ler os
+// atributos de outra parte da malha.
+static bool MatchCopies(const std::vector<GLuint>& ids, const std::vector<GLuint>& indices, const GLuint* triangles, size_t num_triangles, GLuint from, GLuint to, std::vector<CopyPair>* pairs)
+{
+    pairs->clear();
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        const GLuint* v = &ids[3*triangles[t]];
+        int k_from = v[0] == from ? 0 : (v[1] == from ? 1 : 2);
+        int k_to   = v[0] == to ? 0 : (v[1] == to ? 1 : (v[2] == to ? 2 : -1));
+        if ( k_to < 0 )
+            continue;
+
+        GLuint from_copy = indices[3*triangles[t] + k_from];
+        GLuint to_copy   = indices[3*triangles[t] + k_to];
+
+        bool found = false;
+        for (size_t p = 0; p < pairs->size(); ++p)
+        {
+            if ( (*pairs)[p].first != from_copy )
+                continue;
+            if ( (*pairs)[p].second != to_copy )
+                return false;
+            found = true;
+        }
+        if ( !found )
+            pairs->push_back(CopyPair(from_copy, to_copy));
+    }
+
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        const GLuint* v = &ids[3*triangles[t]];
+        if ( v[0] == to || v[1] == to || v[2] == to )
+            continue;
+
+        int k_from = v[0] == from ? 0 : (v[1] == from ? 1 : 2);
+        GLuint from_copy = indices[3*triangles[t] + k_from];
+
+        bool found = false;
+        for (size_t p = 0; p < pairs->size() && !found; ++p)
+            found = (*pairs)[p].first == from_copy;
+        if ( !found )
+            return false;
+    }
+    return true;
+}
+
+float MeshSimplify_Simplify(const std::vector<PackedVertex>& vertices, std::vector<GLuint>* indices, size_t target_num_indices)
+{
+    const size_t num_vertices = vertices.size();
+    const size_t target_num_triangles = target_num_indices / 3;
+
+    SimplifyState state;
+    InitState(&state, vertices, *indices);
+
+    std::vector<GLuint>   ids;              // Vértice representante de cada canto
+    std::vector<GLuint>   triangle_offsets; // Triângulos de cada vértice representante:
+    std::vector<GLuint>   vertex_triangles; //   vertex_triangles[triangle_offsets[v] .. triangle_offsets[v+1]-1]
+    std::vector<uint64_t> edges;
+    std::vector<Collapse> collapses;
+    std::vector<char>     locked;
+    std::vector<CopyPair> pairs;
+    std::vector<GLuint>   simplified;
+
+    double max_error = 0.0;
+
+    // Cada passo ordena todas as arestas pelo custo e aplica os colapsos mais
+    // baratos. Um colapso trava os vértices vizinhos até o fim do passo, pois
+    // o teste de orientação acima supõe que os triângulos em volta de "from"
+    // ainda não foram alterados.
+    while ( indices->size() / 3 > target_num_triangles )
+    {
+        const size_t num_triangles = indices->size() / 3;
+
+        ids.resize(indices->size());
+        for (size_t i = 0; i < indices->size(); ++i)
+            ids[i] = state.position_id[(*indices)[i]];
+
+        triangle_offsets.assign(num_vertices + 1, 0);
+        for (size_t i = 0; i < ids.size(); ++i)
+            triangle_offsets[ids[i] + 1] += 1;
+        for (size_t v = 0; v < num_vertices; ++v)
+            triangle_offsets[v + 1] += triangle_offsets[v];
+        vertex_triangles.resize(ids.size());
+        {
+            std::vector<GLuint> fill(triangle_offsets.begin(), triangle_offsets.end() - 1);
+            for (size_t i = 0; i < ids.size(); ++i)
+                vertex_triangles[fill[ids[i]]++] = (GLuint)(i / 3);
+        }
+
+        edges.clear();
+        for (size_t t = 0; t < num_triangles; ++t)
+            for (int k = 0; k < 3; ++k)
+                edges.push_back(EdgeKey(ids[3*t + k], ids[3*t + (k+1)%3]));
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        // Cada aresta pode ser colapsada nos dois sentidos; ficamos com o
+        // mais barato.
+        collapses.clear();
+        for (size_t e = 0; e < edges.size(); ++e)
+        {
+            GLuint a = (GLuint)(edges[e] >> 32);
+            GLuint b = (GLuint)(edges[e] & 0xffffffffu);
+
+            Quadric q = state.quadrics[a];
+            Quadric_Add(&q, state.quadrics[b]);
+
+            Collapse c;
+            double cost_to_b = Quadric_Error(q, state.positions[b]);
+            double cost_to_a = Quadric_Error(q, state.positions[a]);
+            c.from = cost_to_b <= cost_to_a ? a : b;
+            c.to   = cost_to_b <= cost_to_a ? b : a;
+            c.cost = std::min(cost_to_a, cost_to_b);
+            collapses.push_back(c);
+        }
+        std::sort(collapses.begin(), collapses.end(), CollapseLess);
+
+        // Cada colapso remove cerca de dois triângulos. Só consideramos os
+        // colapsos necessários para chegar ao objetivo: os que ficarem
+        // travados neste passo serão reavaliados no próximo, em vez de
+        // aplicarmos colapsos mais caros no lugar deles.
+        size_t num_candidates = std::min(collapses.size(), std::max((size_t)1, (num_triangles - target_num_triangles) / 2));
+
+        locked.assign(num_vertices, 0);
+        size_t removed = 0;
+        size_t applied = 0;
+        for (size_t i = 0; i < num_candidates && num_triangles - removed > target_num_triangles; ++i)
+        {
+            const Collapse& c = collapses[i];
+            if ( locked[c.from] || locked[c.to] )
+                continue;
+
+            const GLuint* triangles = &vertex_triangles[triangle_offsets[c.from]];
+            size_t count = triangle_offsets[c.from + 1] - triangle_offsets[c.from];
+            if ( !CollapseKeepsNormals(state, ids, triangles, count, c.from, c.to) )
+                continue;
+            if ( !MatchCopies(ids, *indices, triangles, count, c.from, c.to, &pairs) )
+                continue;
+
+            for (size_t t = 0; t < count; ++t)
+            {
+                const GLuint* v = &ids[3*triangles[t]];
+                if ( v[0] == c.to || v[1] == c.to || v[2] == c.to )
+                    removed += 1;
+                locked[v[0]] = locked[v[1]] = locked[v[2]] = 1;
+            }
+
+            for (size_t p = 0; p < pairs.size(); ++p)
+                state.collapsed_to[pairs[p].first] = pairs[p].second;
+            Quadric_Add(&state.quadrics[c.to], state.quadrics[c.from]);
+
+            double weight = state.quadrics[c.to].weight;
+            if ( weight > 0.0 )
+                max_error = std::max(max_error, c.cost / weight);
+
+            applied += 1;
+        }
+
+        if ( applied == 0 )
+            break;
+
+        // Os cantos de vértices colapsados passam a usar a cópia do vértice
+        // de destino escolhida em MatchCopies(); os demais mantêm o vértice
+        // original. Triângulos degenerados são removidos.
+        simplified.clear();
+        for (size_t t = 0; t < num_triangles; ++t)
+        {
+            GLuint target[3];
+            for (int k = 0; k < 3; ++k)
+                target[k] = FindTarget(&state, (*indices)[3*t + k]);
+
+            GLuint a = state.position_id[target[0]], b = state.position_id[target[1]], c = state.position_id[target[2]];
+            if ( a == b || b == c || a == c )
+                continue;
+
+            for (int k = 0; k < 3; ++k)
+                simplified.push_back(target[k]);
+        }
+        indices->swap(simplified);
+    }
+
+    return (float)sqrt(max_error);
+}
+
+void MeshSimplify_GenerateLods(MeshData* mesh)
+{
+    for (size_t shape = 0; shape < mesh->shapes.size(); ++shape)
+    {
+        MeshShape& s = mesh->shapes[shape];
+
+        s.num_lods = 1;
+        s.lods[0].first_index = s.first_index;
+        s.lods[0].num_indices = s.num_indices;
+        s.lods[0].error       = 0.0f;
+
+        if ( s.num_indices / 3 < MESHSIMPLIFY_MIN_TRIANGLES )
+            continue;
+
+        std::vector<GLuint> original(mesh->indices.begin() + s.first_index, mesh->indices.begin() + s.first_index + s.num_indices);
+
+        // Cada nível é simplificado a partir do nível 0, então o erro de cada
+        // um é medido em relação à malha original.
+        float ratio = 1.0f;
+        for (int lod = 1; lod < MESH_MAX_LODS; ++lod)
+        {
+            ratio *= MESHSIMPLIFY_LOD_RATIO;
+            size_t target = 3 * (size_t)(ratio * (s.num_indices / 3));
+
+            std::vector<GLuint> lod_indices = original;
+            float error = MeshSimplify_Simplify(mesh->vertices, &lod_indices, target);
+
+            if ( lod_indices.empty() || lod_indices.size() > MESHSIMPLIFY_MIN_REDUCTION * s.lods[lod-1].num_indices )
+                break;
+
+            MeshOptimize_VertexCache(lod_indices.data(), lod_indices.size(), mesh->vertices.size());
+
+            s.lods[lod].first_index = mesh->indices.size();
+            s.lods[lod].num_indices = lod_indices.size();
+            s.lods[lod].error       = error;
+            s.num_lods = lod + 1;
+
+            mesh->indices.insert(mesh->indices.end(), lod_indices.begin(), lod_indices.end());
+        }
+    }
+}
+
+void MeshSimplify_PrintReport(const char* filename, const std::vector<MeshShape>& shapes)
+{
+    for (size_t shape = 0; shape < shapes.size(); ++shape)
+    {
+        const MeshShape& s = shapes[shape];
+        if ( s.num_lods <= 1 )
+            continue;
+
+        printf("  LODs de \"%s\" (%s):", s.name.c_str(), filename);
+        for (int lod = 0; lod < s.num_lods; ++lod)
+            printf(" %d", (int)(s.lods[lod].num_indices / 3));
+        printf(" triângulos, erro");
+        for (int lod = 0; lod < s.num_lods; ++lod)
+            printf(" %.4f", s.lods[lod].error);
+        printf("\n");
+    }
+}
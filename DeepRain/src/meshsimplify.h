@@ -0,0 +1,57 @@
+#ifndef _MESHSIMPLIFY_H
+#define _MESHSIMPLIFY_H
+
+// Geração de níveis de detalhe (LOD) das malhas, executada uma única vez
+// quando um OBJ é processado (o resultado fica guardado no cache, veja
+// "meshcache.h").
+//
+// Cada nível é obtido do anterior por colapsos de arestas ordenados pelo erro
+// quádrico (Garland e Heckbert, "Surface Simplification Using Quadric Error
+// Metrics", 1997). Um colapso move um vértice para a posição do outro extremo
+// da aresta, então os níveis simplificados utilizam apenas vértices que já
+// existem: todos os níveis compartilham o mesmo VBO, e cada nível é apenas um
+// novo intervalo no vetor de índices. Nas costuras de textura e nas arestas
+// vivas (vértices separados por coordenadas de textura ou normais
+// diferentes), cada canto passa para a cópia do vértice de destino do mesmo
+// lado da costura, e os colapsos que moveriam a costura são rejeitados.
+//
+// O erro de cada nível é uma distância no espaço do modelo (a raiz do maior
+// erro quádrico, por unidade de área, entre os colapsos). Multiplicado pela
+// escala do objeto e projetado na tela, ele indica quantos pixels o nível
+// simplificado pode desviar da malha original; veja SelectLod() em
+// "main.cpp".
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "meshcache.h"
+
+// Fração de triângulos (em relação ao nível 0) de cada nível simplificado
+#define MESHSIMPLIFY_LOD_RATIO 0.5f
+
+// Um nível só é mantido se tiver no máximo esta fração dos triângulos do
+// nível anterior; senão a simplificação "travou" e os níveis seguintes não
+// são gerados.
+#define MESHSIMPLIFY_MIN_REDUCTION 0.9f
+
+// Objetos com menos triângulos que isso não recebem níveis simplificados
+#define MESHSIMPLIFY_MIN_TRIANGLES 64
+
+// Simplifica os triângulos (GL_TRIANGLES) de "indices" até no máximo
+// "target_num_indices" índices (ou até nenhuma aresta poder ser colapsada).
+// O resultado substitui o conteúdo de "indices" e utiliza apenas vértices de
+// "vertices". Retorna o erro geométrico do resultado, no espaço do modelo.
+float MeshSimplify_Simplify(const std::vector<PackedVertex>& vertices, std::vector<GLuint>* indices, size_t target_num_indices);
+
+// Gera os níveis de detalhe de todos os objetos de "mesh". Os índices de cada
+// nível são adicionados no final de mesh->indices, já otimizados para a cache
+// de vértices, e descritos em MeshShape::lods.
+void MeshSimplify_GenerateLods(MeshData* mesh);
+
+// Imprime no terminal o número de triângulos e o erro de cada nível de
+// detalhe dos objetos de uma malha.
+void MeshSimplify_PrintReport(const char* filename, const std::vector<MeshShape>& shapes);
+
+#endif // _MESHSIMPLIFY_H
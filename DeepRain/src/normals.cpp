@@ -0,0 +1,211 @@
+#include "normals.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "jobs.h"
+
+// SSE2 faz parte de todo processador x86 de 64 bits. Em outras arquiteturas
+// (por exemplo, Macs com processador ARM) utilizamos somente o código escalar.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NORMALS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Número mínimo de triângulos processados por cada thread. Malhas pequenas
+// são processadas inteiramente pela thread que chamou Normals_Compute().
+#define NORMALS_MIN_TRIANGLES_PER_BATCH 16384
+#define NORMALS_MIN_VERTICES_PER_BATCH  32768
+
+// Ângulo entre os vetores u e v, dados os produtos escalares já calculados
+static float AngleBetween(float dot_uv, float length2_u, float length2_v)
+{
+    float denominator = std::sqrt(length2_u * length2_v);
+    if ( denominator <= 0.0f )
+        return 0.0f;
+    float cosine = std::max(-1.0f, std::min(1.0f, dot_uv / denominator));
+    return std::acos(cosine);
+}
+
+// Soma a contribuição de um triângulo, com normal (nx,ny,nz) e pesos w[k] em
+// cada canto, no acumulador.
+static void Scatter(float* accum, const int* triangle, float nx, float ny, float nz, const float w[3])
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        float* a = &accum[3*triangle[k]];
+        a[0] += w[k] * nx;
+        a[1] += w[k] * ny;
+        a[2] += w[k] * nz;
+    }
+}
+
+// Processa um triângulo com código escalar
+static void AccumulateTriangle(const float* positions, const int* triangle, NormalWeighting weighting, float* accum)
+{
+    const float* a = &positions[3*triangle[0]];
+    const float* b = &positions[3*triangle[1]];
+    const float* c = &positions[3*triangle[2]];
+
+    const float abx = b[0]-a[0], aby = b[1]-a[1], abz = b[2]-a[2];
+    const float acx = c[0]-a[0], acy = c[1]-a[1], acz = c[2]-a[2];
+
+    // Produto vetorial (b-a) x (c-a)
+    float nx = aby*acz - abz*acy;
+    float ny = abz*acx - abx*acz;
+    float nz = abx*acy - aby*acx;
+
+    float w[3] = { 1.0f, 1.0f, 1.0f };
+
+    if ( weighting == NORMALS_ANGLE_WEIGHTED )
+    {
+        float length = std::sqrt(nx*nx + ny*ny + nz*nz);
+        if ( length <= 0.0f )
+            return;
+        nx /= length;
+        ny /= length;
+        nz /= length;
+
+        const float bcx = c[0]-b[0], bcy = c[1]-b[1], bcz = c[2]-b[2];
+        const float ab2 = abx*abx + aby*aby + abz*abz;
+        const float ac2 = acx*acx + acy*acy + acz*acz;
+        const float bc2 = bcx*bcx + bcy*bcy + bcz*bcz;
+
+        w[0] = AngleBetween(  abx*acx + aby*acy + abz*acz,  ab2, ac2); // Em a: (b-a) e (c-a)
+        w[1] = AngleBetween(-(abx*bcx + aby*bcy + abz*bcz), ab2, bc2); // Em b: (a-b) e (c-b)
+        w[2] = AngleBetween(  acx*bcx + acy*bcy + acz*bcz,  ac2, bc2); // Em c: (a-c) e (b-c)
+    }
+
+    Scatter(accum, triangle, nx, ny, nz, w);
+}
+
+#ifdef NORMALS_USE_SSE2
+// Processa 4 triângulos ao mesmo tempo. Os vértices são lidos para
+// registradores no formato "structure of arrays" (um registrador com as
+// coordenadas X dos 4 triângulos, outro com as Y, etc.).
+static void AccumulateTriangles4(const float* positions, const int* triangles, NormalWeighting weighting, float* accum)
+{
+    const float* p[4][3];
+    for (int t = 0; t < 4; ++t)
+        for (int k = 0; k < 3; ++k)
+            p[t][k] = &positions[3*triangles[3*t + k]];
+
+    #define LOAD_COORD(k, i) _mm_setr_ps(p[0][k][i], p[1][k][i], p[2][k][i], p[3][k][i])
+    const __m128 ax = LOAD_COORD(0,0), ay = LOAD_COORD(0,1), az = LOAD_COORD(0,2);
+    const __m128 bx = LOAD_COORD(1,0), by = LOAD_COORD(1,1), bz = LOAD_COORD(1,2);
+    const __m128 cx = LOAD_COORD(2,0), cy = LOAD_COORD(2,1), cz = LOAD_COORD(2,2);
+    #undef LOAD_COORD
+
+    const __m128 abx = _mm_sub_ps(bx, ax), aby = _mm_sub_ps(by, ay), abz = _mm_sub_ps(bz, az);
+    const __m128 acx = _mm_sub_ps(cx, ax), acy = _mm_sub_ps(cy, ay), acz = _mm_sub_ps(cz, az);
+
+    // Produto vetorial (b-a) x (c-a)
+    __m128 nx = _mm_sub_ps(_mm_mul_ps(aby, acz), _mm_mul_ps(abz, acy));
+    __m128 ny = _mm_sub_ps(_mm_mul_ps(abz, acx), _mm_mul_ps(abx, acz));
+    __m128 nz = _mm_sub_ps(_mm_mul_ps(abx, acy), _mm_mul_ps(aby, acx));
+
+    float w[3][4] = { { 1.0f, 1.0f, 1.0f, 1.0f },
+                      { 1.0f, 1.0f, 1.0f, 1.0f },
+                      { 1.0f, 1.0f, 1.0f, 1.0f } };
+
+    if ( weighting == NORMALS_ANGLE_WEIGHTED )
+    {
+        // Normalizamos; triângulos degenerados ficam com normal nula
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+        const __m128 valid = _mm_cmpgt_ps(length2, zero);
+        const __m128 inv_length = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2)));
+        nx = _mm_mul_ps(nx, inv_length);
+        ny = _mm_mul_ps(ny, inv_length);
+        nz = _mm_mul_ps(nz, inv_length);
+
+        const __m128 bcx = _mm_sub_ps(cx, bx), bcy = _mm_sub_ps(cy, by), bcz = _mm_sub_ps(cz, bz);
+
+        #define DOT(ux,uy,uz,vx,vy,vz) _mm_add_ps(_mm_add_ps(_mm_mul_ps(ux,vx), _mm_mul_ps(uy,vy)), _mm_mul_ps(uz,vz))
+        float ab2[4], ac2[4], bc2[4], dot_a[4], dot_b[4], dot_c[4];
+        _mm_storeu_ps(ab2,   DOT(abx,aby,abz, abx,aby,abz));
+        _mm_storeu_ps(ac2,   DOT(acx,acy,acz, acx,acy,acz));
+        _mm_storeu_ps(bc2,   DOT(bcx,bcy,bcz, bcx,bcy,bcz));
+        _mm_storeu_ps(dot_a, DOT(abx,aby,abz, acx,acy,acz));
+        _mm_storeu_ps(dot_b, DOT(abx,aby,abz, bcx,bcy,bcz));
+        _mm_storeu_ps(dot_c, DOT(acx,acy,acz, bcx,bcy,bcz));
+        #undef DOT
+
+        // Não existe arco-cosseno em SSE, então os ângulos são escalares
+        for (int t = 0; t < 4; ++t)
+        {
+            w[0][t] = AngleBetween( dot_a[t], ab2[t], ac2[t]);
+            w[1][t] = AngleBetween(-dot_b[t], ab2[t], bc2[t]);
+            w[2][t] = AngleBetween( dot_c[t], ac2[t], bc2[t]);
+        }
+    }
+
+    float n[3][4];
+    _mm_storeu_ps(n[0], nx);
+    _mm_storeu_ps(n[1], ny);
+    _mm_storeu_ps(n[2], nz);
+
+    // Os triângulos podem compartilhar vértices, então a soma nos
+    // acumuladores é feita um triângulo por vez.
+    for (int t = 0; t < 4; ++t)
+    {
+        const float wt[3] = { w[0][t], w[1][t], w[2][t] };
+        Scatter(accum, &triangles[3*t], n[0][t], n[1][t], n[2][t], wt);
+    }
+}
+#endif
+
+void Normals_Compute(const float* positions, size_t num_vertices,
+                     const int* indices, size_t num_indices,
+                     NormalWeighting weighting, float* normals)
+{
+    const size_t num_triangles = num_indices / 3;
+
+    // Um acumulador por lote, para que as threads nunca escrevam na mesma
+    // posição de memória.
+    const size_t num_batches = std::max((size_t)1, Jobs_NumParallelForBatches(num_triangles, NORMALS_MIN_TRIANGLES_PER_BATCH));
+    std::vector<float> accumulators(num_batches * 3 * num_vertices, 0.0f);
+
+    Jobs_ParallelFor(num_triangles, NORMALS_MIN_TRIANGLES_PER_BATCH,
+        [&](size_t begin, size_t end, size_t batch)
+        {
+            float* accum = &accumulators[batch * 3 * num_vertices];
+            size_t t = begin;
+#ifdef NORMALS_USE_SSE2
+            for ( ; t + 4 <= end; t += 4)
+                AccumulateTriangles4(positions, &indices[3*t], weighting, accum);
+#endif
+            for ( ; t < end; ++t)
+                AccumulateTriangle(positions, &indices[3*t], weighting, accum);
+        });
+
+    // Somamos os acumuladores e normalizamos, também em paralelo
+    Jobs_ParallelFor(num_vertices, NORMALS_MIN_VERTICES_PER_BATCH,
+        [&](size_t begin, size_t end, size_t)
+        {
+            for (size_t v = begin; v < end; ++v)
+            {
+                float nx = 0.0f, ny = 0.0f, nz = 0.0f;
+                for (size_t batch = 0; batch < num_batches; ++batch)
+                {
+                    const float* a = &accumulators[(batch * num_vertices + v) * 3];
+                    nx += a[0];
+                    ny += a[1];
+                    nz += a[2];
+                }
+
+                float length = std::sqrt(nx*nx + ny*ny + nz*nz);
+                if ( length > 0.0f )
+                {
+                    nx /= length;
+                    ny /= length;
+                    nz /= length;
+                }
+
+                normals[3*v + 0] = nx;
+                normals[3*v + 1] = ny;
+                normals[3*v + 2] = nz;
+            }
+        });
+}
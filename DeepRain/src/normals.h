@@ -0,0 +1,36 @@
+#ifndef _NORMALS_H
+#define _NORMALS_H
+
+// Cálculo das normais dos vértices de uma malha de triângulos, utilizado por
+// ComputeNormals() em "main.cpp" quando o arquivo OBJ não possui normais.
+//
+// A normal de cada vértice é a média (normalizada) das normais de todos os
+// triângulos que o compartilham, segundo o método de Gouraud. Os triângulos
+// são processados de 4 em 4 com instruções SIMD (SSE2), quando disponíveis, e
+// malhas grandes são divididas entre as threads auxiliares (veja "jobs.h"),
+// cada uma somando em um acumulador próprio; os acumuladores são somados no
+// final.
+
+#include <cstddef>
+
+// Peso da normal de cada triângulo na média
+enum NormalWeighting
+{
+    // Normal do triângulo sem normalizar, cujo comprimento é o dobro da área
+    // do triângulo. É o mesmo resultado do cálculo original de ComputeNormals().
+    NORMALS_AREA_WEIGHTED,
+
+    // Normal unitária do triângulo multiplicada pelo ângulo do triângulo no
+    // vértice. Não depende de como as faces foram subdivididas.
+    NORMALS_ANGLE_WEIGHTED
+};
+
+// Computa as normais dos vértices. "positions" possui 3 floats (X,Y,Z) por
+// vértice, "indices" possui 3 índices de vértices por triângulo, e "normals"
+// deve ter espaço para 3 floats por vértice. Vértices que não pertencem a
+// nenhum triângulo (ou só a triângulos degenerados) recebem normal nula.
+void Normals_Compute(const float* positions, size_t num_vertices,
+                     const int* indices, size_t num_indices,
+                     NormalWeighting weighting, float* normals);
+
+#endif // _NORMALS_H
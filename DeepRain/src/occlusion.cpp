@@ -0,0 +1,608 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <vector>
+
+// SSE2 faz parte de todo processador x86 de 64 bits. Em outras arquiteturas
+// (por exemplo, Macs com processador ARM) utilizamos somente o código escalar.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define TILES_X (OCCLUSION_WIDTH / OCCLUSION_TILE_SIZE)
+#define TILES_Y (OCCLUSION_HEIGHT / OCCLUSION_TILE_SIZE)
+
+// Malha substituta de um oclusor
+struct Occluder
+{
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint>    indices;
+    glm::vec3              center;  // Esfera que envolve a malha, utilizada
+    float                  radius;  // para ordenar os oclusores
+};
+
+struct QueuedOccluder
+{
+    OccluderId id;
+    glm::mat4  model;
+    float      priority;  // Tamanho aproximado na tela
+};
+
+static std::vector<Occluder>       g_Occluders;
+static std::vector<QueuedOccluder> g_QueuedOccluders;
+
+// Buffer de profundidade, com a coordenada Z normalizada (NDC) de cada
+// pixel; 1.0 é o "far plane". g_TileMaxDepth guarda a maior profundidade de
+// cada bloco.
+static float     g_Depth[OCCLUSION_WIDTH * OCCLUSION_HEIGHT];
+static float     g_TileMaxDepth[TILES_X * TILES_Y];
+static bool      g_BufferEmpty = true;  // Nada foi rasterizado desde a limpeza
+static bool      g_BufferValid = false; // g_BufferViewProjection é do quadro atual
+static glm::mat4 g_BufferViewProjection;
+
+static OcclusionStats g_FrameStats;
+static OcclusionStats g_LastFrameStats;
+
+// O recuo de cada vértice em Occlusion_CreateOccluder() é limitado a este
+// múltiplo do recuo pedido, nos vértices com faces quase opostas
+#define OCCLUSION_MAX_INSET_SCALE 4.0f
+
+// Ordem lexicográfica das posições, para fundir os vértices iguais
+struct PositionLess
+{
+    bool operator()(const glm::vec3& a, const glm::vec3& b) const
+    {
+        if ( a.x != b.x ) return a.x < b.x;
+        if ( a.y != b.y ) return a.y < b.y;
+        return a.z < b.z;
+    }
+};
+
+// Pontos de cada triângulo da malha substituta em que a distância até a
+// malha original é medida: os pontos de uma grade baricêntrica com esta
+// subdivisão, exceto os cantos (que são vértices da malha original)
+#define OCCLUSION_DEVIATION_SUBDIVISION 3
+
+// Ponto do triângulo (a, b, c) mais próximo de "p" (Ericson, "Real-Time
+// Collision Detection", 2005, seção 5.1.5)
+static glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if ( d1 <= 0.0f && d2 <= 0.0f )
+        return a;
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if ( d3 >= 0.0f && d4 <= d3 )
+        return b;
+
+    float vc = d1*d4 - d3*d2;
+    if ( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f )
+        return a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if ( d6 >= 0.0f && d5 <= d6 )
+        return c;
+
+    float vb = d5*d2 - d1*d6;
+    if ( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f )
+        return a + ac * (d2 / (d2 - d6));
+
+    float va = d3*d6 - d5*d4;
+    if ( va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f )
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Maior distância entre os pontos de amostragem dos triângulos da malha
+// substituta e os triângulos "original_indices" da malha original. Os
+// triângulos originais são distribuídos em uma grade uniforme, e cada ponto
+// visita as células em camadas cada vez mais distantes, até que nenhuma
+// célula ainda não visitada possa conter um triângulo mais próximo.
+static float MeasureDeviation(const Occluder& occluder, const PackedVertex* vertices, const GLuint* original_indices, size_t num_original_indices)
+{
+    const size_t num_original = num_original_indices / 3;
+    if ( num_original == 0 )
+        return 0.0f;
+
+    std::vector<glm::vec3> original(3 * num_original);
+    glm::vec3 grid_min = glm::vec3( 1e30f);
+    glm::vec3 grid_max = glm::vec3(-1e30f);
+    for (size_t i = 0; i < original.size(); ++i)
+    {
+        const float* p = vertices[original_indices[i]].position;
+        original[i] = glm::vec3(p[0], p[1], p[2]);
+        grid_min = glm::min(grid_min, original[i]);
+        grid_max = glm::max(grid_max, original[i]);
+    }
+
+    // Cerca de um triângulo por célula
+    glm::vec3 size = glm::max(grid_max - grid_min, glm::vec3(1e-6f));
+    float cell_size = std::cbrt(size.x * size.y * size.z / (float)num_original);
+    cell_size = std::max(cell_size, std::max(size.x, std::max(size.y, size.z)) / 64.0f);
+    int cells[3];
+    for (int axis = 0; axis < 3; ++axis)
+        cells[axis] = std::max(1, std::min(64, (int)std::ceil(size[axis] / cell_size)));
+
+    std::vector< std::vector<GLuint> > grid(cells[0] * cells[1] * cells[2]);
+    for (size_t t = 0; t < num_original; ++t)
+    {
+        glm::vec3 t_min = glm::min(original[3*t], glm::min(original[3*t + 1], original[3*t + 2]));
+        glm::vec3 t_max = glm::max(original[3*t], glm::max(original[3*t + 1], original[3*t + 2]));
+        int c0[3], c1[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            c0[axis] = std::max(0, std::min(cells[axis] - 1, (int)((t_min[axis] - grid_min[axis]) / cell_size)));
+            c1[axis] = std::max(0, std::min(cells[axis] - 1, (int)((t_max[axis] - grid_min[axis]) / cell_size)));
+        }
+        for (int z = c0[2]; z <= c1[2]; ++z)
+        for (int y = c0[1]; y <= c1[1]; ++y)
+        for (int x = c0[0]; x <= c1[0]; ++x)
+            grid[(z * cells[1] + y) * cells[0] + x].push_back((GLuint)t);
+    }
+
+    const int n = OCCLUSION_DEVIATION_SUBDIVISION;
+    const int max_ring = std::max(cells[0], std::max(cells[1], cells[2]));
+    float deviation = 0.0f;
+    for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+    {
+        const glm::vec3& a = occluder.positions[occluder.indices[i]];
+        const glm::vec3& b = occluder.positions[occluder.indices[i + 1]];
+        const glm::vec3& c = occluder.positions[occluder.indices[i + 2]];
+
+        for (int u = 0; u <= n; ++u)
+        for (int v = 0; u + v <= n; ++v)
+        {
+            int w = n - u - v;
+            if ( u == n || v == n || w == n )
+                continue;
+            glm::vec3 p = (a * (float)u + b * (float)v + c * (float)w) / (float)n;
+
+            int center[3];
+            for (int axis = 0; axis < 3; ++axis)
+                center[axis] = std::max(0, std::min(cells[axis] - 1, (int)((p[axis] - grid_min[axis]) / cell_size)));
+
+            // As células fora das camadas 0..ring estão a pelo menos
+            // ring * cell_size do ponto
+            float best = 1e30f;
+            for (int ring = 0; ring <= max_ring; ++ring)
+            {
+                for (int z = center[2] - ring; z <= center[2] + ring; ++z)
+                for (int y = center[1] - ring; y <= center[1] + ring; ++y)
+                for (int x = center[0] - ring; x <= center[0] + ring; ++x)
+                {
+                    if ( std::max(std::abs(x - center[0]), std::max(std::abs(y - center[1]), std::abs(z - center[2]))) != ring )
+                        continue;
+                    if ( x < 0 || y < 0 || z < 0 || x >= cells[0] || y >= cells[1] || z >= cells[2] )
+                        continue;
+
+                    const std::vector<GLuint>& cell = grid[(z * cells[1] + y) * cells[0] + x];
+                    for (size_t k = 0; k < cell.size(); ++k)
+                    {
+                        const glm::vec3* t = &original[3 * cell[k]];
+                        glm::vec3 q = ClosestPointOnTriangle(p, t[0], t[1], t[2]);
+                        best = std::min(best, glm::dot(p - q, p - q));
+                    }
+                }
+
+                float reach = ring * cell_size;
+                if ( best <= reach * reach )
+                    break;
+            }
+            deviation = std::max(deviation, std::sqrt(best));
+        }
+    }
+    return deviation;
+}
+
+// Tempo em milissegundos, para o controle do tempo gasto por quadro
+static double Now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+OccluderId Occlusion_CreateOccluder(const PackedVertex* vertices, const GLuint* indices, size_t num_indices, const GLuint* original_indices, size_t num_original_indices)
+{
+    Occluder occluder;
+    occluder.indices.reserve(num_indices);
+
+    // Copiamos somente os vértices utilizados, renumerando os índices. Os
+    // vértices com a mesma posição (separados por normais ou coordenadas de
+    // textura diferentes) são fundidos, para que o recuo abaixo não abra
+    // buracos nas costuras.
+    std::map<glm::vec3, GLuint, PositionLess> remap;
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        const float* p = vertices[indices[i]].position;
+        glm::vec3 position(p[0], p[1], p[2]);
+
+        std::map<glm::vec3, GLuint, PositionLess>::iterator it = remap.find(position);
+        if ( it == remap.end() )
+        {
+            it = remap.insert(std::make_pair(position, (GLuint)occluder.positions.size())).first;
+            occluder.positions.push_back(position);
+        }
+        occluder.indices.push_back(it->second);
+    }
+
+    // A malha substituta é simplificada e pode passar da superfície original.
+    // Medimos o quanto ela se afasta da original e recuamos cada vértice para
+    // dentro, ao longo da média das normais das faces vizinhas, o bastante
+    // para que cada uma dessas faces recue pelo menos essa distância.
+    float inset = 0.0f;
+    if ( indices != original_indices || num_indices != num_original_indices )
+        inset = MeasureDeviation(occluder, vertices, original_indices, num_original_indices);
+    if ( inset > 0.0f )
+    {
+        std::vector<glm::vec3> normals(occluder.positions.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+        {
+            const GLuint* v = &occluder.indices[i];
+            glm::vec3 n = glm::cross(occluder.positions[v[1]] - occluder.positions[v[0]], occluder.positions[v[2]] - occluder.positions[v[0]]);
+            for (int k = 0; k < 3; ++k)
+                normals[v[k]] += n;
+        }
+
+        std::vector<float> min_cos(occluder.positions.size(), 1.0f);
+        for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+        {
+            const GLuint* v = &occluder.indices[i];
+            glm::vec3 n = glm::cross(occluder.positions[v[1]] - occluder.positions[v[0]], occluder.positions[v[2]] - occluder.positions[v[0]]);
+            float length = glm::length(n);
+            if ( length == 0.0f )
+                continue;
+            for (int k = 0; k < 3; ++k)
+            {
+                float normal_length = glm::length(normals[v[k]]);
+                if ( normal_length > 0.0f )
+                    min_cos[v[k]] = std::min(min_cos[v[k]], glm::dot(normals[v[k]], n) / (normal_length * length));
+            }
+        }
+
+        for (size_t i = 0; i < occluder.positions.size(); ++i)
+        {
+            float normal_length = glm::length(normals[i]);
+            if ( normal_length == 0.0f )
+                continue;
+            float scale = 1.0f / std::max(min_cos[i], 1.0f / OCCLUSION_MAX_INSET_SCALE);
+            occluder.positions[i] -= normals[i] * (inset * scale / normal_length);
+        }
+    }
+
+    glm::vec3 bbox_min = glm::vec3( 1e30f);
+    glm::vec3 bbox_max = glm::vec3(-1e30f);
+    for (size_t i = 0; i < occluder.positions.size(); ++i)
+    {
+        bbox_min = glm::min(bbox_min, occluder.positions[i]);
+        bbox_max = glm::max(bbox_max, occluder.positions[i]);
+    }
+    occluder.center = (bbox_min + bbox_max) * 0.5f;
+    occluder.radius = occluder.positions.empty() ? 0.0f : glm::length(bbox_max - bbox_min) * 0.5f;
+
+    g_Occluders.push_back(occluder);
+    return (OccluderId)g_Occluders.size() - 1;
+}
+
+void Occlusion_GetOccluderTriangles(OccluderId id, const glm::mat4& model, std::vector<glm::vec3>* triangles)
+{
+    if ( id == OCCLUDER_NONE )
+        return;
+
+    const Occluder& occluder = g_Occluders[id];
+    for (size_t i = 0; i < occluder.indices.size(); ++i)
+    {
+        const glm::vec3& p = occluder.positions[occluder.indices[i]];
+        triangles->push_back(glm::vec3(model * glm::vec4(p, 1.0f)));
+    }
+}
+
+void Occlusion_AddOccluder(OccluderId id, const glm::mat4& model)
+{
+    if ( id == OCCLUDER_NONE )
+        return;
+
+    QueuedOccluder queued;
+    queued.id       = id;
+    queued.model    = model;
+    queued.priority = 0.0f;
+    g_QueuedOccluders.push_back(queued);
+}
+
+static void ClearBuffer()
+{
+    for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; ++i)
+        g_Depth[i] = 1.0f;
+    for (int i = 0; i < TILES_X * TILES_Y; ++i)
+        g_TileMaxDepth[i] = 1.0f;
+    g_BufferEmpty = true;
+}
+
+static void UpdateTileMaxDepth()
+{
+    for (int ty = 0; ty < TILES_Y; ++ty)
+        for (int tx = 0; tx < TILES_X; ++tx)
+        {
+            float max_depth = -1.0f;
+            for (int y = ty * OCCLUSION_TILE_SIZE; y < (ty + 1) * OCCLUSION_TILE_SIZE; ++y)
+                for (int x = tx * OCCLUSION_TILE_SIZE; x < (tx + 1) * OCCLUSION_TILE_SIZE; ++x)
+                    max_depth = std::max(max_depth, g_Depth[y * OCCLUSION_WIDTH + x]);
+            g_TileMaxDepth[ty * TILES_X + tx] = max_depth;
+        }
+}
+
+// Vértice projetado: posição em pixels e profundidade normalizada
+struct ScreenVertex
+{
+    float x, y, z;
+};
+
+// Rasteriza um triângulo, guardando em cada pixel coberto a menor
+// profundidade. Somente triângulos de frente (anti-horário na tela) são
+// rasterizados; os de trás ficam escondidos por eles em malhas fechadas.
+static void RasterizeTriangle(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if ( !(area > 0.0f) )
+        return;
+
+    int min_x = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x))));
+    int max_x = std::min(OCCLUSION_WIDTH - 1, (int)std::floor(std::max(a.x, std::max(b.x, c.x))));
+    int min_y = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+    int max_y = std::min(OCCLUSION_HEIGHT - 1, (int)std::floor(std::max(a.y, std::max(b.y, c.y))));
+    if ( min_x > max_x || min_y > max_y )
+        return;
+
+    // Funções de aresta E(x,y) = A*x + B*y + C, positivas dentro do
+    // triângulo. A aresta oposta a cada vértice dá o seu peso baricêntrico.
+    // Pixels exatamente sobre uma aresta são cobertos pelos dois triângulos
+    // que a compartilham, para não deixar frestas entre eles.
+    float a0 = b.y - c.y, b0 = c.x - b.x, c0 = b.x * c.y - b.y * c.x; // Aresta bc (peso de a)
+    float a1 = c.y - a.y, b1 = a.x - c.x, c1 = c.x * a.y - c.y * a.x; // Aresta ca (peso de b)
+    float a2 = a.y - b.y, b2 = b.x - a.x, c2 = a.x * b.y - a.y * b.x; // Aresta ab (peso de c)
+
+    // Plano da profundidade: Z(x,y) = zx*x + zy*y + z0
+    float inv_area = 1.0f / area;
+    float zx = (a0 * a.z + a1 * b.z + a2 * c.z) * inv_area;
+    float zy = (b0 * a.z + b1 * b.z + b2 * c.z) * inv_area;
+    float z0 = (c0 * a.z + c1 * b.z + c2 * c.z) * inv_area;
+
+    // Os pixels são processados em grupos de 4 alinhados; a largura do
+    // buffer é múltipla de 4.
+    int start_x = min_x & ~3;
+
+#ifdef OCCLUSION_USE_SSE2
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero    = _mm_setzero_ps();
+#endif
+
+    for (int y = min_y; y <= max_y; ++y)
+    {
+        float py = y + 0.5f;
+        float* row = &g_Depth[y * OCCLUSION_WIDTH];
+
+        for (int x = start_x; x <= max_x; x += 4)
+        {
+#ifdef OCCLUSION_USE_SSE2
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), _mm_set1_ps(b0 * py + c0));
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), _mm_set1_ps(b1 * py + c1));
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), _mm_set1_ps(b2 * py + c2));
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+            if ( _mm_movemask_ps(inside) == 0 )
+                continue;
+
+            __m128 z   = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx), px), _mm_set1_ps(zy * py + z0));
+            __m128 old = _mm_loadu_ps(&row[x]);
+            __m128 closer = _mm_min_ps(old, z);
+            _mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+#else
+            for (int k = 0; k < 4; ++k)
+            {
+                float px = x + k + 0.5f;
+                float e0 = a0 * px + b0 * py + c0;
+                float e1 = a1 * px + b1 * py + c1;
+                float e2 = a2 * px + b2 * py + c2;
+                if ( e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f )
+                    row[x + k] = std::min(row[x + k], zx * px + zy * py + z0);
+            }
+#endif
+        }
+    }
+}
+
+static void RasterizeOccluder(const Occluder& occluder, const glm::mat4& model_view_projection)
+{
+    static std::vector<ScreenVertex> screen;
+    static std::vector<bool>         clipped;
+    screen.resize(occluder.positions.size());
+    clipped.resize(occluder.positions.size());
+
+    for (size_t i = 0; i < occluder.positions.size(); ++i)
+    {
+        glm::vec4 p = model_view_projection * glm::vec4(occluder.positions[i], 1.0f);
+
+        // Vértices antes do "near plane" não são projetados; os triângulos
+        // que os utilizam são ignorados, o que só diminui a oclusão.
+        clipped[i] = !(p.w > 0.0f) || p.z < -p.w;
+        if ( clipped[i] )
+            continue;
+
+        screen[i].x = (p.x / p.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        screen[i].y = (p.y / p.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+        screen[i].z = p.z / p.w;
+    }
+
+    for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+    {
+        GLuint v0 = occluder.indices[i], v1 = occluder.indices[i + 1], v2 = occluder.indices[i + 2];
+        if ( clipped[v0] || clipped[v1] || clipped[v2] )
+            continue;
+
+        RasterizeTriangle(screen[v0], screen[v1], screen[v2]);
+        g_FrameStats.triangles_rendered += 1;
+    }
+}
+
+static bool PriorityGreater(const QueuedOccluder& a, const QueuedOccluder& b)
+{
+    return a.priority > b.priority;
+}
+
+void Occlusion_Render(const glm::mat4& projection_view)
+{
+    double start = Now();
+
+    if ( !g_BufferValid || projection_view != g_BufferViewProjection )
+    {
+        ClearBuffer();
+        g_BufferValid = true;
+        g_BufferViewProjection = projection_view;
+    }
+
+    if ( g_QueuedOccluders.empty() )
+        return;
+
+    // Ordena os oclusores pelo tamanho aproximado na tela (raio da esfera
+    // dividido pela distância), para que os maiores sejam rasterizados antes
+    // de o tempo acabar.
+    for (size_t i = 0; i < g_QueuedOccluders.size(); ++i)
+    {
+        QueuedOccluder& queued = g_QueuedOccluders[i];
+        const Occluder& occluder = g_Occluders[queued.id];
+        const glm::mat4& m = queued.model;
+        float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        glm::vec4 center = projection_view * m * glm::vec4(occluder.center, 1.0f);
+        queued.priority = occluder.radius * scale / std::max(center.w, 1e-3f);
+    }
+    std::sort(g_QueuedOccluders.begin(), g_QueuedOccluders.end(), PriorityGreater);
+
+    bool rendered = false;
+    for (size_t i = 0; i < g_QueuedOccluders.size(); ++i)
+    {
+        if ( g_FrameStats.milliseconds + (Now() - start) >= OCCLUSION_BUDGET_MS )
+        {
+            g_FrameStats.occluders_skipped += (int)(g_QueuedOccluders.size() - i);
+            break;
+        }
+
+        const QueuedOccluder& queued = g_QueuedOccluders[i];
+        RasterizeOccluder(g_Occluders[queued.id], projection_view * queued.model);
+        g_FrameStats.occluders_rendered += 1;
+        rendered = true;
+    }
+    g_QueuedOccluders.clear();
+
+    if ( rendered )
+    {
+        UpdateTileMaxDepth();
+        g_BufferEmpty = false;
+    }
+
+    g_FrameStats.milliseconds += Now() - start;
+}
+
+// Retorna true se algum pixel do retângulo [x0,x1]x[y0,y1] está atrás da
+// profundidade "depth".
+static bool AnyPixelBehind(int x0, int x1, int y0, int y1, float depth)
+{
+    for (int y = y0; y <= y1; ++y)
+    {
+        const float* row = &g_Depth[y * OCCLUSION_WIDTH];
+        for (int x = x0; x <= x1; ++x)
+            if ( row[x] >= depth )
+                return true;
+    }
+    return false;
+}
+
+static bool IsBoxVisible(const glm::mat4& projection_view, const glm::vec3& center, const glm::vec3& extent)
+{
+    // Projeta os 8 cantos da caixa
+    float min_x = 1e30f, max_x = -1e30f, min_y = 1e30f, max_y = -1e30f, min_z = 1e30f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec3 sign = glm::vec3((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+        glm::vec4 p = projection_view * glm::vec4(center + sign * extent, 1.0f);
+
+        // Caixas que cruzam o "near plane" envolvem (quase) a câmera
+        if ( !(p.w > 0.0f) || p.z < -p.w )
+            return true;
+
+        float x = (p.x / p.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        float y = (p.y / p.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, p.z / p.w);
+    }
+
+    int x0 = std::max(0, (int)std::floor(min_x));
+    int x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::floor(max_x));
+    int y0 = std::max(0, (int)std::floor(min_y));
+    int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)std::floor(max_y));
+    if ( x0 > x1 || y0 > y1 )
+        return true;
+
+    // Blocos cuja maior profundidade está na frente da caixa escondem toda a
+    // parte da caixa que cobrem; os outros são verificados pixel a pixel.
+    for (int ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1 / OCCLUSION_TILE_SIZE; ++ty)
+        for (int tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1 / OCCLUSION_TILE_SIZE; ++tx)
+        {
+            if ( g_TileMaxDepth[ty * TILES_X + tx] < min_z )
+                continue;
+
+            int tile_x0 = std::max(x0, tx * OCCLUSION_TILE_SIZE);
+            int tile_x1 = std::min(x1, (tx + 1) * OCCLUSION_TILE_SIZE - 1);
+            int tile_y0 = std::max(y0, ty * OCCLUSION_TILE_SIZE);
+            int tile_y1 = std::min(y1, (ty + 1) * OCCLUSION_TILE_SIZE - 1);
+            if ( AnyPixelBehind(tile_x0, tile_x1, tile_y0, tile_y1, min_z) )
+                return true;
+        }
+
+    return false;
+}
+
+bool Occlusion_IsBoxVisible(const glm::mat4& projection_view, const glm::vec3& center, const glm::vec3& extent)
+{
+    if ( g_BufferEmpty || !g_BufferValid || projection_view != g_BufferViewProjection )
+        return true;
+
+    if ( g_FrameStats.milliseconds >= OCCLUSION_BUDGET_MS )
+    {
+        g_FrameStats.boxes_over_budget += 1;
+        return true;
+    }
+
+    double start = Now();
+    bool visible = IsBoxVisible(projection_view, center, extent);
+    g_FrameStats.milliseconds += Now() - start;
+
+    g_FrameStats.boxes_tested += 1;
+    if ( !visible )
+        g_FrameStats.boxes_occluded += 1;
+    return visible;
+}
+
+void Occlusion_EndFrame()
+{
+    g_QueuedOccluders.clear();
+    g_BufferValid = false;
+
+    g_LastFrameStats = g_FrameStats;
+    memset(&g_FrameStats, 0, sizeof(g_FrameStats));
+}
+
+const OcclusionStats& Occlusion_GetStats()
+{
+    return g_LastFrameStats;
+}
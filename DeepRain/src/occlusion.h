@@ -0,0 +1,103 @@
+#ifndef _OCCLUSION_H
+#define _OCCLUSION_H
+
+// Descarte de objetos escondidos atrás de outros (occlusion culling) com um
+// rasterizador em software.
+//
+// A cada quadro, alguns objetos grandes (o morro e as pedras; veja
+// g_OccluderObjectNames em "main.cpp") são rasterizados na CPU, em baixa
+// resolução, em um buffer de profundidade próprio. Cada um utiliza uma malha
+// substituta (proxy) com poucos triângulos: o nível de detalhe mais simples
+// da malha original (veja "meshsimplify.h"). A simplificação não é
+// conservadora: a malha simplificada pode passar da original e esconder
+// objetos visíveis. Por isso a distância entre a malha substituta e a
+// original é medida em alguns pontos de cada triângulo, e a malha substituta
+// é recuada para dentro por essa distância. O recuo reduz bastante o
+// problema, mas não é uma garantia: a distância é amostrada, e nos cantos
+// muito agudos o recuo é limitado (OCCLUSION_MAX_INSET_SCALE em
+// "occlusion.cpp"), então a malha substituta ainda pode passar um pouco da
+// original. Depois, antes de cada desenho ser enviado para a GPU, a caixa do
+// objeto é projetada na tela e comparada com o buffer: se todos os pixels
+// cobertos pela caixa estão mais perto do que o ponto mais próximo da caixa,
+// o objeto está escondido e não é desenhado.
+//
+// O buffer é dividido em blocos de OCCLUSION_TILE_SIZE x OCCLUSION_TILE_SIZE
+// pixels com a maior profundidade de cada bloco, de forma que a maior parte
+// dos testes não precisa olhar os pixels individualmente. A rasterização
+// processa 4 pixels por vez com instruções SIMD (SSE2), quando disponíveis.
+//
+// O tempo gasto na CPU (rasterização e testes) é limitado a
+// OCCLUSION_BUDGET_MS por quadro: os oclusores são rasterizados do maior
+// (na tela) para o menor, e quando o tempo acaba os oclusores restantes são
+// ignorados e os testes restantes consideram os objetos visíveis.
+//
+// Todas as funções devem ser chamadas na thread do jogo (veja
+// "renderthread.h").
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "meshcache.h"
+
+typedef int OccluderId;
+#define OCCLUDER_NONE (-1)
+
+// Resolução do buffer de profundidade. A largura deve ser múltipla de 4 e de
+// OCCLUSION_TILE_SIZE.
+#define OCCLUSION_WIDTH     256
+#define OCCLUSION_HEIGHT    128
+#define OCCLUSION_TILE_SIZE 8
+
+// Tempo máximo de CPU por quadro, em milissegundos
+#define OCCLUSION_BUDGET_MS 1.0
+
+// Contadores de um quadro
+struct OcclusionStats
+{
+    int    occluders_rendered;
+    int    occluders_skipped;   // Ignorados por falta de tempo
+    int    triangles_rendered;
+    int    boxes_tested;
+    int    boxes_occluded;
+    int    boxes_over_budget;   // Não testados por falta de tempo
+    double milliseconds;
+};
+
+// Cria a malha substituta de um oclusor a partir dos triângulos
+// (GL_TRIANGLES) em "indices", que apontam para "vertices", e a recua para
+// dentro pela maior distância medida até os triângulos da malha original,
+// "original_indices".
+OccluderId Occlusion_CreateOccluder(const PackedVertex* vertices, const GLuint* indices, size_t num_indices, const GLuint* original_indices, size_t num_original_indices);
+
+// Acrescenta a "triangles" os triângulos (3 vértices por triângulo) da
+// malha substituta de um oclusor, transformados pela matriz de modelagem
+// "model". Utilizada no cálculo do PVS (veja "pvs.h").
+void Occlusion_GetOccluderTriangles(OccluderId occluder, const glm::mat4& model, std::vector<glm::vec3>* triangles);
+
+// Pede a rasterização de um oclusor, transformado pela matriz de modelagem
+// "model", na próxima chamada a Occlusion_Render().
+void Occlusion_AddOccluder(OccluderId occluder, const glm::mat4& model);
+
+// Rasteriza os oclusores pedidos desde a última chamada. Se a matriz
+// projection*view for diferente da utilizada anteriormente no mesmo quadro,
+// o buffer é limpo antes.
+void Occlusion_Render(const glm::mat4& projection_view);
+
+// Retorna false se a caixa (no espaço do mundo, dada pelo centro e pela
+// metade do tamanho em cada eixo) está inteiramente escondida pelos
+// oclusores rasterizados com a matriz "projection_view". Retorna true se
+// não está, se nada foi rasterizado com essa matriz ou se o tempo do quadro
+// acabou.
+bool Occlusion_IsBoxVisible(const glm::mat4& projection_view, const glm::vec3& center, const glm::vec3& extent);
+
+// Chamada uma vez por quadro, depois de glfwSwapBuffers(): limpa o buffer,
+// reinicia o tempo disponível, e os contadores do quadro que terminou passam
+// a ser retornados por Occlusion_GetStats().
+void Occlusion_EndFrame();
+const OcclusionStats& Occlusion_GetStats();
+
+#endif // _OCCLUSION_H
@@ -0,0 +1,431 @@
+#include "pvs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <glm/geometric.hpp>
+
+#include "jobs.h"
+
+// Cabeçalho do arquivo. Logo após o cabeçalho vem a tabela com o offset do
+// vetor de bits comprimido de cada célula (num_cells + 1 valores de 32 bits,
+// relativos ao início dos dados) e, em seguida, os dados comprimidos. As
+// células são numeradas linha por linha: cell = z * cells_x + x.
+struct PvsHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t cells_x;
+    uint32_t cells_z;
+    uint32_t num_objects;
+    float    cell_size;
+    float    origin_x;     // Canto (mínimo X, mínimo Z) da célula 0
+    float    origin_z;
+    uint32_t data_size;
+    uint64_t objects_hash;
+};
+
+static const char pvs_magic[8] = { 'D','R','P','V','S','\0','\0','\0' };
+#define PVS_VERSION 2
+
+// Tolerância dos testes de interseção dos segmentos
+#define PVS_EPSILON 1e-5f
+
+struct PvsData
+{
+    bool                  loaded;
+    PvsHeader             header;
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t>  data;
+    int                   cached_cell;  // Célula descomprimida em "visible_set"
+    std::vector<uint8_t>  visible_set;
+};
+
+static PvsData g_Pvs = { false, PvsHeader(), std::vector<uint32_t>(), std::vector<uint8_t>(), -1, std::vector<uint8_t>() };
+
+// Codificação PackBits: um byte de controle "t" menor que 0x80 é seguido de
+// t+1 bytes copiados literalmente; um byte de controle maior ou igual a 0x80
+// é seguido de um único byte, repetido t-0x80+1 vezes (no máximo 128 bytes
+// em cada caso).
+static void Compress(const uint8_t* bytes, size_t size, std::vector<uint8_t>* output)
+{
+    size_t i = 0;
+    while ( i < size )
+    {
+        size_t run = 1;
+        while ( i + run < size && run < 128 && bytes[i + run] == bytes[i] )
+            ++run;
+
+        if ( run >= 2 )
+        {
+            output->push_back((uint8_t)(0x80 + run - 1));
+            output->push_back(bytes[i]);
+            i += run;
+            continue;
+        }
+
+        // Sequência literal, até o início da próxima repetição
+        size_t literal = 1;
+        while ( i + literal < size && literal < 128
+             && !(i + literal + 1 < size && bytes[i + literal] == bytes[i + literal + 1]) )
+            ++literal;
+
+        output->push_back((uint8_t)(literal - 1));
+        output->insert(output->end(), bytes + i, bytes + i + literal);
+        i += literal;
+    }
+}
+
+static bool Decompress(const uint8_t* input, size_t input_size, uint8_t* bytes, size_t size)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while ( i < input_size )
+    {
+        uint8_t token = input[i++];
+        if ( token < 0x80 )
+        {
+            size_t literal = (size_t)token + 1;
+            if ( i + literal > input_size || o + literal > size )
+                return false;
+            memcpy(bytes + o, input + i, literal);
+            i += literal;
+            o += literal;
+        }
+        else
+        {
+            size_t run = (size_t)token - 0x80 + 1;
+            if ( i >= input_size || o + run > size )
+                return false;
+            memset(bytes + o, input[i++], run);
+            o += run;
+        }
+    }
+    return o == size;
+}
+
+// Teste do segmento p + t*d, t em [0,1], contra uma caixa (método "slab")
+static bool SegmentHitsBox(const glm::vec3& p, const glm::vec3& d, const glm::vec3& bbox_min, const glm::vec3& bbox_max)
+{
+    float t0 = 0.0f;
+    float t1 = 1.0f;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if ( std::fabs(d[axis]) < PVS_EPSILON )
+        {
+            if ( p[axis] < bbox_min[axis] || p[axis] > bbox_max[axis] )
+                return false;
+            continue;
+        }
+
+        float inv = 1.0f / d[axis];
+        float ta = (bbox_min[axis] - p[axis]) * inv;
+        float tb = (bbox_max[axis] - p[axis]) * inv;
+        if ( ta > tb )
+            std::swap(ta, tb);
+        t0 = std::max(t0, ta);
+        t1 = std::min(t1, tb);
+        if ( t0 > t1 )
+            return false;
+    }
+    return true;
+}
+
+// Teste do segmento p + t*d, t em (0,1), contra as faces de um oclusor
+// voltadas para "p" (algoritmo de Möller-Trumbore)
+static bool SegmentHitsOccluder(const glm::vec3& p, const glm::vec3& d, const PvsOccluder& occluder)
+{
+    if ( !SegmentHitsBox(p, d, occluder.bbox_min, occluder.bbox_max) )
+        return false;
+
+    const std::vector<glm::vec3>& triangles = occluder.triangles;
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+    {
+        glm::vec3 e1 = triangles[i + 1] - triangles[i];
+        glm::vec3 e2 = triangles[i + 2] - triangles[i];
+        glm::vec3 q  = glm::cross(d, e2);
+        float det = glm::dot(e1, q);
+
+        // det = -dot(d, normal): somente as faces com a frente voltada para
+        // o observador (det > 0) bloqueiam a visão
+        if ( det <= PVS_EPSILON )
+            continue;
+
+        glm::vec3 s = p - triangles[i];
+        float u = glm::dot(s, q);
+        if ( u < 0.0f || u > det )
+            continue;
+
+        glm::vec3 r = glm::cross(s, e1);
+        float v = glm::dot(d, r);
+        if ( v < 0.0f || u + v > det )
+            continue;
+
+        float t = glm::dot(e2, r) / det;
+        if ( t > PVS_EPSILON && t < 1.0f - PVS_EPSILON )
+            return true;
+    }
+    return false;
+}
+
+static bool IsSegmentBlocked(const PvsBakeInput& input, int object, const glm::vec3& eye, const glm::vec3& target)
+{
+    glm::vec3 d = target - eye;
+    for (size_t i = 0; i < input.occluders.size(); ++i)
+    {
+        if ( input.occluders[i].object == object )
+            continue;
+        if ( SegmentHitsOccluder(eye, d, input.occluders[i]) )
+            return true;
+    }
+    return false;
+}
+
+// Pontos de uma caixa testados a partir dos pontos de observação: os 8
+// cantos, o centro e os centros das 6 faces
+static void BoxTargets(const glm::vec3& bbox_min, const glm::vec3& bbox_max, std::vector<glm::vec3>* targets)
+{
+    glm::vec3 center = (bbox_min + bbox_max) * 0.5f;
+    targets->clear();
+    targets->push_back(center);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        glm::vec3 a = center, b = center;
+        a[axis] = bbox_min[axis];
+        b[axis] = bbox_max[axis];
+        targets->push_back(a);
+        targets->push_back(b);
+    }
+    for (int corner = 0; corner < 8; ++corner)
+        targets->push_back(glm::vec3((corner & 1) ? bbox_max.x : bbox_min.x,
+                                     (corner & 2) ? bbox_max.y : bbox_min.y,
+                                     (corner & 4) ? bbox_max.z : bbox_min.z));
+}
+
+// Pontos de observação da célula [cell_min, cell_max] (no plano XZ): uma
+// grade de PVS_EYE_SAMPLES x PVS_EYE_SAMPLES pontos na interseção da célula
+// com cada volume de observação, na altura mínima e na máxima do volume
+static void CellEyes(const PvsBakeInput& input, float x0, float z0, float x1, float z1, std::vector<glm::vec3>* eyes)
+{
+    eyes->clear();
+    for (size_t v = 0; v < input.view_volumes.size(); ++v)
+    {
+        const PvsViewVolume& volume = input.view_volumes[v];
+        float ax = std::max(x0, volume.min.x), bx = std::min(x1, volume.max.x);
+        float az = std::max(z0, volume.min.z), bz = std::min(z1, volume.max.z);
+        if ( ax > bx || az > bz )
+            continue;
+
+        for (int i = 0; i < PVS_EYE_SAMPLES; ++i)
+        for (int j = 0; j < PVS_EYE_SAMPLES; ++j)
+        {
+            float fx = (i + 0.5f) / PVS_EYE_SAMPLES;
+            float fz = (j + 0.5f) / PVS_EYE_SAMPLES;
+            float x = ax + (bx - ax) * fx;
+            float z = az + (bz - az) * fz;
+            eyes->push_back(glm::vec3(x, volume.min.y, z));
+            if ( volume.max.y > volume.min.y )
+                eyes->push_back(glm::vec3(x, volume.max.y, z));
+        }
+    }
+}
+
+bool Pvs_Bake(const PvsBakeInput& input, const char* filename)
+{
+    const int num_objects = (int)input.object_min.size();
+    const int cells_x = std::max(1, (int)std::ceil((input.area_max.x - input.area_min.x) / PVS_CELL_SIZE));
+    const int cells_z = std::max(1, (int)std::ceil((input.area_max.z - input.area_min.z) / PVS_CELL_SIZE));
+    const int num_cells = cells_x * cells_z;
+    const size_t set_size = (size_t)(num_objects + 7) / 8;
+
+    printf("Baking PVS: %dx%d cells, %d objects, %d occluders...\n", cells_x, cells_z, num_objects, (int)input.occluders.size());
+
+    // Os vetores de bits de todas as células, sem compressão
+    std::vector<uint8_t> sets(num_cells * set_size, 0);
+
+    Jobs_ParallelFor(num_cells, 1,
+        [&](size_t begin, size_t end, size_t)
+        {
+            std::vector<glm::vec3> eyes;
+            std::vector<glm::vec3> targets;
+            for (size_t cell = begin; cell < end; ++cell)
+            {
+                int cx = (int)cell % cells_x;
+                int cz = (int)cell / cells_x;
+                float x0 = input.area_min.x + cx * PVS_CELL_SIZE;
+                float z0 = input.area_min.z + cz * PVS_CELL_SIZE;
+                CellEyes(input, x0, z0, x0 + PVS_CELL_SIZE, z0 + PVS_CELL_SIZE, &eyes);
+
+                uint8_t* set = &sets[cell * set_size];
+                for (int object = 0; object < num_objects; ++object)
+                {
+                    // Uma célula fora de todos os volumes de observação não
+                    // deveria ser usada; por segurança, tudo é visível dela
+                    bool visible = eyes.empty();
+                    BoxTargets(input.object_min[object], input.object_max[object], &targets);
+                    for (size_t e = 0; e < eyes.size() && !visible; ++e)
+                        for (size_t t = 0; t < targets.size() && !visible; ++t)
+                            visible = !IsSegmentBlocked(input, object, eyes[e], targets[t]);
+
+                    if ( visible )
+                        set[object >> 3] |= (uint8_t)(1 << (object & 7));
+                }
+            }
+        });
+
+    // A amostragem pode perder frestas estreitas: cada célula recebe também
+    // os objetos visíveis das células vizinhas, até PVS_DILATION células de
+    // distância, para que um objeto não apareça de repente ao cruzar a
+    // borda de uma célula.
+    if ( PVS_DILATION > 0 )
+    {
+        std::vector<uint8_t> sampled(sets);
+        for (int cz = 0; cz < cells_z; ++cz)
+        for (int cx = 0; cx < cells_x; ++cx)
+        {
+            uint8_t* set = &sets[(cz * cells_x + cx) * set_size];
+            for (int nz = std::max(0, cz - PVS_DILATION); nz <= std::min(cells_z - 1, cz + PVS_DILATION); ++nz)
+            for (int nx = std::max(0, cx - PVS_DILATION); nx <= std::min(cells_x - 1, cx + PVS_DILATION); ++nx)
+            {
+                const uint8_t* neighbour = &sampled[(nz * cells_x + nx) * set_size];
+                for (size_t i = 0; i < set_size; ++i)
+                    set[i] |= neighbour[i];
+            }
+        }
+    }
+
+    PvsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, pvs_magic, sizeof(pvs_magic));
+    header.version      = PVS_VERSION;
+    header.cells_x      = cells_x;
+    header.cells_z      = cells_z;
+    header.num_objects  = num_objects;
+    header.cell_size    = PVS_CELL_SIZE;
+    header.origin_x     = input.area_min.x;
+    header.origin_z     = input.area_min.z;
+    header.objects_hash = input.objects_hash;
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t>  data;
+    size_t num_hidden = 0;
+    for (int cell = 0; cell < num_cells; ++cell)
+    {
+        offsets.push_back((uint32_t)data.size());
+        Compress(&sets[cell * set_size], set_size, &data);
+        for (int object = 0; object < num_objects; ++object)
+            if ( !Pvs_IsVisible(&sets[cell * set_size], object) )
+                ++num_hidden;
+    }
+    offsets.push_back((uint32_t)data.size());
+    header.data_size = (uint32_t)data.size();
+
+    printf("PVS: %.1f%% of the (cell, object) pairs hidden, %d bytes compressed (%d uncompressed).\n",
+           num_cells * num_objects > 0 ? 100.0 * num_hidden / (num_cells * num_objects) : 0.0,
+           (int)data.size(), (int)sets.size());
+
+    // Assim como o cache de malhas (veja "meshcache.cpp"), escrevemos em um
+    // arquivo temporário e só depois o renomeamos
+    std::string tmp_filename = std::string(filename) + ".tmp";
+    FILE* file = fopen(tmp_filename.c_str(), "wb");
+    if ( file == NULL )
+    {
+        fprintf(stderr, "ERROR: Cannot create PVS file \"%s\".\n", filename);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), file) == offsets.size();
+    ok = ok && (data.empty() || fwrite(data.data(), 1, data.size(), file) == data.size());
+    ok = (fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+    remove(filename);
+#endif
+    if ( !ok || rename(tmp_filename.c_str(), filename) != 0 )
+    {
+        fprintf(stderr, "ERROR: Cannot write PVS file \"%s\".\n", filename);
+        remove(tmp_filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Pvs_Load(const char* filename, uint64_t objects_hash)
+{
+    g_Pvs.loaded = false;
+    g_Pvs.cached_cell = -1;
+
+    FILE* file = fopen(filename, "rb");
+    if ( file == NULL )
+    {
+        fprintf(stderr, "WARNING: PVS file \"%s\" not found; all static objects will be drawn. Run \"./main --bake-pvs\" to create it.\n", filename);
+        return false;
+    }
+
+    PvsHeader& header = g_Pvs.header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+           && memcmp(header.magic, pvs_magic, sizeof(pvs_magic)) == 0
+           && header.version == PVS_VERSION
+           && header.cells_x > 0 && header.cells_z > 0
+           && header.cell_size > 0.0f;
+
+    if ( ok )
+    {
+        g_Pvs.offsets.resize((size_t)header.cells_x * header.cells_z + 1);
+        g_Pvs.data.resize(header.data_size);
+        ok = fread(g_Pvs.offsets.data(), sizeof(uint32_t), g_Pvs.offsets.size(), file) == g_Pvs.offsets.size()
+          && (header.data_size == 0 || fread(g_Pvs.data.data(), 1, header.data_size, file) == header.data_size)
+          && g_Pvs.offsets.back() == header.data_size;
+    }
+    fclose(file);
+
+    if ( !ok )
+    {
+        fprintf(stderr, "ERROR: Invalid PVS file \"%s\"; all static objects will be drawn. Run \"./main --bake-pvs\" to create it again.\n", filename);
+        return false;
+    }
+
+    if ( header.objects_hash != objects_hash )
+    {
+        fprintf(stderr, "WARNING: PVS file \"%s\" is out of date; all static objects will be drawn. Run \"./main --bake-pvs\" to update it.\n", filename);
+        return false;
+    }
+
+    g_Pvs.visible_set.assign((header.num_objects + 7) / 8, 0);
+    g_Pvs.loaded = true;
+    return true;
+}
+
+const uint8_t* Pvs_VisibleSet(const glm::vec4& position)
+{
+    if ( !g_Pvs.loaded )
+        return NULL;
+
+    const PvsHeader& header = g_Pvs.header;
+    int cx = (int)std::floor((position.x - header.origin_x) / header.cell_size);
+    int cz = (int)std::floor((position.z - header.origin_z) / header.cell_size);
+    if ( cx < 0 || cz < 0 || cx >= (int)header.cells_x || cz >= (int)header.cells_z )
+        return NULL;
+
+    // A câmera permanece na mesma célula durante muitos quadros
+    int cell = cz * (int)header.cells_x + cx;
+    if ( cell != g_Pvs.cached_cell )
+    {
+        uint32_t begin = g_Pvs.offsets[cell];
+        uint32_t end   = g_Pvs.offsets[cell + 1];
+        if ( begin > end || end > g_Pvs.data.size()
+          || !Decompress(&g_Pvs.data[begin], end - begin, g_Pvs.visible_set.data(), g_Pvs.visible_set.size()) )
+        {
+            g_Pvs.cached_cell = -1;
+            return NULL;
+        }
+        g_Pvs.cached_cell = cell;
+    }
+
+    return g_Pvs.visible_set.data();
+}
@@ -0,0 +1,110 @@
+#ifndef _PVS_H
+#define _PVS_H
+
+// Conjunto potencialmente visível (potentially visible set, PVS) dos objetos
+// estáticos do mapa (morro, pedras, árvores e cápsulas).
+//
+// A área do mapa é dividida em células de PVS_CELL_SIZE x PVS_CELL_SIZE
+// unidades no plano XZ. Um cálculo feito uma única vez ("./main --bake-pvs")
+// descobre, para cada célula, quais objetos estáticos podem ser vistos de
+// algum ponto da célula, e grava o resultado em PVS_FILENAME. Durante o jogo,
+// basta encontrar a célula da câmera para saber quais objetos estáticos
+// desenhar, sem nenhum teste de visibilidade por quadro.
+//
+// Cada objeto estático possui um índice (a sua posição na lista passada para
+// Pvs_Bake()), e o conjunto de cada célula é um vetor de bits com um bit por
+// objeto, comprimido com codificação de sequências (PackBits): células
+// vizinhas de espaços abertos têm quase todos os bits ligados, e células
+// atrás do morro têm longas sequências de bits desligados.
+//
+// O cálculo traça segmentos entre pontos de observação dentro da célula e
+// pontos na caixa de cada objeto; o objeto é visível se algum segmento não
+// atravessa nenhum oclusor (as malhas substitutas do morro e das pedras,
+// veja "occlusion.h"). Como a visibilidade é amostrada, um objeto visível
+// somente por uma fresta muito estreita pode não ser encontrado; por isso o
+// conjunto de cada célula inclui os conjuntos das células vizinhas (veja
+// PVS_DILATION), e um objeto visto de perto de uma célula continua sendo
+// desenhado dentro dela.
+//
+// O arquivo não faz parte do repositório: "make pvs" (ou "./main --bake-pvs"
+// na pasta do executável) o gera, e "make run" o gera antes da primeira
+// execução. Enquanto ele não existe, todos os objetos estáticos são
+// desenhados.
+//
+// O arquivo guarda um hash das matrizes de modelagem dos objetos estáticos:
+// se algum objeto mudar de lugar no código, o arquivo é ignorado (todos os
+// objetos são desenhados) até ser gerado de novo.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#define PVS_FILENAME "../../data/pvs.bin"
+
+// Tamanho de cada célula, em unidades do mundo
+#define PVS_CELL_SIZE 8.0f
+
+// Pontos de observação em cada célula: PVS_EYE_SAMPLES x PVS_EYE_SAMPLES no
+// plano XZ, em cada uma das alturas extremas de cada volume de observação
+#define PVS_EYE_SAMPLES 3
+
+// Distância, em células, até onde os conjuntos das células vizinhas são
+// incluídos no conjunto de cada célula
+#define PVS_DILATION 1
+
+// Região onde a câmera pode estar (no chão, em cima do morro, etc.)
+struct PvsViewVolume
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Oclusor no espaço do mundo: caixa que o envolve e triângulos (3 vértices
+// por triângulo, anti-horário visto de fora). Somente as faces voltadas para
+// o observador bloqueiam a visão, de forma que um ponto de observação dentro
+// de um oclusor não é considerado bloqueado.
+struct PvsOccluder
+{
+    int                    object;  // Objeto estático que é o próprio oclusor
+                                    // (não esconde a si mesmo), ou -1
+    glm::vec3              bbox_min;
+    glm::vec3              bbox_max;
+    std::vector<glm::vec3> triangles;
+};
+
+struct PvsBakeInput
+{
+    glm::vec3                  area_min;     // Área dividida em células (somente X e Z)
+    glm::vec3                  area_max;
+    std::vector<PvsViewVolume> view_volumes;
+    std::vector<glm::vec3>     object_min;   // Caixa de cada objeto estático,
+    std::vector<glm::vec3>     object_max;   // no espaço do mundo
+    std::vector<PvsOccluder>   occluders;
+    uint64_t                   objects_hash; // Veja Pvs_Load()
+};
+
+// Calcula o PVS de todas as células, em paralelo nas threads auxiliares
+// (veja "jobs.h"), e grava o resultado em "filename".
+bool Pvs_Bake(const PvsBakeInput& input, const char* filename);
+
+// Lê o PVS gravado por Pvs_Bake(). Se o arquivo não existir, for inválido ou
+// tiver sido gerado com outro "objects_hash", retorna false e
+// Pvs_VisibleSet() passa a retornar NULL.
+bool Pvs_Load(const char* filename, uint64_t objects_hash);
+
+// Retorna o vetor de bits dos objetos estáticos visíveis da célula que
+// contém "position", ou NULL (todos os objetos visíveis) se o PVS não foi
+// carregado ou a posição está fora da área. O vetor é válido até a próxima
+// chamada.
+const uint8_t* Pvs_VisibleSet(const glm::vec4& position);
+
+// Testa o bit do objeto "object" em um vetor retornado por Pvs_VisibleSet()
+inline bool Pvs_IsVisible(const uint8_t* visible_set, int object)
+{
+    return visible_set == NULL || ((visible_set[object >> 3] >> (object & 7)) & 1) != 0;
+}
+
+#endif // _PVS_H
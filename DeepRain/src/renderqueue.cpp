@@ -0,0 +1,752 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "drawdata.h"
+#include "frustum.h"
+#include "instancing.h"
+#include "occlusion.h"
+
+#define KEY_PASS_SHIFT      62
+#define KEY_SLICE_BITS      6
+#define KEY_PROGRAM_BITS    6
+#define KEY_OBJECT_ID_BITS  8
+#define KEY_MESH_BITS       16
+#define KEY_DEPTH_BITS      26
+
+// Consultas GL_SAMPLES_PASSED em uso ao mesmo tempo. O resultado de uma
+// consulta só é lido quando fica pronto, alguns quadros depois, sem esperar
+// pela GPU.
+#define RENDERQUEUE_QUERIES 3
+
+struct RenderItem
+{
+    int        pass;
+    int        program;         // Posição em RenderFrame::programs
+    GLuint     vertex_array_id;
+    GLenum     rendering_mode;
+    GLsizei    num_indices;
+    size_t     first_index;
+    GLint      base_vertex;
+    glm::mat4  model;
+    int        object_id;
+    glm::vec3  bbox_min;
+    glm::vec3  bbox_max;
+    size_t     first_instance;  // Posição em RenderFrame::instances
+    int        num_instances;   // Zero para desenhos não instanciados
+    GLintptr   record;          // Posição do registro no buffer de "DrawData"
+    int        mesh_id;
+    float      depth;           // Veja ViewDepth()
+    bool       depth_prepass;   // Também desenhado em RENDERPASS_DEPTH_PREPASS
+};
+
+// Estado dos próximos pedidos de desenho
+static RenderPass    g_CurrentPass = RENDERPASS_OPAQUE;
+static RenderProgram g_CurrentProgram = { 0 };
+static glm::mat4     g_CurrentModel = glm::mat4(1.0f);
+static int           g_CurrentObjectId = 0;
+static bool          g_CurrentDepthPrepass = false;
+static glm::mat4     g_CurrentView = glm::mat4(1.0f);
+static glm::mat4     g_CurrentProjection = glm::mat4(1.0f);
+
+// Conteúdo da fila em um quadro. Existem dois quadros: o gravado pela thread
+// do jogo e o executado pela thread de renderização, trocados por
+// RenderQueue_SwapFrame(). Os vetores são reutilizados entre os quadros, para
+// evitar alocações.
+struct RenderFrame
+{
+    std::vector<RenderProgram>                   programs;
+    std::vector<RenderItem>                      items;
+    std::vector<std::pair<uint64_t, uint32_t> >  sorted_items; // (chave, posição em "items")
+    std::vector<glm::mat4>                       instances;
+    std::vector<DrawRecord>                      records;      // Montados por RenderQueue_Prepare()
+    RenderQueueStats                             stats;
+    bool                                         overdraw;
+};
+
+static RenderFrame  g_Frames[2];
+static RenderFrame* g_RecordFrame  = &g_Frames[0]; // Thread do jogo
+static RenderFrame* g_ExecuteFrame = &g_Frames[1]; // Thread de renderização
+
+static std::vector<GLintptr> g_RecordChunks; // Posição de cada envio de registros
+
+// Caixas testadas contra o frustum: uma por item não instanciado e uma por
+// cópia dos itens instanciados, na ordem dos itens do quadro.
+static FrustumBoxes         g_Boxes;
+static std::vector<uint8_t> g_BoxVisible;
+
+static RenderQueueStats g_LastFrameStats;
+
+// Programas do passo de profundidade e da visualização de sobreposição
+static RenderProgram g_DepthProgram = { 0 };
+static RenderProgram g_OverdrawProgram = { 0 };
+static bool          g_OverdrawMode = false;
+
+static GLuint    g_Queries[RENDERQUEUE_QUERIES];
+static bool      g_QueriesCreated = false;
+static bool      g_QueryPending[RENDERQUEUE_QUERIES];
+static int       g_QueryFrame = 0;      // Consulta do quadro atual
+static long long g_SamplesShaded = -1;  // Último resultado lido
+
+void RenderQueue_SetPass(RenderPass pass)
+{
+    g_CurrentPass = pass;
+}
+
+void RenderQueue_SetProgram(const RenderProgram& program)
+{
+    g_CurrentProgram = program;
+}
+
+void RenderQueue_SetModel(const glm::mat4& model)
+{
+    g_CurrentModel = model;
+}
+
+void RenderQueue_SetObjectId(int object_id)
+{
+    g_CurrentObjectId = object_id;
+}
+
+void RenderQueue_SetDepthPrepass(bool enabled)
+{
+    g_CurrentDepthPrepass = enabled;
+}
+
+void RenderQueue_SetDepthProgram(const RenderProgram& program)
+{
+    g_DepthProgram = program;
+}
+
+void RenderQueue_SetOverdrawProgram(const RenderProgram& program)
+{
+    g_OverdrawProgram = program;
+}
+
+void RenderQueue_SetOverdrawMode(bool enabled)
+{
+    g_OverdrawMode = enabled;
+}
+
+bool RenderQueue_OverdrawMode()
+{
+    return g_OverdrawMode;
+}
+
+void RenderQueue_SetView(const glm::mat4& view)
+{
+    g_CurrentView = view;
+}
+
+void RenderQueue_SetProjection(const glm::mat4& projection)
+{
+    g_CurrentProjection = projection;
+}
+
+// Posição do programa na lista do quadro gravado, que é esvaziada a cada
+// quadro; o número de programas diferentes em uma mesma fila é pequeno,
+// então uma busca linear é suficiente.
+static int ProgramIndex(const RenderProgram& program)
+{
+    std::vector<RenderProgram>& programs = g_RecordFrame->programs;
+    for (size_t i = 0; i < programs.size(); ++i)
+        if ( programs[i].program_id == program.program_id )
+            return (int)i;
+
+    programs.push_back(program);
+    return (int)programs.size() - 1;
+}
+
+// Distância (no eixo Z do sistema de coordenadas da câmera) até o centro da
+// caixa da malha transformada por "model". Negativa atrás da câmera.
+static float ViewDepth(const RenderMesh& mesh, const glm::mat4& model)
+{
+    glm::vec4 center = glm::vec4((mesh.bbox_min + mesh.bbox_max) * 0.5f, 1.0f);
+    return -(g_CurrentView * model * center).z;
+}
+
+// Faixa de profundidade da chave: RENDERQUEUE_DEPTH_SLICES faixas por dobra
+// da distância até a câmera
+static uint64_t DepthSlice(float depth)
+{
+    if ( !(depth > 0.0f) )
+        return 0;
+
+    float slice = std::log2(1.0f + depth) * RENDERQUEUE_DEPTH_SLICES;
+    return (uint64_t)std::min(slice, (float)((1u << KEY_SLICE_BITS) - 1));
+}
+
+// Bits de um float não negativo, que mantêm a ordem dos valores quando
+// comparados como inteiros.
+static uint32_t DepthBits(float depth)
+{
+    if ( !(depth > 0.0f) )
+        return 0;
+
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+static uint64_t MakeKey(const RenderItem& item, int mesh_id, float depth)
+{
+    uint64_t pass      = (uint64_t)item.pass;
+    uint64_t program   = (uint64_t)item.program   & ((1u << KEY_PROGRAM_BITS) - 1);
+    uint64_t object_id = (uint64_t)item.object_id & ((1u << KEY_OBJECT_ID_BITS) - 1);
+    uint64_t mesh      = (uint64_t)mesh_id        & ((1u << KEY_MESH_BITS) - 1);
+    uint64_t depth_bits = DepthBits(depth);
+
+    if ( item.pass == RENDERPASS_TRANSPARENT )
+    {
+        // De trás para frente: a profundidade invertida vem antes do estado
+        uint64_t far_first = (uint64_t)(~(uint32_t)depth_bits);
+        return (pass << KEY_PASS_SHIFT)
+             | (far_first << (KEY_PROGRAM_BITS + KEY_OBJECT_ID_BITS + KEY_MESH_BITS))
+             | (program   << (KEY_OBJECT_ID_BITS + KEY_MESH_BITS))
+             | (object_id << KEY_MESH_BITS)
+             | mesh;
+    }
+
+    // De frente para trás por faixas; o estado desempata dentro da faixa
+    return (pass             << KEY_PASS_SHIFT)
+         | (DepthSlice(depth) << (KEY_PROGRAM_BITS + KEY_OBJECT_ID_BITS + KEY_MESH_BITS + KEY_DEPTH_BITS))
+         | (program          << (KEY_OBJECT_ID_BITS + KEY_MESH_BITS + KEY_DEPTH_BITS))
+         | (object_id        << (KEY_MESH_BITS + KEY_DEPTH_BITS))
+         | (mesh             << KEY_DEPTH_BITS)
+         | (depth_bits >> (32 - KEY_DEPTH_BITS));
+}
+
+static RenderItem NewItem(const RenderMesh& mesh)
+{
+    RenderItem item;
+    item.pass            = g_CurrentPass;
+    item.program         = ProgramIndex(g_CurrentProgram);
+    item.vertex_array_id = mesh.vertex_array_id;
+    item.rendering_mode  = mesh.rendering_mode;
+    item.num_indices     = mesh.num_indices;
+    item.first_index     = mesh.first_index;
+    item.base_vertex     = mesh.base_vertex;
+    item.model           = g_CurrentModel;
+    item.object_id       = g_CurrentObjectId;
+    item.bbox_min        = mesh.bbox_min;
+    item.bbox_max        = mesh.bbox_max;
+    item.first_instance  = 0;
+    item.num_instances   = 0;
+    item.record          = 0;
+    item.mesh_id         = mesh.mesh_id;
+    item.depth           = 0.0f;
+    item.depth_prepass   = g_CurrentDepthPrepass && g_CurrentPass == RENDERPASS_OPAQUE;
+    return item;
+}
+
+static void AddItem(const RenderItem& item, uint64_t key)
+{
+    g_RecordFrame->sorted_items.push_back(std::make_pair(key, (uint32_t)g_RecordFrame->items.size()));
+    g_RecordFrame->items.push_back(item);
+}
+
+void RenderQueue_Draw(const RenderMesh& mesh)
+{
+    RenderItem item = NewItem(mesh);
+    item.depth = ViewDepth(mesh, item.model);
+    AddItem(item, MakeKey(item, mesh.mesh_id, item.depth));
+}
+
+void RenderQueue_DrawInstanced(const RenderMesh& mesh, const glm::mat4* models, int num_instances)
+{
+    if ( num_instances <= 0 )
+        return;
+
+    RenderItem item = NewItem(mesh);
+    item.model          = glm::mat4(1.0f);
+    item.first_instance = g_RecordFrame->instances.size();
+    item.num_instances  = num_instances;
+    g_RecordFrame->instances.insert(g_RecordFrame->instances.end(), models, models + num_instances);
+
+    // A profundidade do grupo é a da cópia mais próxima
+    float depth = ViewDepth(mesh, models[0]);
+    for (int i = 1; i < num_instances; ++i)
+        depth = std::min(depth, ViewDepth(mesh, models[i]));
+
+    item.depth = depth;
+    AddItem(item, MakeKey(item, mesh.mesh_id, depth));
+}
+
+// Estado do OpenGL durante RenderQueue_Execute(). No início ele é
+// desconhecido (-1 ou false), pois o código fora da fila pode tê-lo alterado.
+struct SubmitState
+{
+    int       enabled[3];  // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE
+    int       pass;        // Passo das funções de profundidade, máscaras e mistura
+    bool      query_started;
+    int       program;
+    GLuint    vertex_array_id;
+    bool      vertex_array_known;
+    bool      record_known;
+    GLintptr  record;
+    bool      instancing_enabled;
+};
+
+static void SetCapability(SubmitState* state, int slot, GLenum capability, bool enable)
+{
+    if ( state->enabled[slot] == (int)enable )
+    {
+        g_ExecuteFrame->stats.state_changes_skipped += 1;
+        return;
+    }
+
+    if ( enable )
+        glEnable(capability);
+    else
+        glDisable(capability);
+    state->enabled[slot] = (int)enable;
+    g_ExecuteFrame->stats.state_changes += 1;
+}
+
+static void ApplyPass(SubmitState* state, int pass)
+{
+    bool overdraw = g_ExecuteFrame->overdraw;
+    bool blend = pass == RENDERPASS_TRANSPARENT || (overdraw && pass != RENDERPASS_DEPTH_PREPASS);
+
+    SetCapability(state, 0, GL_BLEND,      blend);
+    SetCapability(state, 1, GL_DEPTH_TEST, true);
+    SetCapability(state, 2, GL_CULL_FACE,  pass != RENDERPASS_BACKGROUND);
+
+    if ( state->pass == pass )
+        return;
+    state->pass = pass;
+
+    if ( blend && overdraw )
+        glBlendFunc(GL_ONE, GL_ONE);
+    else if ( blend )
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // O passo de profundidade não escreve cor, e o plano de fundo não
+    // escreve profundidade. Depois do passo de profundidade, os fragmentos
+    // com a mesma profundidade já escrita devem passar no teste.
+    GLboolean color = pass == RENDERPASS_DEPTH_PREPASS ? GL_FALSE : GL_TRUE;
+    glColorMask(color, color, color, color);
+    glDepthMask(pass == RENDERPASS_BACKGROUND ? GL_FALSE : GL_TRUE);
+    glDepthFunc(pass == RENDERPASS_DEPTH_PREPASS ? GL_LESS : GL_LEQUAL);
+    glDepthRange(pass == RENDERPASS_BACKGROUND ? 1.0 : 0.0, 1.0);
+
+    // A contagem de amostras começa no primeiro passo que escreve cor
+    int query = g_QueryFrame % RENDERQUEUE_QUERIES;
+    if ( pass != RENDERPASS_DEPTH_PREPASS && !state->query_started && !g_QueryPending[query] )
+    {
+        glBeginQuery(GL_SAMPLES_PASSED, g_Queries[query]);
+        state->query_started = true;
+    }
+}
+
+static void ApplyRecord(SubmitState* state, const RenderItem& item)
+{
+    if ( state->record_known && state->record == item.record )
+    {
+        g_ExecuteFrame->stats.record_binds_skipped += 1;
+        return;
+    }
+
+    DrawData_BindRecord(item.record);
+    state->record_known = true;
+    state->record = item.record;
+    g_ExecuteFrame->stats.record_binds += 1;
+}
+
+static bool SameRecord(const RenderItem& a, const RenderItem& b)
+{
+    return a.object_id == b.object_id
+        && a.bbox_min == b.bbox_min
+        && a.bbox_max == b.bbox_max
+        && a.model == b.model;
+}
+
+// Monta os registros de "DrawData" dos itens, na ordem em que serão
+// desenhados: itens seguidos com os mesmos dados compartilham um registro.
+// Cada item guarda, por enquanto, a posição do seu registro no vetor.
+static void BuildRecords(RenderFrame* frame)
+{
+    frame->records.clear();
+    const RenderItem* previous = NULL;
+    for (size_t i = 0; i < frame->sorted_items.size(); ++i)
+    {
+        RenderItem& item = frame->items[frame->sorted_items[i].second];
+        if ( previous == NULL || !SameRecord(*previous, item) )
+        {
+            DrawRecord record;
+            DrawData_MakeRecord(&record, item.model, item.object_id, item.bbox_min, item.bbox_max);
+            frame->records.push_back(record);
+        }
+        item.record = (GLintptr)(frame->records.size() - 1);
+        previous = &item;
+    }
+}
+
+// Envia todos os registros de uma vez (em partes de no máximo
+// DrawData_MaxRecords()) e troca a posição de cada item no vetor pela
+// posição do seu registro no buffer.
+static void UploadRecords(RenderFrame* frame)
+{
+    size_t max_records = DrawData_MaxRecords();
+    g_RecordChunks.clear();
+    for (size_t first = 0; first < frame->records.size(); first += max_records)
+        g_RecordChunks.push_back(DrawData_Upload(&frame->records[first], std::min(max_records, frame->records.size() - first)));
+
+    size_t stride = DrawData_Stride();
+    for (size_t i = 0; i < frame->sorted_items.size(); ++i)
+    {
+        RenderItem& item = frame->items[frame->sorted_items[i].second];
+        size_t index = (size_t)item.record;
+        item.record = g_RecordChunks[index / max_records] + (GLintptr)((index % max_records) * stride);
+    }
+}
+
+// Descarta os itens (e as cópias dos itens instanciados) fora do frustum ou
+// escondidos pelos oclusores
+static void CullItems()
+{
+    RenderFrame* frame = g_RecordFrame;
+    Frustum_ClearBoxes(&g_Boxes);
+    for (size_t i = 0; i < frame->items.size(); ++i)
+    {
+        const RenderItem& item = frame->items[i];
+        if ( item.pass == RENDERPASS_BACKGROUND )
+            continue;
+
+        if ( item.num_instances == 0 )
+            Frustum_AddBox(&g_Boxes, item.bbox_min, item.bbox_max, item.model);
+        else
+            for (int k = 0; k < item.num_instances; ++k)
+                Frustum_AddBox(&g_Boxes, item.bbox_min, item.bbox_max, frame->instances[item.first_instance + k]);
+    }
+
+    glm::mat4 projection_view = g_CurrentProjection * g_CurrentView;
+    g_BoxVisible.resize(g_Boxes.center[0].size());
+    size_t num_visible = Frustum_CullBoxes(Frustum_FromMatrix(projection_view), g_Boxes, g_BoxVisible.data());
+    frame->stats.boxes_culled += (int)(g_BoxVisible.size() - num_visible);
+
+    // As caixas dentro do frustum são testadas contra os oclusores pedidos
+    // até aqui (veja "occlusion.h")
+    Occlusion_Render(projection_view);
+    for (size_t i = 0; i < g_BoxVisible.size(); ++i)
+    {
+        if ( !g_BoxVisible[i] )
+            continue;
+
+        glm::vec3 center = glm::vec3(g_Boxes.center[0][i], g_Boxes.center[1][i], g_Boxes.center[2][i]);
+        glm::vec3 extent = glm::vec3(g_Boxes.extent[0][i], g_Boxes.extent[1][i], g_Boxes.extent[2][i]);
+        if ( !Occlusion_IsBoxVisible(projection_view, center, extent) )
+        {
+            g_BoxVisible[i] = 0;
+            num_visible -= 1;
+            frame->stats.boxes_occluded += 1;
+        }
+    }
+    frame->stats.boxes_visible += (int)num_visible;
+
+    // As cópias visíveis são movidas para o início do intervalo do item, e
+    // os itens sem nenhuma parte visível saem da lista ordenada.
+    static std::vector<uint8_t> removed;
+    removed.assign(frame->items.size(), 0);
+    size_t box = 0;
+    for (size_t i = 0; i < frame->items.size(); ++i)
+    {
+        RenderItem& item = frame->items[i];
+        if ( item.pass == RENDERPASS_BACKGROUND )
+            continue;
+
+        if ( item.num_instances == 0 )
+        {
+            removed[i] = !g_BoxVisible[box++];
+            continue;
+        }
+
+        int num_visible_instances = 0;
+        for (int k = 0; k < item.num_instances; ++k)
+            if ( g_BoxVisible[box++] )
+                frame->instances[item.first_instance + num_visible_instances++] = frame->instances[item.first_instance + k];
+        item.num_instances = num_visible_instances;
+        removed[i] = num_visible_instances == 0;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < frame->sorted_items.size(); ++i)
+        if ( !removed[frame->sorted_items[i].second] )
+            frame->sorted_items[kept++] = frame->sorted_items[i];
+    frame->sorted_items.resize(kept);
+}
+
+// Dois itens não instanciados podem ser desenhados na mesma chamada se todo
+// o estado utilizado por eles for igual.
+static bool SameState(const RenderItem& a, const RenderItem& b)
+{
+    return a.num_instances == 0 && b.num_instances == 0
+        && a.pass == b.pass
+        && a.program == b.program
+        && a.vertex_array_id == b.vertex_array_id
+        && a.rendering_mode == b.rendering_mode
+        && a.record == b.record;
+}
+
+void RenderQueue_Prepare()
+{
+    RenderFrame* frame = g_RecordFrame;
+    if ( frame->items.empty() )
+        return;
+
+    CullItems();
+
+    // Os itens opacos visíveis marcados com RenderQueue_SetDepthPrepass() são
+    // repetidos no passo de profundidade, com as mesmas cópias e o mesmo
+    // registro de "DrawData"
+    if ( g_DepthProgram.program_id != 0 )
+    {
+        int depth_program = ProgramIndex(g_DepthProgram);
+        size_t num_sorted = frame->sorted_items.size();
+        for (size_t i = 0; i < num_sorted; ++i)
+        {
+            RenderItem copy = frame->items[frame->sorted_items[i].second];
+            if ( !copy.depth_prepass )
+                continue;
+
+            copy.pass          = RENDERPASS_DEPTH_PREPASS;
+            copy.program       = depth_program;
+            copy.depth_prepass = false;
+            AddItem(copy, MakeKey(copy, copy.mesh_id, copy.depth));
+            frame->stats.depth_prepass_items += 1;
+        }
+    }
+
+    // A posição do item na fila desempata chaves iguais, mantendo a ordem em
+    // que os itens foram pedidos.
+    std::sort(frame->sorted_items.begin(), frame->sorted_items.end());
+
+    BuildRecords(frame);
+}
+
+void RenderQueue_SwapFrame()
+{
+    // Os contadores do quadro executado por último ficam completos
+    g_LastFrameStats = g_ExecuteFrame->stats;
+    g_LastFrameStats.samples_shaded = g_SamplesShaded;
+
+    std::swap(g_RecordFrame, g_ExecuteFrame);
+    g_ExecuteFrame->overdraw = g_OverdrawMode;
+
+    RenderFrame* frame = g_RecordFrame;
+    frame->programs.clear();
+    frame->items.clear();
+    frame->sorted_items.clear();
+    frame->instances.clear();
+    frame->records.clear();
+    memset(&frame->stats, 0, sizeof(frame->stats));
+}
+
+void RenderQueue_ReplaceProgram(GLuint old_program_id, GLuint new_program_id)
+{
+    std::vector<RenderProgram>& programs = g_ExecuteFrame->programs;
+    for (size_t i = 0; i < programs.size(); ++i)
+        if ( programs[i].program_id == old_program_id )
+            programs[i].program_id = new_program_id;
+}
+
+void RenderQueue_Execute()
+{
+    RenderFrame* frame = g_ExecuteFrame;
+    RenderQueueStats& stats = frame->stats;
+    if ( frame->sorted_items.empty() )
+        return;
+
+    if ( !g_QueriesCreated )
+    {
+        glGenQueries(RENDERQUEUE_QUERIES, g_Queries);
+        for (int q = 0; q < RENDERQUEUE_QUERIES; ++q)
+            g_QueryPending[q] = false;
+        g_QueriesCreated = true;
+    }
+
+    // Todas as cópias dos desenhos instanciados são enviadas de uma vez
+    GLintptr instances_offset = 0;
+    if ( !frame->instances.empty() )
+        instances_offset = Instancing_Upload(frame->instances.data(), frame->instances.size());
+
+    UploadRecords(frame);
+
+    std::vector<RenderItem>&                      items = frame->items;
+    std::vector<std::pair<uint64_t, uint32_t> >&  sorted_items = frame->sorted_items;
+
+    // Vetores reutilizados entre as chamadas, para evitar alocações a cada quadro
+    static std::vector<GLsizei>     counts;
+    static std::vector<const void*> offsets;
+    static std::vector<GLint>       base_vertices;
+
+    SubmitState state;
+    state.enabled[0] = state.enabled[1] = state.enabled[2] = -1;
+    state.pass = -1;
+    state.query_started = false;
+    state.program = -1;
+    state.vertex_array_id = 0;
+    state.vertex_array_known = false;
+    state.record_known = false;
+    state.record = 0;
+    state.instancing_enabled = false;
+
+    size_t i = 0;
+    while ( i < sorted_items.size() )
+    {
+        const RenderItem& item = items[sorted_items[i].second];
+
+        ApplyPass(&state, item.pass);
+
+        if ( state.program == item.program )
+            stats.program_binds_skipped += 1;
+        else
+        {
+            bool overdraw = frame->overdraw && g_OverdrawProgram.program_id != 0 && item.pass != RENDERPASS_DEPTH_PREPASS;
+            glUseProgram(overdraw ? g_OverdrawProgram.program_id : frame->programs[item.program].program_id);
+            state.program = item.program;
+            stats.program_binds += 1;
+        }
+
+        if ( state.vertex_array_known && state.vertex_array_id == item.vertex_array_id )
+            stats.vertex_array_binds_skipped += 1;
+        else
+        {
+            // Os atributos das instâncias pertencem ao VAO anterior
+            if ( state.instancing_enabled )
+            {
+                Instancing_DisableAttributes();
+                state.instancing_enabled = false;
+            }
+            glBindVertexArray(item.vertex_array_id);
+            state.vertex_array_known = true;
+            state.vertex_array_id = item.vertex_array_id;
+            stats.vertex_array_binds += 1;
+        }
+
+        ApplyRecord(&state, item);
+
+        if ( item.num_instances > 0 )
+        {
+            Instancing_EnableAttributes(instances_offset + item.first_instance * sizeof(InstanceData));
+            state.instancing_enabled = true;
+
+            glDrawElementsInstancedBaseVertex(
+                item.rendering_mode,
+                item.num_indices,
+                GL_UNSIGNED_INT,
+                (void*)(item.first_index * sizeof(GLuint)),
+                item.num_instances,
+                item.base_vertex
+            );
+            stats.items += 1;
+            stats.draw_calls += 1;
+            stats.triangles += item.num_instances * (item.num_indices / 3);
+            i += 1;
+            continue;
+        }
+
+        if ( state.instancing_enabled )
+        {
+            Instancing_DisableAttributes();
+            state.instancing_enabled = false;
+        }
+
+        // Agrupa os itens seguintes com o mesmo estado
+        size_t end = i + 1;
+        while ( end < sorted_items.size() && SameState(item, items[sorted_items[end].second]) )
+            end += 1;
+
+        if ( end == i + 1 )
+        {
+            stats.triangles += item.num_indices / 3;
+            glDrawElementsBaseVertex(
+                item.rendering_mode,
+                item.num_indices,
+                GL_UNSIGNED_INT,
+                (void*)(item.first_index * sizeof(GLuint)),
+                item.base_vertex
+            );
+        }
+        else
+        {
+            counts.clear();
+            offsets.clear();
+            base_vertices.clear();
+            for (size_t j = i; j < end; ++j)
+            {
+                const RenderItem& part = items[sorted_items[j].second];
+                counts.push_back(part.num_indices);
+                stats.triangles += part.num_indices / 3;
+                offsets.push_back((const void*)(part.first_index * sizeof(GLuint)));
+                base_vertices.push_back(part.base_vertex);
+            }
+            glMultiDrawElementsBaseVertex(item.rendering_mode, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)counts.size(), base_vertices.data());
+
+            // Cada item agrupado teria ligado o programa, o VAO e o registro
+            // em um desenho separado.
+            size_t merged = end - i - 1;
+            stats.program_binds_skipped      += (int)merged;
+            stats.vertex_array_binds_skipped += (int)merged;
+            stats.record_binds_skipped       += (int)merged;
+        }
+
+        stats.items += (int)(end - i);
+        stats.draw_calls += 1;
+        i = end;
+    }
+
+    if ( state.instancing_enabled )
+        Instancing_DisableAttributes();
+
+    if ( state.query_started )
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        g_QueryPending[g_QueryFrame % RENDERQUEUE_QUERIES] = true;
+    }
+
+    // Restaura o estado padrão esperado pelo código fora da fila
+    if ( state.enabled[0] != 0 ) glDisable(GL_BLEND);
+    if ( state.enabled[1] != 1 ) glEnable(GL_DEPTH_TEST);
+    if ( state.enabled[2] != 1 ) glEnable(GL_CULL_FACE);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glDepthRange(0.0, 1.0);
+}
+
+void RenderQueue_EndFrame()
+{
+    // Lê as consultas de amostras que já terminaram, sem esperar pela GPU
+    if ( g_QueriesCreated )
+    {
+        for (int k = 1; k <= RENDERQUEUE_QUERIES; ++k)
+        {
+            // Da mais antiga (a próxima a ser reutilizada) para a mais nova
+            int q = (g_QueryFrame + k) % RENDERQUEUE_QUERIES;
+            if ( !g_QueryPending[q] )
+                continue;
+
+            GLuint available = 0;
+            glGetQueryObjectuiv(g_Queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+            if ( !available )
+                continue;
+
+            GLuint samples = 0;
+            glGetQueryObjectuiv(g_Queries[q], GL_QUERY_RESULT, &samples);
+            g_SamplesShaded = (long long)samples;
+            g_QueryPending[q] = false;
+        }
+        g_QueryFrame += 1;
+    }
+}
+
+const RenderQueueStats& RenderQueue_GetStats()
+{
+    return g_LastFrameStats;
+}
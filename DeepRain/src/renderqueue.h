@@ -0,0 +1,196 @@
+#ifndef _RENDERQUEUE_H
+#define _RENDERQUEUE_H
+
+// Fila de renderização: os desenhos da cena não são executados no momento em
+// que são pedidos, mas guardados como itens de uma fila. Cada item recebe uma
+// chave de ordenação de 64 bits; RenderQueue_Prepare() ordena a fila pela
+// chave e RenderQueue_Execute() executa os desenhos, evitando as trocas de
+// estado redundantes.
+//
+// A chave é montada (do bit mais significativo para o menos) com:
+//
+//   passo (2 bits) | faixa de profundidade (6) | programa (6) | object_id (8) | malha (16) | profundidade (26)
+//
+// Assim, os desenhos são agrupados primeiro pelo passo (veja RenderPass) e
+// desenhados aproximadamente de frente para trás: a faixa de profundidade
+// cresce com o logaritmo da distância até a câmera (RENDERQUEUE_DEPTH_SLICES
+// faixas por dobra da distância), de forma que os objetos próximos, que
+// escondem os outros, são desenhados primeiro e o teste de profundidade
+// descarta os fragmentos escondidos antes do fragment shader (early-z).
+// Dentro de cada faixa, os desenhos são agrupados pelo programa de GPU, pelo
+// material (o "object_id", que escolhe as texturas em
+// "shader_fragment.glsl") e pela malha, evitando trocas de estado; por fim,
+// os mais próximos vêm primeiro. No passo RENDERPASS_TRANSPARENT a
+// profundidade (invertida: de trás para frente) vem logo depois do passo,
+// pois a ordem dos desenhos com mistura (blending) altera o resultado.
+//
+// Os desenhos pedidos com RenderQueue_SetDepthPrepass(true) (objetos com
+// fragment shaders caros) também são desenhados antes de todos os outros,
+// no passo RENDERPASS_DEPTH_PREPASS, somente no Z-buffer e com o programa de
+// RenderQueue_SetDepthProgram(). No passo RENDERPASS_OPAQUE, com
+// glDepthFunc(GL_LEQUAL), apenas os fragmentos visíveis desses objetos
+// executam o fragment shader completo.
+//
+// O céu (RENDERPASS_BACKGROUND) é desenhado depois dos objetos opacos, no
+// plano de fundo (glDepthRange(1, 1)), com glDepthFunc(GL_LEQUAL) e sem
+// escrita no Z-buffer: somente os pixels não cobertos pela cena o desenham.
+//
+// Com RenderQueue_SetOverdrawMode(true), todos os desenhos utilizam o
+// programa de RenderQueue_SetOverdrawProgram() e são somados com mistura
+// aditiva: cada fragmento que passa pelo teste de profundidade clareia o
+// pixel, mostrando quantas vezes cada pixel foi pintado. Independentemente
+// do modo, o número de amostras pintadas fora do passo de profundidade é
+// medido com uma consulta GL_SAMPLES_PASSED (veja RenderQueueStats).
+//
+// Itens consecutivos com exatamente o mesmo estado (programa, VAO e dados do
+// desenho) são desenhados com uma única chamada a
+// glMultiDrawElementsBaseVertex().
+//
+// Os dados de cada item (matriz "model", "object_id", "bbox_min" e
+// "bbox_max") são definidos com as funções RenderQueue_Set*() antes do
+// pedido de desenho. RenderQueue_Execute() não os envia com glUniform*(): os
+// registros de todos os itens são copiados de uma só vez para o buffer do
+// bloco "DrawData", e cada desenho apenas escolhe o seu registro (veja
+// "drawdata.h"). O bloco "FrameData" ("view" e "projection") não faz parte
+// dos itens: ele é definido uma vez por quadro, antes de
+// RenderQueue_Execute().
+//
+// Antes da ordenação, os itens fora do campo de visão são descartados (veja
+// "frustum.h"): cada item é testado com a caixa do seu modelo, e cada cópia
+// de um desenho instanciado é testada separadamente. O frustum é o das
+// últimas matrizes passadas para RenderQueue_SetProjection() e
+// RenderQueue_SetView(). Os itens dentro do frustum são então testados
+// contra os oclusores pedidos com Occlusion_AddOccluder() (veja
+// "occlusion.h"). Os itens do passo RENDERPASS_BACKGROUND (que envolvem a
+// câmera) não são testados.
+//
+// A fila possui dois quadros (veja "renderthread.h"): a thread do jogo grava
+// os pedidos de desenho e chama RenderQueue_Prepare(), que faz todo o
+// trabalho de CPU (descarte, ordenação, montagem dos registros) sem usar
+// OpenGL; RenderQueue_SwapFrame() entrega o quadro preparado para a thread de
+// renderização, que o executa com RenderQueue_Execute(). As funções de
+// gravação, RenderQueue_Prepare() e RenderQueue_GetStats() devem ser
+// chamadas na thread do jogo; RenderQueue_Execute(), RenderQueue_EndFrame()
+// e RenderQueue_ReplaceProgram() na thread que possui o contexto OpenGL; e
+// RenderQueue_SwapFrame() com as duas threads sincronizadas.
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+// Os passos são executados nesta ordem
+enum RenderPass
+{
+    RENDERPASS_DEPTH_PREPASS = 0, // Somente profundidade; criado pela fila (veja RenderQueue_SetDepthPrepass())
+    RENDERPASS_OPAQUE,            // Estado padrão, com glDepthFunc(GL_LEQUAL)
+    RENDERPASS_BACKGROUND,        // Plano de fundo, sem escrita no Z-buffer e sem descarte de faces (skybox)
+    RENDERPASS_TRANSPARENT,       // Mistura ligada (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+    RENDERPASS_COUNT
+};
+
+// Número de faixas de profundidade da chave de ordenação por dobra da
+// distância até a câmera
+#define RENDERQUEUE_DEPTH_SLICES 4
+
+// Programa de GPU, com os blocos "FrameData" e "DrawData" já ligados por
+// DrawData_BindProgram()
+struct RenderProgram
+{
+    GLuint program_id;
+};
+
+// Intervalo de índices a ser desenhado com glDrawElementsBaseVertex()
+struct RenderMesh
+{
+    GLuint    vertex_array_id;
+    GLenum    rendering_mode;
+    GLsizei   num_indices;
+    size_t    first_index;
+    GLint     base_vertex;
+    int       mesh_id;   // Identifica a malha na chave de ordenação
+    glm::vec3 bbox_min;  // Enviados para "bbox_min" e "bbox_max", e usados
+    glm::vec3 bbox_max;  // para calcular a profundidade do item
+};
+
+// Contadores de um quadro. Os campos "*_skipped" contam as trocas de estado
+// que seriam feitas por um desenho imediato e foram evitadas pela ordenação.
+struct RenderQueueStats
+{
+    int items;
+    int draw_calls;
+    int triangles;
+    int boxes_visible;          // Itens e cópias dentro do frustum
+    int boxes_culled;           // Itens e cópias fora do frustum
+    int boxes_occluded;         // Itens e cópias escondidos pelos oclusores
+    int program_binds;
+    int program_binds_skipped;
+    int vertex_array_binds;
+    int vertex_array_binds_skipped;
+    int record_binds;           // Troca do registro de "DrawData" (glBindBufferRange)
+    int record_binds_skipped;
+    int state_changes;          // glEnable()/glDisable() de mistura, profundidade e faces
+    int state_changes_skipped;
+    int depth_prepass_items;    // Itens desenhados também no passo de profundidade
+    long long samples_shaded;   // Amostras pintadas fora do passo de profundidade
+                                // (GL_SAMPLES_PASSED), de alguns quadros atrás;
+                                // -1 enquanto nenhuma medida terminou
+};
+
+// Estado utilizado pelos próximos pedidos de desenho
+void RenderQueue_SetPass(RenderPass pass);
+void RenderQueue_SetProgram(const RenderProgram& program);
+void RenderQueue_SetModel(const glm::mat4& model);
+void RenderQueue_SetObjectId(int object_id);
+void RenderQueue_SetDepthPrepass(bool enabled); // Somente para RENDERPASS_OPAQUE
+
+// Programa utilizado no passo de profundidade. Pode ter um fragment shader
+// vazio, mas deve calcular gl_Position exatamente como os demais (veja
+// "invariant" em "shader_vertex.glsl").
+void RenderQueue_SetDepthProgram(const RenderProgram& program);
+
+// Visualização de sobreposição de desenhos (overdraw)
+void RenderQueue_SetOverdrawProgram(const RenderProgram& program);
+void RenderQueue_SetOverdrawMode(bool enabled);
+bool RenderQueue_OverdrawMode();
+
+// Matriz "view" utilizada para calcular a profundidade dos próximos itens e,
+// com a matriz "projection", o frustum testado em RenderQueue_Prepare()
+void RenderQueue_SetView(const glm::mat4& view);
+void RenderQueue_SetProjection(const glm::mat4& projection);
+
+// Adiciona um desenho à fila
+void RenderQueue_Draw(const RenderMesh& mesh);
+
+// Adiciona um desenho instanciado (veja "instancing.h") à fila. As matrizes
+// são copiadas; a matriz "model" do item é a identidade.
+void RenderQueue_DrawInstanced(const RenderMesh& mesh, const glm::mat4* models, int num_instances);
+
+// Descarta os itens invisíveis, cria as cópias do passo de profundidade,
+// ordena a fila e monta os registros de "DrawData". Chamada uma vez por
+// quadro, depois de todos os pedidos de desenho.
+void RenderQueue_Prepare();
+
+// Troca os dois quadros: o quadro preparado passa a ser executado, e os
+// próximos pedidos de desenho vão para uma fila vazia. O modo de
+// sobreposição é copiado para o quadro entregue. Os contadores do último
+// quadro executado passam a ser retornados por RenderQueue_GetStats().
+void RenderQueue_SwapFrame();
+
+// Troca um programa de GPU recriado (veja LoadShadersFromFiles() em
+// "main.cpp") nos itens do quadro entregue e ainda não executado
+void RenderQueue_ReplaceProgram(GLuint old_program_id, GLuint new_program_id);
+
+// Executa os desenhos do quadro entregue. No final, o estado padrão
+// (profundidade e descarte de faces ligados, mistura desligada,
+// glDepthFunc(GL_LESS), escrita em todos os buffers) é restaurado.
+void RenderQueue_Execute();
+
+// Chamada uma vez por quadro, depois de glfwSwapBuffers(): lê os resultados
+// das consultas de amostras que já terminaram.
+void RenderQueue_EndFrame();
+const RenderQueueStats& RenderQueue_GetStats();
+
+#endif // _RENDERQUEUE_H
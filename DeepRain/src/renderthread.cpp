@@ -0,0 +1,151 @@
+#include "renderthread.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// Estado compartilhado pelas duas threads, protegido por g_RenderMutex
+static std::thread              g_RenderThread;
+static std::mutex               g_RenderMutex;
+static std::condition_variable  g_RenderChanged;
+static unsigned long long       g_FramesSubmitted = 0; // Quadros entregues pela thread do jogo
+static unsigned long long       g_FramesAccepted = 0;  // Quadros já trocados pela thread de renderização
+static bool                     g_RenderQuit = false;
+static std::exception_ptr       g_RenderError;
+
+static GLFWwindow*          g_Window = NULL;
+static RenderThreadFunction g_Handoff;
+static RenderThreadFunction g_Render;
+
+// Tempos medidos pela thread de renderização, publicados em
+// g_LastStats durante a troca
+static RenderThreadStats g_Stats;
+static RenderThreadStats g_LastStats;
+
+// Cerca colocada no fim de cada quadro; a posição é o número do quadro
+// módulo RENDERTHREAD_GPU_FRAMES
+static GLsync g_FrameFences[RENDERTHREAD_GPU_FRAMES];
+
+// Espera a GPU terminar o quadro que usou a mesma posição de g_FrameFences
+static void WaitFrameFence(unsigned long long frame)
+{
+    GLsync& fence = g_FrameFences[frame % RENDERTHREAD_GPU_FRAMES];
+    if ( fence == 0 )
+        return;
+
+    while ( glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED )
+        ;
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+// Laço executado pela thread de renderização
+static void RenderThread_Loop()
+{
+    glfwMakeContextCurrent(g_Window);
+
+    for (unsigned long long frame = 0; ; ++frame)
+    {
+        {
+            std::unique_lock<std::mutex> lock(g_RenderMutex);
+            double wait_start = glfwGetTime();
+            while (g_FramesAccepted == g_FramesSubmitted && !g_RenderQuit)
+                g_RenderChanged.wait(lock);
+
+            if (g_FramesAccepted == g_FramesSubmitted)
+                break;
+
+            // A thread do jogo está parada em RenderThread_SubmitFrame()
+            g_Stats.render_wait_ms = (float)(1000.0*(glfwGetTime() - wait_start));
+            try
+            {
+                g_Handoff();
+            }
+            catch (...)
+            {
+                g_RenderError = std::current_exception();
+            }
+            g_LastStats.render_wait_ms = g_Stats.render_wait_ms;
+            g_LastStats.render_ms      = g_Stats.render_ms;
+            g_FramesAccepted += 1;
+        }
+        g_RenderChanged.notify_all();
+
+        WaitFrameFence(frame);
+
+        double render_start = glfwGetTime();
+        try
+        {
+            g_Render();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(g_RenderMutex);
+            g_RenderError = std::current_exception();
+        }
+        g_FrameFences[frame % RENDERTHREAD_GPU_FRAMES] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        g_Stats.render_ms = (float)(1000.0*(glfwGetTime() - render_start));
+    }
+
+    for (int i = 0; i < RENDERTHREAD_GPU_FRAMES; ++i)
+        WaitFrameFence(i);
+
+    glfwMakeContextCurrent(NULL);
+}
+
+void RenderThread_Start(GLFWwindow* window, const RenderThreadFunction& handoff, const RenderThreadFunction& render)
+{
+    g_Window  = window;
+    g_Handoff = handoff;
+    g_Render  = render;
+    g_FramesSubmitted = g_FramesAccepted = 0;
+    g_RenderQuit = false;
+    for (int i = 0; i < RENDERTHREAD_GPU_FRAMES; ++i)
+        g_FrameFences[i] = 0;
+
+    // Um contexto só pode ser atual em uma thread de cada vez
+    glfwMakeContextCurrent(NULL);
+    g_RenderThread = std::thread(RenderThread_Loop);
+}
+
+void RenderThread_SubmitFrame()
+{
+    double wait_start = glfwGetTime();
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(g_RenderMutex);
+        g_FramesSubmitted += 1;
+        g_RenderChanged.notify_all();
+        while (g_FramesAccepted != g_FramesSubmitted && !g_RenderError)
+            g_RenderChanged.wait(lock);
+
+        error = g_RenderError;
+        g_RenderError = std::exception_ptr();
+    }
+    g_LastStats.game_wait_ms = (float)(1000.0*(glfwGetTime() - wait_start));
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void RenderThread_Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_RenderMutex);
+        g_RenderQuit = true;
+    }
+    g_RenderChanged.notify_all();
+
+    if (g_RenderThread.joinable())
+        g_RenderThread.join();
+    glfwMakeContextCurrent(g_Window);
+}
+
+const RenderThreadStats& RenderThread_GetStats()
+{
+    return g_LastStats;
+}
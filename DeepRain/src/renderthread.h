@@ -0,0 +1,68 @@
+#ifndef _RENDERTHREAD_H
+#define _RENDERTHREAD_H
+
+// Thread de renderização: durante o jogo, o contexto OpenGL pertence a uma
+// thread separada, e a thread principal (a thread do jogo) fica com a janela,
+// os eventos do GLFW e a simulação.
+//
+// Cada quadro é gravado pela thread do jogo (matrizes da câmera, itens da
+// fila de renderização, textos do HUD, linhas de depuração) e entregue com
+// RenderThread_SubmitFrame(). A entrega é uma fila com um único lugar
+// (produtor: a thread do jogo; consumidor: a thread de renderização): a
+// thread do jogo espera a thread de renderização terminar o quadro anterior
+// e executar a função de troca ("handoff"). Durante a troca, com as duas
+// threads sincronizadas e a thread do jogo parada, os módulos trocam os seus
+// buffers duplos (veja RenderQueue_SwapFrame(), TextRendering_SwapFrame() e
+// DebugDraw_SwapFrame()): o quadro gravado passa a ser uma cópia que só a
+// thread de renderização lê, e a thread do jogo volta a gravar nos vetores
+// do quadro anterior. Em seguida, a thread do jogo simula e grava o quadro
+// N+1 enquanto a thread de renderização executa os comandos OpenGL do
+// quadro N ("render") e chama glfwSwapBuffers().
+//
+// O estado compartilhado pelas duas threads (malhas e texturas carregadas
+// pelas tarefas de conclusão de "jobs.h", programas de GPU, tabela de
+// materiais) só é alterado durante a troca. Assim, as funções que os outros
+// módulos reservam à "thread principal", por usarem OpenGL, são chamadas
+// durante o jogo somente na thread de renderização.
+//
+// A latência é limitada: a thread do jogo fica no máximo um quadro à frente
+// da thread de renderização, e a thread de renderização espera (glFenceSync)
+// a GPU terminar o quadro de RENDERTHREAD_GPU_FRAMES quadros atrás antes de
+// começar um novo.
+//
+// As funções abaixo devem ser chamadas na thread principal.
+
+#include <functional>
+
+struct GLFWwindow;
+
+// Quadros enviados para a GPU e ainda não terminados, no máximo
+#define RENDERTHREAD_GPU_FRAMES 2
+
+typedef std::function<void()> RenderThreadFunction;
+
+// Tempos do último quadro, em milissegundos
+struct RenderThreadStats
+{
+    float game_wait_ms;    // Thread do jogo esperando a troca
+    float render_wait_ms;  // Thread de renderização esperando um quadro
+    float render_ms;       // Comandos OpenGL do quadro e glfwSwapBuffers()
+};
+
+// Libera o contexto OpenGL da janela na thread principal e cria a thread de
+// renderização, que passa a possuí-lo. "handoff" e "render" são executadas
+// na thread de renderização, uma vez por quadro entregue, como descrito
+// acima.
+void RenderThread_Start(GLFWwindow* window, const RenderThreadFunction& handoff, const RenderThreadFunction& render);
+
+// Entrega o quadro gravado e retorna depois da troca. Exceções lançadas na
+// thread de renderização são relançadas aqui.
+void RenderThread_SubmitFrame();
+
+// Espera o último quadro entregue, termina a thread de renderização e torna
+// o contexto OpenGL atual de novo na thread principal.
+void RenderThread_Stop();
+
+const RenderThreadStats& RenderThread_GetStats();
+
+#endif // _RENDERTHREAD_H
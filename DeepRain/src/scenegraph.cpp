@@ -0,0 +1,151 @@
+#include "scenegraph.h"
+
+#include <algorithm>
+
+#include "pvs.h"
+
+struct SceneNode
+{
+    SceneNodeId parent;
+    SceneNodeId first_child;
+    SceneNodeId last_child;
+    SceneNodeId next_sibling;
+    int         drawable;
+    int         static_index;
+    bool        visible;
+    bool        dirty;    // "local" mudou desde o último SceneGraph_Update()
+    bool        updated;  // "world" foi recalculada no SceneGraph_Update() atual
+    glm::mat4   local;
+    glm::mat4   world;
+};
+
+static std::vector<SceneNode> g_Nodes;
+
+// Menor índice de um nó com "dirty" verdadeiro, ou g_Nodes.size() se nenhum
+static size_t g_FirstDirty = 0;
+
+// Pilha de SceneGraph_Collect(), reutilizada entre as chamadas
+static std::vector<SceneNodeId> g_CollectStack;
+
+SceneNodeId SceneGraph_CreateNode(SceneNodeId parent, int drawable)
+{
+    SceneNode node;
+    node.parent       = parent;
+    node.first_child  = SCENENODE_NONE;
+    node.last_child   = SCENENODE_NONE;
+    node.next_sibling = SCENENODE_NONE;
+    node.drawable     = drawable;
+    node.static_index = -1;
+    node.visible      = true;
+    node.dirty        = true;
+    node.updated      = false;
+    node.local        = glm::mat4(1.0f);
+    node.world        = glm::mat4(1.0f);
+
+    SceneNodeId id = (SceneNodeId)g_Nodes.size();
+    g_Nodes.push_back(node);
+
+    // Os filhos ficam na ordem de criação
+    if ( parent != SCENENODE_NONE )
+    {
+        SceneNode& p = g_Nodes[parent];
+        if ( p.last_child == SCENENODE_NONE )
+            p.first_child = id;
+        else
+            g_Nodes[p.last_child].next_sibling = id;
+        p.last_child = id;
+    }
+
+    if ( (size_t)id < g_FirstDirty )
+        g_FirstDirty = id;
+    return id;
+}
+
+void SceneGraph_SetLocal(SceneNodeId id, const glm::mat4& local)
+{
+    SceneNode& node = g_Nodes[id];
+    if ( node.local == local )
+        return;
+
+    node.local = local;
+    node.dirty = true;
+    if ( (size_t)id < g_FirstDirty )
+        g_FirstDirty = id;
+}
+
+const glm::mat4& SceneGraph_GetLocal(SceneNodeId id)
+{
+    return g_Nodes[id].local;
+}
+
+void SceneGraph_SetVisible(SceneNodeId id, bool visible)
+{
+    g_Nodes[id].visible = visible;
+}
+
+void SceneGraph_SetStaticIndex(SceneNodeId id, int static_index)
+{
+    g_Nodes[id].static_index = static_index;
+}
+
+void SceneGraph_Update()
+{
+    if ( g_FirstDirty >= g_Nodes.size() )
+        return;
+
+    // O pai vem antes do filho no vetor: quando um nó é visitado, a matriz
+    // "world" do pai já está atualizada, e "updated" indica se ela mudou.
+    for (size_t i = g_FirstDirty; i < g_Nodes.size(); ++i)
+    {
+        SceneNode& node = g_Nodes[i];
+        bool parent_updated = node.parent != SCENENODE_NONE && g_Nodes[node.parent].updated;
+        node.updated = node.dirty || parent_updated;
+        if ( !node.updated )
+            continue;
+
+        node.world = node.parent == SCENENODE_NONE ? node.local : g_Nodes[node.parent].world * node.local;
+        node.dirty = false;
+    }
+
+    // "updated" só é usado dentro da passada acima
+    for (size_t i = g_FirstDirty; i < g_Nodes.size(); ++i)
+        g_Nodes[i].updated = false;
+    g_FirstDirty = g_Nodes.size();
+}
+
+const glm::mat4& SceneGraph_GetWorld(SceneNodeId id)
+{
+    return g_Nodes[id].world;
+}
+
+void SceneGraph_Collect(SceneNodeId root, const uint8_t* static_visible, std::vector<SceneNodeDraw>* draws)
+{
+    g_CollectStack.clear();
+    g_CollectStack.push_back(root);
+    while ( !g_CollectStack.empty() )
+    {
+        SceneNodeId id = g_CollectStack.back();
+        g_CollectStack.pop_back();
+
+        const SceneNode& node = g_Nodes[id];
+        if ( !node.visible )
+            continue;
+        if ( node.static_index >= 0 && !Pvs_IsVisible(static_visible, node.static_index) )
+            continue;
+
+        if ( node.drawable != SCENE_NO_DRAWABLE )
+        {
+            SceneNodeDraw draw;
+            draw.node     = id;
+            draw.drawable = node.drawable;
+            draw.world    = &node.world;
+            draws->push_back(draw);
+        }
+
+        // Empilhados do último para o primeiro, para visitar na ordem de criação
+        size_t first = g_CollectStack.size();
+        for (SceneNodeId child = node.first_child; child != SCENENODE_NONE; child = g_Nodes[child].next_sibling)
+            g_CollectStack.push_back(child);
+        std::reverse(g_CollectStack.begin() + first, g_CollectStack.end());
+    }
+}
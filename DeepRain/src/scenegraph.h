@@ -0,0 +1,74 @@
+#ifndef _SCENEGRAPH_H
+#define _SCENEGRAPH_H
+
+// Grafo de cena: árvore de nós, cada um com uma transformação relativa ao
+// nó pai (matriz "local") e, opcionalmente, algo a ser desenhado.
+//
+// A matriz de modelagem de cada nó no espaço do mundo ("world", o produto
+// das matrizes locais desde a raiz) fica guardada, e só é recalculada
+// quando a matriz local do nó ou de algum ancestral muda. Assim, os objetos
+// que não se movem (o morro, as pedras, as árvores) não custam nenhuma
+// multiplicação de matrizes depois do primeiro quadro, e um objeto preso a
+// outro (por exemplo, a arma presa à câmera) acompanha o pai sem código
+// adicional.
+//
+// Os nós são guardados em um vetor, na ordem de criação. Como o pai de um
+// nó sempre é criado antes dele, SceneGraph_Update() recalcula as matrizes
+// em uma única passada pelo vetor, começando pelo primeiro nó alterado.
+//
+// O grafo não sabe desenhar: cada nó guarda apenas um número ("drawable")
+// que o código que percorre o grafo usa para escolher o que desenhar (veja
+// DrawSceneGraph() em "main.cpp").
+//
+// Todas as funções devem ser chamadas na thread do jogo (veja
+// "renderthread.h").
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+typedef int SceneNodeId;
+#define SCENENODE_NONE (-1)
+
+// Valor de "drawable" dos nós que só agrupam outros nós
+#define SCENE_NO_DRAWABLE (-1)
+
+// Nó a ser desenhado, retornado por SceneGraph_Collect()
+struct SceneNodeDraw
+{
+    SceneNodeId      node;
+    int              drawable;
+    const glm::mat4* world;  // Válido até a próxima alteração do grafo
+};
+
+// Cria um nó filho de "parent" (ou uma raiz, se SCENENODE_NONE), com a
+// matriz local identidade e visível.
+SceneNodeId SceneGraph_CreateNode(SceneNodeId parent, int drawable = SCENE_NO_DRAWABLE);
+
+// Altera a matriz local do nó. O nó e todos os seus descendentes terão a
+// matriz "world" recalculada na próxima chamada a SceneGraph_Update().
+void SceneGraph_SetLocal(SceneNodeId node, const glm::mat4& local);
+const glm::mat4& SceneGraph_GetLocal(SceneNodeId node);
+
+// Um nó invisível não é desenhado, nem os seus descendentes
+void SceneGraph_SetVisible(SceneNodeId node, bool visible);
+
+// Índice do nó no PVS dos objetos estáticos (veja "pvs.h"), ou -1 (padrão)
+// se o nó não faz parte do PVS
+void SceneGraph_SetStaticIndex(SceneNodeId node, int static_index);
+
+// Recalcula as matrizes "world" dos nós alterados desde a última chamada
+void SceneGraph_Update();
+
+// Matriz "world" do nó, calculada na última chamada a SceneGraph_Update()
+const glm::mat4& SceneGraph_GetWorld(SceneNodeId node);
+
+// Acrescenta a "draws", em profundidade a partir de "root", os nós visíveis
+// com algo a desenhar. Os nós com índice no PVS que não estão em
+// "static_visible" (retornado por Pvs_VisibleSet()) são ignorados; NULL
+// considera todos visíveis.
+void SceneGraph_Collect(SceneNodeId root, const uint8_t* static_visible, std::vector<SceneNodeDraw>* draws);
+
+#endif // _SCENEGRAPH_H
@@ -14,55 +14,72 @@ in vec4 position_model;
 // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
 in vec2 texcoords;
 
-// Matrizes computadas no cdigo C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-// Identificador que define qual objeto est sendo desenhado no momento
-#define SKYBOX1 0
-#define BUNNY  1
-#define PLANE  2
-#define MONSTER 3
-#define ROCK 4
-#define FLYMONSTER 5
-#define SPACESHIP 6
-#define MOUNT 7
-#define BULLETS 8
-#define HITBOX 9
-#define PIECE 10
-#define TREE 11
-#define BOSS 12
-#define GUN 13
-#define CAPSULE 14
-#define ASTRONAUT 15
-#define SKYBOX2 16
-
-uniform int object_id;
-
-// Parmetros da axis-aligned bounding box (AABB) do modelo
-uniform vec4 bbox_min;
-uniform vec4 bbox_max;
-
-// Variveis para acesso das imagens de textura
-uniform sampler2D TextureImage0; //MAP
-uniform sampler2D TextureImage1; //LIGHTS MAP
-uniform sampler2D TextureImage2; //MONSTER
-uniform sampler2D TextureImage3; //GRASS
-uniform sampler2D TextureImage4; //SKY
-uniform sampler2D TextureImage5; //ROCK
-uniform sampler2D TextureImage6; //FLYMONSTES
-uniform sampler2D TextureImage7; //SPACESHIP
-uniform sampler2D TextureImage8; //MOUNT
-uniform sampler2D TextureImage9; //BULLETS
-uniform sampler2D TextureImage10; //PIECE
-uniform sampler2D TextureImage11; //TREE
-uniform sampler2D TextureImage12; //BOSS BODY
-uniform sampler2D TextureImage13; //BOSS METAL
-uniform sampler2D TextureImage14; //GUN
-uniform sampler2D TextureImage15; //CAPSULE1
-uniform sampler2D TextureImage16; //ASTRONAUT
-uniform sampler2D TextureImage17; //UNIVERSE
+// Dados computados no cdigo C++ e enviados para a GPU em buffers de
+// variveis uniformes (veja "drawdata.h" e "shader_vertex.glsl")
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+};
+
+layout (std140) uniform DrawData
+{
+    mat4 model;
+    mat3 normal_matrix;
+    vec4 bbox_min;       // Parmetros da axis-aligned bounding box (AABB) do modelo
+    vec4 bbox_max;
+    int  object_id;      // Objeto sendo desenhado: posio na tabela de materiais
+};
+
+// Valores de "UV_MODE" e "LIGHTING" (MATERIAL_UV_* e MATERIAL_LIGHTING_* em
+// "drawdata.h")
+#define UV_TEXCOORDS 0
+#define UV_SPHERE    1
+#define UV_PLANAR_XY 2
+
+#define LIGHTING_LAMBERT   0
+#define LIGHTING_DAY_NIGHT 1
+#define LIGHTING_DETAIL    2
+#define LIGHTING_VERTEX    3
+
+// Classe de material deste programa. As duas definies so inseridas pelo
+// cdigo C++ logo depois de "#version", uma combinao por programa (veja
+// "shaderpermutation.h"); os valores abaixo s valem sem a insero.
+#ifndef UV_MODE
+#define UV_MODE UV_TEXCOORDS
+#endif
+#ifndef LIGHTING
+#define LIGHTING LIGHTING_LAMBERT
+#endif
+
+// Programas especiais da fila de renderizao (veja "renderqueue.h"), tambm
+// criados como permutaes: "DEPTH_ONLY" para o passo de profundidade, e
+// "OVERDRAW" para a visualizao de sobreposio de desenhos.
+
+// Tabela de materiais, indexada por "object_id" (veja MaterialRecord em
+// "drawdata.h")
+#define MAX_MATERIALS 32
+
+struct Material
+{
+    int   texture_array;
+    int   texture_layer;
+    int   detail_array;
+    int   detail_layer;
+    float uv_scale;
+    float alpha;
+};
+
+layout (std140) uniform MaterialData
+{
+    Material materials[MAX_MATERIALS];
+};
+
+// Arrays de texturas: o array i est na unidade de textura i. Veja
+// "texturearray.h".
+#define MAX_TEXTURE_ARRAYS 16
+uniform sampler2DArray TextureArrays[MAX_TEXTURE_ARRAYS];
 
 // O valor de sada ("out") de um Fragment Shader  a cor final do fragmento.
 out vec4 color;
@@ -71,12 +88,50 @@ out vec4 color;
 #define M_PI   3.14159265358979323846
 #define M_PI_2 1.57079632679489661923
 
+// L a camada "layer" do array de texturas "array". Em GLSL 3.30 um array de
+// samplers s pode ser indexado por uma constante, ento cada array tem o
+// seu caso; como o array  o mesmo em todo o desenho, s uma leitura  feita.
+vec3 SampleTexture(int array, int layer, vec2 uv)
+{
+    vec3 coords = vec3(uv, float(layer));
+    switch (array)
+    {
+        case 0:  return texture(TextureArrays[0],  coords).rgb;
+        case 1:  return texture(TextureArrays[1],  coords).rgb;
+        case 2:  return texture(TextureArrays[2],  coords).rgb;
+        case 3:  return texture(TextureArrays[3],  coords).rgb;
+        case 4:  return texture(TextureArrays[4],  coords).rgb;
+        case 5:  return texture(TextureArrays[5],  coords).rgb;
+        case 6:  return texture(TextureArrays[6],  coords).rgb;
+        case 7:  return texture(TextureArrays[7],  coords).rgb;
+        case 8:  return texture(TextureArrays[8],  coords).rgb;
+        case 9:  return texture(TextureArrays[9],  coords).rgb;
+        case 10: return texture(TextureArrays[10], coords).rgb;
+        case 11: return texture(TextureArrays[11], coords).rgb;
+        case 12: return texture(TextureArrays[12], coords).rgb;
+        case 13: return texture(TextureArrays[13], coords).rgb;
+        case 14: return texture(TextureArrays[14], coords).rgb;
+        case 15: return texture(TextureArrays[15], coords).rgb;
+    }
+
+    // Imagem ainda no carregada: cinza (128 em sRGB)
+    return vec3(0.2158);
+}
+
 void main()
 {
-    // Obtemos a posio da cmera utilizando a inversa da matriz que define o
-    // sistema de coordenadas da cmera.
-    vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-    vec4 camera_position = inverse(view) * origin;
+#if defined(DEPTH_ONLY)
+    // A cor no  escrita (glColorMask) no passo de profundidade
+    color = vec4(0.0);
+#elif defined(OVERDRAW)
+    // Somada ao pixel (mistura aditiva) por cada fragmento pintado
+    color = vec4(0.1, 0.05, 0.02, 1.0);
+#else
+    Material material = materials[object_id];
+
+    // A posio da cmera (a inversa da matriz que define o sistema de
+    // coordenadas da cmera aplicada  origem) vem calculada da CPU, no bloco
+    // "FrameData".
 
     // O fragmento atual  coberto por um ponto que percente  superfcie de um
     // dos objetos virtuais da cena. Este ponto, p, possui uma posio no
@@ -96,162 +151,37 @@ void main()
     // Half vector para clculo do termo de Blinn-Phong
     vec4 h = normalize(v+l);
 
-
-    // Vetor que define o sentido da reflexo especular ideal.
-    vec4 r = -l+2*n*(dot(n, l));
-
     // Coordenadas de textura U e V
-    float p_U = 0.0;
-    float p_V = 0.0;
-
-    // Parmetros que definem as propriedades espectrais da superfcie
-    vec3 Kd; // Refletncia difusa
-    vec3 Ks; // Refletncia especular
-    vec3 Ka; // Refletncia ambiente
-    float q; // Expoente especular para o modelo de iluminao de Phong
-
-    if ( object_id == SKYBOX1 || object_id == SKYBOX2 || object_id == BULLETS || object_id == HITBOX)
-    {
-        // PARA TEXTURA
-        vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
-        vec4 p_line = bbox_center + (position_model - bbox_center)/(length(position_model - bbox_center));
-        vec4 vecp = p_line - bbox_center;
-
-        p_U = (atan(vecp[0], vecp[2]) + M_PI)/(2*M_PI);
-        p_V = (asin(vecp[1]) + M_PI_2)/M_PI;
-    }
-    else if ( object_id == BUNNY)
-    {
-        Kd = vec3(0.008,0.4,0.8);
-        Ks = vec3(0.8,0.8,0.8);
-        Ka = vec3(0.004,0.2,0.4);
-        q = 32.0;
-
-        // PARA TEXTURA
-        float minx = bbox_min.x;
-        float maxx = bbox_max.x;
-
-        float miny = bbox_min.y;
-        float maxy = bbox_max.y;
-
-        float minz = bbox_min.z;
-        float maxz = bbox_max.z;
-
-        p_U = (position_model.x - minx)/(maxx - minx);
-        p_V = (position_model.y - miny)/(maxy - miny);
-
-    }
-    else if ( object_id == MONSTER    || object_id == ROCK      ||
-              object_id == FLYMONSTER || object_id == ASTRONAUT ||
-              object_id == MOUNT      || object_id == PIECE     ||
-              object_id == BOSS       || object_id == SPACESHIP ||
-              object_id == CAPSULE    || object_id == GUN)
-    {
-        // Coordenadas de textura da estatua, monstro ou pedra, obtidas dos arquivos OBJ.
-        p_U = texcoords.x;
-        p_V = texcoords.y;
-    }
-    else if ( object_id == PLANE )
-    {
-        // Coordenadas do plano, obtidas dos arquivos OBJ.
-        // multiplicao por 10 para forar as coordenadas a sairem do intervalo [0, 1]
-        // e serem repetidas pelo parmetro de texture wrapping GL_MIRRORED_REPEAT
-        p_U = texcoords.x * 10;
-        p_V = texcoords.y * 10;
-    }
-    else // Objeto desconhecido = preto
-    {
-        p_U = 0.0f;
-        p_V = 0.0f;
-    }
-
-    // Obtemos a refletncia difusa a partir da leitura da imagem TextureImage0
-    vec3 Kd0 = texture(TextureImage0, vec2(p_U, p_V)).rgb;
-    vec3 Kd1 = texture(TextureImage1, vec2(p_U, p_V)).rgb;
-    vec3 Kd2 = texture(TextureImage1, vec2(p_U, p_V)).rgb;
-
-    if (object_id == MONSTER)
-    {
-        Kd0 = texture(TextureImage2, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == PLANE)
-    {
-        Kd0 = texture(TextureImage3, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == SKYBOX1 || object_id == HITBOX)
-    {
-        Kd0 = texture(TextureImage4, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == ROCK)
-    {
-        Kd0 = texture(TextureImage5, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == FLYMONSTER)
-    {
-        Kd0 = texture(TextureImage6, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == SPACESHIP)
-    {
-        Kd0 = texture(TextureImage7, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == MOUNT)
-    {
-        Kd0 = texture(TextureImage8, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == BULLETS)
-    {
-        Kd0 = texture(TextureImage9, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == PIECE)
-    {
-        Kd0 = texture(TextureImage10, vec2(p_U, p_V)).rgb;
-    }
-    //else if (object_id == TREE)
-    //{
-    //    Kd0 = texture(TextureImage11, vec2(p_U, p_V)).rgb;
-    //}
-    else if (object_id == BOSS)
-    {
-        Kd0 = texture(TextureImage12, vec2(p_U, p_V)).rgb;
-        Kd1 = texture(TextureImage13, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == GUN)
-    {
-        Kd0 = texture(TextureImage14, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == CAPSULE)
-    {
-        Kd0 = texture(TextureImage15, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == ASTRONAUT)
-    {
-        Kd0 = texture(TextureImage16, vec2(p_U, p_V)).rgb;
-    }
-    else if (object_id == SKYBOX2)
-    {
-        Kd0 = texture(TextureImage17, vec2(p_U, p_V)).rgb;
-    }
+    vec2 uv;
+
+#if UV_MODE == UV_SPHERE
+    // Projeo esfrica (skybox, balas, hitboxes)
+    vec4 bbox_center = (bbox_min + bbox_max) / 2.0;
+    vec4 p_line = bbox_center + (position_model - bbox_center)/(length(position_model - bbox_center));
+    vec4 vecp = p_line - bbox_center;
+
+    uv.x = (atan(vecp[0], vecp[2]) + M_PI)/(2*M_PI);
+    uv.y = (asin(vecp[1]) + M_PI_2)/M_PI;
+#elif UV_MODE == UV_PLANAR_XY
+    // Projeo no plano XY da caixa do modelo (coelho)
+    uv.x = (position_model.x - bbox_min.x)/(bbox_max.x - bbox_min.x);
+    uv.y = (position_model.y - bbox_min.y)/(bbox_max.y - bbox_min.y);
+#else
+    // Coordenadas de textura obtidas dos arquivos OBJ. Com "uv_scale" maior
+    // que 1 (o plano), as coordenadas saem do intervalo [0, 1] e so
+    // repetidas pelo parmetro de texture wrapping GL_MIRRORED_REPEAT
+    uv = texcoords * material.uv_scale;
+#endif
 
     // Espectro da fonte de iluminao
     vec3 I = vec3(1.0, 1.0, 1.0);
 
-    // Espectro da luz ambiente
-    vec3 Ia = vec3(0.2, 0.2, 0.2);
-
-    // Termo ambiente
-    vec3 ambient_term = Ka*Ia;
-
     // Termo difuso utilizando a lei dos cossenos de Lambert
     // PARA ILUMINAO LOCAL
     // vec3 lambert_diffuse_term = Kd*I*max(0.0, dot(n,l));
     float lambert = max(0, dot(n, l));
     float invlambert = max(0, dot(-n, l));
 
-    // Termo especular utilizando o modelo de iluminao de Phong
-    // PARA ILUMINAO LOCAL
-    // vec3 phong_specular_term  = Ks*I*max(0.0, pow(dot(r, v), q));
-    vec3 blinn_phong_specular_term = Ks*I*max(0.0, pow(dot(n, h), q));
-
     // NOTE: Se voc quiser fazer o rendering de objetos transparentes, 
     // necessrio:
     // 1) Habilitar a operao de "blending" de OpenGL logo antes de realizar o
@@ -264,28 +194,36 @@ void main()
     //    suas distncias para a cmera (desenhando primeiro objetos
     //    transparentes que esto mais longe da cmera).
     // Alpha default = 1 = 100% opaco = 0% transparente
-    if (object_id == HITBOX)
-        color.a = 0;
-    else
-        color.a = 1;
+    color.a = material.alpha;
 
     // Cor final do fragmento calculada com uma combinao dos termos difuso,
     // especular, e ambiente. Veja slide 129 do documento Aula_17_e_18_Modelos_de_Iluminacao.pdf.
-    // PARA ILUMINAO LOCAL
-    // color.rgb = lambert_diffuse_term + ambient_term + phong_specular_term;
-    // PARA TEXTURA
-    if (object_id == BUNNY)
-        color.rgb = Kd0 * (lambert + 0.1) + Kd1 * (invlambert + 0.25) + blinn_phong_specular_term;
-    else if (object_id == BOSS)
-        color.rgb = (Kd0 + Kd1) * (lambert + 0.1);
-    else if (object_id == TREE)
-        color = color_v;
-    else
-        color.rgb = Kd0 * (lambert + 0.1);
+    // PARA TEXTURA: uma nica leitura da imagem difusa por fragmento; a
+    // segunda imagem s  lida pelos materiais que a utilizam.
+#if LIGHTING == LIGHTING_VERTEX
+    // Iluminao calculada por vrtice em "shader_vertex.glsl" (rvores)
+    color.rgb = color_v.rgb;
+#else
+    vec3 Kd0 = SampleTexture(material.texture_array, material.texture_layer, uv);
+
+#if LIGHTING == LIGHTING_DAY_NIGHT
+    // Luzes da cidade no lado escuro, e termo especular de Blinn-Phong
+    vec3 Kd1 = SampleTexture(material.detail_array, material.detail_layer, uv);
+    vec3 Ks = vec3(0.8,0.8,0.8); // Refletncia especular
+    float q = 32.0;              // Expoente especular
+    vec3 blinn_phong_specular_term = Ks*I*max(0.0, pow(dot(n, h), q));
+    color.rgb = Kd0 * (lambert + 0.1) + Kd1 * (invlambert + 0.25) + blinn_phong_specular_term;
+#elif LIGHTING == LIGHTING_DETAIL
+    vec3 Kd1 = SampleTexture(material.detail_array, material.detail_layer, uv);
+    color.rgb = (Kd0 + Kd1) * (lambert + 0.1);
+#else
+    color.rgb = Kd0 * (lambert + 0.1);
+#endif
+#endif
 
     // Cor final com correo gamma, considerando monitor sRGB.
     // Veja https://en.wikipedia.org/w/index.php?title=Gamma_correction&oldid=751281772#Windows.2C_Mac.2C_sRGB_and_TV.2Fvideo_standard_gammas
     color.rgb = pow(color.rgb, vec3(1.0,1.0,1.0)/2.2);
-
+#endif
 }
 
@@ -1,15 +1,69 @@
 #version 330 core
 
 // Atributos de vértice recebidos como entrada ("in") pelo Vertex Shader.
-// Veja a função BuildTrianglesAndAddToVirtualScene() em "main.cpp".
+// Veja a função AddMeshToVirtualScene() em "main.cpp" e a estrutura
+// PackedVertex em "meshcache.h": a posição é enviada com 3 floats (a GPU
+// completa w = 1), a normal com 10 bits por coeficiente e as coordenadas de
+// textura em meia precisão. A conversão para float é feita pela GPU.
 layout (location = 0) in vec4 model_coefficients;
 layout (location = 1) in vec4 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
 
-// Matrizes computadas no código C++ e enviadas para a GPU
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Matriz de modelagem de cada cópia nos desenhos instanciados (ocupa as
+// posições 3 a 6) e a sua matriz das normais (posições 7 a 9). Nos demais
+// desenhos os atributos não vêm de um buffer e valem a identidade. Veja
+// "instancing.h".
+layout (location = 3) in mat4 instance_model;
+layout (location = 7) in mat3 instance_normal;
+
+// Dados computados no código C++ e enviados para a GPU em buffers de
+// variáveis uniformes (veja "drawdata.h"). A matriz das normais é a inversa
+// da transposta de "model", calculada na CPU.
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec4 camera_position;
+};
+
+layout (std140) uniform DrawData
+{
+    mat4 model;
+    mat3 normal_matrix;
+    vec4 bbox_min;
+    vec4 bbox_max;
+    int  object_id;
+};
+
+// Tabela de materiais e classe de material do programa (veja
+// "shader_fragment.glsl"). Os materiais com iluminação por vértice (as
+// árvores) são calculados aqui.
+#define LIGHTING_LAMBERT 0
+#define LIGHTING_VERTEX  3
+#ifndef LIGHTING
+#define LIGHTING LIGHTING_LAMBERT
+#endif
+
+#define MAX_MATERIALS 32
+
+struct Material
+{
+    int   texture_array;
+    int   texture_layer;
+    int   detail_array;
+    int   detail_layer;
+    float uv_scale;
+    float alpha;
+};
+
+layout (std140) uniform MaterialData
+{
+    Material materials[MAX_MATERIALS];
+};
+
+// Arrays de texturas (veja "texturearray.h")
+#define MAX_TEXTURE_ARRAYS 16
+uniform sampler2DArray TextureArrays[MAX_TEXTURE_ARRAYS];
 
 // Atributos de vértice que serão gerados como saída ("out") pelo Vertex Shader.
 // ** Estes serão interpolados pelo rasterizador! ** gerando, assim, valores
@@ -21,10 +75,37 @@ out vec4 normal;
 out vec2 texcoords;
 out vec4 color_v;
 
-uniform int object_id;
-uniform sampler2D TextureImage11; //TREE
+// A posição deve ser calculada exatamente igual por todos os programas
+// compilados deste arquivo: o passo de profundidade e o passo opaco comparam
+// as profundidades com GL_LEQUAL (veja "renderqueue.h").
+invariant gl_Position;
 
-#define TREE 11
+// Lê a camada "layer" do array de texturas "array" (veja SampleTexture() em
+// "shader_fragment.glsl")
+vec3 SampleTexture(int array, int layer, vec2 uv)
+{
+    vec3 coords = vec3(uv, float(layer));
+    switch (array)
+    {
+        case 0:  return texture(TextureArrays[0],  coords).rgb;
+        case 1:  return texture(TextureArrays[1],  coords).rgb;
+        case 2:  return texture(TextureArrays[2],  coords).rgb;
+        case 3:  return texture(TextureArrays[3],  coords).rgb;
+        case 4:  return texture(TextureArrays[4],  coords).rgb;
+        case 5:  return texture(TextureArrays[5],  coords).rgb;
+        case 6:  return texture(TextureArrays[6],  coords).rgb;
+        case 7:  return texture(TextureArrays[7],  coords).rgb;
+        case 8:  return texture(TextureArrays[8],  coords).rgb;
+        case 9:  return texture(TextureArrays[9],  coords).rgb;
+        case 10: return texture(TextureArrays[10], coords).rgb;
+        case 11: return texture(TextureArrays[11], coords).rgb;
+        case 12: return texture(TextureArrays[12], coords).rgb;
+        case 13: return texture(TextureArrays[13], coords).rgb;
+        case 14: return texture(TextureArrays[14], coords).rgb;
+        case 15: return texture(TextureArrays[15], coords).rgb;
+    }
+    return vec3(0.2158);
+}
 
 void main()
 {
@@ -40,7 +121,11 @@ void main()
     // deste Vertex Shader, a placa de vídeo (GPU) fará a divisão por W. Veja
     // slides 41-67 e 69-86 do documento Aula_09_Projecoes.pdf.
 
-    gl_Position = projection * view * model * model_coefficients;
+    // Nos desenhos instanciados "model" é a identidade e a transformação de
+    // cada cópia vem de "instance_model"; nos demais, o contrário.
+    mat4 model_matrix = model * instance_model;
+
+    gl_Position = projection * view * model_matrix * model_coefficients;
 
     // Como as variáveis acima  (tipo vec4) são vetores com 4 coeficientes,
     // também é possível acessar e modificar cada coeficiente de maneira
@@ -57,23 +142,25 @@ void main()
     // rasterizador para gerar atributos únicos para cada fragmento gerado.
 
     // Posição do vértice atual no sistema de coordenadas global (World).
-    position_world = model * model_coefficients;
+    position_world = model_matrix * model_coefficients;
 
     // Posição do vértice atual no sistema de coordenadas local do modelo.
     position_model = model_coefficients;
 
     // Normal do vértice atual no sistema de coordenadas global (World).
     // Veja slides 123-151 do documento Aula_07_Transformacoes_Geometricas_3D.pdf.
-    normal = inverse(transpose(model)) * normal_coefficients;
-    normal.w = 0.0;
+    // O coeficiente w da normal compactada não é utilizado, então é
+    // descartado antes da multiplicação. A inversa da transposta de
+    // "model_matrix" é o produto das matrizes das normais de "model" e de
+    // "instance_model", ambas calculadas na CPU.
+    normal = vec4(normal_matrix * instance_normal * normal_coefficients.xyz, 0.0);
 
     // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
     texcoords = texture_coefficients;
 
-    if (object_id == TREE)
+#if LIGHTING == LIGHTING_VERTEX
+    Material material = materials[object_id];
     {
-        vec4 origin = vec4(0.0, 0.0, 0.0, 1.0);
-        vec4 camera_position = inverse(view) * origin;
         vec4 p = position_world;
         vec4 n = normalize(normal);
         vec4 l = normalize(vec4(0.0, 1.0, 0.5, 0.0));
@@ -84,7 +171,7 @@ void main()
         float p_U = texcoords.x;
         float p_V = texcoords.y;
 
-        vec3 Kd0 = texture(TextureImage11, vec2(p_U, p_V)).rgb;
+        vec3 Kd0 = SampleTexture(material.texture_array, material.texture_layer, vec2(p_U, p_V));
 
         vec3 I = vec3(1.0, 1.0, 1.0);
         vec3 Ia = vec3(0.2, 0.2, 0.2);
@@ -94,5 +181,5 @@ void main()
         color_v.a = 1;
         color_v.rgb = Kd0 * (lambert + 0.1);
     }
+#endif
 }
-
@@ -0,0 +1,242 @@
+#include "shaderpermutation.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+
+#include "geometryarena.h"
+
+GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
+
+struct ShaderPermutation
+{
+    std::string defines;
+    GLuint      program_id;
+    GLint       uniforms[SHADERUNIFORM_COUNT];
+};
+
+static std::vector<ShaderPermutation> g_Permutations;
+
+// Nomes das variáveis de ShaderUniform, na mesma ordem
+static const char* const g_UniformNames[SHADERUNIFORM_COUNT] = {
+    "TextureArrays",
+};
+
+ShaderPermutationId ShaderPermutation_Add(const std::string& defines)
+{
+    for (size_t i = 0; i < g_Permutations.size(); ++i)
+        if ( g_Permutations[i].defines == defines )
+            return (ShaderPermutationId)i;
+
+    ShaderPermutation permutation;
+    permutation.defines    = defines;
+    permutation.program_id = 0;
+    for (int u = 0; u < SHADERUNIFORM_COUNT; ++u)
+        permutation.uniforms[u] = -1;
+    g_Permutations.push_back(permutation);
+    return (ShaderPermutationId)g_Permutations.size() - 1;
+}
+
+static bool ReadFile(const char* filename, std::string* contents)
+{
+    std::ifstream file(filename);
+    if ( !file )
+    {
+        fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", filename);
+        return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    *contents = stream.str();
+    return true;
+}
+
+// Insere "defines" logo depois da linha "#version", que deve ser a primeira
+// diretiva do arquivo
+static std::string InjectDefines(const std::string& source, const std::string& defines)
+{
+    size_t version = source.find("#version");
+    if ( version == std::string::npos )
+        return defines + source;
+
+    size_t line_end = source.find('\n', version);
+    if ( line_end == std::string::npos )
+        return source + "\n" + defines;
+
+    return source.substr(0, line_end + 1) + defines + source.substr(line_end + 1);
+}
+
+// Compila um shader, imprimindo erros e avisos como LoadShader() em "main.cpp".
+// Retorna 0 se a compilação falhou.
+static GLuint CompileShader(GLenum type, const std::string& source, const char* filename, const std::string& defines)
+{
+    GLuint shader_id = glCreateShader(type);
+    const GLchar* shader_string = source.c_str();
+    const GLint   shader_string_length = (GLint)source.length();
+    glShaderSource(shader_id, 1, &shader_string, &shader_string_length);
+    glCompileShader(shader_id);
+
+    GLint compiled_ok;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
+
+    GLint log_length = 0;
+    glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
+    if ( log_length > 1 )
+    {
+        std::vector<GLchar> log(log_length);
+        glGetShaderInfoLog(shader_id, log_length, &log_length, log.data());
+
+        std::string output;
+        output += compiled_ok ? "WARNING: OpenGL compilation of \"" : "ERROR: OpenGL compilation of \"";
+        output += filename;
+        output += compiled_ok ? "\".\n" : "\" failed.\n";
+        output += "== Permutation:\n";
+        output += defines;
+        output += "== Start of compilation log\n";
+        output += log.data();
+        output += "== End of compilation log\n";
+        fprintf(stderr, "%s", output.c_str());
+    }
+
+    if ( !compiled_ok )
+    {
+        glDeleteShader(shader_id);
+        return 0;
+    }
+    return shader_id;
+}
+
+// Lista as variáveis uniformes ativas do programa e guarda as posições das
+// variáveis de ShaderUniform
+static void ReflectUniforms(ShaderPermutation* permutation)
+{
+    for (int u = 0; u < SHADERUNIFORM_COUNT; ++u)
+        permutation->uniforms[u] = -1;
+
+    GLint num_uniforms = 0;
+    GLint max_name_length = 0;
+    glGetProgramiv(permutation->program_id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+    glGetProgramiv(permutation->program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::vector<GLchar> name(max_name_length + 1);
+    for (GLint i = 0; i < num_uniforms; ++i)
+    {
+        GLsizei length = 0;
+        GLint   size = 0;
+        GLenum  type = 0;
+        glGetActiveUniform(permutation->program_id, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+        // Os arrays são listados como "nome[0]"
+        std::string uniform_name(name.data(), length);
+        size_t bracket = uniform_name.find('[');
+        if ( bracket != std::string::npos )
+            uniform_name.erase(bracket);
+
+        for (int u = 0; u < SHADERUNIFORM_COUNT; ++u)
+            if ( uniform_name == g_UniformNames[u] )
+                permutation->uniforms[u] = glGetUniformLocation(permutation->program_id, name.data());
+    }
+}
+
+bool ShaderPermutation_Build(const char* vertex_filename, const char* fragment_filename)
+{
+    std::string vertex_source;
+    std::string fragment_source;
+    if ( !ReadFile(vertex_filename, &vertex_source) || !ReadFile(fragment_filename, &fragment_source) )
+        return false;
+
+    double build_start = glfwGetTime();
+    bool all_ok = true;
+    for (size_t i = 0; i < g_Permutations.size(); ++i)
+    {
+        ShaderPermutation& permutation = g_Permutations[i];
+
+        GLuint vertex_shader_id = CompileShader(GL_VERTEX_SHADER, InjectDefines(vertex_source, permutation.defines), vertex_filename, permutation.defines);
+        GLuint fragment_shader_id = CompileShader(GL_FRAGMENT_SHADER, InjectDefines(fragment_source, permutation.defines), fragment_filename, permutation.defines);
+        if ( vertex_shader_id == 0 || fragment_shader_id == 0 )
+        {
+            if ( vertex_shader_id != 0 )
+                glDeleteShader(vertex_shader_id);
+            if ( fragment_shader_id != 0 )
+                glDeleteShader(fragment_shader_id);
+            all_ok = false;
+            continue;
+        }
+
+        GLuint program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+        GLint linked_ok = GL_FALSE;
+        glGetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+        if ( linked_ok == GL_FALSE )
+        {
+            glDeleteProgram(program_id);
+            all_ok = false;
+            continue;
+        }
+
+        if ( permutation.program_id != 0 )
+            glDeleteProgram(permutation.program_id);
+        permutation.program_id = program_id;
+        ReflectUniforms(&permutation);
+    }
+
+    printf("%d permutações de shaders compiladas em %.1f ms.\n", (int)g_Permutations.size(), 1000.0*(glfwGetTime() - build_start));
+    return all_ok;
+}
+
+void ShaderPermutation_Prewarm()
+{
+    double prewarm_start = glfwGetTime();
+
+    GeometryArena_Bind();
+    for (size_t i = 0; i < g_Permutations.size(); ++i)
+    {
+        if ( g_Permutations[i].program_id == 0 )
+            continue;
+
+        glUseProgram(g_Permutations[i].program_id);
+        for (int blend = 0; blend < 2; ++blend)
+        {
+            if ( blend )
+            {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            }
+            glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, (void*)0);
+            if ( blend )
+                glDisable(GL_BLEND);
+        }
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    // Esperamos a GPU (e o driver) terminarem os desenhos acima
+    glFinish();
+    printf("Permutações de shaders aquecidas em %.1f ms.\n", 1000.0*(glfwGetTime() - prewarm_start));
+}
+
+size_t ShaderPermutation_Count()
+{
+    return g_Permutations.size();
+}
+
+GLuint ShaderPermutation_Program(ShaderPermutationId id)
+{
+    return g_Permutations[id].program_id;
+}
+
+GLint ShaderPermutation_Uniform(ShaderPermutationId id, ShaderUniform uniform)
+{
+    return g_Permutations[id].uniforms[uniform];
+}
+
+void ShaderPermutation_Shutdown()
+{
+    for (size_t i = 0; i < g_Permutations.size(); ++i)
+        if ( g_Permutations[i].program_id != 0 )
+            glDeleteProgram(g_Permutations[i].program_id);
+    g_Permutations.clear();
+}
@@ -0,0 +1,67 @@
+#ifndef _SHADERPERMUTATION_H
+#define _SHADERPERMUTATION_H
+
+// Permutações de shaders: vários programas de GPU especializados, compilados
+// a partir dos mesmos arquivos "shader_vertex.glsl" e "shader_fragment.glsl".
+//
+// Cada permutação é um conjunto de linhas "#define NOME VALOR", inseridas
+// logo depois da linha "#version" dos dois arquivos. Os shaders escolhem o
+// código com "#if", então cada programa contém apenas o mapeamento de
+// coordenadas de textura e o modelo de iluminação da sua classe de material,
+// sem desvios (branches) em tempo de execução. Veja LoadShadersFromFiles()
+// em "main.cpp".
+//
+// Depois da linkagem, as variáveis uniformes ativas de cada programa são
+// listadas (glGetActiveUniform) uma única vez, e as posições das variáveis
+// usadas pelo código C++ (ShaderUniform) ficam guardadas: nenhuma chamada a
+// glGetUniformLocation() com strings é feita durante o jogo.
+//
+// Todas as permutações são compiladas de uma vez por ShaderPermutation_Build()
+// e "aquecidas" por ShaderPermutation_Prewarm(): muitos drivers só terminam a
+// compilação no primeiro desenho com o programa, o que causaria uma pausa no
+// meio do jogo na primeira vez em que um objeto de cada classe aparece.
+//
+// Todas as funções devem ser chamadas na thread de renderização (veja
+// "renderthread.h").
+
+#include <cstddef>
+#include <string>
+
+#include <glad/glad.h>
+
+typedef int ShaderPermutationId;
+
+// Variáveis uniformes (fora dos blocos de "drawdata.h") usadas pelo código C++
+enum ShaderUniform
+{
+    SHADERUNIFORM_TEXTURE_ARRAYS = 0, // "TextureArrays", veja "texturearray.h"
+    SHADERUNIFORM_COUNT
+};
+
+// Registra uma permutação com as linhas "#define" em "defines" e retorna o
+// seu identificador. Pedir de novo as mesmas definições retorna a mesma
+// permutação. O programa só é criado em ShaderPermutation_Build().
+ShaderPermutationId ShaderPermutation_Add(const std::string& defines);
+
+// Lê os dois arquivos e (re)compila todas as permutações registradas. Uma
+// permutação que não compila mantém o programa anterior, se existir.
+// Retorna false se alguma permutação falhou.
+bool ShaderPermutation_Build(const char* vertex_filename, const char* fragment_filename);
+
+// Desenha um triângulo com cada programa (no estado padrão e com mistura),
+// forçando o driver a terminar a compilação. Chamada depois da carga das
+// malhas, pois os desenhos utilizam a arena de geometria (veja
+// "geometryarena.h"), e antes do primeiro glClear() do quadro.
+void ShaderPermutation_Prewarm();
+
+size_t ShaderPermutation_Count();
+GLuint ShaderPermutation_Program(ShaderPermutationId id);
+
+// Posição de uma variável uniforme no programa da permutação, ou -1 se ela
+// não é utilizada pelo programa
+GLint ShaderPermutation_Uniform(ShaderPermutationId id, ShaderUniform uniform);
+
+// Destrói os programas. Chamada antes de destruir o contexto OpenGL.
+void ShaderPermutation_Shutdown();
+
+#endif // _SHADERPERMUTATION_H
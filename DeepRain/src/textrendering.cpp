@@ -1,6 +1,9 @@
 // Based on http://hamelot.io/visualization/opengl-text-without-any-external-libraries/
 //   and on https://github.com/rougier/freetype-gl
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -87,8 +90,70 @@ GLuint textVBO;
 GLuint textprogram_id;
 GLuint texttexture_id;
 
+// Os textos não são desenhados por TextRendering_PrintString(): os seus
+// quadriláteros (dois triângulos por caractere) são acumulados em
+// textvertices e desenhados todos juntos por TextRendering_Flush(), com
+// uma única configuração de estado e uma única chamada de desenho por quadro.
+//
+// Os textos são escritos pela thread do jogo e desenhados pela thread de
+// renderização (veja "renderthread.h"). TextRendering_SwapFrame(), chamada
+// com as duas threads sincronizadas, copia o quadro escrito para as
+// variáveis "textframe_*", que só TextRendering_Flush() lê.
+struct TextVertex
+{
+    float x, y, s, t;
+};
+std::vector<TextVertex> textvertices;
+size_t textVBO_capacity = 0; // Em vértices
+
+// Widgets do HUD: textos que mudam poucas vezes por segundo (balas, vidas,
+// tempo, ...). Cada widget possui uma faixa fixa do início de textVBO, com
+// espaço para "max_chars" caracteres, e só refaz os seus triângulos (e os
+// envia para a GPU) quando o valor mostrado, a posição ou o tamanho da
+// janela mudam. Os textos comuns (TextRendering_PrintString()) ficam depois
+// das faixas dos widgets.
+struct TextWidget
+{
+    size_t                  first;      // Primeiro vértice da faixa em textVBO
+    size_t                  max_chars;
+    std::vector<TextVertex> vertices;   // Cópia dos vértices na CPU
+    bool                    valid;      // Falso até o primeiro texto
+    bool                    dirty;      // Vértices ainda não enviados para a GPU
+    int                     value;
+    float                   x, y, scale;
+    int                     window_width, window_height;
+};
+std::vector<TextWidget> textwidgets;
+size_t textwidgets_vertices = 0;  // Tamanho das faixas de todos os widgets
+std::vector<int> textwidget_draws; // Widgets mostrados no quadro atual
+
+// Quadro entregue por TextRendering_SwapFrame()
+std::vector<TextVertex> textframe_vertices;         // Textos comuns
+std::vector<TextVertex> textframe_widget_vertices;  // Cópia das faixas de todos os widgets
+std::vector<std::pair<size_t, size_t> > textframe_uploads; // Faixas (primeiro, número de vértices) a enviar
+std::vector<GLint>   textdraw_firsts; // Argumentos de glMultiDrawArrays(),
+std::vector<GLsizei> textdraw_counts; // reutilizados entre os quadros
+
+// Tabela de acesso direto aos glifos, indexada pelo caractere. A fonte só
+// possui caracteres ASCII; os demais ficam com NULL e não são desenhados.
+#define TEXT_GLYPH_TABLE_SIZE 128
+const texture_glyph_t* textglyphs[TEXT_GLYPH_TABLE_SIZE];
+
+// Tamanho da janela, lido uma vez por quadro em TextRendering_BeginFrame()
+int textwindow_width = 0;
+int textwindow_height = 0;
+
 void TextRendering_Init()
 {
+    for (size_t i = 0; i < TEXT_GLYPH_TABLE_SIZE; ++i)
+        textglyphs[i] = NULL;
+    for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
+    {
+        uint32_t codepoint = dejavufont.glyphs[j].codepoint;
+        if ( codepoint < TEXT_GLYPH_TABLE_SIZE && textglyphs[codepoint] == NULL )
+            textglyphs[codepoint] = &dejavufont.glyphs[j];
+    }
+
     GLuint sampler;
 
     glGenBuffers(1, &textVBO);
@@ -127,7 +192,7 @@ void TextRendering_Init()
     glBindVertexArray(textVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_DYNAMIC_DRAW);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(0);
     glCheckError();
@@ -144,26 +209,26 @@ void TextRendering_Init()
 
 float textscale = 1.5f;
 
-void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+// Deve ser chamada no início de cada quadro, antes dos textos
+void TextRendering_BeginFrame(GLFWwindow* window)
+{
+    glfwGetWindowSize(window, &textwindow_width, &textwindow_height);
+    textvertices.clear();
+    textwidget_draws.clear();
+}
+
+// Adiciona os triângulos de "str" em "vertices"
+static void TextRendering_AppendString(std::vector<TextVertex>* vertices, const std::string &str, float x, float y, float scale)
 {
     scale *= textscale;
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    float sx = scale / width;
-    float sy = scale / height;
+    float sx = scale / textwindow_width;
+    float sy = scale / textwindow_height;
 
     for (size_t i = 0; i < str.size(); i++)
     {
         // Find the glyph for the character we are looking for
-        texture_glyph_t *glyph = 0;
-        for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
-        {
-            if (dejavufont.glyphs[j].codepoint == (uint32_t)str[i])
-            {
-                glyph = &dejavufont.glyphs[j];
-                break;
-            }
-        }
+        unsigned char c = (unsigned char)str[i];
+        const texture_glyph_t *glyph = c < TEXT_GLYPH_TABLE_SIZE ? textglyphs[c] : NULL;
         if (!glyph) {
             continue;
         }
@@ -178,7 +243,7 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
         float s1 = glyph->s1 - 0.5f/dejavufont.tex_width;
         float t1 = glyph->t1 - 0.5f/dejavufont.tex_height;
 
-        struct {float x, y, s, t;} data[6] = {
+        TextVertex data[6] = {
             { x0, y0, s0, t0 },
             { x0, y1, s0, t1 },
             { x1, y1, s1, t1 },
@@ -186,43 +251,188 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
             { x1, y1, s1, t1 },
             { x1, y0, s1, t0 }
         };
+        vertices->insert(vertices->end(), data, data + 6);
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        x += (glyph->advance_x * sx);
+    }
+}
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_ALWAYS);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 24 * sizeof(float), data);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+{
+    if ( textwindow_width == 0 || textwindow_height == 0 )
+        glfwGetWindowSize(window, &textwindow_width, &textwindow_height);
 
-        glUseProgram(textprogram_id);
-        glBindVertexArray(textVAO);
+    TextRendering_AppendString(&textvertices, str, x, y, scale);
+}
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+// Cria um widget com espaço para "max_chars" caracteres e retorna o seu
+// identificador
+int TextRendering_CreateWidget(size_t max_chars)
+{
+    TextWidget widget;
+    widget.first         = textwidgets_vertices;
+    widget.max_chars     = max_chars;
+    widget.valid         = false;
+    widget.dirty         = false;
+    widget.value         = 0;
+    widget.x             = 0.0f;
+    widget.y             = 0.0f;
+    widget.scale         = 0.0f;
+    widget.window_width  = 0;
+    widget.window_height = 0;
+    textwidgets.push_back(widget);
+
+    textwidgets_vertices += 6 * max_chars;
+    return (int)textwidgets.size() - 1;
+}
+
+// Mostra o widget no quadro atual, com o valor "value" na posição (x,y).
+// Retorna true se o texto precisa ser refeito (primeiro uso, ou valor,
+// posição ou tamanho da janela diferentes); nesse caso, chame
+// TextRendering_SetWidgetText() em seguida. Caso contrário, os triângulos
+// do quadro anterior são reutilizados, sem formatar o texto de novo.
+bool TextRendering_UpdateWidget(GLFWwindow* window, int widget_id, int value, float x, float y, float scale = 1.0f)
+{
+    if ( textwindow_width == 0 || textwindow_height == 0 )
+        glfwGetWindowSize(window, &textwindow_width, &textwindow_height);
+
+    textwidget_draws.push_back(widget_id);
+
+    TextWidget& widget = textwidgets[widget_id];
+    if ( widget.valid
+      && widget.value == value
+      && widget.x == x && widget.y == y && widget.scale == scale
+      && widget.window_width == textwindow_width
+      && widget.window_height == textwindow_height )
+        return false;
+
+    widget.valid         = true;
+    widget.value         = value;
+    widget.x             = x;
+    widget.y             = y;
+    widget.scale         = scale;
+    widget.window_width  = textwindow_width;
+    widget.window_height = textwindow_height;
+    return true;
+}
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDepthFunc(GL_LESS);
+// Refaz os triângulos do widget com o texto "str", na posição definida pela
+// última chamada a TextRendering_UpdateWidget(). Caracteres além de
+// "max_chars" são descartados.
+void TextRendering_SetWidgetText(int widget_id, const std::string &str)
+{
+    TextWidget& widget = textwidgets[widget_id];
+    widget.vertices.clear();
+    TextRendering_AppendString(&widget.vertices, str, widget.x, widget.y, widget.scale);
+    if ( widget.vertices.size() > 6 * widget.max_chars )
+        widget.vertices.resize(6 * widget.max_chars);
+    widget.dirty = true;
+}
 
-        glDisable(GL_BLEND);
+// Entrega os textos escritos desde TextRendering_BeginFrame() e os widgets
+// mostrados no quadro para TextRendering_Flush(). Chamada uma vez por
+// quadro, depois de todos os textos.
+void TextRendering_SwapFrame()
+{
+    textframe_vertices.swap(textvertices);
+    textvertices.clear();
 
-        x += (glyph->advance_x * sx);
+    // Somente os widgets que mudaram são copiados (e enviados)
+    textframe_widget_vertices.resize(textwidgets_vertices);
+    for (size_t i = 0; i < textwidgets.size(); ++i)
+    {
+        TextWidget& widget = textwidgets[i];
+        if ( !widget.dirty )
+            continue;
+        std::copy(widget.vertices.begin(), widget.vertices.end(), textframe_widget_vertices.begin() + widget.first);
+        if ( !widget.vertices.empty() )
+            textframe_uploads.push_back(std::make_pair(widget.first, widget.vertices.size()));
+        widget.dirty = false;
     }
+
+    // Uma faixa de vértices por widget mostrado, mais a dos textos comuns,
+    // desenhadas com uma única chamada
+    textdraw_firsts.clear();
+    textdraw_counts.clear();
+    for (size_t i = 0; i < textwidget_draws.size(); ++i)
+    {
+        const TextWidget& widget = textwidgets[textwidget_draws[i]];
+        if ( widget.vertices.empty() )
+            continue;
+        textdraw_firsts.push_back((GLint)widget.first);
+        textdraw_counts.push_back((GLsizei)widget.vertices.size());
+    }
+    if ( !textframe_vertices.empty() )
+    {
+        textdraw_firsts.push_back((GLint)textframe_widget_vertices.size());
+        textdraw_counts.push_back((GLsizei)textframe_vertices.size());
+    }
+    textwidget_draws.clear();
+}
+
+// Desenha os textos entregues por TextRendering_SwapFrame()
+void TextRendering_Flush()
+{
+    if ( textdraw_firsts.empty() )
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
+
+    // Se o buffer precisa crescer, ele é recriado e todos os widgets são
+    // enviados de novo
+    size_t widgets_size = textframe_widget_vertices.size();
+    size_t required = widgets_size + textframe_vertices.size();
+    if ( required > textVBO_capacity )
+    {
+        textVBO_capacity = std::max(required, 2 * textVBO_capacity);
+        glBufferData(GL_ARRAY_BUFFER, textVBO_capacity * sizeof(TextVertex), NULL, GL_DYNAMIC_DRAW);
+        textframe_uploads.clear();
+        if ( widgets_size > 0 )
+            textframe_uploads.push_back(std::make_pair((size_t)0, widgets_size));
+    }
+
+    for (size_t i = 0; i < textframe_uploads.size(); ++i)
+    {
+        size_t first = textframe_uploads[i].first;
+        size_t count = textframe_uploads[i].second;
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(TextVertex), count * sizeof(TextVertex), &textframe_widget_vertices[first]);
+    }
+    textframe_uploads.clear();
+
+    if ( !textframe_vertices.empty() )
+        glBufferSubData(GL_ARRAY_BUFFER, widgets_size * sizeof(TextVertex), textframe_vertices.size() * sizeof(TextVertex), textframe_vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDepthFunc(GL_ALWAYS);
+
+    glUseProgram(textprogram_id);
+    glBindVertexArray(textVAO);
+
+    glMultiDrawArrays(GL_TRIANGLES, textdraw_firsts.data(), textdraw_counts.data(), (GLsizei)textdraw_firsts.size());
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDepthFunc(GL_LESS);
+
+    glDisable(GL_BLEND);
 }
 
 float TextRendering_LineHeight(GLFWwindow* window)
 {
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    return dejavufont.height / height * textscale;
+    if ( textwindow_height == 0 )
+        glfwGetWindowSize(window, &textwindow_width, &textwindow_height);
+    return dejavufont.height / textwindow_height * textscale;
 }
 
 float TextRendering_CharWidth(GLFWwindow* window)
 {
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    return dejavufont.glyphs[32].advance_x / width * textscale;
+    if ( textwindow_width == 0 )
+        glfwGetWindowSize(window, &textwindow_width, &textwindow_height);
+    return dejavufont.glyphs[32].advance_x / textwindow_width * textscale;
 }
 
 void TextRendering_PrintMatrix(GLFWwindow* window, glm::mat4 M, float x, float y, float scale = 1.0f)
@@ -0,0 +1,203 @@
+#include "texturearray.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "texturecook.h"
+
+struct TextureArray
+{
+    GLuint           texture_id;
+    GLenum           internal_format;
+    int              width;
+    int              height;
+    int              num_levels;
+    int              capacity;     // Camadas alocadas na GPU
+    int              num_layers;   // Camadas já entregues por TextureArray_Add()
+};
+
+static std::vector<TextureArray> g_Arrays;
+
+// Os únicos formatos comprimidos utilizados são os BC1 de "texturecook.h"
+static bool IsCompressed(GLenum internal_format)
+{
+    return internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+        || internal_format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+}
+
+static int LevelWidth(const TextureArray& array, int level)
+{
+    return std::max(1, array.width >> level);
+}
+
+static int LevelHeight(const TextureArray& array, int level)
+{
+    return std::max(1, array.height >> level);
+}
+
+// Bytes de uma camada em um nível. As imagens sem compressão são lidas e
+// enviadas como GL_RGBA/GL_UNSIGNED_BYTE; em BC1 cada bloco de 4x4 pixels
+// ocupa 8 bytes.
+static size_t LevelLayerBytes(const TextureArray& array, int level)
+{
+    size_t width  = (size_t)LevelWidth(array, level);
+    size_t height = (size_t)LevelHeight(array, level);
+    if ( IsCompressed(array.internal_format) )
+        return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+    return width * height * 4;
+}
+
+// Cria a textura do array, com "capacity" camadas vazias, e a liga à sua
+// unidade de textura
+static void CreateStorage(TextureArray* array, int index, int capacity)
+{
+    glGenTextures(1, &array->texture_id);
+    glActiveTexture(GL_TEXTURE0 + index);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->texture_id);
+
+    for (int level = 0; level < array->num_levels; ++level)
+    {
+        int width  = LevelWidth(*array, level);
+        int height = LevelHeight(*array, level);
+        if ( IsCompressed(array->internal_format) )
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array->internal_format, width, height, capacity, 0, (GLsizei)(LevelLayerBytes(*array, level) * capacity), NULL);
+        else
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, array->internal_format, width, height, capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    // Veja slides 95-96 do documento Aula_20_Mapeamento_de_Texturas.pdf
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array->num_levels - 1);
+
+    array->capacity = capacity;
+}
+
+// Recria o array com o dobro de camadas, copiando o conteúdo pela CPU
+static void Grow(TextureArray* array, int index)
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    std::vector< std::vector<unsigned char> > levels(array->num_levels);
+    glActiveTexture(GL_TEXTURE0 + index);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->texture_id);
+    for (int level = 0; level < array->num_levels; ++level)
+    {
+        levels[level].resize(LevelLayerBytes(*array, level) * array->capacity);
+        if ( IsCompressed(array->internal_format) )
+            glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, level, levels[level].data());
+        else
+            glGetTexImage(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data());
+    }
+
+    GLuint old_texture_id = array->texture_id;
+    int old_capacity = array->capacity;
+    CreateStorage(array, index, 2 * old_capacity);
+    glDeleteTextures(1, &old_texture_id);
+
+    for (int level = 0; level < array->num_levels; ++level)
+    {
+        int width  = LevelWidth(*array, level);
+        int height = LevelHeight(*array, level);
+        if ( IsCompressed(array->internal_format) )
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, old_capacity, array->internal_format, (GLsizei)levels[level].size(), levels[level].data());
+        else
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, old_capacity, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data());
+    }
+
+    printf("Array de texturas %d (%dx%d) aumentado para %d camadas.\n", index, array->width, array->height, array->capacity);
+}
+
+TextureLayer TextureArray_Add(GLenum internal_format, int width, int height, int num_levels)
+{
+    TextureLayer texture;
+    texture.array = -1;
+    texture.layer = 0;
+
+    for (size_t i = 0; i < g_Arrays.size(); ++i)
+    {
+        const TextureArray& array = g_Arrays[i];
+        if ( array.internal_format == internal_format && array.width == width && array.height == height && array.num_levels == num_levels )
+        {
+            texture.array = (int)i;
+            break;
+        }
+    }
+
+    if ( texture.array < 0 )
+    {
+        if ( g_Arrays.size() >= TEXTUREARRAY_MAX_ARRAYS )
+        {
+            fprintf(stderr, "ERROR: Too many different texture sizes and formats (at most %d); %dx%d texture not loaded.\n", TEXTUREARRAY_MAX_ARRAYS, width, height);
+            return texture;
+        }
+
+        TextureArray array;
+        array.texture_id      = 0;
+        array.internal_format = internal_format;
+        array.width           = width;
+        array.height          = height;
+        array.num_levels      = num_levels;
+        array.capacity        = 0;
+        array.num_layers      = 0;
+        texture.array = (int)g_Arrays.size();
+        CreateStorage(&array, texture.array, TEXTUREARRAY_INITIAL_LAYERS);
+        g_Arrays.push_back(array);
+    }
+
+    TextureArray& array = g_Arrays[texture.array];
+    if ( array.num_layers == array.capacity )
+        Grow(&array, texture.array);
+    texture.layer = array.num_layers++;
+    return texture;
+}
+
+void TextureArray_SetLevel(const TextureLayer& texture, int level, int width, int height, GLenum format, GLenum type, const void* pixels)
+{
+    glActiveTexture(GL_TEXTURE0 + texture.array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, g_Arrays[texture.array].texture_id);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, texture.layer, width, height, 1, format, type, pixels);
+}
+
+void TextureArray_SetCompressedLevel(const TextureLayer& texture, int level, int width, int height, GLsizei size, const void* data)
+{
+    const TextureArray& array = g_Arrays[texture.array];
+    glActiveTexture(GL_TEXTURE0 + texture.array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture_id);
+    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, texture.layer, width, height, 1, array.internal_format, size, data);
+}
+
+void TextureArray_GenerateMipmaps(const TextureLayer& texture)
+{
+    glActiveTexture(GL_TEXTURE0 + texture.array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, g_Arrays[texture.array].texture_id);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+size_t TextureArray_NumArrays()
+{
+    return g_Arrays.size();
+}
+
+size_t TextureArray_GpuBytes()
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < g_Arrays.size(); ++i)
+        for (int level = 0; level < g_Arrays[i].num_levels; ++level)
+            bytes += LevelLayerBytes(g_Arrays[i], level) * g_Arrays[i].capacity;
+    return bytes;
+}
+
+void TextureArray_Shutdown()
+{
+    for (size_t i = 0; i < g_Arrays.size(); ++i)
+        glDeleteTextures(1, &g_Arrays[i].texture_id);
+    g_Arrays.clear();
+}
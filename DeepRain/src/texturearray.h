@@ -0,0 +1,61 @@
+#ifndef _TEXTUREARRAY_H
+#define _TEXTUREARRAY_H
+
+// Arrays de texturas (GL_TEXTURE_2D_ARRAY, OpenGL 3.0): as imagens com o
+// mesmo formato, tamanho e número de níveis de mipmap são guardadas como
+// camadas (layers) de uma mesma textura, em vez de uma textura por imagem.
+//
+// O array i fica sempre ligado à unidade de textura i, e os shaders escolhem
+// a imagem pelo par (array, camada) lido da tabela de materiais (veja
+// "drawdata.h" e "shader_fragment.glsl"). Assim o número de imagens não é
+// limitado pelo número de unidades de textura, e sim o número de combinações
+// diferentes de formato e tamanho (TEXTUREARRAY_MAX_ARRAYS).
+//
+// Cada array começa com TEXTUREARRAY_INITIAL_LAYERS camadas. Quando ele
+// fica cheio, é recriado com o dobro de camadas; como o OpenGL 3.3 não tem
+// glCopyImageSubData(), o conteúdo antigo passa pela CPU (glGetTexImage()).
+// As camadas só são liberadas junto com o array, em TextureArray_Shutdown().
+//
+// Todas as funções devem ser chamadas na thread com o contexto OpenGL: a
+// thread principal durante a carga e a thread de renderização durante o
+// jogo (veja "renderthread.h").
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// Número de arrays, e de unidades de textura (0 a TEXTUREARRAY_MAX_ARRAYS-1)
+// ocupadas por eles. Deve ser igual ao tamanho de "TextureArrays" nos shaders.
+#define TEXTUREARRAY_MAX_ARRAYS 16
+
+#define TEXTUREARRAY_INITIAL_LAYERS 4
+
+// Imagem dentro de um array
+struct TextureLayer
+{
+    int array;  // Posição do array, que também é a sua unidade de textura
+    int layer;
+};
+
+// Reserva uma camada em um array com o formato e o tamanho pedidos (criando
+// o array, se necessário). Retorna array = -1 (e imprime o erro) se todos os
+// TEXTUREARRAY_MAX_ARRAYS arrays já estão ocupados com outros formatos.
+TextureLayer TextureArray_Add(GLenum internal_format, int width, int height, int num_levels);
+
+// Envia um nível de mipmap de uma camada, como glTexSubImage3D() e
+// glCompressedTexSubImage3D()
+void TextureArray_SetLevel(const TextureLayer& texture, int level, int width, int height, GLenum format, GLenum type, const void* pixels);
+void TextureArray_SetCompressedLevel(const TextureLayer& texture, int level, int width, int height, GLsizei size, const void* data);
+
+// Gera os níveis de mipmap a partir do nível 0. O OpenGL gera os mipmaps de
+// todas as camadas do array, não apenas os da camada pedida.
+void TextureArray_GenerateMipmaps(const TextureLayer& texture);
+
+// Número de arrays criados e memória de vídeo ocupada por eles (estimada)
+size_t TextureArray_NumArrays();
+size_t TextureArray_GpuBytes();
+
+// Destrói os arrays. Chamada antes de destruir o contexto OpenGL.
+void TextureArray_Shutdown();
+
+#endif // _TEXTUREARRAY_H
@@ -0,0 +1,519 @@
+#include "texturecook.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+// Identificador no início de todo arquivo KTX 1.1
+static const unsigned char ktx_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// Chave gravada nos metadados do KTX com o tamanho e a data de modificação da
+// imagem original, para detectarmos arquivos cozidos desatualizados.
+static const char ktx_source_key[] = "DeepRain.source";
+
+struct KTXHeader
+{
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t number_of_array_elements;
+    uint32_t number_of_faces;
+    uint32_t number_of_mipmap_levels;
+    uint32_t bytes_of_key_value_data;
+};
+
+static uint32_t AlignTo4(uint32_t size)
+{
+    return (size + 3) & ~(uint32_t)3;
+}
+
+// Valor gravado na chave ktx_source_key
+static bool SourceStamp(const char* source_filename, std::string* stamp)
+{
+    struct stat st;
+    if ( stat(source_filename, &st) != 0 )
+        return false;
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%lld %lld", (long long)st.st_size, (long long)st.st_mtime);
+    *stamp = buffer;
+    return true;
+}
+
+std::string TextureCook_Filename(const char* source_filename)
+{
+    return std::string(source_filename) + ".ktx";
+}
+
+bool TextureCook_IsSupported()
+{
+    // Os formatos sRGB de S3TC vêm de EXT_texture_sRGB; drivers mais recentes
+    // os anunciam separadamente em EXT_texture_compression_s3tc_srgb.
+    return glfwExtensionSupported("GL_EXT_texture_compression_s3tc")
+        && ( glfwExtensionSupported("GL_EXT_texture_sRGB")
+          || glfwExtensionSupported("GL_EXT_texture_compression_s3tc_srgb") );
+}
+
+// ---------------------------------------------------------------------------
+// Geração dos mipmaps
+
+// Conversões entre sRGB (como as imagens são gravadas) e intensidade linear.
+// A média de pixels para os mipmaps deve ser feita no espaço linear, como faz
+// glGenerateMipmap() em texturas GL_SRGB8.
+static float SRGBToLinear(float c)
+{
+    return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static unsigned char LinearToSRGB8(float c)
+{
+    c = std::max(0.0f, std::min(1.0f, c));
+    float s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)(s * 255.0f + 0.5f);
+}
+
+// Reduz uma imagem linear (3 floats por pixel) pela metade em cada dimensão,
+// calculando a média de cada bloco de 2x2 pixels.
+static void Downsample(const std::vector<float>& src, int width, int height, std::vector<float>* dst, int* out_width, int* out_height)
+{
+    const int w = std::max(1, width / 2);
+    const int h = std::max(1, height / 2);
+    dst->assign(3 * w * h, 0.0f);
+
+    for (int y = 0; y < h; ++y)
+    {
+        const int y0 = std::min(2*y, height - 1);
+        const int y1 = std::min(2*y + 1, height - 1);
+        for (int x = 0; x < w; ++x)
+        {
+            const int x0 = std::min(2*x, width - 1);
+            const int x1 = std::min(2*x + 1, width - 1);
+            for (int c = 0; c < 3; ++c)
+            {
+                float sum = src[3*(y0*width + x0) + c] + src[3*(y0*width + x1) + c]
+                          + src[3*(y1*width + x0) + c] + src[3*(y1*width + x1) + c];
+                (*dst)[3*(y*w + x) + c] = 0.25f * sum;
+            }
+        }
+    }
+
+    *out_width  = w;
+    *out_height = h;
+}
+
+// ---------------------------------------------------------------------------
+// Compressão BC1
+//
+// Cada bloco de 4x4 pixels é representado por duas cores de 16 bits (RGB 565)
+// e um índice de 2 bits por pixel, escolhendo entre as duas cores e duas
+// interpolações entre elas: 8 bytes por bloco.
+
+static uint16_t PackRGB565(const float c[3])
+{
+    int r = (int)(std::max(0.0f, std::min(255.0f, c[0])) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::max(0.0f, std::min(255.0f, c[1])) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::max(0.0f, std::min(255.0f, c[2])) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(uint16_t packed, float c[3])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    c[0] = (float)((r << 3) | (r >> 2));
+    c[1] = (float)((g << 2) | (g >> 4));
+    c[2] = (float)((b << 3) | (b >> 2));
+}
+
+// Escolhe, para cada pixel, a cor mais próxima da paleta. Retorna o erro total.
+static float AssignIndices(const float pixels[16][3], const float palette[4][3], int indices[16])
+{
+    float total = 0.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float best = 1e30f;
+        for (int p = 0; p < 4; ++p)
+        {
+            float dr = pixels[i][0] - palette[p][0];
+            float dg = pixels[i][1] - palette[p][1];
+            float db = pixels[i][2] - palette[p][2];
+            float d = dr*dr + dg*dg + db*db;
+            if ( d < best )
+            {
+                best = d;
+                indices[i] = p;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+static void MakePalette(const float e0[3], const float e1[3], float palette[4][3])
+{
+    for (int c = 0; c < 3; ++c)
+    {
+        palette[0][c] = e0[c];
+        palette[1][c] = e1[c];
+        palette[2][c] = (2.0f*e0[c] + e1[c]) / 3.0f;
+        palette[3][c] = (e0[c] + 2.0f*e1[c]) / 3.0f;
+    }
+}
+
+static void CompressBlockBC1(const float pixels[16][3], unsigned char out[8])
+{
+    // Direção de maior variação das cores (eixo principal), por iteração de
+    // potência sobre a matriz de covariância.
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c)
+            mean[c] += pixels[i][c] / 16.0f;
+
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; ++i)
+    {
+        float r = pixels[i][0] - mean[0];
+        float g = pixels[i][1] - mean[1];
+        float b = pixels[i][2] - mean[2];
+        cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+        cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+    }
+
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+        float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+        float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+        float m = std::max(fabsf(x), std::max(fabsf(y), fabsf(z)));
+        if ( m <= 0.0f )
+            break;
+        axis[0] = x / m;
+        axis[1] = y / m;
+        axis[2] = z / m;
+    }
+
+    // Os extremos da projeção das cores no eixo são as cores iniciais
+    float min_t = 1e30f, max_t = -1e30f;
+    int min_i = 0, max_i = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        float t = pixels[i][0]*axis[0] + pixels[i][1]*axis[1] + pixels[i][2]*axis[2];
+        if ( t < min_t ) { min_t = t; min_i = i; }
+        if ( t > max_t ) { max_t = t; max_i = i; }
+    }
+
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        e0[c] = pixels[max_i][c];
+        e1[c] = pixels[min_i][c];
+    }
+
+    // Refinamos as cores com mínimos quadrados: dados os índices, as cores
+    // que minimizam o erro são a solução de um sistema 2x2.
+    float palette[4][3];
+    int indices[16];
+    for (int iteration = 0; iteration < 2; ++iteration)
+    {
+        MakePalette(e0, e1, palette);
+        AssignIndices(pixels, palette, indices);
+
+        static const float weight0[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[3] = { 0.0f, 0.0f, 0.0f };
+        float bx[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; ++i)
+        {
+            float a = weight0[indices[i]];
+            float b = 1.0f - a;
+            aa += a*a; ab += a*b; bb += b*b;
+            for (int c = 0; c < 3; ++c)
+            {
+                ax[c] += a * pixels[i][c];
+                bx[c] += b * pixels[i][c];
+            }
+        }
+
+        float det = aa*bb - ab*ab;
+        if ( fabsf(det) < 1e-6f )
+            break;
+        for (int c = 0; c < 3; ++c)
+        {
+            e0[c] = std::max(0.0f, std::min(255.0f, (ax[c]*bb - bx[c]*ab) / det));
+            e1[c] = std::max(0.0f, std::min(255.0f, (bx[c]*aa - ax[c]*ab) / det));
+        }
+    }
+
+    // Quantizamos as cores e escolhemos os índices com a paleta que a GPU
+    // realmente vai reconstruir.
+    uint16_t c0 = PackRGB565(e0);
+    uint16_t c1 = PackRGB565(e1);
+
+    // Com c0 > c1 o bloco usa 4 cores; com c0 <= c1, somente 3 (modo com
+    // transparência), que não queremos.
+    if ( c0 < c1 )
+        std::swap(c0, c1);
+
+    uint32_t bits = 0;
+    if ( c0 != c1 )
+    {
+        float q0[3], q1[3];
+        UnpackRGB565(c0, q0);
+        UnpackRGB565(c1, q1);
+        MakePalette(q0, q1, palette);
+        AssignIndices(pixels, palette, indices);
+
+        for (int i = 0; i < 16; ++i)
+            bits |= (uint32_t)indices[i] << (2*i);
+    }
+
+    out[0] = (unsigned char)(c0 & 0xff);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xff);
+    out[3] = (unsigned char)(c1 >> 8);
+    out[4] = (unsigned char)(bits & 0xff);
+    out[5] = (unsigned char)((bits >> 8) & 0xff);
+    out[6] = (unsigned char)((bits >> 16) & 0xff);
+    out[7] = (unsigned char)(bits >> 24);
+}
+
+// Comprime uma imagem RGB de 8 bits. Blocos na borda de imagens cujas
+// dimensões não são múltiplas de 4 repetem os últimos pixels.
+static void CompressImageBC1(const std::vector<unsigned char>& rgb, int width, int height, std::vector<unsigned char>* out)
+{
+    const int blocks_x = (width + 3) / 4;
+    const int blocks_y = (height + 3) / 4;
+    out->resize(8 * blocks_x * blocks_y);
+
+    for (int by = 0; by < blocks_y; ++by)
+    {
+        for (int bx = 0; bx < blocks_x; ++bx)
+        {
+            float pixels[16][3];
+            for (int y = 0; y < 4; ++y)
+            {
+                const int py = std::min(4*by + y, height - 1);
+                for (int x = 0; x < 4; ++x)
+                {
+                    const int px = std::min(4*bx + x, width - 1);
+                    for (int c = 0; c < 3; ++c)
+                        pixels[4*y + x][c] = rgb[3*(py*width + px) + c];
+                }
+            }
+            CompressBlockBC1(pixels, &(*out)[8 * (by*blocks_x + bx)]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+bool TextureCook_CookFile(const char* source_filename, const char* ktx_filename)
+{
+    std::string stamp;
+    if ( !SourceStamp(source_filename, &stamp) )
+    {
+        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", source_filename);
+        return false;
+    }
+
+    int width, height, channels;
+    unsigned char* data = stbi_load(source_filename, &width, &height, &channels, 3);
+    if ( data == NULL )
+    {
+        fprintf(stderr, "ERROR: Cannot open image file \"%s\".\n", source_filename);
+        return false;
+    }
+
+    std::vector<float> linear(3 * width * height);
+    for (size_t i = 0; i < linear.size(); ++i)
+        linear[i] = SRGBToLinear(data[i] / 255.0f);
+
+    // Nível 0: comprimimos diretamente os pixels originais
+    std::vector<std::vector<unsigned char> > levels(1);
+    CompressImageBC1(std::vector<unsigned char>(data, data + 3 * width * height), width, height, &levels[0]);
+    stbi_image_free(data);
+
+    // Demais níveis, até 1x1
+    std::vector<unsigned char> rgb;
+    std::vector<float> smaller;
+    int w = width, h = height;
+    while ( w > 1 || h > 1 )
+    {
+        Downsample(linear, w, h, &smaller, &w, &h);
+        linear.swap(smaller);
+
+        rgb.resize(linear.size());
+        for (size_t i = 0; i < linear.size(); ++i)
+            rgb[i] = LinearToSRGB8(linear[i]);
+
+        levels.push_back(std::vector<unsigned char>());
+        CompressImageBC1(rgb, w, h, &levels.back());
+    }
+
+    // Metadados: um único par chave/valor com a origem do arquivo
+    const uint32_t key_value_size = (uint32_t)(sizeof(ktx_source_key) + stamp.size() + 1);
+    std::vector<unsigned char> key_value(4 + AlignTo4(key_value_size), 0);
+    memcpy(&key_value[0], &key_value_size, 4);
+    memcpy(&key_value[4], ktx_source_key, sizeof(ktx_source_key));
+    memcpy(&key_value[4 + sizeof(ktx_source_key)], stamp.c_str(), stamp.size() + 1);
+
+    KTXHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.identifier, ktx_identifier, sizeof(ktx_identifier));
+    header.endianness              = 0x04030201;
+    header.gl_type                 = 0; // Compressão: tipo e formato são zero
+    header.gl_type_size            = 1;
+    header.gl_format               = 0;
+    header.gl_internal_format      = GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    header.gl_base_internal_format = GL_RGB;
+    header.pixel_width             = (uint32_t)width;
+    header.pixel_height            = (uint32_t)height;
+    header.number_of_faces         = 1;
+    header.number_of_mipmap_levels = (uint32_t)levels.size();
+    header.bytes_of_key_value_data = (uint32_t)key_value.size();
+
+    // Escrevemos em um arquivo temporário e só depois o renomeamos, como em
+    // MeshCache_Write().
+    std::string tmp_filename = std::string(ktx_filename) + ".tmp";
+    FILE* file = fopen(tmp_filename.c_str(), "wb");
+    if ( file == NULL )
+    {
+        fprintf(stderr, "ERROR: Cannot create \"%s\".\n", ktx_filename);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(key_value.data(), 1, key_value.size(), file) == key_value.size();
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        // BC1 sempre tem tamanho múltiplo de 8, então não há preenchimento
+        uint32_t image_size = (uint32_t)levels[i].size();
+        ok = ok && fwrite(&image_size, 4, 1, file) == 1;
+        ok = ok && fwrite(levels[i].data(), 1, image_size, file) == image_size;
+    }
+    ok = (fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+    remove(ktx_filename);
+#endif
+    if ( !ok || rename(tmp_filename.c_str(), ktx_filename) != 0 )
+    {
+        fprintf(stderr, "ERROR: Cannot write \"%s\".\n", ktx_filename);
+        remove(tmp_filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool TextureCook_LoadKTX(const char* ktx_filename, const char* source_filename, CompressedTexture* texture)
+{
+    std::string stamp;
+    if ( !SourceStamp(source_filename, &stamp) )
+        return false;
+
+    FILE* file = fopen(ktx_filename, "rb");
+    if ( file == NULL )
+        return false;
+
+    std::vector<unsigned char> contents;
+    unsigned char buffer[64*1024];
+    size_t n;
+    while ( (n = fread(buffer, 1, sizeof(buffer), file)) > 0 )
+        contents.insert(contents.end(), buffer, buffer + n);
+    fclose(file);
+
+    KTXHeader header;
+    if ( contents.size() < sizeof(header) )
+        return false;
+    memcpy(&header, contents.data(), sizeof(header));
+
+    if ( memcmp(header.identifier, ktx_identifier, sizeof(ktx_identifier)) != 0
+      || header.endianness != 0x04030201
+      || header.gl_internal_format != GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+      || header.number_of_faces != 1
+      || header.number_of_array_elements != 0
+      || header.number_of_mipmap_levels == 0 )
+        return false;
+
+    size_t offset = sizeof(header);
+    if ( offset + header.bytes_of_key_value_data > contents.size() )
+        return false;
+
+    // Procuramos a chave com a origem do arquivo
+    bool up_to_date = false;
+    size_t end = offset + header.bytes_of_key_value_data;
+    while ( offset + 4 <= end )
+    {
+        uint32_t size;
+        memcpy(&size, &contents[offset], 4);
+        offset += 4;
+        if ( offset + size > end )
+            return false;
+
+        const char* pair = (const char*)&contents[offset];
+        if ( size > sizeof(ktx_source_key) && memcmp(pair, ktx_source_key, sizeof(ktx_source_key)) == 0 )
+        {
+            const char* value  = pair + sizeof(ktx_source_key);
+            size_t      length = size - sizeof(ktx_source_key);
+            const char* nul    = (const char*)memchr(value, 0, length);
+            if ( nul != NULL )
+                length = nul - value;
+            up_to_date = stamp == std::string(value, length);
+        }
+
+        offset += AlignTo4(size);
+    }
+    offset = end;
+
+    if ( !up_to_date )
+        return false;
+
+    texture->internal_format = header.gl_internal_format;
+    texture->levels.clear();
+
+    int width  = (int)header.pixel_width;
+    int height = (int)header.pixel_height;
+    for (uint32_t i = 0; i < header.number_of_mipmap_levels; ++i)
+    {
+        uint32_t image_size;
+        if ( offset + 4 > contents.size() )
+            return false;
+        memcpy(&image_size, &contents[offset], 4);
+        offset += 4;
+
+        const uint32_t expected = 8 * ((width + 3) / 4) * ((height + 3) / 4);
+        if ( image_size != expected || offset + image_size > contents.size() )
+            return false;
+
+        CompressedTexture::Level level;
+        level.width  = width;
+        level.height = height;
+        level.offset = offset;
+        level.size   = image_size;
+        texture->levels.push_back(level);
+
+        offset += AlignTo4(image_size);
+        width  = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    texture->data.swap(contents);
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef _TEXTURECOOK_H
+#define _TEXTURECOOK_H
+
+// "Cozimento" (pré-processamento) das imagens de textura.
+//
+// Decodificar JPG/PNG a cada execução, enviar os pixels sem compressão para a
+// GPU e gerar os mipmaps com glGenerateMipmap() é lento e ocupa muita memória
+// de vídeo. Com "./main --cook" (ou "make cook"), cada imagem é convertida
+// para um arquivo "<imagem>.ktx" (formato KTX 1.1, veja
+// https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html) ao lado da
+// imagem original, contendo todos os níveis de mipmap já comprimidos no
+// formato BC1 (também conhecido como DXT1 ou S3TC), com 4 bits por pixel.
+//
+// LoadTextureImage() em "main.cpp" utiliza o arquivo cozido quando ele existe,
+// corresponde à imagem original e a GPU suporta BC1; caso contrário, a imagem
+// original é carregada como antes.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Formatos de EXT_texture_compression_s3tc e EXT_texture_sRGB, que não estão
+// em "glad.h" pois não fazem parte do OpenGL 3.3.
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+
+// Textura comprimida lida de um arquivo KTX, pronta para glCompressedTexImage2D()
+struct CompressedTexture
+{
+    struct Level
+    {
+        int    width;
+        int    height;
+        size_t offset; // Posição dos dados do nível dentro de "data"
+        size_t size;
+    };
+
+    GLenum                     internal_format;
+    std::vector<Level>         levels; // Nível 0 é a imagem em resolução máxima
+    std::vector<unsigned char> data;
+};
+
+// Nome do arquivo cozido correspondente a uma imagem
+std::string TextureCook_Filename(const char* source_filename);
+
+// Lê uma imagem, gera todos os níveis de mipmap, comprime-os em BC1 e grava o
+// arquivo KTX. A imagem é lida com a stb_image, então quem chama deve definir
+// stbi_set_flip_vertically_on_load() da mesma forma que LoadTextureImage().
+// Retorna false (e imprime o erro) em caso de falha.
+bool TextureCook_CookFile(const char* source_filename, const char* ktx_filename);
+
+// Lê um arquivo KTX gerado por TextureCook_CookFile(). Retorna false se o
+// arquivo não existe, é inválido, ou foi gerado a partir de outra versão da
+// imagem original.
+bool TextureCook_LoadKTX(const char* ktx_filename, const char* source_filename, CompressedTexture* texture);
+
+// Retorna true se o contexto OpenGL atual suporta texturas BC1 em sRGB. Deve
+// ser chamada na thread com o contexto OpenGL.
+bool TextureCook_IsSupported();
+
+#endif // _TEXTURECOOK_H